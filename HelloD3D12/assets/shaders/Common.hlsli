@@ -0,0 +1,42 @@
+// Declarations shared by the scene shaders, the layouts mirror ShaderTypes.h.
+
+// must match ShadowMap::CascadeCount
+#define SHADOW_CASCADE_COUNT 4
+
+// must match the LightClusters grid
+#define CLUSTER_TILE_COUNT_X 16
+#define CLUSTER_TILE_COUNT_Y 9
+#define CLUSTER_SLICE_COUNT 24
+
+cbuffer FrameConstants : register(b0)
+{
+    float4x4 gViewProj;
+    float4x4 gCascadeViewProj[SHADOW_CASCADE_COUNT];
+    float4   gCascadeSplits;
+    float4   gCascadeBias;
+    float3   gLightDir;
+    float    gClusterDepthScale;
+    float2   gClusterTileScale;
+    float    gClusterDepthBias;
+}
+
+cbuffer DrawConstants : register(b1)
+{
+    uint gInstanceBase;
+    uint gMaterialIndex;
+}
+
+struct InstanceData
+{
+    float4x4 world;
+};
+
+struct LightData
+{
+    float3 position;
+    float  range;
+    float3 color;
+    float  spotCosOuter;
+    float3 direction;
+    float  spotCosInner;
+};
\ No newline at end of file
@@ -0,0 +1,15 @@
+#include "Common.hlsli"
+
+StructuredBuffer<InstanceData> gInstances : register(t0);
+StructuredBuffer<uint> gInstanceIndices : register(t1);
+
+cbuffer CascadeConstants : register(b2)
+{
+    uint gCascade;
+}
+
+float4 VSMain(float3 position : POSITION, float2 uv : TEXCOORD, float3 normal : NORMAL, uint instanceId : SV_InstanceID) : SV_POSITION
+{
+    float4x4 world = gInstances[gInstanceIndices[gInstanceBase + instanceId]].world;
+    return mul(mul(float4(position, 1.0f), world), gCascadeViewProj[gCascade]);
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#include "Common.hlsli"
+
+// must match SimpleShader::MaxMaterials
+#ifndef MAX_MATERIALS
+#define MAX_MATERIALS 256
+#endif
+
+// Variant features, see ShaderFeature. The project builds the default variant, the others are compiled
+// by SimpleShader when they are first used.
+#ifndef SHADOWS
+#define SHADOWS 0
+#endif
+#ifndef ALPHA_TEST
+#define ALPHA_TEST 0
+#endif
+#ifndef INSTANCING
+#define INSTANCING 0
+#endif
+
+struct PSInput
+{
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD;
+    float3 normal : NORMAL;
+    float3 worldPosition : POSITION;
+    float viewDepth : VIEWDEPTH;
+};
\ No newline at end of file
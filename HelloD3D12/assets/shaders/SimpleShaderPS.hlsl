@@ -0,0 +1,59 @@
+#include "SimpleShader.hlsli"
+
+// the table is sized at build time, SimpleShader checks the count against its root signature
+Texture2D g_textures[MAX_MATERIALS] : register(t0, space1);
+Texture2DArray g_shadowtexture : register(t1);
+SamplerState g_sampler : register(s0);
+
+// clustered lights, see LightClusters. A cell holds the offset and count of the cluster in the index list.
+StructuredBuffer<LightData> gLights : register(t4);
+StructuredBuffer<uint2> gLightCells : register(t5);
+StructuredBuffer<uint> gLightIndices : register(t6);
+
+float3 shadeClusteredLights(float4 screenPosition, float3 worldPosition, float viewDepth, float3 normal)
+{
+    uint2 tile = min(uint2(screenPosition.xy * gClusterTileScale), uint2(CLUSTER_TILE_COUNT_X - 1, CLUSTER_TILE_COUNT_Y - 1));
+    uint slice = min((uint)max(floor(log(viewDepth) * gClusterDepthScale + gClusterDepthBias), 0.f), CLUSTER_SLICE_COUNT - 1);
+    uint2 cell = gLightCells[(slice * CLUSTER_TILE_COUNT_Y + tile.y) * CLUSTER_TILE_COUNT_X + tile.x];
+
+    float3 lighting = 0.f;
+    for (uint i = 0; i < cell.y; i++)
+    {
+        LightData light = gLights[gLightIndices[cell.x + i]];
+        float3 toLight = light.position - worldPosition;
+        float distanceSq = dot(toLight, toLight);
+        float3 lightDir = toLight * rsqrt(max(distanceSq, 1e-8f));
+        // smooth falloff reaching 0 at the range, the cluster bounds assume the light ends there
+        float falloff = saturate(1.f - distanceSq / (light.range * light.range));
+        // point lights have cosines below -1, the cone covers every direction
+        float cone = smoothstep(light.spotCosOuter, light.spotCosInner, dot(-lightDir, light.direction));
+        lighting += light.color * (saturate(dot(normal, lightDir)) * falloff * falloff * cone);
+    }
+    return lighting;
+}
+
+float4 PSMain(PSInput input) : SV_TARGET
+{
+    float4 color = g_textures[gMaterialIndex].Sample(g_sampler, input.uv);
+#if ALPHA_TEST
+    clip(color.a - 0.5f);
+#endif
+
+#if SHADOWS
+    // the first cascade ending behind the pixel, the cascades are orthographic so there is no divide by w
+    uint cascade = min((uint)dot(float4(input.viewDepth > gCascadeSplits), 1.f), SHADOW_CASCADE_COUNT - 1);
+    float4 shadowPos = mul(float4(input.worldPosition, 1.0f), gCascadeViewProj[cascade]);
+    float2 shadowCoord = 0.5f * shadowPos.xy + 0.5f;
+    shadowCoord.y = 1.0f - shadowCoord.y;
+    float shadowDepth = shadowPos.z - gCascadeBias[cascade];
+    float shadowMapDepth = g_shadowtexture.Sample(g_sampler, float3(shadowCoord, cascade));
+    float shadowScale = shadowMapDepth > shadowDepth ? 1.f : 0.2f;
+#else
+    float shadowScale = 1.f;
+#endif
+
+    float3 wNormal = normalize(input.normal);
+    float intensity = saturate(dot(wNormal, -gLightDir)) * shadowScale;
+    float3 lighting = intensity + shadeClusteredLights(input.position, input.worldPosition, input.viewDepth, wNormal);
+    return float4(color.rgb * lighting, color.a * intensity);
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#include "SimpleShader.hlsli"
+
+StructuredBuffer<InstanceData> gInstances : register(t2);
+StructuredBuffer<uint> gInstanceIndices : register(t3);
+
+// Quantized vertices need no code here, the input layout expands them to float.
+PSInput VSMain(float3 position : POSITION, float2 uv : TEXCOORD, float3 normal : NORMAL, uint instanceId : SV_InstanceID)
+{
+    PSInput result;
+
+#if INSTANCING
+    float4x4 world = gInstances[gInstanceIndices[gInstanceBase + instanceId]].world;
+#else
+    float4x4 world = gInstances[gInstanceIndices[gInstanceBase]].world;
+#endif
+    float4 worldPosition = mul(float4(position, 1.0f), world);
+    result.position = mul(worldPosition, gViewProj);
+    result.uv = uv;
+    result.normal = mul(float4(normal, 0.f), world).xyz;
+    result.worldPosition = worldPosition.xyz;
+    result.viewDepth = result.position.w;
+
+    return result;
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "ResourceStateTracker.h"
+
+namespace HDX
+{
+
+// Collects the barriers of one command list and records them with a single ResourceBarrier call per flush().
+// Resources are tracked with the state they are in when the batcher first meets them, transitions then only
+// name the state they go to and are dropped when the resource is already there.
+// Not thread safe, use one batcher per command list being recorded.
+class BarrierBatcher
+{
+public:
+    // Forgets the tracked resources, e.g. when a new frame starts.
+    void reset();
+
+    void track(ID3D12Resource* resource, D3D12_RESOURCE_STATES state, UINT subresourceCount = 1);
+    bool isTracked(ID3D12Resource* resource) const { return mHandles.find(resource) != mHandles.end(); }
+    D3D12_RESOURCE_STATES getState(ID3D12Resource* resource, UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES) const;
+
+    void transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES state, UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+    // Split transition, the GPU may start it while the commands in between execute. The subresource keeps
+    // its old state until endTransition() is called with the same subresource.
+    void beginTransition(ID3D12Resource* resource, D3D12_RESOURCE_STATES state, UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+    void endTransition(ID3D12Resource* resource, UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+
+    void aliasing(ID3D12Resource* before, ID3D12Resource* after);
+    void uav(ID3D12Resource* resource);
+
+    // Records the queued barriers, in the order they were queued.
+    void flush(ID3D12GraphicsCommandList* commandList);
+
+    // Split transitions begun and not ended yet, they have to be ended before the command list is closed.
+    uint32_t getPendingCount() const { return mTracker.getPendingCount(); }
+    uint32_t getFlushCount() const { return mFlushCount; }
+    uint32_t getBarrierCount() const { return mBarrierCount; }
+
+    static UINT getSubresourceCount(const D3D12_RESOURCE_DESC& desc);
+
+private:
+    uint32_t getHandle(ID3D12Resource* resource) const;
+    void queueTransitions();
+
+    ResourceStateTracker mTracker;
+    std::unordered_map<ID3D12Resource*, uint32_t> mHandles;
+    std::vector<ID3D12Resource*> mResources;
+    std::vector<StateTransition> mTransitions;
+    std::vector<D3D12_RESOURCE_BARRIER> mBarriers;
+    uint32_t mFlushCount{ 0 };
+    uint32_t mBarrierCount{ 0 };
+};
+
+}
\ No newline at end of file
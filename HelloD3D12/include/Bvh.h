@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MathTypes.h"
+
+namespace HDX
+{
+
+// Dynamic bounding volume hierarchy over object bounds, backing frustum culling, light (sphere) queries and ray
+// picking.
+// build() creates a binary tree with a binned surface area heuristic. refit() updates the boxes after objects moved
+// and can rotate subtrees (swap a child with a grandchild when that shrinks the affected node, Kopta et al. 2012),
+// so the tree keeps its quality over many frames without rebuilds.
+// Queries run on a BVH4 collapsed from the binary tree after every build and refit. A BVH4 node holds the boxes of
+// its four children as structure of arrays, so one SSE instruction tests all four and a node is 144 bytes.
+// Objects are reordered depth first in the collapse, every subtree covers a contiguous range of objects, so a subtree
+// fully inside the frustum is accepted without visiting it.
+class Bvh
+{
+public:
+    // leaves of the binary tree, each of their objects gets a lane of a BVH4 node, so at most 4
+    static const uint32_t MaxLeafSize{ 4 };
+    // deeper subtrees of the BVH4 become one leaf, which bounds the traversal stacks
+    static const uint32_t MaxDepth{ 64 };
+    static const uint32_t InvalidIndex{ 0xffffffff };
+
+    struct Box
+    {
+        float min[3];
+        float max[3];
+    };
+
+    struct Stats
+    {
+        uint32_t binaryNodes{ 0 };
+        uint32_t wideNodes{ 0 };
+        // depth of the BVH4
+        uint32_t depth{ 0 };
+        uint32_t rotations{ 0 };
+        // surface area heuristic cost of the binary tree relative to the root area, lower is better
+        float sahCost{ 0.f };
+    };
+
+    void build(const Bounds* bounds, uint32_t count);
+    // bounds holds the same objects as in build, in the same order
+    void refit(const Bounds* bounds, bool rotate);
+
+    uint32_t getCount() const { return static_cast<uint32_t>(mObjectBoxes.size()); }
+    const Stats& getStats() const { return mStats; }
+
+    // Writes 1 to visible[i] for the objects intersecting the convex volume and 0 for the others, returns how many
+    // are visible. Read only, several queries can run at once.
+    uint32_t cull(const Plane* planes, uint32_t planeCount, uint8_t* visible) const;
+    // Appends the objects whose box overlaps the sphere.
+    void querySphere(const Float3& center, float radius, std::vector<uint32_t>& objects) const;
+    // Object whose box the ray enters first within maxDistance, InvalidIndex when it hits nothing.
+    uint32_t raycast(const Float3& origin, const Float3& direction, float maxDistance, float* hitDistance) const;
+
+private:
+    struct BinaryNode
+    {
+        Box box;
+        uint32_t left;
+        uint32_t right;
+        // leaf objects in mBuildIndices, count is 0 for inner nodes
+        uint32_t first;
+        uint32_t count;
+    };
+
+    struct BuildRef
+    {
+        Box box;
+        float centroid[3];
+        uint32_t object;
+    };
+
+    struct alignas(16) WideNode
+    {
+        float minX[4];
+        float minY[4];
+        float minZ[4];
+        float maxX[4];
+        float maxY[4];
+        float maxZ[4];
+        // wide node index, InvalidIndex for leaves
+        uint32_t child[4];
+        // objects of the child subtree in mObjects, count is 0 for empty slots
+        uint32_t first[4];
+        uint32_t count[4];
+    };
+
+    uint32_t buildNode(uint32_t first, uint32_t count, uint32_t depth);
+    void refitNode(uint32_t node, bool rotate);
+    void rotate(uint32_t node);
+    void appendObjects(uint32_t node);
+    uint32_t collapseNode(uint32_t node, uint32_t depth);
+    void setLane(uint32_t node, uint32_t lane, const Box& box, uint32_t child, uint32_t first, uint32_t count, uint32_t source);
+    void collapse();
+    void updateSahCost();
+
+    static const uint32_t ObjectSource{ 0x80000000 };
+
+    std::vector<Box> mObjectBoxes;
+    std::vector<uint32_t> mBuildIndices;
+    std::vector<BinaryNode> mBinaryNodes;
+    uint32_t mBinaryRoot{ InvalidIndex };
+
+    // only used while building
+    std::vector<BuildRef> mBuildRefs;
+
+    std::vector<WideNode> mWideNodes;
+    // binary node or ObjectSource | object each wide child was collapsed from, 4 per wide node, a refit without
+    // rotations copies their boxes
+    std::vector<uint32_t> mWideSources;
+    // object indices in depth first order of the wide tree
+    std::vector<uint32_t> mObjects;
+
+    Stats mStats;
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace HDX
+{
+
+// Key to blob store persisted between runs, e.g. compiled shaders keyed by the hash of their source.
+// The file layout is fixed little endian regardless of the platform:
+//   header  "HDXC", uint32 version, uint64 tag, uint32 entry count, uint32 reserved
+//   entries uint64 key, uint64 FNV-1a of the data, uint32 size, uint32 reserved, size bytes of data
+// Entries are written sorted by key, so equal contents give identical files. The tag identifies what produced
+// the blobs, e.g. the compiler version, a file with another tag is ignored as a whole. Entries whose data does
+// not match its hash are dropped one by one.
+class CacheFile
+{
+public:
+    static const uint32_t Version{ 1 };
+    static const size_t HeaderSize{ 24 };
+    static const size_t EntryHeaderSize{ 24 };
+
+    explicit CacheFile(uint64_t tag = 0) : mTag(tag) {}
+
+    // Replaces the entries with the ones of data, false when data is not a cache of this version and tag.
+    bool deserialize(const uint8_t* data, size_t size);
+    void serialize(std::vector<uint8_t>& data) const;
+
+    // A missing or unreadable file leaves the cache empty.
+    bool load(const char* path);
+    bool save(const char* path);
+
+    const std::vector<uint8_t>* find(uint64_t key) const;
+    void insert(uint64_t key, const void* data, size_t size);
+
+    uint64_t getTag() const { return mTag; }
+    size_t getEntryCount() const { return mEntries.size(); }
+    // entries inserted since the last load or save
+    bool isDirty() const { return mDirty; }
+    uint32_t getCorruptEntryCount() const { return mCorruptEntries; }
+
+private:
+    uint64_t mTag;
+    std::unordered_map<uint64_t, std::vector<uint8_t>> mEntries;
+    bool mDirty{ false };
+    uint32_t mCorruptEntries{ 0 };
+};
+
+}
\ No newline at end of file
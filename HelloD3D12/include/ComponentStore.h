@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace HDX
+{
+
+// Entity handle, the slot in the low 24 bits and its generation in the high 8 bits, so a handle to a destroyed
+// entity does not alias the next entity reusing the slot.
+typedef uint32_t Entity;
+static const Entity InvalidEntity{ 0xffffffff };
+
+class EntityPool
+{
+public:
+    static const uint32_t SlotBits{ 24 };
+    static const uint32_t SlotMask{ (1u << SlotBits) - 1 };
+
+    static uint32_t getSlot(Entity entity) { return entity & SlotMask; }
+
+    Entity create();
+    void destroy(Entity entity);
+    bool isAlive(Entity entity) const;
+
+    uint32_t getCount() const { return static_cast<uint32_t>(mGenerations.size() - mFreeSlots.size()); }
+
+private:
+    std::vector<uint8_t> mGenerations;
+    std::vector<uint32_t> mFreeSlots;
+};
+
+// Sparse set storing the components of one archetype in parallel dense arrays: the components of an entity share
+// the same dense index in every array, so systems iterate plain arrays and only read the components they need.
+// The sparse array maps an entity slot to its dense index. Removal moves the last entity into the hole, so the
+// arrays stay packed but dense indices are not stable across removals, keep the Entity to refer to an object.
+template <typename... Components>
+class ComponentStore
+{
+public:
+    static const uint32_t InvalidIndex{ 0xffffffff };
+
+    // Returns the dense index of the entity.
+    uint32_t add(Entity entity, Components... components)
+    {
+        const uint32_t slot = EntityPool::getSlot(entity);
+        if (slot >= mSparse.size())
+        {
+            mSparse.resize(slot + 1, InvalidIndex);
+        }
+        assert(mSparse[slot] == InvalidIndex);
+
+        const uint32_t index = static_cast<uint32_t>(mDense.size());
+        mSparse[slot] = index;
+        mDense.push_back(entity);
+        using Expand = int[];
+        (void)Expand{ 0, (std::get<std::vector<Components>>(mArrays).push_back(std::move(components)), 0)... };
+        return index;
+    }
+
+    void remove(Entity entity)
+    {
+        assert(contains(entity));
+        const uint32_t slot = EntityPool::getSlot(entity);
+        const uint32_t index = mSparse[slot];
+        const uint32_t last = static_cast<uint32_t>(mDense.size() - 1);
+        if (index != last)
+        {
+            mDense[index] = mDense[last];
+            mSparse[EntityPool::getSlot(mDense[index])] = index;
+            using Expand = int[];
+            (void)Expand{ 0, (moveLast(std::get<std::vector<Components>>(mArrays), index), 0)... };
+        }
+        mDense.pop_back();
+        using Expand = int[];
+        (void)Expand{ 0, (std::get<std::vector<Components>>(mArrays).pop_back(), 0)... };
+        mSparse[slot] = InvalidIndex;
+    }
+
+    bool contains(Entity entity) const
+    {
+        const uint32_t slot = EntityPool::getSlot(entity);
+        return slot < mSparse.size() && mSparse[slot] != InvalidIndex && mDense[mSparse[slot]] == entity;
+    }
+
+    uint32_t getIndex(Entity entity) const { return contains(entity) ? mSparse[EntityPool::getSlot(entity)] : InvalidIndex; }
+    Entity getEntity(uint32_t index) const { return mDense[index]; }
+    uint32_t getCount() const { return static_cast<uint32_t>(mDense.size()); }
+
+    // dense array of one component type, getCount() elements
+    template <typename T>
+    T* get() { return std::get<std::vector<T>>(mArrays).data(); }
+    template <typename T>
+    const T* get() const { return std::get<std::vector<T>>(mArrays).data(); }
+
+    void reserve(uint32_t count)
+    {
+        mDense.reserve(count);
+        using Expand = int[];
+        (void)Expand{ 0, (std::get<std::vector<Components>>(mArrays).reserve(count), 0)... };
+    }
+
+private:
+    template <typename T>
+    static void moveLast(std::vector<T>& array, uint32_t index)
+    {
+        array[index] = std::move(array.back());
+    }
+
+    std::vector<uint32_t> mSparse;
+    std::vector<Entity> mDense;
+    std::tuple<std::vector<Components>...> mArrays;
+};
+
+template <typename... Components>
+const uint32_t ComponentStore<Components...>::InvalidIndex;
+
+}
\ No newline at end of file
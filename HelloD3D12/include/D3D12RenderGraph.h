@@ -0,0 +1,111 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "BarrierBatcher.h"
+#include "DeferredDeletionQueue.h"
+#include "RenderGraph.h"
+
+using namespace Microsoft::WRL;
+
+namespace HDX
+{
+
+// Runs a RenderGraph on D3D12. Transient textures are placed in one heap per alias group and cached across frames,
+// so a graph declaring the same resources every frame keeps the same ID3D12Resources and descriptors stay valid.
+// Passes of one command list are recorded in declaration order, different command lists may be recorded in parallel.
+class D3D12RenderGraph
+{
+public:
+    typedef RenderGraph::ResourceHandle ResourceHandle;
+    typedef RenderGraph::PassHandle PassHandle;
+    typedef std::function<void(ID3D12GraphicsCommandList*)> ExecuteFunction;
+
+    bool prepare(ID3D12Device* device, uint32_t framesInFlight);
+
+    // Starts the declarations of a new frame.
+    void reset();
+
+    ResourceHandle importResource(const char* name, ID3D12Resource* resource, D3D12_RESOURCE_STATES initialState, D3D12_RESOURCE_STATES finalState);
+    ResourceHandle createTexture(const char* name, const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE* clearValue);
+
+    PassHandle addPass(const char* name, uint32_t commandList, ExecuteFunction execute, bool hasSideEffects = false);
+    void read(PassHandle pass, ResourceHandle resource, D3D12_RESOURCE_STATES state);
+    void write(PassHandle pass, ResourceHandle resource, D3D12_RESOURCE_STATES state);
+
+    // Compiles the graph and creates the transient resources it needs.
+    bool compile();
+
+    // Resource of a handle this frame, valid after compile().
+    ID3D12Resource* getResource(ResourceHandle resource) const { return mResources[resource]; }
+
+    void record(uint32_t commandList, ID3D12GraphicsCommandList* commandListObject);
+    // Ends the transitions to the final states, the last thing recorded before closing the command list.
+    void finish(uint32_t commandList, ID3D12GraphicsCommandList* commandListObject);
+
+    const RenderGraph& getGraph() const { return mGraph; }
+    double getCompileMs() const { return mCompileMs; }
+    UINT64 getHeapBytes() const;
+    // ResourceBarrier calls recorded this frame, valid once every command list is finished.
+    uint32_t getBarrierCallCount() const;
+
+private:
+    enum AliasGroup : uint32_t
+    {
+        AliasGroupRenderTargets,
+        AliasGroupTextures,
+        AliasGroupCount
+    };
+
+    struct TextureDecl
+    {
+        D3D12_RESOURCE_DESC desc;
+        D3D12_CLEAR_VALUE clearValue;
+        bool hasClearValue;
+    };
+
+    struct CachedTexture
+    {
+        TextureDecl decl;
+        uint32_t aliasGroup;
+        uint32_t heapGeneration;
+        UINT64 offset;
+        D3D12_RESOURCE_STATES initialState;
+        ComPtr<ID3D12Resource> resource;
+        uint64_t lastUsedFrame;
+    };
+
+    // Completes a frame once framesInFlight newer frames started, the frame fences guarantee it.
+    struct FrameFence
+    {
+        const uint64_t* frame;
+        uint64_t framesInFlight;
+
+        uint64_t getCompletedValue() const { return *frame > framesInFlight ? *frame - framesInFlight : 0; }
+    };
+
+    ID3D12Resource* acquireTexture(ResourceHandle handle);
+    void queueBarriers(BarrierBatcher& batcher, uint32_t first, uint32_t count);
+
+    ComPtr<ID3D12Device> mDevice;
+    RenderGraph mGraph;
+
+    std::vector<ID3D12Resource*> mResources;
+    std::vector<TextureDecl> mTextureDecls;
+    std::vector<ExecuteFunction> mPassFunctions;
+    // one per command list so different lists record in parallel
+    std::vector<BarrierBatcher> mBatchers;
+
+    ComPtr<ID3D12Heap> mHeaps[AliasGroupCount];
+    UINT64 mHeapSizes[AliasGroupCount]{};
+    uint32_t mHeapGenerations[AliasGroupCount]{};
+    std::vector<CachedTexture> mTextureCache;
+
+    uint64_t mFrame{ 0 };
+    std::unique_ptr<DeferredDeletionQueue<FrameFence, ComPtr<ID3D12Pageable>>> mRetired;
+    double mCompileMs{ 0. };
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+namespace HDX
+{
+
+// Keeps objects alive until the GPU is done with them. Each object is queued with the fence value of its last use
+// and released by collect() once the fence reports that value completed.
+// Fence is anything with a uint64_t getCompletedValue() const, read once per collect(), so the queue works with
+// an ID3D12Fence in the renderer and with a plain counter elsewhere.
+// Payload is released by destroying it, e.g. a ComPtr dropping its reference.
+template <typename Fence, typename Payload>
+class DeferredDeletionQueue
+{
+public:
+    explicit DeferredDeletionQueue(Fence fence = Fence())
+        : mFence(std::move(fence))
+    {
+    }
+
+    DeferredDeletionQueue(const DeferredDeletionQueue&) = delete;
+    DeferredDeletionQueue& operator=(const DeferredDeletionQueue&) = delete;
+
+    // Objects sharing a fence value go into the same batch. Fence values are expected to mostly increase,
+    // an older value is still sorted into place so nothing is released before its own fence.
+    void enqueue(Payload payload, uint64_t lastUseFenceValue)
+    {
+        if (mBatches.empty() || mBatches.back().fenceValue < lastUseFenceValue)
+        {
+            mBatches.emplace_back();
+            mBatches.back().fenceValue = lastUseFenceValue;
+            mBatches.back().payloads.push_back(std::move(payload));
+        }
+        else
+        {
+            auto it = mBatches.end();
+            while (it != mBatches.begin() && (it - 1)->fenceValue >= lastUseFenceValue)
+            {
+                --it;
+            }
+
+            if (it == mBatches.end() || it->fenceValue != lastUseFenceValue)
+            {
+                it = mBatches.emplace(it);
+                it->fenceValue = lastUseFenceValue;
+            }
+            it->payloads.push_back(std::move(payload));
+        }
+        mPendingCount++;
+    }
+
+    // Releases every batch whose fence value completed, returns the number of objects released.
+    size_t collect()
+    {
+        if (mBatches.empty())
+        {
+            return 0;
+        }
+        return releaseUpTo(mFence.getCompletedValue());
+    }
+
+    // Releases everything, only safe once the GPU is idle.
+    size_t flush()
+    {
+        return releaseUpTo(UINT64_MAX);
+    }
+
+    size_t getPendingCount() const { return mPendingCount; }
+    size_t getReleasedCount() const { return mReleasedCount; }
+    uint64_t getOldestFenceValue() const { return mBatches.empty() ? 0 : mBatches.front().fenceValue; }
+
+    const Fence& getFence() const { return mFence; }
+
+private:
+    struct Batch
+    {
+        uint64_t fenceValue;
+        std::vector<Payload> payloads;
+    };
+
+    size_t releaseUpTo(uint64_t completedFenceValue)
+    {
+        size_t released = 0;
+        while (!mBatches.empty() && mBatches.front().fenceValue <= completedFenceValue)
+        {
+            released += mBatches.front().payloads.size();
+            mBatches.pop_front();
+        }
+
+        mPendingCount -= released;
+        mReleasedCount += released;
+        return released;
+    }
+
+    Fence mFence;
+    std::deque<Batch> mBatches;
+    size_t mPendingCount{ 0 };
+    size_t mReleasedCount{ 0 };
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace HDX
+{
+
+enum class RenderPass : uint32_t
+{
+    Shadow = 0,
+    Main = 1,
+};
+
+// 64 bit draw sort key, most significant field first:
+// | pass:4 | root signature:6 | pipeline:10 | material:14 | mesh:14 | depth:16 |
+// Sorting the keys groups draws by the most expensive state first, then front to back inside a state bucket.
+struct DrawSortKey
+{
+    static const uint32_t PassBits{ 4 };
+    static const uint32_t RootSignatureBits{ 6 };
+    static const uint32_t PipelineBits{ 10 };
+    static const uint32_t MaterialBits{ 14 };
+    static const uint32_t MeshBits{ 14 };
+    static const uint32_t DepthBits{ 16 };
+
+    static const uint32_t DepthShift{ 0 };
+    static const uint32_t MeshShift{ DepthShift + DepthBits };
+    static const uint32_t MaterialShift{ MeshShift + MeshBits };
+    static const uint32_t PipelineShift{ MaterialShift + MaterialBits };
+    static const uint32_t RootSignatureShift{ PipelineShift + PipelineBits };
+    static const uint32_t PassShift{ RootSignatureShift + RootSignatureBits };
+
+    static uint64_t make(RenderPass pass, uint32_t rootSignature, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depthBucket)
+    {
+        return encode(static_cast<uint32_t>(pass), PassShift, PassBits)
+            | encode(rootSignature, RootSignatureShift, RootSignatureBits)
+            | encode(pipeline, PipelineShift, PipelineBits)
+            | encode(material, MaterialShift, MaterialBits)
+            | encode(mesh, MeshShift, MeshBits)
+            | encode(depthBucket, DepthShift, DepthBits);
+    }
+
+    // Linear depth bucket in [nearZ, farZ], closer draws get smaller buckets.
+    static uint32_t quantizeDepth(float viewDepth, float nearZ, float farZ)
+    {
+        float t = (viewDepth - nearZ) / (farZ - nearZ);
+        t = t < 0.f ? 0.f : (t > 1.f ? 1.f : t);
+        return static_cast<uint32_t>(t * static_cast<float>((1u << DepthBits) - 1));
+    }
+
+    static uint32_t getPass(uint64_t key) { return decode(key, PassShift, PassBits); }
+    static uint32_t getRootSignature(uint64_t key) { return decode(key, RootSignatureShift, RootSignatureBits); }
+    static uint32_t getPipeline(uint64_t key) { return decode(key, PipelineShift, PipelineBits); }
+    static uint32_t getMaterial(uint64_t key) { return decode(key, MaterialShift, MaterialBits); }
+    static uint32_t getMesh(uint64_t key) { return decode(key, MeshShift, MeshBits); }
+    static uint32_t getDepth(uint64_t key) { return decode(key, DepthShift, DepthBits); }
+
+private:
+    static uint64_t encode(uint32_t value, uint32_t shift, uint32_t bits)
+    {
+        return (static_cast<uint64_t>(value) & ((1ull << bits) - 1)) << shift;
+    }
+
+    static uint32_t decode(uint64_t key, uint32_t shift, uint32_t bits)
+    {
+        return static_cast<uint32_t>((key >> shift) & ((1ull << bits) - 1));
+    }
+};
+
+struct DrawPacket
+{
+    uint64_t key;
+    uint32_t drawIndex;
+    uint32_t padding;
+};
+
+// LSD radix sort on DrawPacket::key, 8 bits per pass. Passes where every key shares the same digit are skipped.
+// scratch must hold count packets. The result is stable and always ends up in packets.
+void radixSortDrawPackets(DrawPacket* packets, DrawPacket* scratch, size_t count);
+
+struct StateChangeStats
+{
+    uint32_t draws{ 0 };
+    uint32_t rootSignatureChanges{ 0 };
+    uint32_t pipelineChanges{ 0 };
+    uint32_t materialChanges{ 0 };
+    uint32_t meshChanges{ 0 };
+    // binds that set the state already bound, i.e. what recording every draw with its full state costs for nothing
+    uint32_t redundantBinds{ 0 };
+
+    uint32_t getStateChanges() const { return rootSignatureChanges + pipelineChanges + materialChanges + meshChanges; }
+};
+
+// Counts the state changes needed to submit packets in the given order.
+StateChangeStats countStateChanges(const DrawPacket* packets, size_t count);
+
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+#include "FrameTimeHistogram.h"
+
+namespace HDX
+{
+
+enum class PacingMode : uint32_t
+{
+    // frames start as soon as the fence of their frame in flight slot completes
+    Fence = 0,
+    // frames wait on the swap chain latency object, then sleep until the predicted start deadline
+    Waitable = 1,
+};
+
+struct FramePacerConfig
+{
+    uint32_t framesInFlight{ 2 };
+    PacingMode mode{ PacingMode::Waitable };
+    // slack kept between the predicted end of a frame and its display
+    double safetyMarginMs{ 1.0 };
+};
+
+// Platform independent frame pacing. All times are milliseconds on one monotonic clock supplied by the caller,
+// which lets the controller run against a simulated display.
+//
+// The renderer reports when frames begin and end on the CPU, when their GPU work completes and when they reach the
+// display. From this the pacer predicts the earliest display slot of the next frame and the latest time it can start
+// and still make it, so input is sampled as late as possible. The CPU and GPU times are budgeted with their recent
+// deviation, so jittery frames start earlier than steady ones. A frame displayed after its predicted slot widens the
+// margin, hits slowly narrow it. The deadline never targets a slot the frame could not make, so pacing does not cost
+// throughput, it only removes queueing.
+class FramePacer
+{
+public:
+    static const uint32_t MaxFramesInFlight{ 4 };
+
+    explicit FramePacer(const FramePacerConfig& config);
+
+    uint32_t getFramesInFlight() const { return mFramesInFlight; }
+    PacingMode getMode() const { return mMode; }
+
+    // Input event seen at timeMs. The oldest input not consumed yet is attributed to the next frame that begins.
+    void onInput(double timeMs);
+
+    // Time the next frame should begin at. Returns 0 when there is nothing to wait for.
+    double getStartDeadline() const;
+
+    // Returns the id of the frame, ids start at 1 and follow the present order.
+    uint64_t beginFrame(double timeMs);
+    void endFrame(uint64_t frameId, double timeMs);
+
+    // The GPU finished the work of frameId at timeMs.
+    void onFrameGpuCompleted(uint64_t frameId, double timeMs);
+
+    // The frame frameId reached the display at timeMs. Frames may be reported late or skipped.
+    void onFrameDisplayed(uint64_t frameId, double timeMs);
+
+    double getPredictedCpuMs() const { return mCpuMs; }
+    double getPredictedGpuMs() const { return mGpuMs; }
+    // CPU and GPU time budgeted between the start deadline and the display, the margin excluded
+    double getPredictedFrameMs() const;
+    double getRefreshIntervalMs() const { return mRefreshMs; }
+    double getMarginMs() const { return mMarginMs; }
+    uint32_t getMissedDeadlines() const { return mMissedDeadlines; }
+
+    // input to display latency of the frames displayed since the last reset
+    const FrameTimeHistogram& getLatency() const { return mLatency; }
+    void resetStats();
+
+private:
+    struct FrameRecord
+    {
+        uint64_t id;
+        double inputMs;
+        double beginMs;
+        double endMs;
+        double predictedDisplayMs;
+    };
+
+    FrameRecord* findFrame(uint64_t frameId);
+    double predictDisplay(uint64_t frameId) const;
+
+    uint32_t mFramesInFlight;
+    PacingMode mMode;
+    double mBaseMarginMs;
+    double mMarginMs;
+
+    double mPendingInputMs{ -1. };
+    uint64_t mNextFrameId{ 1 };
+    std::deque<FrameRecord> mFrames;
+
+    double mCpuMs{ 0. };
+    // from the end of the CPU work to the end of the GPU work, queueing included
+    double mGpuMs{ 0. };
+    double mCpuDeviationMs{ 0. };
+    double mGpuDeviationMs{ 0. };
+    // shortest spacing between two consecutive frames on the display
+    double mRefreshMs{ 0. };
+    uint64_t mLastDisplayedId{ 0 };
+    double mLastDisplayMs{ 0. };
+
+    uint32_t mMissedDeadlines{ 0 };
+    FrameTimeHistogram mLatency;
+};
+
+}
\ No newline at end of file
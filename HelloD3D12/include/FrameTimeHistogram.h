@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace HDX
+{
+
+// Fixed width histogram of frame times in milliseconds. Times past the last bucket land in an overflow bucket.
+class FrameTimeHistogram
+{
+public:
+    static const uint32_t BucketCount{ 128 };
+
+    explicit FrameTimeHistogram(double bucketWidthMs = 0.25);
+
+    void add(double ms);
+    void reset();
+
+    uint32_t getCount() const { return mCount; }
+    double getMean() const { return mCount ? mTotalMs / mCount : 0.; }
+    double getMax() const { return mMaxMs; }
+
+    // Upper bound of the bucket holding the given percentile, in [0, 100].
+    double getPercentile(double percentile) const;
+
+    // Percentiles followed by one bar per non empty bucket.
+    std::string toString() const;
+
+private:
+    double mBucketWidthMs;
+    uint32_t mBuckets[BucketCount + 1];
+    uint32_t mCount{ 0 };
+    double mTotalMs{ 0. };
+    double mMaxMs{ 0. };
+};
+
+}
\ No newline at end of file
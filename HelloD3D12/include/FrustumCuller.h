@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MathTypes.h"
+
+namespace HDX
+{
+
+// Frustum culling over bounds stored as structure of arrays, one array per component, so a SIMD register holds
+// the same component of SimdWidth objects and no shuffling is needed.
+// 8 objects per iteration with AVX (/arch:AVX), 4 with SSE otherwise. The arrays are padded to a multiple of 8
+// with empty bounds, so the vector loop never needs a scalar tail for the last objects.
+// An object is culled when its box or its sphere is completely behind one of the planes.
+class FrustumCuller
+{
+public:
+#ifdef __AVX__
+    static const uint32_t SimdWidth{ 8 };
+#else
+    static const uint32_t SimdWidth{ 4 };
+#endif
+
+    void resize(uint32_t count);
+    uint32_t getCount() const { return mCount; }
+
+    void setBounds(uint32_t index, const Bounds& bounds);
+
+    // Writes 1 to visible[i] for the objects in [begin, end) intersecting the frustum, 0 for the others, and
+    // returns the number of visible objects. Disjoint ranges can be culled from several threads.
+    uint32_t cull(const Frustum& frustum, uint32_t begin, uint32_t end, uint8_t* visible) const
+    {
+        return cull(frustum.planes, Frustum::SideCount, begin, end, visible);
+    }
+
+    // Same against any convex set of at most MaxPlanes planes.
+    uint32_t cull(const Plane* planes, uint32_t planeCount, uint32_t begin, uint32_t end, uint8_t* visible) const;
+
+    // Same test one object at a time, the reference for the vector paths.
+    uint32_t cullScalar(const Plane* planes, uint32_t planeCount, uint32_t begin, uint32_t end, uint8_t* visible) const;
+
+private:
+    uint32_t mCount{ 0 };
+    std::vector<float> mCenterX;
+    std::vector<float> mCenterY;
+    std::vector<float> mCenterZ;
+    std::vector<float> mExtentX;
+    std::vector<float> mExtentY;
+    std::vector<float> mExtentZ;
+    std::vector<float> mRadius;
+};
+
+}
\ No newline at end of file
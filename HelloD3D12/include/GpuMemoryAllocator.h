@@ -0,0 +1,137 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "TLSFAllocator.h"
+
+using namespace Microsoft::WRL;
+
+namespace HDX
+{
+
+class GpuMemoryAllocator;
+
+// A resource created by GpuMemoryAllocator, owning its memory. Small buffers share one buffer resource,
+// getOffset() is where they start in it. Destroying the allocation releases the resource and frees its range,
+// so it goes through the deletion queue while the GPU may still use it.
+class GpuAllocation
+{
+public:
+    GpuAllocation() = default;
+    GpuAllocation(GpuAllocation&& other);
+    GpuAllocation& operator=(GpuAllocation&& other);
+    ~GpuAllocation();
+
+    GpuAllocation(const GpuAllocation&) = delete;
+    GpuAllocation& operator=(const GpuAllocation&) = delete;
+
+    void reset();
+
+    ID3D12Resource* getResource() const { return mResource.Get(); }
+    UINT64 getOffset() const { return mOffset; }
+    UINT64 getSize() const { return mSize; }
+    D3D12_GPU_VIRTUAL_ADDRESS getGPUAddress() const { return mResource->GetGPUVirtualAddress() + mOffset; }
+
+    explicit operator bool() const { return mResource != nullptr; }
+
+private:
+    friend class GpuMemoryAllocator;
+
+    ComPtr<ID3D12Resource> mResource;
+    GpuMemoryAllocator* mAllocator{ nullptr };
+    UINT64 mOffset{ 0 };
+    UINT64 mSize{ 0 };
+    uint32_t mPool{ 0 };
+    uint32_t mBlock{ 0 };
+    uint32_t mHandle{ TLSFAllocator::InvalidHandle };
+};
+
+// Places default heap resources in large ID3D12Heap blocks sub-allocated with TLSF instead of giving each one
+// its own implicit heap. Buffers, render target / depth textures and other textures live in separate heaps
+// so resource heap tier 1 hardware is supported. Buffers under SmallBufferSize are packed at 256 byte alignment
+// into shared buffer resources instead of taking a 64KB placement each. Resources too large for a heap block
+// fall back to committed resources. Not thread safe, resources are created and freed on the render thread.
+class GpuMemoryAllocator
+{
+public:
+    static const UINT64 HeapBlockSize{ 64ull << 20 };
+    static const UINT64 SmallBufferBlockSize{ 4ull << 20 };
+    static const UINT64 SmallBufferSize{ 64ull << 10 };
+    static const UINT64 SmallBufferAlignment{ 256 };
+
+    struct Stats
+    {
+        uint32_t heapCount{ 0 };
+        UINT64 heapBytes{ 0 };
+        UINT64 usedBytes{ 0 };
+        uint32_t placedResources{ 0 };
+        uint32_t smallBuffers{ 0 };
+        uint32_t committedResources{ 0 };
+        UINT64 committedBytes{ 0 };
+        // worst TLSFAllocator::getFragmentation() over the heap blocks
+        float fragmentation{ 0.f };
+    };
+
+    ~GpuMemoryAllocator();
+
+    bool prepare(ID3D12Device* device);
+
+    // Default heap buffer in the COMMON state.
+    bool createBuffer(UINT64 size, GpuAllocation& allocation);
+    bool createResource(const D3D12_RESOURCE_DESC& desc,
+                        D3D12_RESOURCE_STATES initialState,
+                        const D3D12_CLEAR_VALUE* clearValue,
+                        GpuAllocation& allocation);
+
+    Stats getStats() const;
+    std::string getReport() const;
+
+private:
+    friend class GpuAllocation;
+
+    enum PoolType : uint32_t
+    {
+        PoolBuffers,
+        PoolTextures,
+        PoolRenderTargets,
+        PoolSmallBuffers,
+        PoolCount
+    };
+
+    static const uint32_t CommittedBlock{ 0xffffffff };
+
+    struct Block
+    {
+        explicit Block(UINT64 size) : allocator(size) {}
+
+        ComPtr<ID3D12Heap> heap;
+        // shared buffer of the small buffer pool
+        ComPtr<ID3D12Resource> buffer;
+        TLSFAllocator allocator;
+    };
+
+    struct Pool
+    {
+        D3D12_HEAP_FLAGS heapFlags;
+        UINT64 blockSize;
+        std::vector<std::unique_ptr<Block>> blocks;
+    };
+
+    bool allocateRange(uint32_t pool, UINT64 size, UINT64 alignment, uint32_t &block, TLSFAllocator::Allocation &range);
+    bool createBlock(uint32_t pool);
+    bool createCommitted(const D3D12_RESOURCE_DESC& desc,
+                         D3D12_RESOURCE_STATES initialState,
+                         const D3D12_CLEAR_VALUE* clearValue,
+                         UINT64 size,
+                         GpuAllocation& allocation);
+    void free(GpuAllocation& allocation);
+
+    ComPtr<ID3D12Device> mDevice;
+    Pool mPools[PoolCount];
+    uint32_t mCommittedResources{ 0 };
+    UINT64 mCommittedBytes{ 0 };
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace HDX
+{
+
+// 64 bit FNV-1a over a stream of values. Integers are fed least significant byte first and floats by their
+// bit pattern, so a key only depends on the values hashed, never on the platform or on struct padding.
+// Hash structs field by field, not as raw memory.
+class Hasher
+{
+public:
+    static const uint64_t OffsetBasis{ 0xcbf29ce484222325ull };
+    static const uint64_t Prime{ 0x100000001b3ull };
+
+    Hasher& addBytes(const void* data, size_t size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            mHash = (mHash ^ bytes[i]) * Prime;
+        }
+        return *this;
+    }
+
+    Hasher& add(uint64_t value)
+    {
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            mHash = (mHash ^ ((value >> (i * 8)) & 0xff)) * Prime;
+        }
+        return *this;
+    }
+
+    Hasher& add(uint32_t value)
+    {
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            mHash = (mHash ^ ((value >> (i * 8)) & 0xff)) * Prime;
+        }
+        return *this;
+    }
+
+    Hasher& add(int32_t value) { return add(static_cast<uint32_t>(value)); }
+
+    Hasher& add(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return add(bits);
+    }
+
+    // Length prefixed so consecutive strings cannot run into each other, nullptr hashes like "".
+    Hasher& addString(const char* value)
+    {
+        size_t length = value ? strlen(value) : 0;
+        add(static_cast<uint64_t>(length));
+        return addBytes(value, length);
+    }
+
+    uint64_t get() const { return mHash; }
+
+private:
+    uint64_t mHash{ OffsetBasis };
+};
+
+inline uint64_t hashBytes(const void* data, size_t size)
+{
+    return Hasher().addBytes(data, size).get();
+}
+
+}
\ No newline at end of file
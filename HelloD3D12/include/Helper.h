@@ -23,6 +23,7 @@ inline void ErrorDescription(HRESULT hr)
 }
 
 #define LOG_ERROR(...) printf(__VA_ARGS__)
+#define LOG_INFO(...) printf(__VA_ARGS__)
 #define HR_ERROR_CHECK_CALL(func, ret, ... ) { _HR_ERROR_CHECK_CALL(func, ret, __VA_ARGS__) }
 #define _HR_ERROR_CHECK_CALL(func, ret, ... ) \
         auto hr = func; \
@@ -35,5 +36,6 @@ inline void ErrorDescription(HRESULT hr)
         } 
 #else
 #define LOG_ERROR(...) void()
+#define LOG_INFO(...) void()
 #define HR_ERROR_CHECK_CALL(func, ret, ... ) func
 #endif
\ No newline at end of file
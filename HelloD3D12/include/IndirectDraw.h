@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace HDX
+{
+
+// Mirror of the argument layout consumed by ExecuteIndirect, kept free of D3D12 types so it can be packed headless.
+// Argument order: 2 root constants | vertex buffer view | index buffer view | DrawIndexed arguments.
+// The command signature created by the renderer must describe the same order.
+struct IndirectDrawCommand
+{
+    // root constants
+    uint32_t instanceBase;
+    uint32_t materialIndex;
+
+    // D3D12_VERTEX_BUFFER_VIEW
+    uint64_t vertexBufferLocation;
+    uint32_t vertexBufferSize;
+    uint32_t vertexStride;
+
+    // D3D12_INDEX_BUFFER_VIEW
+    uint64_t indexBufferLocation;
+    uint32_t indexBufferSize;
+    uint32_t indexFormat;
+
+    // D3D12_DRAW_INDEXED_ARGUMENTS
+    uint32_t indexCountPerInstance;
+    uint32_t instanceCount;
+    uint32_t startIndexLocation;
+    int32_t  baseVertexLocation;
+    uint32_t startInstanceLocation;
+
+    uint32_t padding;
+};
+
+static_assert(sizeof(IndirectDrawCommand) == 64, "IndirectDrawCommand must stay one cache line");
+static_assert(offsetof(IndirectDrawCommand, vertexBufferLocation) == 8, "Unexpected IndirectDrawCommand layout");
+static_assert(offsetof(IndirectDrawCommand, indexCountPerInstance) == 40, "Unexpected IndirectDrawCommand layout");
+
+// One instanced draw to pack. templateIndex selects the per mesh LOD command that holds the buffer views and index range.
+struct IndirectDrawBatch
+{
+    uint32_t templateIndex;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+    uint32_t padding;
+};
+
+static_assert(sizeof(IndirectDrawBatch) == 16, "IndirectDrawBatch is loaded as one 16 byte vector");
+
+// Writes one command per batch: a copy of its template with instanceBase and instanceCount patched in.
+// commands must be 16 byte aligned. Stores bypass the cache, commands is meant to point into write combined upload memory.
+void packIndirectDrawCommands(const IndirectDrawCommand* templates, const IndirectDrawBatch* batches, size_t count, IndirectDrawCommand* commands);
+
+// Scalar reference of packIndirectDrawCommands.
+void packIndirectDrawCommandsScalar(const IndirectDrawCommand* templates, const IndirectDrawBatch* batches, size_t count, IndirectDrawCommand* commands);
+
+}
\ No newline at end of file
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace HDX
+{
+
+// Counts outstanding jobs. A counter reaching zero means every job that was started with it has finished.
+class JobCounter
+{
+public:
+    bool isDone() const { return mValue.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+    std::atomic<int32_t> mValue{ 0 };
+};
+
+struct Job
+{
+    static const size_t StorageSize{ 32 };
+
+    void (*mEntry)(Job&) { nullptr };
+    JobCounter* mCounter{ nullptr };
+    const JobCounter* mDependency{ nullptr };
+    std::atomic<uint32_t> mBusy{ 0 };
+    alignas(8) unsigned char mStorage[StorageSize];
+};
+
+// Chase-Lev work stealing deque. push/pop are only called by the owning worker, steal by everyone else.
+class WorkStealingQueue
+{
+public:
+    explicit WorkStealingQueue(uint32_t capacity);
+
+    bool push(Job* job);
+    Job* pop();
+    Job* steal();
+
+private:
+    std::atomic<int64_t> mTop{ 0 };
+    std::atomic<int64_t> mBottom{ 0 };
+    std::unique_ptr<std::atomic<Job*>[]> mJobs;
+    int64_t mMask;
+};
+
+class JobSystem
+{
+public:
+    // workerCount includes the calling thread, 0 picks one worker per hardware thread.
+    explicit JobSystem(uint32_t workerCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    uint32_t getWorkerCount() const { return static_cast<uint32_t>(mWorkers.size()); }
+
+    // Runs func on any worker. The job will not start before dependency (if any) is done, until then it is parked
+    // off the queues so idle workers can sleep. dependency must outlive the start of the job.
+    template<typename F>
+    void run(JobCounter& counter, F&& func, const JobCounter* dependency = nullptr)
+    {
+        using Func = typename std::decay<F>::type;
+        static_assert(sizeof(Func) <= Job::StorageSize, "Job capture is too large");
+        static_assert(alignof(Func) <= 8, "Job capture is over aligned");
+
+        Job* job = allocateJob();
+        new (job->mStorage) Func(std::forward<F>(func));
+        job->mEntry = &invoke<Func>;
+        job->mCounter = &counter;
+        job->mDependency = dependency;
+        counter.mValue.fetch_add(1, std::memory_order_relaxed);
+        submit(job);
+    }
+
+    // Blocks until counter is done, executing other jobs meanwhile.
+    void wait(const JobCounter& counter);
+
+    // Calls func(begin, end) over [0, count) split in chunks of grainSize and waits for completion.
+    template<typename F>
+    void parallelFor(uint32_t count, uint32_t grainSize, F&& func)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        if (grainSize == 0)
+        {
+            grainSize = 1;
+        }
+
+        if (count <= grainSize || mWorkers.size() == 1)
+        {
+            func(0u, count);
+            return;
+        }
+
+        JobCounter counter;
+        auto* funcPtr = &func;
+        for (uint32_t begin = grainSize; begin < count; begin += grainSize)
+        {
+            uint32_t end = (count - begin > grainSize) ? begin + grainSize : count;
+            run(counter, [funcPtr, begin, end]() { (*funcPtr)(begin, end); });
+        }
+
+        func(0u, grainSize);
+        wait(counter);
+    }
+
+private:
+    static const uint32_t JobsPerWorker{ 4096 };
+
+    struct Worker
+    {
+        Worker() : mQueue(JobsPerWorker), mJobs(new Job[JobsPerWorker]) {}
+
+        WorkStealingQueue mQueue;
+        std::unique_ptr<Job[]> mJobs;
+        uint32_t mNextJob{ 0 };
+        uint32_t mRandom{ 0 };
+        std::thread mThread;
+    };
+
+    template<typename Func>
+    static void invoke(Job& job)
+    {
+        Func* func = reinterpret_cast<Func*>(job.mStorage);
+        (*func)();
+        func->~Func();
+    }
+
+    Job* allocateJob();
+    void submit(Job* job);
+    void enqueue(Job* job);
+    bool park(Job* job);
+    void releaseParked();
+    Job* findJob(uint32_t workerIndex);
+    void pushOverflow(Job* job);
+    Job* popOverflow();
+    bool tryRunJob(uint32_t workerIndex);
+    void execute(Job* job);
+    void workerMain(uint32_t workerIndex);
+    uint32_t getCurrentWorkerIndex() const;
+
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+
+    // jobs that did not fit their deque, checked after stealing
+    std::mutex mOverflowMutex;
+    std::deque<Job*> mOverflowJobs;
+    std::atomic<int32_t> mOverflowCount{ 0 };
+
+    // jobs whose dependency is not done, out of the queues and of mQueuedJobs so idle workers sleep instead of
+    // picking them up again. They are queued by the job that completes their dependency.
+    std::mutex mParkMutex;
+    std::vector<Job*> mParkedJobs;
+    std::atomic<int32_t> mParkedCount{ 0 };
+
+    std::atomic<int32_t> mQueuedJobs{ 0 };
+    std::atomic<int32_t> mSleepingWorkers{ 0 };
+    std::atomic<bool> mQuit{ false };
+    std::mutex mWakeMutex;
+    std::condition_variable mWakeCondition;
+};
+
+}
\ No newline at end of file
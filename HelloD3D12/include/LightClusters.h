@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "MathTypes.h"
+
+namespace HDX
+{
+
+// Clustered light assignment for forward shading. The view frustum is split in TileCountX x TileCountY screen tiles
+// and SliceCount depth slices, spaced exponentially so clusters keep roughly cubic proportions. Lights are
+// assigned on the CPU by testing their bounding sphere against the view space box of each cluster, and written as
+// one compact index list plus an (offset, count) cell per cluster, which the pixel shader reads for its cluster.
+// The sphere to box distance is separable: the x distances depend on the tile column and slice, the y distances
+// on the row and slice, so a light computes the x distances of a slice once and tests a whole row of tiles with
+// TileCountX / 4 SSE compares.
+class LightClusters
+{
+public:
+    static const uint32_t TileCountX{ 16 };
+    static const uint32_t TileCountY{ 9 };
+    static const uint32_t SliceCount{ 24 };
+    static const uint32_t ClusterCount{ TileCountX * TileCountY * SliceCount };
+
+    // view space bounding sphere of a light
+    struct Light
+    {
+        Float3 center;
+        float radius;
+    };
+
+    // lights of a cluster, indices[offset] to indices[offset + count - 1]
+    struct Cell
+    {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    struct Stats
+    {
+        uint32_t lights{ 0 };
+        // lights touching at least one cluster
+        uint32_t visibleLights{ 0 };
+        uint32_t indices{ 0 };
+        // cluster references that did not fit in the index list
+        uint32_t droppedIndices{ 0 };
+        uint32_t maxClusterLights{ 0 };
+    };
+
+    // Bounding sphere of a spot light cone, cosHalfAngle is the cosine of the outer half angle.
+    static Light boundCone(const Float3& apex, const Float3& direction, float range, float cosHalfAngle);
+
+    // Builds the cluster boxes of a left handed perspective projection, only needed when it changes.
+    void setProjection(float fovY, float aspectRatio, float nearZ, float farZ);
+
+    // The cluster of a pixel is ((slice * TileCountY + tileY) * TileCountX + tileX), tiles counted from the top left
+    // corner of the screen and slice = floor(log(view depth) * getDepthScale() + getDepthBias()).
+    float getDepthScale() const { return mDepthScale; }
+    float getDepthBias() const { return mDepthBias; }
+
+    // Writes ClusterCount cells, and at most maxIndices light indices in cluster order. Lights of a cluster are in
+    // the order of the lights array. Both are built in scratch arrays and copied out once, so cells and indices
+    // can point into write combined upload memory.
+    void assign(const Light* lights, uint32_t count, Cell* cells, uint32_t* indices, uint32_t maxIndices);
+
+    const Stats& getStats() const { return mStats; }
+
+private:
+    // slice of a view depth, clamped to the grid
+    uint32_t getSlice(float depth) const;
+
+    // view space box of each cluster, stored per axis, see the class comment
+    float mTileMinX[SliceCount][TileCountX]{};
+    float mTileMaxX[SliceCount][TileCountX]{};
+    float mTileMinY[SliceCount][TileCountY]{};
+    float mTileMaxY[SliceCount][TileCountY]{};
+    float mSliceNear[SliceCount]{};
+    float mSliceFar[SliceCount]{};
+
+    float mNearZ{ 0.f };
+    float mFarZ{ 0.f };
+    float mDepthScale{ 0.f };
+    float mDepthBias{ 0.f };
+
+    // (light, cluster) references packed as light << ClusterBits | cluster, sorted by cluster into the index list
+    static const uint32_t ClusterBits{ 12 };
+    std::vector<uint32_t> mPairs;
+    std::vector<uint32_t> mClusterCounts;
+    std::vector<Cell> mCells;
+    std::vector<uint32_t> mIndices;
+    Stats mStats;
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MathTypes.h"
+
+namespace HDX
+{
+
+// CPU occlusion culling in the style of Masked Occlusion Culling (Hasselgren et al. 2016).
+// The buffer is split in tiles of 32x4 pixels. A tile stores no per pixel depth, only two layers: every pixel is at
+// most zMax0 deep, and the pixels in its coverage mask are at most zMax1 deep. A triangle ORs its coverage into the
+// mask and raises zMax1, or restarts the working layer when its depth is closer to zMax0. Once the mask is full the
+// working layer becomes the new zMax0. The four rows of a tile are one SSE register of coverage bits, so a triangle
+// is rasterized into a tile with a handful of vector instructions.
+// Depth is D3D z/w, 0 at the near plane. Occluders are rendered with back faces culled, clockwise front faces like
+// the default rasterizer state, and triangles crossing the near plane are dropped, which only loses occlusion.
+class MaskedOcclusionBuffer
+{
+public:
+    static const uint32_t TileWidth{ 32 };
+    static const uint32_t TileHeight{ 4 };
+
+    struct Stats
+    {
+        uint32_t triangles{ 0 };
+        // triangles that touched at least one tile, the others were back facing, clipped or too small
+        uint32_t rasterizedTriangles{ 0 };
+        uint32_t tileUpdates{ 0 };
+    };
+
+    // width and height are rounded up to whole tiles, the buffer covers the viewport either way
+    void resize(uint32_t width, uint32_t height);
+    void clear();
+
+    uint32_t getWidth() const { return mTilesX * TileWidth; }
+    uint32_t getHeight() const { return mTilesY * TileHeight; }
+
+    // positions holds 3 object space corners per triangle, worldViewProj is row major and multiplies row vectors.
+    void renderTriangles(const Float3* positions, uint32_t triangleCount, const float* worldViewProj);
+
+    // False when the world space box is hidden behind everything rendered since clear(). Read only, several
+    // tests can run at once.
+    bool testBox(const Bounds& bounds, const float* viewProj) const;
+
+    // upper bound of the depth of the pixel, 1 where nothing was rendered
+    float getPixelDepth(uint32_t x, uint32_t y) const;
+    // Writes the depth as a binary PGM, nearest white and empty pixels black.
+    bool saveDepthImage(const char* path) const;
+
+    const Stats& getStats() const { return mStats; }
+    void resetStats() { mStats = Stats{}; }
+
+private:
+    struct ScreenTriangle
+    {
+        float x[3];
+        float y[3];
+        float z[3];
+    };
+
+    void rasterize(const ScreenTriangle& triangle);
+    void updateTile(uint32_t tile, const uint32_t* coverage, float triangleZMax);
+
+    uint32_t mTilesX{ 0 };
+    uint32_t mTilesY{ 0 };
+    // per tile, TileHeight rows of coverage bits, bit x is pixel x of the row
+    std::vector<uint32_t> mMasks;
+    std::vector<float> mZMax0;
+    std::vector<float> mZMax1;
+
+    Stats mStats;
+};
+
+}
\ No newline at end of file
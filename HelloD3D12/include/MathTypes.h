@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+namespace HDX
+{
+
+// Minimal math for the portable modules, which cannot use DirectXMath. Matrices are 16 floats in the row major,
+// row vector layout of XMFLOAT4X4, i.e. a point transforms as p * M and the translation is the last row.
+
+struct Float3
+{
+    float x;
+    float y;
+    float z;
+};
+
+// Box given by center and half extents, plus a sphere around the same center. Each volume is conservative on its
+// own, culling tests both and keeps whichever is tighter.
+struct Bounds
+{
+    Float3 center;
+    Float3 extents;
+    float radius;
+};
+
+// Points p with dot(normal, p) + distance >= 0 are inside.
+struct Plane
+{
+    Float3 normal;
+    float distance;
+};
+
+// Most planes a convex volume passed to culling can have, enough for two frustums.
+static const uint32_t MaxPlanes{ 12 };
+
+inline Bounds makeBounds(const Float3& minCorner, const Float3& maxCorner)
+{
+    Bounds bounds;
+    bounds.center = { (minCorner.x + maxCorner.x) * 0.5f, (minCorner.y + maxCorner.y) * 0.5f, (minCorner.z + maxCorner.z) * 0.5f };
+    bounds.extents = { (maxCorner.x - minCorner.x) * 0.5f, (maxCorner.y - minCorner.y) * 0.5f, (maxCorner.z - minCorner.z) * 0.5f };
+    bounds.radius = std::sqrt(bounds.extents.x * bounds.extents.x + bounds.extents.y * bounds.extents.y + bounds.extents.z * bounds.extents.z);
+    return bounds;
+}
+
+// The box stays tight under rotation by summing the absolute axes, the sphere grows with the largest axis scale.
+inline Bounds transformBounds(const Bounds& bounds, const float* m)
+{
+    const Float3& c = bounds.center;
+    const Float3& e = bounds.extents;
+
+    Bounds result;
+    result.center = {
+        c.x * m[0] + c.y * m[4] + c.z * m[8] + m[12],
+        c.x * m[1] + c.y * m[5] + c.z * m[9] + m[13],
+        c.x * m[2] + c.y * m[6] + c.z * m[10] + m[14]
+    };
+    result.extents = {
+        e.x * std::fabs(m[0]) + e.y * std::fabs(m[4]) + e.z * std::fabs(m[8]),
+        e.x * std::fabs(m[1]) + e.y * std::fabs(m[5]) + e.z * std::fabs(m[9]),
+        e.x * std::fabs(m[2]) + e.y * std::fabs(m[6]) + e.z * std::fabs(m[10])
+    };
+
+    float scale = 0.f;
+    for (int row = 0; row < 3; row++)
+    {
+        const float* axis = m + row * 4;
+        float lengthSq = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        scale = lengthSq > scale ? lengthSq : scale;
+    }
+    result.radius = bounds.radius * std::sqrt(scale);
+    return result;
+}
+
+struct Frustum
+{
+    enum Side
+    {
+        Left,
+        Right,
+        Bottom,
+        Top,
+        Near,
+        Far,
+        SideCount
+    };
+
+    Plane planes[SideCount];
+
+    // Planes of a D3D view projection matrix (clip space z in [0, 1]), normalized so plane distances are in world units.
+    static Frustum fromViewProjection(const float* m)
+    {
+        // clip = p * M, so each clip coordinate is the dot product of p with a column
+        auto column = [m](int index, float* out)
+        {
+            for (int row = 0; row < 4; row++)
+            {
+                out[row] = m[row * 4 + index];
+            }
+        };
+
+        float x[4];
+        float y[4];
+        float z[4];
+        float w[4];
+        column(0, x);
+        column(1, y);
+        column(2, z);
+        column(3, w);
+
+        Frustum frustum;
+        float sides[SideCount][4];
+        for (int i = 0; i < 4; i++)
+        {
+            sides[Left][i] = w[i] + x[i];
+            sides[Right][i] = w[i] - x[i];
+            sides[Bottom][i] = w[i] + y[i];
+            sides[Top][i] = w[i] - y[i];
+            sides[Near][i] = z[i];
+            sides[Far][i] = w[i] - z[i];
+        }
+
+        for (int side = 0; side < SideCount; side++)
+        {
+            const float* p = sides[side];
+            float length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+            float scale = length > 0.f ? 1.f / length : 0.f;
+            frustum.planes[side] = { { p[0] * scale, p[1] * scale, p[2] * scale }, p[3] * scale };
+        }
+        return frustum;
+    }
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MathTypes.h"
+#include "ResourceDeletionQueue.h"
+
+using namespace Microsoft::WRL;
+using namespace DirectX;
+
+namespace HDX
+{
+
+class GpuMemoryAllocator;
+class UploadManager;
+
+// Geometry and texture loaded from one source name, shared by every model using it.
+class Mesh
+{
+public:
+    struct Vertex
+    {
+        XMFLOAT3 pos;
+        XMFLOAT2 uv;
+        XMFLOAT3 normal;
+    };
+
+    // layout of the quantized vertex shader variant, half position and uv and snorm normal in 16 bytes instead of 32
+    struct QuantizedVertex
+    {
+        uint16_t pos[4];
+        uint16_t uv[2];
+        int8_t normal[4];
+    };
+
+    // levels of detail per mesh, LOD 0 is the source geometry
+    static const uint32_t MaxLods{ 4 };
+    // LOD k > 0 is clustered with cells of radius * LodCellScale * 2^(k - 1)
+    static const float LodCellScale;
+    // the occlusion buffer's triangle budget per frame, larger meshes never occlude and keep no occluder triangles
+    static const uint32_t MaxOccluderTriangles{ 16384 };
+
+    // index range of one LOD in the shared index buffer
+    struct Lod
+    {
+        uint32_t indexOffset;
+        uint32_t indexCount;
+    };
+
+    Mesh(std::string name, uint32_t id);
+    ~Mesh();
+
+    // CPU side loading (mesh parsing, texture decoding), safe to run on any thread.
+    bool load();
+
+    bool prepare(ID3D12Device* device,
+                 GpuMemoryAllocator* allocator,
+                 UploadManager* uploadManager,
+                 ID3D12DescriptorHeap* srvCBVHeap,
+                 UINT &heapOffset);
+
+    // Hands the GPU resources to the deletion queue, they are freed once lastUseFenceValue completes.
+    void release(ResourceDeletionQueue& deletionQueue, UINT64 lastUseFenceValue);
+    bool isResident() const { return static_cast<bool>(mVertexBuffer); }
+
+    const std::string &getName() const { return mName; }
+    uint32_t getId() const { return mId; }
+
+    // object space bounds of the vertices, valid once load() succeeded
+    const Bounds &getBounds() const { return mBounds; }
+
+    // object space corners of every triangle, 3 per triangle, kept on the CPU for the occlusion buffer, empty for
+    // meshes over MaxOccluderTriangles
+    const std::vector<Float3> &getOccluderTriangles() const { return mOccluderTriangles; }
+
+    // valid once load() succeeded
+    uint32_t getLodCount() const { return mLodCount; }
+    const Lod &getLod(uint32_t lod) const { return mLods[lod]; }
+
+    // indices of every LOD
+    UINT getIndexCount() const { return mIndexCount; }
+    const D3D12_VERTEX_BUFFER_VIEW &getVertexBufferView() const { return mVertexBufferView; }
+    const D3D12_INDEX_BUFFER_VIEW &getIndexBufferView() const { return mIndexBufferView; }
+    const D3D12_CPU_DESCRIPTOR_HANDLE getSRVHandle() const { return mSRVDescriptorStart; }
+
+private:
+    static const UINT TexturePixelSize{ 4 };
+
+    std::string mName;
+    uint32_t mId;
+
+    std::vector<Vertex> mVertices;
+    std::vector<uint32_t> mIndices;
+    UINT mIndexCount{ 0 };
+    Bounds mBounds{};
+    Lod mLods[MaxLods]{};
+    uint32_t mLodCount{ 0 };
+    std::vector<Float3> mOccluderTriangles;
+
+    uint8_t* mTexturePixels{ nullptr };
+    int32_t mTextureWidth{ 0 };
+    int32_t mTextureHeight{ 0 };
+
+    GpuAllocation mVertexBuffer;
+    D3D12_VERTEX_BUFFER_VIEW mVertexBufferView;
+    GpuAllocation mIndexBuffer;
+    D3D12_INDEX_BUFFER_VIEW mIndexBufferView;
+    GpuAllocation mTexture;
+
+    D3D12_CPU_DESCRIPTOR_HANDLE mSRVDescriptorStart;
+};
+
+// Hands out one Mesh per source name so models loaded from the same file share GPU buffers and textures.
+class MeshRegistry
+{
+public:
+    std::shared_ptr<Mesh> acquire(const std::string &name);
+
+    // Releases the GPU resources of meshes no model references anymore, returns how many were released.
+    // A released mesh keeps its id and material slot, acquiring its name again loads a new mesh.
+    uint32_t releaseUnused(ResourceDeletionQueue& deletionQueue, UINT64 lastUseFenceValue);
+
+    const std::vector<std::shared_ptr<Mesh>> &getMeshes() const { return mMeshList; }
+
+private:
+    std::unordered_map<std::string, std::shared_ptr<Mesh>> mMeshes;
+    std::vector<std::shared_ptr<Mesh>> mMeshList;
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MathTypes.h"
+
+namespace HDX
+{
+
+// Builds a coarser level of detail by vertex clustering (Rossignac and Borrel 1993). Vertices are snapped to a grid
+// of cellSize from origin, each cell keeps its first vertex, triangles with two corners in the same cell collapse
+// and duplicates are dropped. The LOD indexes the vertices of the source mesh, so LODs share one vertex buffer.
+// A vertex moves by less than a cell diagonal. Appends the indices to lodIndices, returns the triangle count.
+// indices are read before lodIndices grows, so they may point into it.
+uint32_t buildClusteredLod(const float* positions, size_t stride, const uint32_t* indices, uint32_t indexCount,
+                           const Float3& origin, float cellSize, std::vector<uint32_t>& lodIndices);
+
+struct LodConfig
+{
+    // LOD k > 0 of a mesh has an error of radius * errorScale * 2^(k - 1), e.g. the grid cell of buildClusteredLod
+    float errorScale{ 1.f / 64.f };
+    // largest projected error allowed before the budget bias
+    float maxErrorPixels{ 1.f };
+    // relative error margin around the switch distances, an object only changes LOD once it is that far past one
+    float hysteresis{ 0.15f };
+    // triangles drawn per frame the bias aims for, 0 for no budget
+    uint64_t triangleBudget{ 0 };
+    // the bias never coarsens the error threshold more than this
+    float maxBias{ 16.f };
+};
+
+// Picks the LOD of each object by the screen space error of its mesh LODs, over bounds stored as structure of
+// arrays like FrustumCuller. The coarsest LOD whose projected error stays under the threshold wins. Its error
+// doubles per level, so the level is floor(log2(x)) + 1 for x the distance over the error of LOD 1 at the
+// threshold, read straight from the float exponent, 4 objects per SSE iteration.
+// Hysteresis: the LOD picked with a threshold hysteresis below and the one picked hysteresis above bound the
+// allowed range, the current LOD is clamped into it, so an object sitting at a switch distance keeps its LOD.
+// Budget: the threshold is multiplied by a bias, raised when the triangles drawn exceed the budget and lowered
+// slowly when well under it.
+class LodSelector
+{
+public:
+    explicit LodSelector(const LodConfig& config = LodConfig()) : mConfig(config) {}
+
+    void resize(uint32_t count);
+    uint32_t getCount() const { return mCount; }
+
+    // lodCount is the number of LODs of the mesh of the object. Disjoint objects can be set from several threads.
+    void setObject(uint32_t index, const Bounds& bounds, uint32_t lodCount);
+
+    // Updates the LODs of the objects in [begin, end), lods[i] holds the current LOD of object i on input.
+    // projectionScale is the size in pixels of one unit at distance 1, half the viewport height times the
+    // vertical scale of the projection matrix.
+    void select(const Float3& cameraPosition, float projectionScale, uint32_t begin, uint32_t end, uint8_t* lods) const;
+    // Same one object at a time, the reference for the vector path.
+    void selectScalar(const Float3& cameraPosition, float projectionScale, uint32_t begin, uint32_t end, uint8_t* lods) const;
+
+    // Feeds back the triangles drawn with the last selection, adjusting the bias of the next one.
+    void updateBias(uint64_t triangles);
+    float getBias() const { return mBias; }
+    void setConfig(const LodConfig& config) { mConfig = config; }
+    const LodConfig& getConfig() const { return mConfig; }
+
+private:
+    uint32_t mCount{ 0 };
+    std::vector<float> mCenterX;
+    std::vector<float> mCenterY;
+    std::vector<float> mCenterZ;
+    std::vector<float> mRadius;
+    std::vector<float> mInvRadius;
+    // coarsest LOD of each object
+    std::vector<float> mMaxLod;
+
+    LodConfig mConfig;
+    float mBias{ 1.f };
+};
+
+}
\ No newline at end of file
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <memory>
 #include <string>
-#include <vector>
+
+#include "ComponentStore.h"
+#include "MathTypes.h"
+#include "SceneGraph.h"
 
 using namespace Microsoft::WRL;
 using namespace DirectX;
@@ -9,105 +13,85 @@ using namespace DirectX;
 namespace HDX
 {
 
-class SimpleShader;
-class ShadowMap;
+class Mesh;
+
+struct ModelTransform
+{
+    SceneGraph::NodeId node;
+    // relative to the parent node
+    XMFLOAT3 position;
+    float spinSpeed;
+
+    // transposed world matrix, ready to be copied in the instance buffer
+    XMFLOAT4X4 world;
+    // view space depth of the model origin for the camera and the light
+    float viewDepth;
+    float shadowViewDepth;
+
+    // models that do not spin never move, their shadows are drawn once into the static shadow cache
+    // they must not be parented to nodes that move
+    bool isStatic() const { return spinSpeed == 0.f; }
+};
+
+struct ModelMesh
+{
+    // keeps the mesh loaded, id is copied out so the draw loops do not chase the pointer
+    std::shared_ptr<Mesh> mesh;
+    uint32_t id;
+};
+
+struct ModelMaterial
+{
+    // index in the material table
+    uint32_t index;
+};
+
+struct ModelLod
+{
+    // level of detail of the mesh drawn, chosen by LodSelector, which reads and writes the levels as one byte array
+    uint8_t level;
+};
+static_assert(sizeof(ModelLod) == 1, "LodSelector::select updates the levels as a byte array");
 
-class Model
+// Renderable models, one entity each with a transform, mesh, material, level of detail and world bounds component. The components
+// live in dense arrays indexed by the model index, 0 to getCount() - 1, which the update, culling and draw packet
+// loops iterate directly. Removing a model moves the last one into its index.
+class ModelStore
 {
 public:
-    struct Vertex
-    {
-        XMFLOAT3 pos;
-        XMFLOAT2 uv;
-        XMFLOAT3 normal;
-    };
-
-    struct SceneConstantBuffer
-    {
-        XMFLOAT4X4 worldViewProj;
-        XMFLOAT4X4 world;
-    };
-
-    struct SceneStaticConstantBuffer
-    {
-        XMFLOAT4X4 shadowViewProj;
-        XMFLOAT3   lightDir;
-    };
-
-    struct SceneShadowConstantBuffer
-    {
-        XMFLOAT4X4 worldViewProj;
-    };
-
-    const UINT ConstantBufferSize = ((sizeof(SceneConstantBuffer) + 255) & ~255);
-    const UINT StaticConstantBufferSize = ((sizeof(SceneStaticConstantBuffer) + 255) & ~255);
-    const UINT ShadowConstantBufferSize = ((sizeof(SceneShadowConstantBuffer) + 255) & ~255);
-
-    Model(std::string name, const XMFLOAT3& position);
-    ~Model();
-
-    bool prepare(ID3D12Device* device,
-                 ID3D12CommandQueue*  commandQueue,
-                 ID3D12GraphicsCommandList* commandList,
-                 ID3D12DescriptorHeap* srvCBVHeap,
-                 UINT &heapOffset,
-                 SimpleShader* shader,
-                 ShadowMap* shadowMap,
-                 ID3D12Resource* constantBuffer,
-                 UINT &constantBufferOffset,
-                 UINT8* cbDataBegin,
-                 UINT frameCount
-                 );
-    void update(UINT frameIndex);
-
-    void updateShadowDescriptors(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, ID3D12DescriptorHeap* currentFrameHeap, uint32_t &offset, UINT frameIndex);
-    void updateDescriptors(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, ID3D12DescriptorHeap* currentFrameHeap, uint32_t &offset, UINT frameIndex);
-
-    const ComPtr<ID3D12GraphicsCommandList> &getBundle() { return mBundle; }
-    const ComPtr<ID3D12GraphicsCommandList> &getShadowBundle() { return mShadowBundle; }
+    explicit ModelStore(SceneGraph& sceneGraph);
+    ~ModelStore();
+
+    ModelStore(const ModelStore&) = delete;
+    ModelStore& operator=(const ModelStore&) = delete;
+
+    // position is relative to the parent node
+    Entity create(SceneGraph::NodeId parent, std::shared_ptr<Mesh> mesh, const XMFLOAT3& position, float spinSpeed);
+    void destroy(Entity entity);
+
+    uint32_t getCount() const { return mComponents.getCount(); }
+    uint32_t getIndex(Entity entity) const { return mComponents.getIndex(entity); }
+    Entity getEntity(uint32_t index) const { return mComponents.getEntity(index); }
+
+    const ModelTransform* getTransforms() const { return mComponents.get<ModelTransform>(); }
+    const ModelMesh* getMeshes() const { return mComponents.get<ModelMesh>(); }
+    const ModelMaterial* getMaterials() const { return mComponents.get<ModelMaterial>(); }
+    const ModelLod* getLods() const { return mComponents.get<ModelLod>(); }
+    ModelLod* getLods() { return mComponents.get<ModelLod>(); }
+    // world space bounds of the meshes, updated in update()
+    const Bounds* getWorldBounds() const { return mComponents.get<Bounds>(); }
+
+    // Sets the local transform of the spinning models in [begin, end), before SceneGraph::update().
+    // Disjoint ranges may animate in parallel.
+    void animate(uint32_t begin, uint32_t end, float time);
+    // Picks up the world matrices after SceneGraph::update(), matrices and bounds are only rebuilt when they
+    // changed. Disjoint ranges may update in parallel.
+    void update(uint32_t begin, uint32_t end, const XMMATRIX& viewMtx, const XMMATRIX& shadowViewMtx);
 
 private:
-    static const UINT TextureWidth{ 256 };
-    static const UINT TextureHeight{ 256 };
-    static const UINT TexturePixelSize{ 4 };
-
-    std::vector<Vertex> mVertices;
-    std::vector<uint32_t> mIndices;
-
-    XMMATRIX mViewMtx;
-    XMMATRIX mShadowViewMtx;
-    XMMATRIX mProjMtx;
-    XMMATRIX mShadowProjMtx;
-
-    XMFLOAT3 mPosition;
-
-    std::string mFilename;
-
-    ComPtr<ID3D12Resource> mVertexBuffer;
-    D3D12_VERTEX_BUFFER_VIEW mVertexBufferView;
-    ComPtr<ID3D12Resource> mIndexBuffer;
-    D3D12_INDEX_BUFFER_VIEW mIndexBufferView;
-    ComPtr<ID3D12Resource> mTexture;
-    ComPtr<ID3D12CommandAllocator> mBundleAllocator;
-    ComPtr<ID3D12GraphicsCommandList> mBundle;
-    ComPtr<ID3D12GraphicsCommandList> mShadowBundle;
-    SceneConstantBuffer mConstantBufferData{};
-    SceneStaticConstantBuffer mStaticConstantBufferData{};
-    SceneShadowConstantBuffer mShadowConstantBufferData{};
-    UINT  mSRVCBVOffset{ 0 };
-    UINT  mConstantBufferDataOffset{ 0 };
-    UINT  mShadowConstantBufferDataOffset{ 0 };
-    UINT8* mCBVDataBegin{ nullptr };
-
-    ComPtr<ID3D12Resource> vertexBufferUploadHeap;
-    ComPtr<ID3D12Resource> indexBufferUploadHeap;
-    ComPtr<ID3D12Resource> textureUploadHeap; // scope!! Don't destroy it before finishing execute command queue.
-
-    D3D12_CPU_DESCRIPTOR_HANDLE mSRVDescriptorStart;
-    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> mCBVDescriptorStart;
-    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> mShadowCBVDescriptorStart;
-
-    ShadowMap* mShadowMap{ nullptr };
+    SceneGraph* mSceneGraph;
+    EntityPool mEntities;
+    ComponentStore<ModelTransform, ModelMesh, ModelMaterial, ModelLod, Bounds> mComponents;
 };
 
 }
\ No newline at end of file
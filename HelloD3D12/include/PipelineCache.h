@@ -0,0 +1,92 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CacheFile.h"
+
+using namespace Microsoft::WRL;
+
+namespace HDX
+{
+
+// Skips shader compilation and pipeline creation on startups after the first one.
+// The scene shaders are cooked at build time and only loaded here, runtime compilation is left for generated
+// or edited shaders. Compiled bytecode is cached in a CacheFile keyed by the hash of the source, defines, entry point, target and
+// flags. Pipeline states live in an ID3D12PipelineLibrary keyed by the hash of the full pipeline description,
+// shader bytecode included, and the library blob is stored in a CacheFile of its own. A library the driver
+// rejects, e.g. after a driver update, is dropped and rebuilt.
+// Thread safe, shaders and pipelines may be created from several jobs at once.
+class PipelineCache
+{
+public:
+    struct Stats
+    {
+        uint32_t shaderHits{ 0 };
+        uint32_t shaderMisses{ 0 };
+        uint32_t pipelineHits{ 0 };
+        uint32_t pipelineMisses{ 0 };
+        uint32_t shaderLoads{ 0 };
+        uint64_t shaderLoadBytes{ 0 };
+        double shaderMs{ 0. };
+        double shaderLoadMs{ 0. };
+        double pipelineMs{ 0. };
+    };
+
+    // Loads the caches from directory, a missing or stale cache starts empty.
+    bool prepare(ID3D12Device* device, const char* directory);
+
+    bool compileShader(const char* source,
+                       size_t sourceSize,
+                       const D3D_SHADER_MACRO* defines,
+                       const char* entryPoint,
+                       const char* target,
+                       UINT flags,
+                       ComPtr<ID3DBlob>& bytecode);
+
+    // Compiles assets/shaders/<name>.hlsl. Includes are read from the same directory and are part of the key, the
+    // source is preprocessed before it is hashed.
+    bool compileShaderAsset(const char* name,
+                            const D3D_SHADER_MACRO* defines,
+                            const char* entryPoint,
+                            const char* target,
+                            UINT flags,
+                            ComPtr<ID3DBlob>& bytecode);
+
+    // Bytecode the build compiled from assets/shaders/<name>.hlsl, read from assets/shaders/<name>.cso.
+    bool loadShader(const char* name, ComPtr<ID3DBlob>& bytecode);
+    // The cooked bytecode keeps its reflection data, false when the shader does not bind name.
+    static bool findShaderBinding(ID3DBlob* bytecode, const char* name, D3D12_SHADER_INPUT_BIND_DESC& binding);
+
+    // Root signatures created here are part of the pipeline keys.
+    bool createRootSignature(const void* blob, size_t size, ComPtr<ID3D12RootSignature>& rootSignature);
+    bool createGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, ComPtr<ID3D12PipelineState>& pipelineState);
+
+    // Writes the caches if anything was added since prepare.
+    bool save();
+
+    Stats getStats();
+
+    static uint64_t hashShader(const char* source, size_t sourceSize, const D3D_SHADER_MACRO* defines, const char* entryPoint, const char* target, UINT flags);
+    static uint64_t hashPipelineDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureHash);
+
+private:
+    static const uint64_t LibraryKey{ 0 };
+
+    std::mutex mMutex;
+    ComPtr<ID3D12Device> mDevice;
+    std::string mShaderPath;
+    std::string mLibraryPath;
+    CacheFile mShaders;
+    CacheFile mLibraryFile;
+    // the library reads its pipelines from this memory, it has to outlive mLibrary
+    std::vector<uint8_t> mLibraryData;
+    ComPtr<ID3D12PipelineLibrary> mLibrary;
+    bool mLibraryDirty{ false };
+    std::unordered_map<ID3D12RootSignature*, uint64_t> mRootSignatureHashes;
+    Stats mStats;
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace HDX
+{
+
+// Resource states understood by the render graph, the values match D3D12_RESOURCE_STATES so a graph state
+// casts straight to the D3D12 one. Read states may be combined, write states may not.
+enum ResourceState : uint32_t
+{
+    ResourceStateCommon = 0,
+    ResourceStatePresent = 0,
+    ResourceStateVertexAndConstantBuffer = 0x1,
+    ResourceStateIndexBuffer = 0x2,
+    ResourceStateRenderTarget = 0x4,
+    ResourceStateUnorderedAccess = 0x8,
+    ResourceStateDepthWrite = 0x10,
+    ResourceStateDepthRead = 0x20,
+    ResourceStateNonPixelShaderResource = 0x40,
+    ResourceStatePixelShaderResource = 0x80,
+    ResourceStateIndirectArgument = 0x200,
+    ResourceStateCopyDest = 0x400,
+    ResourceStateCopySource = 0x800,
+};
+
+// Memory needs of a transient resource. Only transients of the same alias group share memory,
+// e.g. resources that may live in the same heap type.
+struct RenderGraphResourceDesc
+{
+    uint64_t size{ 0 };
+    uint64_t alignment{ 1 };
+    uint32_t aliasGroup{ 0 };
+};
+
+// Frame graph compiler, independent of the graphics API. Passes declare the resources they read and write,
+// compile() then:
+// - culls passes whose results nobody consumes, passes with side effects and writes to imported resources are kept
+// - places transient resources in per alias group memory, resources whose lifetimes do not overlap share it
+// - derives the state transitions, merges consecutive reads into one combined read state, splits a transition
+//   into begin / end halves when passes of the same command list sit between the two uses, and batches
+//   the barriers of each point of the schedule together
+// - begins the transitions to the final states right after the last use and ends them in the tail of
+//   that command list, recorded by the caller just before closing it
+// Passes run in declaration order, their command list indices must not decrease.
+class RenderGraph
+{
+public:
+    typedef uint32_t ResourceHandle;
+    typedef uint32_t PassHandle;
+
+    static const uint32_t InvalidHandle{ 0xffffffff };
+
+    enum class BarrierType : uint32_t
+    {
+        Transition,
+        // activates resource in memory shared with aliasBefore, InvalidHandle when the previous user is unknown
+        Aliasing,
+    };
+
+    enum class BarrierSplit : uint32_t
+    {
+        Full,
+        Begin,
+        End,
+    };
+
+    struct Barrier
+    {
+        BarrierType type;
+        BarrierSplit split;
+        ResourceHandle resource;
+        ResourceHandle aliasBefore;
+        uint32_t stateBefore;
+        uint32_t stateAfter;
+    };
+
+    // A pass surviving culling, with the barrier batches to record before and after it.
+    struct ScheduledPass
+    {
+        PassHandle pass;
+        uint32_t commandList;
+        uint32_t firstBarrierBefore;
+        uint32_t barrierBeforeCount;
+        uint32_t firstBarrierAfter;
+        uint32_t barrierAfterCount;
+    };
+
+    // Barriers ending a command list, after everything else the caller records in it.
+    struct CommandListTail
+    {
+        uint32_t firstBarrier;
+        uint32_t barrierCount;
+    };
+
+    struct Stats
+    {
+        uint32_t passes{ 0 };
+        uint32_t culledPasses{ 0 };
+        uint32_t barriers{ 0 };
+        uint32_t barrierBatches{ 0 };
+        uint32_t splitBarriers{ 0 };
+        uint32_t aliasingBarriers{ 0 };
+        uint64_t transientBytes{ 0 };
+        // what the transients would take without aliasing
+        uint64_t unaliasedBytes{ 0 };
+    };
+
+    // Clears the declarations and keeps the allocations, the graph is rebuilt every frame.
+    void reset();
+
+    ResourceHandle importResource(const char* name, uint32_t initialState, uint32_t finalState);
+    // Transient resources are created in their first used state and are returned to it at the end of the graph.
+    ResourceHandle createTransient(const char* name, const RenderGraphResourceDesc& desc);
+
+    PassHandle addPass(const char* name, uint32_t commandList, bool hasSideEffects = false);
+    void read(PassHandle pass, ResourceHandle resource, uint32_t state);
+    void write(PassHandle pass, ResourceHandle resource, uint32_t state);
+
+    bool compile();
+
+    const std::vector<ScheduledPass>& getSchedule() const { return mSchedule; }
+    const std::vector<Barrier>& getBarriers() const { return mBarriers; }
+    // Indexed by command list, lists without passes have an empty tail.
+    const std::vector<CommandListTail>& getCommandListTails() const { return mTails; }
+    const Stats& getStats() const { return mStats; }
+
+    bool isCulled(PassHandle pass) const { return mPasses[pass].culled; }
+    const char* getPassName(PassHandle pass) const { return mPasses[pass].name; }
+    const char* getResourceName(ResourceHandle resource) const { return mResources[resource].name; }
+    uint32_t getResourceCount() const { return static_cast<uint32_t>(mResources.size()); }
+    bool isTransient(ResourceHandle resource) const { return !mResources[resource].imported; }
+    const RenderGraphResourceDesc& getDesc(ResourceHandle resource) const { return mResources[resource].desc; }
+
+    // Placement of a transient, valid after compile(). Unused transients are not placed.
+    bool isPlaced(ResourceHandle resource) const { return mResources[resource].firstUse != InvalidHandle; }
+    uint64_t getTransientOffset(ResourceHandle resource) const { return mResources[resource].offset; }
+    uint32_t getInitialState(ResourceHandle resource) const { return mResources[resource].initialState; }
+    uint64_t getAliasGroupSize(uint32_t aliasGroup) const;
+
+    static bool isReadState(uint32_t state);
+
+private:
+    struct Resource
+    {
+        const char* name;
+        RenderGraphResourceDesc desc;
+        uint32_t initialState;
+        uint32_t finalState;
+        bool imported;
+
+        uint32_t readers;
+        // schedule indices of the first and last use
+        uint32_t firstUse;
+        uint32_t lastUse;
+        uint64_t offset;
+        uint32_t state;
+        // first use of the transient taking over its memory
+        uint32_t nextOccupantUse;
+    };
+
+    struct Pass
+    {
+        const char* name;
+        uint32_t commandList;
+        bool hasSideEffects;
+        bool culled;
+        uint32_t writes;
+    };
+
+    struct Access
+    {
+        PassHandle pass;
+        ResourceHandle resource;
+        uint32_t state;
+        bool write;
+    };
+
+    void addAccess(PassHandle pass, ResourceHandle resource, uint32_t state, bool write);
+    void cullPasses();
+    bool buildSchedule();
+    void placeTransients();
+    void buildBarriers();
+    // Transition between the uses at schedule indices fromUse and toUse, InvalidHandle for the graph start and end.
+    // Transitions to the end of the graph are split around the tail of the command list of fromUse.
+    void addTransition(uint32_t fromUse, uint32_t toUse, ResourceHandle resource, uint32_t stateBefore, uint32_t stateAfter);
+    // Returns a transient to its initial state before its memory is handed to the next occupant.
+    void retire(uint32_t lastUse, uint32_t nextOccupantUse, ResourceHandle resource, uint32_t stateBefore, uint32_t stateAfter);
+
+    std::vector<Resource> mResources;
+    std::vector<Pass> mPasses;
+    std::vector<Access> mAccesses;
+    bool mAccessesSorted{ true };
+
+    std::vector<ScheduledPass> mSchedule;
+    std::vector<Barrier> mBarriers;
+    std::vector<CommandListTail> mTails;
+    std::vector<uint64_t> mAliasGroupSizes;
+    Stats mStats;
+
+    // compile scratch, kept to avoid allocating every frame
+    std::vector<uint32_t> mAccessBegin;
+    std::vector<ResourceHandle> mCullStack;
+    std::vector<ResourceHandle> mPlacementOrder;
+    std::vector<ResourceHandle> mLiveNeighbours;
+    std::vector<std::vector<Barrier>> mBarriersBefore;
+    std::vector<std::vector<Barrier>> mBarriersAfter;
+    std::vector<std::vector<Barrier>> mBarriersTail;
+};
+
+}
\ No newline at end of file
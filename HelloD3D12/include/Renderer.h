@@ -3,6 +3,16 @@
 namespace HDX
 {
 
+struct RendererConfig
+{
+    // frames the CPU may run ahead of the GPU, 1 to 4
+    uint32_t framesInFlight{ 2 };
+    // pace frames on the swap chain latency object instead of the frame fences
+    bool waitableSwapChain{ true };
+    // static cubes added on a 100 wide grid, to measure instancing on large scenes
+    uint32_t stressInstances{ 0 };
+};
+
 class Renderer
 {
 public:
@@ -14,8 +24,19 @@ public:
     virtual ~Renderer() {};
 
     virtual bool isInitialized() const = 0;
-    virtual bool init(HWND hWnd, uint32_t width, uint32_t height) = 0;
+    virtual bool init(HWND hWnd, uint32_t width, uint32_t height, const RendererConfig& config) = 0;
     virtual void onRender() = 0;
+    // Removes a model from the scene, its mesh GPU resources are freed once no frame in flight uses them.
+    virtual void unloadModel(uint32_t index) = 0;
+    // Index of the model under the pixel, -1 when there is none. Picks against the model bounds.
+    virtual int32_t pick(int32_t x, int32_t y) = 0;
+    // Writes the CPU occlusion buffer of the last frame as a PGM image.
+    virtual bool saveOcclusionDepth(const char* path) = 0;
+    // Draws the static shadow casters once into a cache instead of every frame.
+    virtual void setShadowCaching(bool enabled) = 0;
+    virtual bool isShadowCaching() const = 0;
+    // timestamps user input for the input to present latency
+    virtual void onInput() = 0;
 };
 
 }
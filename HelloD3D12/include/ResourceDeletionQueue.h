@@ -0,0 +1,20 @@
+#pragma once
+
+#include "DeferredDeletionQueue.h"
+#include "GpuMemoryAllocator.h"
+
+namespace HDX
+{
+
+// Fence view for DeferredDeletionQueue, the queue does not own the fence.
+struct D3D12CompletedFence
+{
+    ID3D12Fence* fence{ nullptr };
+
+    uint64_t getCompletedValue() const { return fence->GetCompletedValue(); }
+};
+
+// Releases GPU resources and their heap ranges once the direct queue fence passes their last use.
+using ResourceDeletionQueue = DeferredDeletionQueue<D3D12CompletedFence, GpuAllocation>;
+
+}
\ No newline at end of file
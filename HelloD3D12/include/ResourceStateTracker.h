@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace HDX
+{
+
+enum class TransitionSplit : uint32_t
+{
+    Full,
+    Begin,
+    End,
+};
+
+struct StateTransition
+{
+    uint32_t resource;
+    uint32_t subresource;
+    uint32_t stateBefore;
+    uint32_t stateAfter;
+    TransitionSplit split;
+};
+
+// Current state of every subresource of the tracked resources, independent of the graphics API.
+// transition() appends the transitions needed to move a resource or one subresource to a state, nothing
+// when it is already there. A resource whose subresources all share a state is stored as one state and
+// transitions as a whole, it is only expanded per subresource once they diverge and folded back when
+// they agree again.
+// Split transitions are begun and ended explicitly. Until ended the subresource keeps its old state, and
+// a transition touching it ends the pending split first.
+class ResourceStateTracker
+{
+public:
+    static const uint32_t AllSubresources{ 0xffffffff };
+
+    // Forgets all resources, handles start from 0 again.
+    void reset();
+
+    uint32_t track(uint32_t subresourceCount, uint32_t state);
+    uint32_t getResourceCount() const { return static_cast<uint32_t>(mResources.size()); }
+
+    void transition(uint32_t resource, uint32_t subresource, uint32_t state, std::vector<StateTransition>& transitions);
+    void beginTransition(uint32_t resource, uint32_t subresource, uint32_t state, std::vector<StateTransition>& transitions);
+    // Ends the splits begun with the same subresource argument.
+    void endTransition(uint32_t resource, uint32_t subresource, std::vector<StateTransition>& transitions);
+
+    uint32_t getState(uint32_t resource, uint32_t subresource) const;
+    bool isUniform(uint32_t resource) const { return mResources[resource].uniform; }
+    uint32_t getPendingCount() const { return static_cast<uint32_t>(mPending.size()); }
+    bool hasPending(uint32_t resource, uint32_t subresource) const;
+
+private:
+    struct Resource
+    {
+        uint32_t subresourceCount;
+        bool uniform;
+        // the state while uniform, otherwise mSubresourceStates[firstSubresource + i] holds subresource i
+        uint32_t state;
+        uint32_t firstSubresource;
+    };
+
+    struct Pending
+    {
+        uint32_t resource;
+        // subresource the split was begun with, endTransition matches it
+        uint32_t key;
+        uint32_t subresource;
+        uint32_t stateBefore;
+        uint32_t stateAfter;
+    };
+
+    static bool overlaps(uint32_t a, uint32_t b) { return a == AllSubresources || b == AllSubresources || a == b; }
+
+    void record(uint32_t resource, uint32_t subresource, uint32_t state, TransitionSplit split, uint32_t key, std::vector<StateTransition>& transitions);
+    void setState(uint32_t resource, uint32_t subresource, uint32_t state);
+    void endOverlapping(uint32_t resource, uint32_t subresource, std::vector<StateTransition>& transitions);
+    void endPending(size_t index, std::vector<StateTransition>& transitions);
+
+    std::vector<Resource> mResources;
+    std::vector<uint32_t> mSubresourceStates;
+    std::vector<Pending> mPending;
+};
+
+}
\ No newline at end of file
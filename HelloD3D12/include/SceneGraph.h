@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MathTypes.h"
+
+namespace HDX
+{
+
+// Transform hierarchy stored as flat arrays in depth first order: a parent always comes before its children and
+// the subtree of a node is the contiguous range [index, index + subtree size). world = local * parent world, so
+// update() computes every world matrix in one forward pass over the arrays, without recursion or pointer chasing.
+// Only dirty subtrees are recomputed. setLocal() flags the node, update() scans the flags a machine word at a time
+// and recomputes the subtree of each flagged node as a contiguous run, clean subtrees cost one flag test per node.
+// Nodes are addressed by stable handles. Roots, and children created depth first, are appended in place. Other
+// structural changes only mark the order stale, it is rebuilt in linear time by the next update(), so building a
+// large hierarchy is not quadratic. Each handle also links its children, so destroying a node only visits them.
+// setLocal() on distinct nodes may run on several threads, everything else is single threaded.
+class SceneGraph
+{
+public:
+    typedef uint32_t NodeId;
+    static const NodeId InvalidNode{ 0xffffffff };
+
+    struct Stats
+    {
+        uint32_t nodes{ 0 };
+        // world matrices computed by the last update
+        uint32_t updatedNodes{ 0 };
+        // subtrees recomputed by the last update, one per dirty node not below another dirty node
+        uint32_t dirtySubtrees{ 0 };
+        // true when the last update rebuilt the order
+        bool rebuilt{ false };
+    };
+
+    // The node starts with an identity local transform, under parent or as a root.
+    NodeId createNode(NodeId parent = InvalidNode);
+    // The children of the node move up to its parent and keep their local transforms.
+    void destroyNode(NodeId node);
+    void setParent(NodeId node, NodeId parent);
+    NodeId getParent(NodeId node) const { return mNodes[node].parent; }
+
+    // local is a row major matrix, relative to the parent
+    void setLocal(NodeId node, const float* local);
+    const float* getLocal(NodeId node) const { return mLocal[mNodes[node].index].m; }
+    // valid after update()
+    const float* getWorld(NodeId node) const { return mWorld[mNodes[node].index].m; }
+    // True when the last update() recomputed the world matrix of the node.
+    bool isUpdated(NodeId node) const { return mUpdateStamps[mNodes[node].index] == mUpdateCount; }
+
+    void update();
+
+    uint32_t getNodeCount() const { return static_cast<uint32_t>(mOrder.size()); }
+    const Stats& getStats() const { return mStats; }
+
+private:
+    struct Matrix
+    {
+        float m[16];
+    };
+
+    struct Node
+    {
+        NodeId parent;
+        // position in the depth first arrays, InvalidIndex while the node is free
+        uint32_t index;
+        // children of the parent as a doubly linked list, most recently attached first
+        NodeId firstChild;
+        NodeId previousSibling;
+        NodeId nextSibling;
+    };
+
+    static const uint32_t InvalidIndex{ 0xffffffff };
+
+    // attach the node as the first child of parent, or make it a root
+    void link(NodeId node, NodeId parent);
+    void unlink(NodeId node);
+    void rebuildOrder();
+    void updateSubtree(uint32_t first, uint32_t end);
+
+    // by handle
+    std::vector<Node> mNodes;
+    std::vector<NodeId> mFreeNodes;
+
+    // by depth first index
+    std::vector<NodeId> mOrder;
+    std::vector<uint32_t> mParentIndices;
+    std::vector<uint32_t> mSubtreeSizes;
+    std::vector<Matrix> mLocal;
+    std::vector<Matrix> mWorld;
+    std::vector<uint8_t> mDirty;
+    std::vector<uint32_t> mUpdateStamps;
+
+    bool mOrderStale{ false };
+    uint32_t mUpdateCount{ 0 };
+    Stats mStats;
+
+    // scratch of rebuildOrder
+    std::vector<uint32_t> mChildStarts;
+    std::vector<NodeId> mChildren;
+    std::vector<NodeId> mStack;
+    std::vector<Matrix> mScratchMatrices;
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace HDX
+{
+
+// One bit per optional shader feature. A variant key is the set of features a variant is built with, each
+// bit turns into a define of the same meaning, see getShaderFeatureDefine.
+enum ShaderFeature : uint32_t
+{
+    ShaderFeatureShadows = 1 << 0,
+    ShaderFeatureAlphaTest = 1 << 1,
+    ShaderFeatureInstancing = 1 << 2,
+    ShaderFeatureQuantizedVertices = 1 << 3,
+};
+
+typedef uint32_t ShaderVariantKey;
+
+static const uint32_t ShaderFeatureCount{ 4 };
+static const ShaderVariantKey ShaderFeatureMask{ (1u << ShaderFeatureCount) - 1 };
+
+// "SHADOWS" for ShaderFeatureShadows, nullptr for anything that is not a single feature bit.
+const char* getShaderFeatureDefine(uint32_t feature);
+// Feature defines joined by '|', "none" for the key 0. For logs.
+std::string describeShaderVariant(ShaderVariantKey key);
+
+// Key to variant lookup table. Keys are small, so the table is a dense array indexed by the key and a lookup
+// is a bounds check and one load, no hashing.
+// Variants are created on first use by resolve, or up front by resolving the keys known at load time.
+// Lookups never lock. Creation runs outside the lock, so variants can be built by several jobs at once. When two
+// threads race for the same key the first one to finish wins and the other result is dropped.
+template <typename T>
+class VariantTable
+{
+public:
+    explicit VariantTable(uint32_t keyBits) : mSlots(size_t(1) << keyBits) {}
+
+    VariantTable(const VariantTable&) = delete;
+    VariantTable& operator=(const VariantTable&) = delete;
+
+    // nullptr when the variant was not created yet or the key is out of range
+    T* find(ShaderVariantKey key) const
+    {
+        return key < mSlots.size() ? mSlots[key].load(std::memory_order_acquire) : nullptr;
+    }
+
+    // create(key) returns a std::unique_ptr<T>, nullptr when the variant cannot be built.
+    template <typename Create>
+    T* resolve(ShaderVariantKey key, Create&& create)
+    {
+        if (key >= mSlots.size())
+        {
+            return nullptr;
+        }
+
+        T* variant = mSlots[key].load(std::memory_order_acquire);
+        if (variant)
+        {
+            return variant;
+        }
+
+        std::unique_ptr<T> created = create(key);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        variant = mSlots[key].load(std::memory_order_relaxed);
+        if (variant)
+        {
+            return variant;
+        }
+        if (!created)
+        {
+            mFailedCount++;
+            return nullptr;
+        }
+
+        variant = created.get();
+        mVariants.push_back(std::move(created));
+        mSlots[key].store(variant, std::memory_order_release);
+        return variant;
+    }
+
+    size_t getCapacity() const { return mSlots.size(); }
+
+    size_t getVariantCount()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mVariants.size();
+    }
+
+    uint32_t getFailedCount()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mFailedCount;
+    }
+
+private:
+    std::vector<std::atomic<T*>> mSlots;
+    std::mutex mMutex;
+    std::vector<std::unique_ptr<T>> mVariants;
+    uint32_t mFailedCount{ 0 };
+};
+
+}
\ No newline at end of file
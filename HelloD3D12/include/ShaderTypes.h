@@ -0,0 +1,50 @@
+#pragma once
+
+using namespace DirectX;
+
+namespace HDX
+{
+
+// Layouts shared with the HLSL in assets/shaders/Common.hlsli, which ShadowMapVS.hlsl and the SimpleShader stages
+// include. Matrices are stored transposed.
+
+// ShadowMap::CascadeCount, the HLSL declares the cascade arrays as float4
+static const uint32_t ShaderCascadeCount{ 4 };
+
+struct FrameConstants
+{
+    XMFLOAT4X4 viewProj;
+    XMFLOAT4X4 cascadeViewProj[ShaderCascadeCount];
+    // camera view depth where each cascade ends
+    float      cascadeSplits[ShaderCascadeCount];
+    // depth bias of each cascade, in shadow map depth units
+    float      cascadeBias[ShaderCascadeCount];
+    XMFLOAT3   lightDir;
+    // cluster slice of a view depth is log(depth) * clusterDepthScale + clusterDepthBias, see LightClusters
+    float      clusterDepthScale;
+    // cluster tiles per pixel
+    XMFLOAT2   clusterTileScale;
+    float      clusterDepthBias;
+    float      padding;
+};
+
+struct InstanceData
+{
+    XMFLOAT4X4 world;
+};
+
+// Point light, or spot light when its cone cosines are above -1. World space.
+struct LightData
+{
+    XMFLOAT3 position;
+    // the light fades out to 0 at this distance
+    float    range;
+    XMFLOAT3 color;
+    // cosine of the outer half angle, no light outside the cone
+    float    spotCosOuter;
+    XMFLOAT3 direction;
+    // cosine of the inner half angle, full intensity inside the cone
+    float    spotCosInner;
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+
+#include "MathTypes.h"
+
+namespace HDX
+{
+
+// Fits the cascades of a cascaded shadow map to the camera.
+// The view depth range is split with the practical split scheme (Zhang et al. 2006), a blend of logarithmic splits,
+// which keep the texel to pixel ratio constant, and uniform splits, which keep the near cascades from getting
+// uselessly small. Each cascade is an orthographic projection around the bounding sphere of its slice of the
+// camera frustum. The sphere only depends on the split depths and the field of view, so the cascade keeps its size
+// when the camera turns, and its center is snapped to whole texels in light space, so the shadow edges do not
+// shimmer when the camera moves.
+// The light view has no translation, the snapping would not be stable otherwise. The depth range only covers the
+// sphere, casters between it and the light are clamped to the near plane by the shadow pipeline instead.
+class ShadowCascades
+{
+public:
+    static const uint32_t MaxCascades{ 4 };
+
+    struct Camera
+    {
+        // row major world to view matrix, left handed like XMMatrixLookAtLH
+        const float* view;
+        // vertical field of view in radians
+        float fovY;
+        float aspectRatio;
+        float nearZ;
+        float farZ;
+    };
+
+    struct Cascade
+    {
+        // row major light view projection, D3D clip space
+        float viewProj[16];
+        // camera view depth range covered by the cascade
+        float splitNear;
+        float splitFar;
+        // world space bounding sphere of the camera frustum slice, before snapping
+        Float3 center;
+        float radius;
+        // world size of a shadow map texel
+        float texelSize;
+        // light view depth range of the projection
+        float lightNearZ;
+        float lightFarZ;
+        // camera frustum clipped to the split range, receivers outside it do not sample this cascade
+        Frustum cameraFrustum;
+    };
+
+    // Writes count + 1 split depths from nearZ to farZ. lambda 0 gives uniform splits, 1 logarithmic ones.
+    static void computeSplits(float nearZ, float farZ, uint32_t count, float lambda, float* splits);
+
+    // lightDirection is the direction the light travels, resolution the size of a cascade in texels.
+    void fit(const Camera& camera, const Float3& lightDirection, uint32_t count, float lambda, uint32_t resolution);
+
+    uint32_t getCount() const { return mCount; }
+    const Cascade& getCascade(uint32_t index) const { return mCascades[index]; }
+    // row major world to light view matrix shared by the cascades
+    const float* getLightView() const { return mLightView; }
+
+private:
+    uint32_t mCount{ 0 };
+    float mLightView[16]{};
+    Cascade mCascades[MaxCascades]{};
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+#include "MathTypes.h"
+
+namespace HDX
+{
+
+// Planes bounding the shadow casters that can darken something the camera sees.
+// A caster shadows the space its bounds sweep along the light direction. The sweep can only cross a plane from
+// outside to inside if the light direction points into the plane, so a caster outside any plane the light does
+// not point into is outside forever and can be culled. Those planes are kept from both frustums:
+//   light frustum  the far plane and the sides, not the near plane, so casters between the light and the shadow
+//                  map volume still cast into it
+//   camera         the planes facing away from the light, so casters whose shadow only falls on receivers outside
+//                  the view are culled too
+class ShadowCasterVolume
+{
+public:
+    // lightDirection is the direction the light travels, light and camera the frustums of their view projections.
+    void build(const Frustum& light, const Frustum& camera, const Float3& lightDirection);
+
+    const Plane* getPlanes() const { return mPlanes; }
+    uint32_t getPlaneCount() const { return mPlaneCount; }
+
+private:
+    Plane mPlanes[MaxPlanes];
+    uint32_t mPlaneCount{ 0 };
+};
+
+}
\ No newline at end of file
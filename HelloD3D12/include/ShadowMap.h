@@ -5,10 +5,38 @@ using namespace Microsoft::WRL;
 namespace HDX
 {
 
+class PipelineCache;
+
+// Cascaded shadow map, one slice of a texture array per cascade, see ShadowCascades. The pass draws each cascade
+// with its own DSV and the cascade index as a root constant, the matrices are in the frame constants.
+// Static casters can be cached: they are drawn into a persistent texture array of the same layout, which is copied
+// to the shadow map every frame before the moving casters are drawn over it. A cascade of the cache is only redrawn
+// when its projection or the set of static casters changed.
 class ShadowMap
 {
 public:
+    enum RootParameter : UINT
+    {
+        RootFrameConstants,
+        RootInstances,
+        RootInstanceIndices,
+        RootDrawConstants,
+        RootCascade,
+        RootParameterCount
+    };
+
+    // same draw constants as SimpleShader so both passes consume one indirect command layout
+    static const UINT DrawConstantCount{ 2 };
+    // size of a cascade
+    static const UINT Size{ 2048 };
+    static const UINT CascadeCount{ 4 };
+
+    // The depth texture is a render graph transient, created from this description.
+    static D3D12_RESOURCE_DESC getDepthTextureDesc();
+    static D3D12_CLEAR_VALUE getDepthClearValue();
+
     bool prepare(ID3D12Device* device,
+        PipelineCache* pipelineCache,
         ID3D12CommandQueue*  commandQueue,
         ID3D12GraphicsCommandList* commandList,
         ID3D12DescriptorHeap* srvCBVHeap,
@@ -19,19 +47,36 @@ public:
         UINT frameCount
     );
 
+    // Points the DSVs and the SRV at the depth texture the render graph placed this frame.
+    void setDepthTexture(ID3D12Device* device, ID3D12Resource* depthTexture);
+
     void onRender(ID3D12GraphicsCommandList* cmdList);
 
+    // True when the static casters of the cascade have to be redrawn into the cache this frame, because its
+    // projection or staticVersion changed since the last redraw. The cascade counts as up to date afterwards.
+    bool updateStaticCache(UINT cascade, const float* viewProj, uint64_t staticVersion);
+    // Forces every cascade to be redrawn, e.g. when a frame drawing the cache was dropped.
+    void invalidateStaticCache();
+
     const ComPtr<ID3D12PipelineState> &getPipelineState() { return mPipelineState; }
     const ComPtr<ID3D12RootSignature> &getRootSignature() { return mRootSignature; }
-    const ComPtr<ID3D12DescriptorHeap> &getDSVHeap() { return mDSVHeap; }
-    const ComPtr<ID3D12Resource> &getDepthTexture() { return mDepthTexture; }
+    D3D12_CPU_DESCRIPTOR_HANDLE getDSVHandle(UINT cascade) { return CD3DX12_CPU_DESCRIPTOR_HANDLE(mDSVHeap->GetCPUDescriptorHandleForHeapStart(), cascade, mDSVDescriptorSize); }
+    ID3D12Resource* getDepthTexture() { return mDepthTexture; }
+    ID3D12Resource* getStaticDepthTexture() { return mStaticDepthTexture.Get(); }
+    D3D12_CPU_DESCRIPTOR_HANDLE getStaticDSVHandle(UINT cascade) { return getDSVHandle(CascadeCount + cascade); }
     const D3D12_CPU_DESCRIPTOR_HANDLE getSRVHandle() { return mSRVDescriptorStart; }
 
 private:
     ComPtr<ID3D12DescriptorHeap> mDSVHeap;
-    ComPtr<ID3D12Resource> mDepthTexture;
+    UINT mDSVDescriptorSize{ 0 };
+    ID3D12Resource* mDepthTexture{ nullptr };
     D3D12_CPU_DESCRIPTOR_HANDLE mSRVDescriptorStart;
 
+    ComPtr<ID3D12Resource> mStaticDepthTexture;
+    float mStaticViewProj[CascadeCount][16]{};
+    uint64_t mStaticVersion[CascadeCount]{};
+    bool mStaticValid[CascadeCount]{};
+
     ComPtr<ID3D12PipelineState> mPipelineState;
     ComPtr<ID3D12RootSignature> mRootSignature;
 };
@@ -1,21 +1,74 @@
 #pragma once
 
+#include "ShaderPermutation.h"
+
 using namespace Microsoft::WRL;
 
 namespace HDX
 {
 
+class PipelineCache;
+
+// Scene shader with permutations, see ShaderFeature. Every variant shares the one root signature, variants only
+// differ in bytecode and pipeline state, so switching between them never rebinds root parameters.
 class SimpleShader
 {
 public:
-    bool prepare(ID3D12Device* device);
+    enum RootParameter : UINT
+    {
+        RootTextures,
+        RootFrameConstants,
+        RootShadowMap,
+        RootInstances,
+        RootInstanceIndices,
+        RootDrawConstants,
+        RootLights,
+        RootLightCells,
+        RootLightIndices,
+        RootParameterCount
+    };
+
+    // instance base and material index, set per draw
+    static const UINT DrawConstantCount{ 2 };
+    // size of the bindless texture table, materials index into it
+    static const UINT MaxMaterials{ 256 };
+
+    // the variant the project compiles at build time and the renderer draws with
+    static const ShaderVariantKey DefaultVariant{ ShaderFeatureShadows | ShaderFeatureInstancing };
+    // features each stage is compiled with, variants differing in other features share the stage bytecode
+    static const ShaderVariantKey VertexFeatures{ ShaderFeatureShadows | ShaderFeatureInstancing };
+    static const ShaderVariantKey PixelFeatures{ ShaderFeatureShadows | ShaderFeatureAlphaTest };
 
-    const ComPtr<ID3D12PipelineState> &getPipelineState() { return mPipelineState; }
+    // Creates the root signature and the default variant.
+    bool prepare(ID3D12Device* device, PipelineCache* pipelineCache);
+    // Builds variants ahead of their first use, e.g. from a loading job. Safe to call from several threads.
+    bool precompile(const ShaderVariantKey* keys, size_t count);
+
+    // Builds the variant on first use, nullptr when it does not build.
+    ID3D12PipelineState* getPipelineState(ShaderVariantKey key = DefaultVariant);
     const ComPtr<ID3D12RootSignature> &getRootSignature() { return mRootSignature; }
+    size_t getVariantCount() { return mPipelineStates.getVariantCount(); }
 
 private:
-    ComPtr<ID3D12PipelineState> mPipelineState;
+    struct ShaderVariant
+    {
+        ComPtr<ID3DBlob> bytecode;
+    };
+
+    struct PipelineVariant
+    {
+        ComPtr<ID3D12PipelineState> pipelineState;
+    };
+
+    // cookedKey is the stage variant the build compiled
+    ID3DBlob* getShader(VariantTable<ShaderVariant>& shaders, ShaderVariantKey key, ShaderVariantKey cookedKey, const char* name, const char* entryPoint, const char* target);
+    std::unique_ptr<PipelineVariant> createPipelineState(ShaderVariantKey key);
+
+    PipelineCache* mPipelineCache{ nullptr };
     ComPtr<ID3D12RootSignature> mRootSignature;
+    VariantTable<ShaderVariant> mVertexShaders{ ShaderFeatureCount };
+    VariantTable<ShaderVariant> mPixelShaders{ ShaderFeatureCount };
+    VariantTable<PipelineVariant> mPipelineStates{ ShaderFeatureCount };
 };
 
 
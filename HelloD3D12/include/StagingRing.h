@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+namespace HDX
+{
+
+// Bookkeeping of a circular staging buffer whose allocations are released in submission order.
+// Allocations made since the last retire() belong to the fence value passed to it and are reclaimed
+// once that fence completes. The ring only hands out offsets, the memory itself is owned by the caller.
+class StagingRing
+{
+public:
+    explicit StagingRing(uint64_t capacity);
+
+    // Returns false when the ring cannot fit size bytes until older allocations are reclaimed.
+    // alignment must be a power of two.
+    bool allocate(uint64_t size, uint64_t alignment, uint64_t &offset);
+
+    // Tags every allocation since the previous retire() with fenceValue. Fence values must increase.
+    void retire(uint64_t fenceValue);
+
+    // Releases the allocations of every fence value up to completedFenceValue.
+    void reclaim(uint64_t completedFenceValue);
+
+    // Fence value whose completion releases the oldest retired allocations, 0 if nothing is retired.
+    uint64_t getOldestFenceValue() const { return mRetired.empty() ? 0 : mRetired.front().fenceValue; }
+
+    uint64_t getCapacity() const { return mCapacity; }
+    uint64_t getUsed() const { return mUsed; }
+    uint64_t getPending() const { return mPending; }
+
+private:
+    struct Retirement
+    {
+        uint64_t fenceValue;
+        uint64_t size;
+    };
+
+    uint64_t mCapacity;
+    uint64_t mHead{ 0 };
+    // bytes between the oldest live allocation and mHead, alignment and wrap padding included
+    uint64_t mUsed{ 0 };
+    // part of mUsed not retired yet
+    uint64_t mPending{ 0 };
+    std::deque<Retirement> mRetired;
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace HDX
+{
+
+// Two level segregated fit allocator over an abstract range of capacity bytes, O(1) allocate and free.
+// Free blocks are binned by the power of two of their size (first level) and by SubdivisionCount linear
+// steps inside it (second level), a pair of bitmaps finds the first non empty bin that fits a request. When there
+// is none, the first block of the bin of the request itself is tried, it may still be large enough.
+// Freed blocks merge with their free neighbours. Only offsets are handed out, the memory is owned by the caller.
+class TLSFAllocator
+{
+public:
+    static const uint32_t InvalidHandle{ 0xffffffff };
+
+    struct Allocation
+    {
+        uint64_t offset{ 0 };
+        uint64_t size{ 0 };
+        uint32_t handle{ InvalidHandle };
+    };
+
+    explicit TLSFAllocator(uint64_t capacity);
+
+    // Returns false when no free block fits size bytes at the alignment, which must be a power of two.
+    bool allocate(uint64_t size, uint64_t alignment, Allocation &allocation);
+    void free(uint32_t handle);
+
+    uint64_t getCapacity() const { return mCapacity; }
+    uint64_t getUsed() const { return mUsed; }
+    uint64_t getFree() const { return mCapacity - mUsed; }
+    uint32_t getAllocationCount() const { return mAllocationCount; }
+    uint32_t getFreeBlockCount() const { return mFreeBlockCount; }
+    uint64_t getLargestFreeBlock() const;
+    bool isEmpty() const { return mAllocationCount == 0; }
+
+    // 1 - largest free block / free bytes: 0 when the free space is one block, close to 1 when it is scattered
+    float getFragmentation() const;
+
+private:
+    static const uint32_t SubdivisionBits{ 4 };
+    static const uint32_t SubdivisionCount{ 1 << SubdivisionBits };
+    static const uint32_t FirstLevelCount{ 64 - SubdivisionBits + 1 };
+
+    struct Block
+    {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t prevPhysical;
+        uint32_t nextPhysical;
+        uint32_t prevFree;
+        uint32_t nextFree;
+        bool isFree;
+    };
+
+    static void mapping(uint64_t size, uint32_t &firstLevel, uint32_t &secondLevel);
+
+    uint32_t newBlock();
+    void deleteBlock(uint32_t index);
+
+    void insertFree(uint32_t index);
+    void removeFree(uint32_t index);
+    // First free block of a bin holding blocks of at least size bytes, InvalidHandle if none.
+    uint32_t findFree(uint64_t size) const;
+    // Shrinks a block to size bytes, the rest moves to remainder, a block fresh from newBlock().
+    void split(uint32_t index, uint64_t size, uint32_t remainder);
+
+    uint64_t mCapacity;
+    uint64_t mUsed{ 0 };
+    uint32_t mAllocationCount{ 0 };
+    uint32_t mFreeBlockCount{ 0 };
+
+    uint64_t mFirstLevelBitmap{ 0 };
+    uint32_t mSecondLevelBitmaps[FirstLevelCount]{};
+    uint32_t mFreeLists[FirstLevelCount][SubdivisionCount];
+
+    std::vector<Block> mBlocks;
+    std::vector<uint32_t> mUnusedBlocks;
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+
+#include "StagingRing.h"
+
+using namespace Microsoft::WRL;
+
+namespace HDX
+{
+
+// Streams buffer and texture data through one persistent upload heap on a dedicated copy queue.
+// Staging memory is reclaimed as the copy fence advances. Destinations are expected in the COMMON state:
+// they are implicitly promoted to COPY_DEST on the copy queue and decay back to COMMON once the copies complete,
+// from where the direct queue promotes them to the read state it needs.
+class UploadManager
+{
+public:
+    ~UploadManager();
+
+    bool prepare(ID3D12Device* device, UINT64 stagingSize);
+
+    // Copies data right away into staging memory and records the GPU copies. Uploads larger than the ring are split.
+    bool uploadBuffer(ID3D12Resource* destination, UINT64 destinationOffset, const void* data, UINT64 size);
+    bool uploadTexture(ID3D12Resource* destination, const D3D12_SUBRESOURCE_DATA& data);
+
+    // Submits the recorded copies, returns the fence value signaled when they complete.
+    UINT64 submit();
+
+    // Makes queue wait on the GPU for the copies of fenceValue, the CPU does not block.
+    void waitOnQueue(ID3D12CommandQueue* queue, UINT64 fenceValue);
+
+    // Releases staging memory and command allocators of completed submissions.
+    void reclaim();
+
+    // Blocks until every submitted copy completed.
+    void waitIdle();
+
+private:
+    struct Allocator
+    {
+        ComPtr<ID3D12CommandAllocator> allocator;
+        UINT64 fenceValue;
+    };
+
+    bool beginCommandList();
+    bool allocateStaging(UINT64 size, UINT64 alignment, UINT64 &offset);
+    void waitForFence(UINT64 fenceValue);
+
+    ComPtr<ID3D12Device> mDevice;
+    ComPtr<ID3D12CommandQueue> mCopyQueue;
+    ComPtr<ID3D12GraphicsCommandList> mCommandList;
+    ComPtr<ID3D12Resource> mStagingBuffer;
+    UINT8* mStagingBegin{ nullptr };
+    std::unique_ptr<StagingRing> mRing;
+
+    ComPtr<ID3D12Fence> mFence;
+    HANDLE mFenceEvent{ nullptr };
+    UINT64 mNextFenceValue{ 1 };
+
+    std::deque<Allocator> mAllocators;
+    ComPtr<ID3D12CommandAllocator> mCurrentAllocator;
+    bool mIsRecording{ false };
+};
+
+}
\ No newline at end of file
@@ -4,6 +4,10 @@
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers.
 #endif
 
+#ifndef NOMINMAX
+#define NOMINMAX                        // std::min and std::max instead of the min/max macros.
+#endif
+
 #include <Windows.h>
 
 #include <d3d12.h>
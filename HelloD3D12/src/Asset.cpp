@@ -34,8 +34,8 @@ struct Asset::Impl
 
     uint32_t getLength() 
     {
-        assert(mAsset);
-        return AAsset_getLength(mAsset);
+        // a missing asset reads as empty
+        return mAsset ? AAsset_getLength(mAsset) : 0;
     }
 
     void read(uint8_t* data, uint32_t size)
@@ -72,9 +72,12 @@ struct Asset::Impl
 
         filename = "assets/" + filename;
         mAsset = fopen(filename.c_str(), "rb");
-        fseek(mAsset, 0L, SEEK_END);
-        mSize = ftell(mAsset);
-        fseek(mAsset, 0L, SEEK_SET);
+        if (mAsset)
+        {
+            fseek(mAsset, 0L, SEEK_END);
+            mSize = ftell(mAsset);
+            fseek(mAsset, 0L, SEEK_SET);
+        }
     }
 
     ~Impl()
@@ -87,6 +90,7 @@ struct Asset::Impl
 
     uint32_t getLength()
     {
+        // a missing file reads as empty
         return mSize;
     }
 
@@ -0,0 +1,117 @@
+#include "stdafx.h"
+
+#include <assert.h>
+#include "BarrierBatcher.h"
+
+namespace HDX
+{
+
+static_assert(ResourceStateTracker::AllSubresources == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, "Subresource wildcards do not match");
+
+void BarrierBatcher::reset()
+{
+    assert(mBarriers.empty() && mTracker.getPendingCount() == 0);
+    mTracker.reset();
+    mHandles.clear();
+    mResources.clear();
+    mFlushCount = 0;
+    mBarrierCount = 0;
+}
+
+void BarrierBatcher::track(ID3D12Resource* resource, D3D12_RESOURCE_STATES state, UINT subresourceCount)
+{
+    assert(!isTracked(resource));
+    mHandles[resource] = mTracker.track(subresourceCount, static_cast<uint32_t>(state));
+    mResources.push_back(resource);
+}
+
+D3D12_RESOURCE_STATES BarrierBatcher::getState(ID3D12Resource* resource, UINT subresource) const
+{
+    return static_cast<D3D12_RESOURCE_STATES>(mTracker.getState(getHandle(resource), subresource));
+}
+
+void BarrierBatcher::transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES state, UINT subresource)
+{
+    mTracker.transition(getHandle(resource), subresource, static_cast<uint32_t>(state), mTransitions);
+    queueTransitions();
+}
+
+void BarrierBatcher::beginTransition(ID3D12Resource* resource, D3D12_RESOURCE_STATES state, UINT subresource)
+{
+    mTracker.beginTransition(getHandle(resource), subresource, static_cast<uint32_t>(state), mTransitions);
+    queueTransitions();
+}
+
+void BarrierBatcher::endTransition(ID3D12Resource* resource, UINT subresource)
+{
+    mTracker.endTransition(getHandle(resource), subresource, mTransitions);
+    queueTransitions();
+}
+
+void BarrierBatcher::aliasing(ID3D12Resource* before, ID3D12Resource* after)
+{
+    mBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(before, after));
+}
+
+void BarrierBatcher::uav(ID3D12Resource* resource)
+{
+    mBarriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(resource));
+}
+
+void BarrierBatcher::flush(ID3D12GraphicsCommandList* commandList)
+{
+    if (mBarriers.empty())
+    {
+        return;
+    }
+
+    commandList->ResourceBarrier(static_cast<UINT>(mBarriers.size()), mBarriers.data());
+    mFlushCount++;
+    mBarrierCount += static_cast<uint32_t>(mBarriers.size());
+    mBarriers.clear();
+}
+
+UINT BarrierBatcher::getSubresourceCount(const D3D12_RESOURCE_DESC& desc)
+{
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    {
+        return 1;
+    }
+
+    // planar formats are not used, every subresource is one mip of one array slice
+    UINT arraySize = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : desc.DepthOrArraySize;
+    return desc.MipLevels * arraySize;
+}
+
+uint32_t BarrierBatcher::getHandle(ID3D12Resource* resource) const
+{
+    auto it = mHandles.find(resource);
+    assert(it != mHandles.end());
+    return it->second;
+}
+
+void BarrierBatcher::queueTransitions()
+{
+    for (const StateTransition& transition : mTransitions)
+    {
+        D3D12_RESOURCE_BARRIER_FLAGS flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+        if (transition.split == TransitionSplit::Begin)
+        {
+            flags = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+        }
+        else if (transition.split == TransitionSplit::End)
+        {
+            flags = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+        }
+
+        mBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
+            mResources[transition.resource],
+            static_cast<D3D12_RESOURCE_STATES>(transition.stateBefore),
+            static_cast<D3D12_RESOURCE_STATES>(transition.stateAfter),
+            transition.subresource,
+            flags));
+    }
+    mTransitions.clear();
+}
+
+}
\ No newline at end of file
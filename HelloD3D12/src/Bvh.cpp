@@ -0,0 +1,812 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <xmmintrin.h>
+
+namespace HDX
+{
+
+static const uint32_t BinCount{ 12 };
+// cost of visiting a node relative to testing one object
+static const float TraversalCost{ 1.f };
+// rotations that save less area than this fraction of the node are not worth collapsing the BVH4 again
+static const float MinRotationGain{ 5e-2f };
+static const uint32_t MaxStackSize{ 3 * Bvh::MaxDepth + 4 };
+
+static Bvh::Box emptyBox()
+{
+    const float big = std::numeric_limits<float>::max();
+    return { { big, big, big }, { -big, -big, -big } };
+}
+
+static void grow(Bvh::Box& box, const Bvh::Box& other)
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        box.min[axis] = std::min(box.min[axis], other.min[axis]);
+        box.max[axis] = std::max(box.max[axis], other.max[axis]);
+    }
+}
+
+static Bvh::Box merge(const Bvh::Box& a, const Bvh::Box& b)
+{
+    Bvh::Box box = a;
+    grow(box, b);
+    return box;
+}
+
+static float area(const Bvh::Box& box)
+{
+    float dx = std::max(box.max[0] - box.min[0], 0.f);
+    float dy = std::max(box.max[1] - box.min[1], 0.f);
+    float dz = std::max(box.max[2] - box.min[2], 0.f);
+    return 2.f * (dx * dy + dy * dz + dz * dx);
+}
+
+static float centroid(const Bvh::Box& box, int axis)
+{
+    return (box.min[axis] + box.max[axis]) * 0.5f;
+}
+
+static Bvh::Box toBox(const Bounds& bounds)
+{
+    return {
+        { bounds.center.x - bounds.extents.x, bounds.center.y - bounds.extents.y, bounds.center.z - bounds.extents.z },
+        { bounds.center.x + bounds.extents.x, bounds.center.y + bounds.extents.y, bounds.center.z + bounds.extents.z }
+    };
+}
+
+// false when the box is completely behind one of the planes in planeMask
+static bool intersectsPlanes(const Bvh::Box& box, const Plane* planes, uint32_t planeMask)
+{
+    for (uint32_t side = 0; planeMask; side++, planeMask >>= 1)
+    {
+        if ((planeMask & 1) == 0)
+        {
+            continue;
+        }
+
+        const Plane& plane = planes[side];
+        float distance = 0.f;
+        float radius = 0.f;
+        const float normal[3] = { plane.normal.x, plane.normal.y, plane.normal.z };
+        for (int axis = 0; axis < 3; axis++)
+        {
+            distance += normal[axis] * centroid(box, axis);
+            radius += std::fabs(normal[axis]) * (box.max[axis] - box.min[axis]) * 0.5f;
+        }
+        if (distance + plane.distance + radius < 0.f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Bvh::build(const Bounds* bounds, uint32_t count)
+{
+    mObjectBoxes.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        mObjectBoxes[i] = toBox(bounds[i]);
+    }
+
+    // the build partitions copies of the boxes, reading them in place through indices would miss the cache
+    mBuildRefs.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        mBuildRefs[i] = { mObjectBoxes[i], { bounds[i].center.x, bounds[i].center.y, bounds[i].center.z }, i };
+    }
+
+    mBinaryNodes.clear();
+    mBinaryNodes.reserve(count > 0 ? 2 * count - 1 : 0);
+    mStats = Stats{};
+    mBinaryRoot = count > 0 ? buildNode(0, count, 1) : InvalidIndex;
+
+    mBuildIndices.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        mBuildIndices[i] = mBuildRefs[i].object;
+    }
+
+    updateSahCost();
+    collapse();
+}
+
+uint32_t Bvh::buildNode(uint32_t first, uint32_t count, uint32_t depth)
+{
+    // the vector may grow while the children are built, the node is only accessed by index
+    const uint32_t index = static_cast<uint32_t>(mBinaryNodes.size());
+    mBinaryNodes.push_back({ emptyBox(), InvalidIndex, InvalidIndex, first, count });
+
+    Box box = emptyBox();
+    Box centroids = emptyBox();
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        const BuildRef& ref = mBuildRefs[i];
+        grow(box, ref.box);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            centroids.min[axis] = std::min(centroids.min[axis], ref.centroid[axis]);
+            centroids.max[axis] = std::max(centroids.max[axis], ref.centroid[axis]);
+        }
+    }
+    mBinaryNodes[index].box = box;
+
+    // binning costs the same for every node, splitting small nodes is not worth it
+    if (count <= MaxLeafSize || depth >= MaxDepth)
+    {
+        return index;
+    }
+
+    // Binned SAH: objects go to bins by centroid, every boundary between bins is a candidate split. All three axes
+    // are binned in one pass over the objects.
+    float scales[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const float extent = centroids.max[axis] - centroids.min[axis];
+        scales[axis] = extent > 0.f ? BinCount / extent : 0.f;
+    }
+
+    uint32_t binCounts[3][BinCount]{};
+    Box binBoxes[3][BinCount];
+    std::fill(&binBoxes[0][0], &binBoxes[0][0] + 3 * BinCount, emptyBox());
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        const BuildRef& ref = mBuildRefs[i];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            uint32_t bin = std::min(BinCount - 1, static_cast<uint32_t>((ref.centroid[axis] - centroids.min[axis]) * scales[axis]));
+            binCounts[axis][bin]++;
+            grow(binBoxes[axis][bin], ref.box);
+        }
+    }
+
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1;
+    uint32_t bestSplit = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (scales[axis] == 0.f)
+        {
+            continue;
+        }
+
+        float leftArea[BinCount - 1];
+        uint32_t leftCount[BinCount - 1];
+        Box left = emptyBox();
+        uint32_t leftObjects = 0;
+        for (uint32_t split = 0; split < BinCount - 1; split++)
+        {
+            grow(left, binBoxes[axis][split]);
+            leftObjects += binCounts[axis][split];
+            leftArea[split] = area(left);
+            leftCount[split] = leftObjects;
+        }
+
+        Box right = emptyBox();
+        uint32_t rightObjects = 0;
+        for (uint32_t split = BinCount - 1; split > 0; split--)
+        {
+            grow(right, binBoxes[axis][split]);
+            rightObjects += binCounts[axis][split];
+            const uint32_t leftObjectCount = leftCount[split - 1];
+            if (leftObjectCount == 0 || rightObjects == 0)
+            {
+                continue;
+            }
+
+            float cost = leftArea[split - 1] * leftObjectCount + area(right) * rightObjects;
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    uint32_t middle;
+    if (bestAxis >= 0)
+    {
+        const float scale = scales[bestAxis];
+        const float minCentroid = centroids.min[bestAxis];
+        BuildRef* begin = mBuildRefs.data() + first;
+        BuildRef* split = std::partition(begin, begin + count, [bestAxis, bestSplit, scale, minCentroid](const BuildRef& ref)
+        {
+            return std::min(BinCount - 1, static_cast<uint32_t>((ref.centroid[bestAxis] - minCentroid) * scale)) < bestSplit;
+        });
+        middle = first + static_cast<uint32_t>(split - begin);
+    }
+    else
+    {
+        // every centroid is the same point, any split is as good as another
+        middle = first + count / 2;
+    }
+
+    const uint32_t left = buildNode(first, middle - first, depth + 1);
+    const uint32_t right = buildNode(middle, first + count - middle, depth + 1);
+    BinaryNode& node = mBinaryNodes[index];
+    node.left = left;
+    node.right = right;
+    node.count = 0;
+    return index;
+}
+
+void Bvh::refit(const Bounds* bounds, bool rotate)
+{
+    for (size_t i = 0; i < mObjectBoxes.size(); i++)
+    {
+        mObjectBoxes[i] = toBox(bounds[i]);
+    }
+
+    mStats.rotations = 0;
+    if (mBinaryRoot != InvalidIndex)
+    {
+        refitNode(mBinaryRoot, rotate);
+    }
+
+    updateSahCost();
+    if (mStats.rotations > 0)
+    {
+        collapse();
+        return;
+    }
+
+    // same topology, the wide nodes only copy the boxes of the binary nodes or objects they were collapsed from
+    for (uint32_t node = 0; node < mWideNodes.size(); node++)
+    {
+        for (uint32_t lane = 0; lane < 4; lane++)
+        {
+            const uint32_t source = mWideSources[node * 4 + lane];
+            if (source == InvalidIndex)
+            {
+                continue;
+            }
+
+            const WideNode& wide = mWideNodes[node];
+            const Box& box = (source & ObjectSource) ? mObjectBoxes[source & ~ObjectSource] : mBinaryNodes[source].box;
+            setLane(node, lane, box, wide.child[lane], wide.first[lane], wide.count[lane], source);
+        }
+    }
+}
+
+void Bvh::refitNode(uint32_t index, bool rotate)
+{
+    BinaryNode& node = mBinaryNodes[index];
+    if (node.count > 0)
+    {
+        Box box = emptyBox();
+        for (uint32_t i = node.first; i < node.first + node.count; i++)
+        {
+            grow(box, mObjectBoxes[mBuildIndices[i]]);
+        }
+        node.box = box;
+        return;
+    }
+
+    refitNode(node.left, rotate);
+    refitNode(node.right, rotate);
+    if (rotate)
+    {
+        this->rotate(index);
+    }
+    node.box = merge(mBinaryNodes[node.left].box, mBinaryNodes[node.right].box);
+}
+
+void Bvh::rotate(uint32_t index)
+{
+    // Swapping a child with a grandchild keeps the node box but changes the box of the other child. Of the four
+    // swaps the one shrinking that box the most is applied, lower nodes were already refit and rotated.
+    BinaryNode& node = mBinaryNodes[index];
+    BinaryNode& left = mBinaryNodes[node.left];
+    BinaryNode& right = mBinaryNodes[node.right];
+
+    float bestGain = 0.f;
+    int bestRotation = -1;
+    if (right.count == 0)
+    {
+        const float rightArea = area(right.box);
+        float gain = rightArea - area(merge(left.box, mBinaryNodes[right.right].box));
+        if (gain > bestGain)
+        {
+            bestGain = gain;
+            bestRotation = 0;
+        }
+        gain = rightArea - area(merge(mBinaryNodes[right.left].box, left.box));
+        if (gain > bestGain)
+        {
+            bestGain = gain;
+            bestRotation = 1;
+        }
+    }
+    if (left.count == 0)
+    {
+        const float leftArea = area(left.box);
+        float gain = leftArea - area(merge(right.box, mBinaryNodes[left.right].box));
+        if (gain > bestGain)
+        {
+            bestGain = gain;
+            bestRotation = 2;
+        }
+        gain = leftArea - area(merge(mBinaryNodes[left.left].box, right.box));
+        if (gain > bestGain)
+        {
+            bestGain = gain;
+            bestRotation = 3;
+        }
+    }
+
+    if (bestRotation < 0 || bestGain < MinRotationGain * area(node.box))
+    {
+        return;
+    }
+
+    switch (bestRotation)
+    {
+    case 0:
+        std::swap(node.left, right.left);
+        break;
+    case 1:
+        std::swap(node.left, right.right);
+        break;
+    case 2:
+        std::swap(node.right, left.left);
+        break;
+    default:
+        std::swap(node.right, left.right);
+        break;
+    }
+
+    // the child that received the grandchild, whichever side it is on now
+    BinaryNode& changed = bestRotation < 2 ? mBinaryNodes[node.right] : mBinaryNodes[node.left];
+    changed.box = merge(mBinaryNodes[changed.left].box, mBinaryNodes[changed.right].box);
+    mStats.rotations++;
+}
+
+void Bvh::updateSahCost()
+{
+    mStats.sahCost = 0.f;
+    if (mBinaryRoot == InvalidIndex)
+    {
+        return;
+    }
+
+    float cost = 0.f;
+    for (const BinaryNode& node : mBinaryNodes)
+    {
+        cost += area(node.box) * (node.count > 0 ? static_cast<float>(node.count) : TraversalCost);
+    }
+    const float rootArea = area(mBinaryNodes[mBinaryRoot].box);
+    mStats.sahCost = rootArea > 0.f ? cost / rootArea : 0.f;
+}
+
+void Bvh::collapse()
+{
+    mWideNodes.clear();
+    mWideSources.clear();
+    mObjects.clear();
+    mObjects.reserve(mObjectBoxes.size());
+    mStats.binaryNodes = static_cast<uint32_t>(mBinaryNodes.size());
+    mStats.depth = 0;
+    if (mBinaryRoot != InvalidIndex)
+    {
+        collapseNode(mBinaryRoot, 1);
+    }
+    mStats.wideNodes = static_cast<uint32_t>(mWideNodes.size());
+}
+
+void Bvh::appendObjects(uint32_t index)
+{
+    const BinaryNode& node = mBinaryNodes[index];
+    if (node.count > 0)
+    {
+        mObjects.insert(mObjects.end(), mBuildIndices.begin() + node.first, mBuildIndices.begin() + node.first + node.count);
+        return;
+    }
+    appendObjects(node.left);
+    appendObjects(node.right);
+}
+
+uint32_t Bvh::collapseNode(uint32_t binaryIndex, uint32_t depth)
+{
+    mStats.depth = std::max(mStats.depth, depth);
+
+    const uint32_t index = static_cast<uint32_t>(mWideNodes.size());
+    mWideNodes.emplace_back();
+    mWideSources.resize(mWideSources.size() + 4, uint32_t{ InvalidIndex });
+    const Box empty = emptyBox();
+    for (uint32_t lane = 0; lane < 4; lane++)
+    {
+        setLane(index, lane, empty, InvalidIndex, 0, 0, InvalidIndex);
+    }
+
+    const BinaryNode& binary = mBinaryNodes[binaryIndex];
+    if (binary.count > 0)
+    {
+        if (binary.count > MaxLeafSize)
+        {
+            // a leaf cut off at MaxDepth
+            const uint32_t first = static_cast<uint32_t>(mObjects.size());
+            appendObjects(binaryIndex);
+            setLane(index, 0, binary.box, InvalidIndex, first, binary.count, binaryIndex);
+            return index;
+        }
+
+        // one object per lane, so the objects are tested four at a time like any other boxes
+        for (uint32_t lane = 0; lane < binary.count; lane++)
+        {
+            const uint32_t object = mBuildIndices[binary.first + lane];
+            setLane(index, lane, mObjectBoxes[object], InvalidIndex, static_cast<uint32_t>(mObjects.size()), 1, object | ObjectSource);
+            mObjects.push_back(object);
+        }
+        return index;
+    }
+
+    // pull up grandchildren until there are four children, opening the largest inner child first
+    uint32_t children[4];
+    uint32_t childCount = 0;
+    children[childCount++] = binary.left;
+    children[childCount++] = binary.right;
+    while (childCount < 4)
+    {
+        int open = -1;
+        float openArea = -1.f;
+        for (uint32_t c = 0; c < childCount; c++)
+        {
+            const BinaryNode& child = mBinaryNodes[children[c]];
+            if (child.count == 0 && area(child.box) > openArea)
+            {
+                openArea = area(child.box);
+                open = static_cast<int>(c);
+            }
+        }
+        if (open < 0)
+        {
+            break;
+        }
+
+        const BinaryNode& opened = mBinaryNodes[children[open]];
+        children[open] = opened.left;
+        children[childCount++] = opened.right;
+    }
+
+    for (uint32_t lane = 0; lane < childCount; lane++)
+    {
+        const BinaryNode& child = mBinaryNodes[children[lane]];
+        const uint32_t first = static_cast<uint32_t>(mObjects.size());
+        uint32_t wideChild = InvalidIndex;
+        if (child.count == 1 || depth >= MaxDepth)
+        {
+            // rotations can deepen the binary tree, whatever is below MaxDepth becomes one leaf
+            appendObjects(children[lane]);
+        }
+        else
+        {
+            wideChild = collapseNode(children[lane], depth + 1);
+        }
+        setLane(index, lane, child.box, wideChild, first, static_cast<uint32_t>(mObjects.size()) - first, children[lane]);
+    }
+
+    return index;
+}
+
+void Bvh::setLane(uint32_t index, uint32_t lane, const Box& box, uint32_t child, uint32_t first, uint32_t count, uint32_t source)
+{
+    WideNode& node = mWideNodes[index];
+    node.minX[lane] = box.min[0];
+    node.minY[lane] = box.min[1];
+    node.minZ[lane] = box.min[2];
+    node.maxX[lane] = box.max[0];
+    node.maxY[lane] = box.max[1];
+    node.maxZ[lane] = box.max[2];
+    node.child[lane] = child;
+    node.first[lane] = first;
+    node.count[lane] = count;
+    mWideSources[index * 4 + lane] = source;
+}
+
+uint32_t Bvh::cull(const Plane* planes, uint32_t planeCount, uint8_t* visible) const
+{
+    assert(planeCount <= MaxPlanes);
+    memset(visible, 0, mObjectBoxes.size());
+    if (mWideNodes.empty())
+    {
+        return 0;
+    }
+
+    __m128 nx[MaxPlanes];
+    __m128 ny[MaxPlanes];
+    __m128 nz[MaxPlanes];
+    __m128 nd[MaxPlanes];
+    __m128 ax[MaxPlanes];
+    __m128 ay[MaxPlanes];
+    __m128 az[MaxPlanes];
+    for (uint32_t side = 0; side < planeCount; side++)
+    {
+        const Plane& plane = planes[side];
+        nx[side] = _mm_set1_ps(plane.normal.x);
+        ny[side] = _mm_set1_ps(plane.normal.y);
+        nz[side] = _mm_set1_ps(plane.normal.z);
+        nd[side] = _mm_set1_ps(plane.distance);
+        ax[side] = _mm_set1_ps(std::fabs(plane.normal.x));
+        ay[side] = _mm_set1_ps(std::fabs(plane.normal.y));
+        az[side] = _mm_set1_ps(std::fabs(plane.normal.z));
+    }
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+
+    // planes a subtree is not yet known to be inside of travel with it, children skip the others
+    struct Entry
+    {
+        uint32_t node;
+        uint32_t planeMask;
+    };
+    Entry stack[MaxStackSize];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = { 0, (1u << planeCount) - 1 };
+
+    uint32_t visibleCount = 0;
+    while (stackSize > 0)
+    {
+        const Entry entry = stack[--stackSize];
+        const WideNode& node = mWideNodes[entry.node];
+
+        const __m128 minX = _mm_load_ps(node.minX);
+        const __m128 minY = _mm_load_ps(node.minY);
+        const __m128 minZ = _mm_load_ps(node.minZ);
+        const __m128 maxX = _mm_load_ps(node.maxX);
+        const __m128 maxY = _mm_load_ps(node.maxY);
+        const __m128 maxZ = _mm_load_ps(node.maxZ);
+        const __m128 cx = _mm_mul_ps(_mm_add_ps(minX, maxX), half);
+        const __m128 cy = _mm_mul_ps(_mm_add_ps(minY, maxY), half);
+        const __m128 cz = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half);
+        const __m128 ex = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+        const __m128 ey = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+        const __m128 ez = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+
+        uint32_t outsideLanes = 0;
+        uint32_t childMasks[4] = { entry.planeMask, entry.planeMask, entry.planeMask, entry.planeMask };
+        for (uint32_t side = 0; side < planeCount; side++)
+        {
+            if ((entry.planeMask & (1u << side)) == 0)
+            {
+                continue;
+            }
+
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, nx[side]), _mm_mul_ps(cy, ny[side])), _mm_add_ps(_mm_mul_ps(cz, nz[side]), nd[side]));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, ax[side]), _mm_mul_ps(ey, ay[side])), _mm_mul_ps(ez, az[side]));
+            outsideLanes |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), zero)));
+            const uint32_t insideLanes = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpge_ps(_mm_sub_ps(distance, radius), zero)));
+            for (uint32_t lane = 0; lane < 4; lane++)
+            {
+                if (insideLanes & (1u << lane))
+                {
+                    childMasks[lane] &= ~(1u << side);
+                }
+            }
+        }
+
+        for (uint32_t lane = 0; lane < 4; lane++)
+        {
+            if (node.count[lane] == 0 || (outsideLanes & (1u << lane)))
+            {
+                continue;
+            }
+
+            const uint32_t first = node.first[lane];
+            const uint32_t last = first + node.count[lane];
+            if (childMasks[lane] == 0)
+            {
+                // inside every plane, the whole subtree is visible
+                for (uint32_t i = first; i < last; i++)
+                {
+                    visible[mObjects[i]] = 1;
+                }
+                visibleCount += last - first;
+            }
+            else if (last - first == 1 && node.child[lane] == InvalidIndex)
+            {
+                // the lane box is the object box, the test above was exact
+                visible[mObjects[first]] = 1;
+                visibleCount++;
+            }
+            else if (node.child[lane] == InvalidIndex)
+            {
+                for (uint32_t i = first; i < last; i++)
+                {
+                    const uint32_t object = mObjects[i];
+                    if (intersectsPlanes(mObjectBoxes[object], planes, childMasks[lane]))
+                    {
+                        visible[object] = 1;
+                        visibleCount++;
+                    }
+                }
+            }
+            else
+            {
+                assert(stackSize < MaxStackSize);
+                stack[stackSize++] = { node.child[lane], childMasks[lane] };
+            }
+        }
+    }
+
+    return visibleCount;
+}
+
+void Bvh::querySphere(const Float3& center, float radius, std::vector<uint32_t>& objects) const
+{
+    if (mWideNodes.empty())
+    {
+        return;
+    }
+
+    const __m128 cx = _mm_set1_ps(center.x);
+    const __m128 cy = _mm_set1_ps(center.y);
+    const __m128 cz = _mm_set1_ps(center.z);
+    const __m128 radiusSq = _mm_set1_ps(radius * radius);
+    const __m128 zero = _mm_setzero_ps();
+    const float c[3] = { center.x, center.y, center.z };
+
+    uint32_t stack[MaxStackSize];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+        const WideNode& node = mWideNodes[stack[--stackSize]];
+
+        // distance from the center to each box, 0 inside
+        __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(node.minX), cx), _mm_sub_ps(cx, _mm_load_ps(node.maxX))), zero);
+        __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(node.minY), cy), _mm_sub_ps(cy, _mm_load_ps(node.maxY))), zero);
+        __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(node.minZ), cz), _mm_sub_ps(cz, _mm_load_ps(node.maxZ))), zero);
+        __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        const uint32_t hitLanes = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(distanceSq, radiusSq)));
+
+        for (uint32_t lane = 0; lane < 4; lane++)
+        {
+            if (node.count[lane] == 0 || (hitLanes & (1u << lane)) == 0)
+            {
+                continue;
+            }
+
+            if (node.child[lane] != InvalidIndex)
+            {
+                assert(stackSize < MaxStackSize);
+                stack[stackSize++] = node.child[lane];
+                continue;
+            }
+
+            for (uint32_t i = node.first[lane]; i < node.first[lane] + node.count[lane]; i++)
+            {
+                const Box& box = mObjectBoxes[mObjects[i]];
+                float distance = 0.f;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    float d = std::max(std::max(box.min[axis] - c[axis], c[axis] - box.max[axis]), 0.f);
+                    distance += d * d;
+                }
+                if (distance <= radius * radius)
+                {
+                    objects.push_back(mObjects[i]);
+                }
+            }
+        }
+    }
+}
+
+uint32_t Bvh::raycast(const Float3& origin, const Float3& direction, float maxDistance, float* hitDistance) const
+{
+    if (mWideNodes.empty())
+    {
+        return InvalidIndex;
+    }
+
+    // a zero component would give 0 * inf slabs, a tiny one gives the right infinite slab instead
+    auto inverse = [](float value)
+    {
+        const float epsilon = 1e-20f;
+        return 1.f / (std::fabs(value) > epsilon ? value : (value < 0.f ? -epsilon : epsilon));
+    };
+    const float o[3] = { origin.x, origin.y, origin.z };
+    const float inv[3] = { inverse(direction.x), inverse(direction.y), inverse(direction.z) };
+    const __m128 ox = _mm_set1_ps(o[0]);
+    const __m128 oy = _mm_set1_ps(o[1]);
+    const __m128 oz = _mm_set1_ps(o[2]);
+    const __m128 ix = _mm_set1_ps(inv[0]);
+    const __m128 iy = _mm_set1_ps(inv[1]);
+    const __m128 iz = _mm_set1_ps(inv[2]);
+
+    float best = maxDistance;
+    uint32_t bestObject = InvalidIndex;
+
+    struct Entry
+    {
+        uint32_t node;
+        float distance;
+    };
+    Entry stack[MaxStackSize];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = { 0, 0.f };
+    while (stackSize > 0)
+    {
+        const Entry entry = stack[--stackSize];
+        if (entry.distance > best)
+        {
+            continue;
+        }
+        const WideNode& node = mWideNodes[entry.node];
+
+        __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), ox), ix);
+        __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), ox), ix);
+        __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), oy), iy);
+        __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), oy), iy);
+        __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), oz), iz);
+        __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), oz), iz);
+        __m128 tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)), _mm_max_ps(_mm_min_ps(t0z, t1z), _mm_setzero_ps()));
+        __m128 tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)), _mm_min_ps(_mm_max_ps(t0z, t1z), _mm_set1_ps(best)));
+        const uint32_t hitLanes = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(tNear, tFar)));
+        alignas(16) float nearDistances[4];
+        _mm_store_ps(nearDistances, tNear);
+
+        // children are pushed far to near, so the nearest one is visited first and shrinks best for the others
+        uint32_t order[4];
+        uint32_t hitCount = 0;
+        for (uint32_t lane = 0; lane < 4; lane++)
+        {
+            if (node.count[lane] == 0 || (hitLanes & (1u << lane)) == 0)
+            {
+                continue;
+            }
+
+            uint32_t slot = hitCount++;
+            for (; slot > 0 && nearDistances[order[slot - 1]] < nearDistances[lane]; slot--)
+            {
+                order[slot] = order[slot - 1];
+            }
+            order[slot] = lane;
+        }
+
+        for (uint32_t i = 0; i < hitCount; i++)
+        {
+            const uint32_t lane = order[i];
+            if (node.child[lane] != InvalidIndex)
+            {
+                assert(stackSize < MaxStackSize);
+                stack[stackSize++] = { node.child[lane], nearDistances[lane] };
+                continue;
+            }
+
+            for (uint32_t j = node.first[lane]; j < node.first[lane] + node.count[lane]; j++)
+            {
+                const Box& box = mObjectBoxes[mObjects[j]];
+                float tMin = 0.f;
+                float tMax = best;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    float t0 = (box.min[axis] - o[axis]) * inv[axis];
+                    float t1 = (box.max[axis] - o[axis]) * inv[axis];
+                    tMin = std::max(tMin, std::min(t0, t1));
+                    tMax = std::min(tMax, std::max(t0, t1));
+                }
+                if (tMin <= tMax && tMin < best)
+                {
+                    best = tMin;
+                    bestObject = mObjects[j];
+                }
+            }
+        }
+    }
+
+    if (hitDistance && bestObject != InvalidIndex)
+    {
+        *hitDistance = best;
+    }
+    return bestObject;
+}
+
+}
\ No newline at end of file
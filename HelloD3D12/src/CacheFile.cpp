@@ -0,0 +1,198 @@
+#include "CacheFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "Hash.h"
+
+#ifdef _MSC_VER
+#pragma warning(disable:4996)
+#endif
+
+namespace HDX
+{
+
+static const uint8_t Magic[4]{ 'H', 'D', 'X', 'C' };
+
+static void write32(std::vector<uint8_t>& data, uint32_t value)
+{
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        data.push_back(static_cast<uint8_t>(value >> (i * 8)));
+    }
+}
+
+static void write64(std::vector<uint8_t>& data, uint64_t value)
+{
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        data.push_back(static_cast<uint8_t>(value >> (i * 8)));
+    }
+}
+
+static uint32_t read32(const uint8_t* data)
+{
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        value |= static_cast<uint32_t>(data[i]) << (i * 8);
+    }
+    return value;
+}
+
+static uint64_t read64(const uint8_t* data)
+{
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        value |= static_cast<uint64_t>(data[i]) << (i * 8);
+    }
+    return value;
+}
+
+bool CacheFile::deserialize(const uint8_t* data, size_t size)
+{
+    mEntries.clear();
+    mDirty = false;
+    mCorruptEntries = 0;
+
+    if (size < HeaderSize || memcmp(data, Magic, sizeof(Magic)) != 0 || read32(data + 4) != Version || read64(data + 8) != mTag)
+    {
+        return false;
+    }
+
+    const uint32_t entryCount = read32(data + 16);
+    size_t offset = HeaderSize;
+    for (uint32_t i = 0; i < entryCount; i++)
+    {
+        if (size - offset < EntryHeaderSize)
+        {
+            // truncated, keep what was read so far
+            mCorruptEntries += entryCount - i;
+            break;
+        }
+
+        const uint64_t key = read64(data + offset);
+        const uint64_t checksum = read64(data + offset + 8);
+        const uint32_t entrySize = read32(data + offset + 16);
+        offset += EntryHeaderSize;
+        if (size - offset < entrySize)
+        {
+            mCorruptEntries += entryCount - i;
+            break;
+        }
+
+        if (hashBytes(data + offset, entrySize) == checksum)
+        {
+            mEntries[key].assign(data + offset, data + offset + entrySize);
+        }
+        else
+        {
+            mCorruptEntries++;
+        }
+        offset += entrySize;
+    }
+
+    return true;
+}
+
+void CacheFile::serialize(std::vector<uint8_t>& data) const
+{
+    std::vector<uint64_t> keys;
+    keys.reserve(mEntries.size());
+    size_t totalSize = HeaderSize;
+    for (auto const& entry : mEntries)
+    {
+        keys.push_back(entry.first);
+        totalSize += EntryHeaderSize + entry.second.size();
+    }
+    std::sort(keys.begin(), keys.end());
+
+    data.clear();
+    data.reserve(totalSize);
+    data.insert(data.end(), Magic, Magic + sizeof(Magic));
+    write32(data, Version);
+    write64(data, mTag);
+    write32(data, static_cast<uint32_t>(keys.size()));
+    write32(data, 0);
+
+    for (uint64_t key : keys)
+    {
+        const std::vector<uint8_t>& blob = mEntries.find(key)->second;
+        write64(data, key);
+        write64(data, hashBytes(blob.data(), blob.size()));
+        write32(data, static_cast<uint32_t>(blob.size()));
+        write32(data, 0);
+        data.insert(data.end(), blob.begin(), blob.end());
+    }
+}
+
+bool CacheFile::load(const char* path)
+{
+    mEntries.clear();
+    mDirty = false;
+    mCorruptEntries = 0;
+
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> data;
+    fseek(file, 0L, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0L, SEEK_SET);
+    bool read = size > 0;
+    if (read)
+    {
+        data.resize(static_cast<size_t>(size));
+        read = fread(data.data(), data.size(), 1, file) == 1;
+    }
+    fclose(file);
+
+    return read && deserialize(data.data(), data.size());
+}
+
+bool CacheFile::save(const char* path)
+{
+    std::vector<uint8_t> data;
+    serialize(data);
+
+    // write next to the old file and swap, a crash half way leaves the old cache intact
+    std::string tempPath = std::string(path) + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (!file)
+    {
+        return false;
+    }
+    bool written = fwrite(data.data(), data.size(), 1, file) == 1;
+    written = fclose(file) == 0 && written;
+
+    remove(path);
+    if (!written || rename(tempPath.c_str(), path) != 0)
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    mDirty = false;
+    return true;
+}
+
+const std::vector<uint8_t>* CacheFile::find(uint64_t key) const
+{
+    auto it = mEntries.find(key);
+    return it != mEntries.end() ? &it->second : nullptr;
+}
+
+void CacheFile::insert(uint64_t key, const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    mEntries[key].assign(bytes, bytes + size);
+    mDirty = true;
+}
+
+}
\ No newline at end of file
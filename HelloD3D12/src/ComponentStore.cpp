@@ -0,0 +1,38 @@
+#include "ComponentStore.h"
+
+namespace HDX
+{
+
+Entity EntityPool::create()
+{
+    uint32_t slot;
+    if (!mFreeSlots.empty())
+    {
+        slot = mFreeSlots.back();
+        mFreeSlots.pop_back();
+    }
+    else
+    {
+        slot = static_cast<uint32_t>(mGenerations.size());
+        // the last slot would alias InvalidEntity
+        assert(slot < SlotMask);
+        mGenerations.push_back(0);
+    }
+    return slot | (static_cast<uint32_t>(mGenerations[slot]) << SlotBits);
+}
+
+void EntityPool::destroy(Entity entity)
+{
+    assert(isAlive(entity));
+    const uint32_t slot = getSlot(entity);
+    mGenerations[slot]++;
+    mFreeSlots.push_back(slot);
+}
+
+bool EntityPool::isAlive(Entity entity) const
+{
+    const uint32_t slot = getSlot(entity);
+    return slot < mGenerations.size() && mGenerations[slot] == (entity >> SlotBits);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,300 @@
+#include "stdafx.h"
+
+#include <assert.h>
+#include <chrono>
+#include <string.h>
+#include "D3D12RenderGraph.h"
+
+namespace HDX
+{
+
+static_assert(ResourceStateRenderTarget == D3D12_RESOURCE_STATE_RENDER_TARGET
+    && ResourceStateUnorderedAccess == D3D12_RESOURCE_STATE_UNORDERED_ACCESS
+    && ResourceStateDepthWrite == D3D12_RESOURCE_STATE_DEPTH_WRITE
+    && ResourceStateDepthRead == D3D12_RESOURCE_STATE_DEPTH_READ
+    && ResourceStateNonPixelShaderResource == D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE
+    && ResourceStatePixelShaderResource == D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE
+    && ResourceStateIndirectArgument == D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT
+    && ResourceStateCopyDest == D3D12_RESOURCE_STATE_COPY_DEST
+    && ResourceStateCopySource == D3D12_RESOURCE_STATE_COPY_SOURCE
+    && ResourceStatePresent == D3D12_RESOURCE_STATE_PRESENT, "Render graph states do not match D3D12_RESOURCE_STATES");
+
+bool D3D12RenderGraph::prepare(ID3D12Device* device, uint32_t framesInFlight)
+{
+    mDevice = device;
+    mRetired = std::make_unique<DeferredDeletionQueue<FrameFence, ComPtr<ID3D12Pageable>>>(FrameFence{ &mFrame, framesInFlight });
+    return true;
+}
+
+void D3D12RenderGraph::reset()
+{
+    mGraph.reset();
+    mResources.clear();
+    mTextureDecls.clear();
+    mPassFunctions.clear();
+}
+
+D3D12RenderGraph::ResourceHandle D3D12RenderGraph::importResource(const char* name, ID3D12Resource* resource, D3D12_RESOURCE_STATES initialState, D3D12_RESOURCE_STATES finalState)
+{
+    ResourceHandle handle = mGraph.importResource(name, initialState, finalState);
+    mResources.push_back(resource);
+    mTextureDecls.emplace_back();
+    return handle;
+}
+
+D3D12RenderGraph::ResourceHandle D3D12RenderGraph::createTexture(const char* name, const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE* clearValue)
+{
+    D3D12_RESOURCE_ALLOCATION_INFO info = mDevice->GetResourceAllocationInfo(0, 1, &desc);
+
+    RenderGraphResourceDesc graphDesc;
+    graphDesc.size = info.SizeInBytes;
+    graphDesc.alignment = info.Alignment;
+    graphDesc.aliasGroup = (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+        ? AliasGroupRenderTargets : AliasGroupTextures;
+
+    ResourceHandle handle = mGraph.createTransient(name, graphDesc);
+    mResources.push_back(nullptr);
+
+    TextureDecl decl{};
+    decl.desc = desc;
+    decl.hasClearValue = clearValue != nullptr;
+    if (clearValue)
+    {
+        decl.clearValue = *clearValue;
+    }
+    mTextureDecls.push_back(decl);
+    return handle;
+}
+
+D3D12RenderGraph::PassHandle D3D12RenderGraph::addPass(const char* name, uint32_t commandList, ExecuteFunction execute, bool hasSideEffects)
+{
+    PassHandle handle = mGraph.addPass(name, commandList, hasSideEffects);
+    mPassFunctions.push_back(std::move(execute));
+    return handle;
+}
+
+void D3D12RenderGraph::read(PassHandle pass, ResourceHandle resource, D3D12_RESOURCE_STATES state)
+{
+    mGraph.read(pass, resource, static_cast<uint32_t>(state));
+}
+
+void D3D12RenderGraph::write(PassHandle pass, ResourceHandle resource, D3D12_RESOURCE_STATES state)
+{
+    mGraph.write(pass, resource, static_cast<uint32_t>(state));
+}
+
+bool D3D12RenderGraph::compile()
+{
+    auto compileStart = std::chrono::high_resolution_clock::now();
+    mFrame++;
+    mRetired->collect();
+
+    if (!mGraph.compile())
+    {
+        LOG_ERROR("Failed to compile render graph, command list indices must not decrease\n");
+        return false;
+    }
+
+    for (uint32_t group = 0; group < AliasGroupCount; group++)
+    {
+        UINT64 size = mGraph.getAliasGroupSize(group);
+        if (size <= mHeapSizes[group])
+        {
+            continue;
+        }
+
+        // the resources placed in the old heap go with it once the frames using them are done
+        if (mHeaps[group])
+        {
+            mRetired->enqueue(std::move(mHeaps[group]), mFrame);
+        }
+
+        size = (size + D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT - 1) & ~static_cast<UINT64>(D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT - 1);
+        D3D12_HEAP_FLAGS flags = group == AliasGroupRenderTargets ? D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES : D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+        CD3DX12_HEAP_DESC heapDesc(size, D3D12_HEAP_TYPE_DEFAULT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT, flags);
+        HR_ERROR_CHECK_CALL(mDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(&mHeaps[group])), false, "Failed to create %llu byte transient heap\n", size);
+        mHeapSizes[group] = size;
+        mHeapGenerations[group]++;
+    }
+
+    for (ResourceHandle handle = 0; handle < mGraph.getResourceCount(); handle++)
+    {
+        if (mGraph.isTransient(handle) && mGraph.isPlaced(handle))
+        {
+            mResources[handle] = acquireTexture(handle);
+            if (!mResources[handle])
+            {
+                return false;
+            }
+        }
+    }
+
+    mBatchers.resize(mGraph.getCommandListTails().size());
+    for (BarrierBatcher& batcher : mBatchers)
+    {
+        batcher.reset();
+    }
+
+    // textures the graph stopped using
+    for (size_t i = 0; i < mTextureCache.size();)
+    {
+        if (mTextureCache[i].lastUsedFrame != mFrame)
+        {
+            mRetired->enqueue(std::move(mTextureCache[i].resource), mTextureCache[i].lastUsedFrame);
+            mTextureCache[i] = std::move(mTextureCache.back());
+            mTextureCache.pop_back();
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    mCompileMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - compileStart).count();
+    return true;
+}
+
+void D3D12RenderGraph::record(uint32_t commandList, ID3D12GraphicsCommandList* commandListObject)
+{
+    BarrierBatcher& batcher = mBatchers[commandList];
+    for (const RenderGraph::ScheduledPass& scheduled : mGraph.getSchedule())
+    {
+        if (scheduled.commandList != commandList)
+        {
+            continue;
+        }
+
+        queueBarriers(batcher, scheduled.firstBarrierBefore, scheduled.barrierBeforeCount);
+        batcher.flush(commandListObject);
+
+        // render targets taking over aliased memory start with undefined content and need a discard or clear
+        for (uint32_t i = 0; i < scheduled.barrierBeforeCount; i++)
+        {
+            const RenderGraph::Barrier& barrier = mGraph.getBarriers()[scheduled.firstBarrierBefore + i];
+            if (barrier.type == RenderGraph::BarrierType::Aliasing
+                && (mGraph.getInitialState(barrier.resource) & (D3D12_RESOURCE_STATE_RENDER_TARGET | D3D12_RESOURCE_STATE_DEPTH_WRITE)) != 0)
+            {
+                commandListObject->DiscardResource(mResources[barrier.resource], nullptr);
+            }
+        }
+
+        mPassFunctions[scheduled.pass](commandListObject);
+
+        queueBarriers(batcher, scheduled.firstBarrierAfter, scheduled.barrierAfterCount);
+        batcher.flush(commandListObject);
+    }
+}
+
+void D3D12RenderGraph::finish(uint32_t commandList, ID3D12GraphicsCommandList* commandListObject)
+{
+    if (commandList >= mBatchers.size())
+    {
+        return;
+    }
+
+    const RenderGraph::CommandListTail& tail = mGraph.getCommandListTails()[commandList];
+    BarrierBatcher& batcher = mBatchers[commandList];
+    queueBarriers(batcher, tail.firstBarrier, tail.barrierCount);
+    batcher.flush(commandListObject);
+    assert(batcher.getPendingCount() == 0);
+}
+
+UINT64 D3D12RenderGraph::getHeapBytes() const
+{
+    UINT64 bytes = 0;
+    for (UINT64 size : mHeapSizes)
+    {
+        bytes += size;
+    }
+    return bytes;
+}
+
+uint32_t D3D12RenderGraph::getBarrierCallCount() const
+{
+    uint32_t calls = 0;
+    for (const BarrierBatcher& batcher : mBatchers)
+    {
+        calls += batcher.getFlushCount();
+    }
+    return calls;
+}
+
+ID3D12Resource* D3D12RenderGraph::acquireTexture(ResourceHandle handle)
+{
+    const TextureDecl& decl = mTextureDecls[handle];
+    const uint32_t group = mGraph.getDesc(handle).aliasGroup;
+    const UINT64 offset = mGraph.getTransientOffset(handle);
+    const D3D12_RESOURCE_STATES initialState = static_cast<D3D12_RESOURCE_STATES>(mGraph.getInitialState(handle));
+
+    for (CachedTexture& cached : mTextureCache)
+    {
+        if (cached.lastUsedFrame != mFrame
+            && cached.aliasGroup == group
+            && cached.heapGeneration == mHeapGenerations[group]
+            && cached.offset == offset
+            && cached.initialState == initialState
+            && cached.decl.hasClearValue == decl.hasClearValue
+            && memcmp(&cached.decl.desc, &decl.desc, sizeof(decl.desc)) == 0
+            && (!decl.hasClearValue || memcmp(&cached.decl.clearValue, &decl.clearValue, sizeof(decl.clearValue)) == 0))
+        {
+            cached.lastUsedFrame = mFrame;
+            return cached.resource.Get();
+        }
+    }
+
+    CachedTexture cached;
+    cached.decl = decl;
+    cached.aliasGroup = group;
+    cached.heapGeneration = mHeapGenerations[group];
+    cached.offset = offset;
+    cached.initialState = initialState;
+    cached.lastUsedFrame = mFrame;
+    HR_ERROR_CHECK_CALL(mDevice->CreatePlacedResource(
+        mHeaps[group].Get(),
+        offset,
+        &decl.desc,
+        initialState,
+        decl.hasClearValue ? &decl.clearValue : nullptr,
+        IID_PPV_ARGS(&cached.resource)), nullptr, "Failed to create transient %s\n", mGraph.getResourceName(handle));
+
+    mTextureCache.push_back(std::move(cached));
+    return mTextureCache.back().resource.Get();
+}
+
+void D3D12RenderGraph::queueBarriers(BarrierBatcher& batcher, uint32_t first, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const RenderGraph::Barrier& barrier = mGraph.getBarriers()[first + i];
+        ID3D12Resource* resource = mResources[barrier.resource];
+        if (barrier.type == RenderGraph::BarrierType::Aliasing)
+        {
+            ID3D12Resource* before = barrier.aliasBefore != RenderGraph::InvalidHandle ? mResources[barrier.aliasBefore] : nullptr;
+            batcher.aliasing(before, resource);
+            continue;
+        }
+
+        // the first barrier of a resource in this command list tells the state it enters the list in
+        if (!batcher.isTracked(resource))
+        {
+            batcher.track(resource, static_cast<D3D12_RESOURCE_STATES>(barrier.stateBefore), BarrierBatcher::getSubresourceCount(resource->GetDesc()));
+        }
+        assert(barrier.split == RenderGraph::BarrierSplit::End || batcher.getState(resource) == static_cast<D3D12_RESOURCE_STATES>(barrier.stateBefore));
+
+        const D3D12_RESOURCE_STATES stateAfter = static_cast<D3D12_RESOURCE_STATES>(barrier.stateAfter);
+        if (barrier.split == RenderGraph::BarrierSplit::Begin)
+        {
+            batcher.beginTransition(resource, stateAfter);
+        }
+        else if (barrier.split == RenderGraph::BarrierSplit::End)
+        {
+            batcher.endTransition(resource);
+        }
+        else
+        {
+            batcher.transition(resource, stateAfter);
+        }
+    }
+}
+
+}
\ No newline at end of file
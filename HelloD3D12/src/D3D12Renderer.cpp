@@ -1,13 +1,36 @@
 #include "stdafx.h"
 
+#include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <random>
 #include <vector>
 #include "Renderer.h"
 
+#include "Bvh.h"
+#include "D3D12RenderGraph.h"
+#include "DrawSort.h"
+#include "FramePacer.h"
+#include "FrameTimeHistogram.h"
+#include "GpuMemoryAllocator.h"
+#include "IndirectDraw.h"
+#include "JobSystem.h"
+#include "LightClusters.h"
+#include "MaskedOcclusion.h"
+#include "Mesh.h"
+#include "MeshLod.h"
 #include "Model.h"
+#include "PipelineCache.h"
+#include "ResourceDeletionQueue.h"
+#include "SceneGraph.h"
+#include "ShaderTypes.h"
 #include "SimpleShader.h"
+#include "ShadowCascades.h"
+#include "ShadowCasterVolume.h"
 #include "ShadowMap.h"
+#include "UploadManager.h"
 
 using namespace Microsoft::WRL;
 using namespace DirectX;
@@ -25,7 +48,12 @@ public:
         if (mIsInitialized)
         {
             waitForGPU();
+            mDeletionQueue->flush();
             CloseHandle(mFenceEvent);
+            if (mFrameLatencyWaitable)
+            {
+                CloseHandle(mFrameLatencyWaitable);
+            }
             mIsInitialized = false;
         }
 
@@ -39,8 +67,16 @@ public:
         return mIsInitialized;
     }
 
-    bool init(HWND hWnd, uint32_t width, uint32_t height) final
+    bool init(HWND hWnd, uint32_t width, uint32_t height, const RendererConfig& config) final
     {
+        FramePacerConfig pacerConfig;
+        pacerConfig.framesInFlight = config.framesInFlight;
+        pacerConfig.mode = config.waitableSwapChain ? PacingMode::Waitable : PacingMode::Fence;
+        mFramePacer = std::make_unique<FramePacer>(pacerConfig);
+        mFrameCount = mFramePacer->getFramesInFlight();
+        // flip model swap chains need at least two buffers
+        mBackBufferCount = mFrameCount > 2 ? mFrameCount : 2;
+
         mWidth = width;
         mHeight = height;
         mAspectRatio = static_cast<float>(mWidth) / static_cast<float>(mHeight);
@@ -48,38 +84,189 @@ public:
         mViewport = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height));
         mScissorRect = CD3DX12_RECT(0, 0, static_cast<LONG>(width), static_cast<LONG>(height));
 
-        mShadowViewport = CD3DX12_VIEWPORT(0.0f, 0.0f, 2048.f, 2048.f);
-        mShadowScissorRect = CD3DX12_RECT(0, 0, 2048, 2048);
+        mShadowViewport = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(ShadowMap::Size), static_cast<float>(ShadowMap::Size));
+        mShadowScissorRect = CD3DX12_RECT(0, 0, ShadowMap::Size, ShadowMap::Size);
+
+        mViewMtx = XMMatrixLookAtLH({ 4.0f, 4.0f, 4.0f }, { 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f });
+        mProjMtx = XMMatrixPerspectiveFovLH(FovY, mAspectRatio, NearZ, FarZ);
+        mLightClusters.setProjection(FovY, mAspectRatio, NearZ, FarZ);
+        createSceneLights();
+        mOcclusionBuffer.resize(OcclusionWidth, OcclusionHeight);
+        XMStoreFloat3(&mLightDir, XMVector3Normalize({ -2.f, -2.f, 2.f }));
 
-        auto modelChalet = std::make_unique<Model>(
+        mModels.create(SceneGraph::InvalidNode, mMeshRegistry.acquire(
 #ifndef _DEBUG
         "chalet"
 #else      
         "cube"
 #endif
-            , XMFLOAT3{ 0.f, 0.f, 0.f });
-        mModels.push_back(std::move(modelChalet));
+            ), XMFLOAT3{ 0.f, 0.f, 0.f }, 90.f);
+
+        mModels.create(SceneGraph::InvalidNode, mMeshRegistry.acquire("cube"), XMFLOAT3{ 0.f, 0.f, 2.f }, -90.f);
+
+        // grid of static cubes to measure batching and shadow caching on large instance counts, placed relative to
+        // a common root node
+        const SceneGraph::NodeId gridNode = mSceneGraph.createNode();
+        XMFLOAT4X4 gridLocal;
+        XMStoreFloat4x4(&gridLocal, XMMatrixTranslation(0.f, -2.f, 0.f));
+        mSceneGraph.setLocal(gridNode, &gridLocal.m[0][0]);
+        for (uint32_t i = 0; i < config.stressInstances; i++)
+        {
+            const uint32_t gridSize = 100;
+            XMFLOAT3 position{ static_cast<float>(i % gridSize) - gridSize * 0.5f, 0.f, static_cast<float>(i / gridSize) - gridSize * 0.5f };
+            mModels.create(gridNode, mMeshRegistry.acquire("cube"), position, 0.f);
+        }
 
-        auto modelCube = std::make_unique<Model>("cube", XMFLOAT3{ 0.f, 0.f, 2.f });
-        mModels.push_back(std::move(modelCube));
+        if (mModels.getCount() > MaxInstances)
+        {
+            LOG_ERROR("Too many models (%u), the instance buffer holds %u\n", mModels.getCount(), MaxInstances);
+            return false;
+        }
+
+        if (mMeshRegistry.getMeshes().size() > SimpleShader::MaxMaterials)
+        {
+            LOG_ERROR("Too many meshes (%zu), the material table holds %u\n", mMeshRegistry.getMeshes().size(), SimpleShader::MaxMaterials);
+            return false;
+        }
 
         mSimpleShader = std::make_unique<SimpleShader>();
         mShadowMap = std::make_unique<ShadowMap>();
 
-        if (!loadPipeline(hWnd))
+        mJobSystem = std::make_unique<JobSystem>();
+
+        auto initStart = std::chrono::high_resolution_clock::now();
+
+        // parse meshes and decode textures on the workers while the device is being created
+        JobCounter loadCounter;
+        std::atomic<bool> loadFailed{ false };
+        for (auto const& mesh : mMeshRegistry.getMeshes())
+        {
+            Mesh* meshPtr = mesh.get();
+            std::atomic<bool>* failed = &loadFailed;
+            mJobSystem->run(loadCounter, [meshPtr, failed]()
+            {
+                if (!meshPtr->load())
+                {
+                    failed->store(true);
+                }
+            });
+        }
+
+        bool pipelineLoaded = loadPipeline(hWnd);
+        auto deviceReady = std::chrono::high_resolution_clock::now();
+        mJobSystem->wait(loadCounter);
+        auto meshesReady = std::chrono::high_resolution_clock::now();
+
+        if (!pipelineLoaded)
         {
             return false;
         }
 
+        if (loadFailed)
+        {
+            LOG_ERROR("Failed to load models\n");
+            return false;
+        }
+
         if (!loadAssets())
         {
             return false;
         }
 
+        auto initEnd = std::chrono::high_resolution_clock::now();
+        LOG_INFO("Startup in %.2f ms: device %.2f ms, waiting on meshes %.2f ms, assets and pipelines %.2f ms\n",
+            std::chrono::duration<double, std::milli>(initEnd - initStart).count(),
+            std::chrono::duration<double, std::milli>(deviceReady - initStart).count(),
+            std::chrono::duration<double, std::milli>(meshesReady - deviceReady).count(),
+            std::chrono::duration<double, std::milli>(initEnd - meshesReady).count());
+
         mIsInitialized = true;
         return true;
     }
 
+    void unloadModel(uint32_t index) final
+    {
+        if (!mIsInitialized || index >= mModels.getCount())
+        {
+            return;
+        }
+
+        if (mModels.getTransforms()[index].isStatic())
+        {
+            mStaticCasterVersion++;
+        }
+        mModels.destroy(mModels.getEntity(index));
+
+        // frames recorded from now on skip the model, the last submitted frame signals the previous fence value
+        UINT64 lastUseFenceValue = mFenceValue[mFrameIndex] - 1;
+        uint32_t released = mMeshRegistry.releaseUnused(*mDeletionQueue, lastUseFenceValue);
+        if (released > 0)
+        {
+            LOG_INFO("Released %u unused meshes, %zu resources pending deletion\n", released, mDeletionQueue->getPendingCount());
+        }
+    }
+
+    int32_t pick(int32_t x, int32_t y) final
+    {
+        if (!mIsInitialized)
+        {
+            return -1;
+        }
+
+        // the ray from the near to the far plane through the pixel
+        XMVECTOR nearPoint = XMVector3Unproject(XMVectorSet(static_cast<float>(x), static_cast<float>(y), 0.f, 0.f),
+            0.f, 0.f, static_cast<float>(mWidth), static_cast<float>(mHeight), 0.f, 1.f, mProjMtx, mViewMtx, XMMatrixIdentity());
+        XMVECTOR farPoint = XMVector3Unproject(XMVectorSet(static_cast<float>(x), static_cast<float>(y), 1.f, 0.f),
+            0.f, 0.f, static_cast<float>(mWidth), static_cast<float>(mHeight), 0.f, 1.f, mProjMtx, mViewMtx, XMMatrixIdentity());
+        XMFLOAT3 origin;
+        XMFLOAT3 direction;
+        XMStoreFloat3(&origin, nearPoint);
+        XMStoreFloat3(&direction, XMVector3Normalize(farPoint - nearPoint));
+        float length = XMVectorGetX(XMVector3Length(farPoint - nearPoint));
+
+        float distance = 0.f;
+        uint32_t model = mSceneBvh.raycast({ origin.x, origin.y, origin.z }, { direction.x, direction.y, direction.z }, length, &distance);
+        if (model == Bvh::InvalidIndex)
+        {
+            LOG_INFO("Picked nothing at %d, %d\n", x, y);
+            return -1;
+        }
+
+        LOG_INFO("Picked model %u at %d, %d, %.2f from the near plane\n", model, x, y, distance);
+        return static_cast<int32_t>(model);
+    }
+
+    bool saveOcclusionDepth(const char* path) final
+    {
+        if (!mIsInitialized || !mOcclusionBuffer.saveDepthImage(path))
+        {
+            LOG_ERROR("Failed to save the occlusion depth to %s\n", path);
+            return false;
+        }
+
+        LOG_INFO("Saved the occlusion depth to %s\n", path);
+        return true;
+    }
+
+    void setShadowCaching(bool enabled) final
+    {
+        mShadowCaching = enabled;
+        LOG_INFO("Static shadow caching %s\n", enabled ? "on" : "off");
+    }
+
+    bool isShadowCaching() const final
+    {
+        return mShadowCaching;
+    }
+
+    void onInput() final
+    {
+        if (mIsInitialized)
+        {
+            mFramePacer->onInput(getTimeMs());
+        }
+    }
+
     void onRender() final
     {
         if (!mIsInitialized)
@@ -87,33 +274,190 @@ public:
             return;
         }
 
-        for (auto const& model : mModels)
+        waitForFrameStart();
+        // Every frame the pacer begins is presented and ended, even when recording failed, so the fences, the frame
+        // index and the pacer stay in step with the swap chain.
+        const uint64_t frameId = mFramePacer->beginFrame(getTimeMs());
+        const bool recorded = recordFrame();
+        if (!recorded)
         {
-            model->update(mFrameIndex);
+            // the cascades marked up to date were never drawn
+            mShadowMap->invalidateStaticCache();
         }
+        presentFrame(frameId, recorded);
+    }
 
-        HR_ERROR_CHECK_CALL(mCommandAllocator[mFrameIndex]->Reset(), void(), "Failed to reset command allocator\n");
+private:
 
-        uint32_t frameHeapOffset = 0;
-        populateShadowCommandList(frameHeapOffset);
-        ID3D12CommandList* ppCommadLists[] = { mCommandList.Get() };
-        mCommandQueue->ExecuteCommandLists(_countof(ppCommadLists), ppCommadLists);
+    // Updates the scene and records and submits the passes of the frame. Returns false when nothing was submitted.
+    bool recordFrame()
+    {
+        auto currentTime = std::chrono::high_resolution_clock::now();
+        float time = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - mStartTime).count() / 1000.0f;
+
+        const uint32_t modelCount = mModels.getCount();
+        if (mVisible[0].size() != modelCount)
+        {
+            // models were added or removed, some may be static casters
+            mStaticCasterVersion++;
+            for (std::vector<uint8_t>& visible : mVisible)
+            {
+                visible.resize(modelCount);
+            }
+        }
 
-        insertGPUFence();
+        XMFLOAT4X4 viewProj;
+        XMStoreFloat4x4(&viewProj, mViewMtx * mProjMtx);
+        const Frustum frustum = Frustum::fromViewProjection(&viewProj.m[0][0]);
+        XMFLOAT4X4 view;
+        XMStoreFloat4x4(&view, mViewMtx);
+        const Float3 lightDir{ mLightDir.x, mLightDir.y, mLightDir.z };
+        mShadowCascades.fit({ &view.m[0][0], FovY, mAspectRatio, NearZ, FarZ }, lightDir, ShadowMap::CascadeCount, ShadowSplitLambda, ShadowMap::Size);
+        const XMMATRIX lightViewMtx = XMLoadFloat4x4(reinterpret_cast<const XMFLOAT4X4*>(mShadowCascades.getLightView()));
+
+        // the triangles the main pass drew last frame steer the LOD bias of this one
+        mLodSelector.updateBias(mLodStats.lastTriangles);
+        mLodSelector.resize(modelCount);
+        XMFLOAT3 cameraPosition;
+        XMStoreFloat3(&cameraPosition, XMMatrixInverse(nullptr, mViewMtx).r[3]);
+        XMFLOAT4X4 proj;
+        XMStoreFloat4x4(&proj, mProjMtx);
+        const float projectionScale = 0.5f * static_cast<float>(mHeight) * proj._22;
+
+        UINT8* frameData = mFrameDataBegin + mFrameIndex * FrameDataSize;
+        InstanceData* instances = reinterpret_cast<InstanceData*>(frameData + InstanceDataOffset);
+        mJobSystem->parallelFor(modelCount, ModelUpdateGrainSize, [this, time](uint32_t begin, uint32_t end)
+        {
+            mModels.animate(begin, end, time);
+        });
+        // one pass over the hierarchy, only the subtrees of the animated nodes are recomputed
+        const auto sceneGraphStart = std::chrono::high_resolution_clock::now();
+        mSceneGraph.update();
+        mSceneGraphStats.ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - sceneGraphStart).count();
+        mSceneGraphStats.updatedNodes += mSceneGraph.getStats().updatedNodes;
+        mSceneGraphStats.rebuilds += mSceneGraph.getStats().rebuilt ? 1 : 0;
+        mJobSystem->parallelFor(modelCount, ModelUpdateGrainSize, [this, instances, lightViewMtx, cameraPosition, projectionScale](uint32_t begin, uint32_t end)
+        {
+            mModels.update(begin, end, mViewMtx, lightViewMtx);
+            const ModelTransform* transforms = mModels.getTransforms();
+            const ModelMesh* meshes = mModels.getMeshes();
+            const Bounds* bounds = mModels.getWorldBounds();
+            for (uint32_t i = begin; i < end; i++)
+            {
+                instances[i].world = transforms[i].world;
+                mLodSelector.setObject(i, bounds[i], meshes[i].mesh->getLodCount());
+            }
+
+            // the shadow passes draw the LOD picked for the camera too
+            mLodSelector.select({ cameraPosition.x, cameraPosition.y, cameraPosition.z }, projectionScale, begin, end, reinterpret_cast<uint8_t*>(mModels.getLods()));
+        });
 
-        populateCommandList(frameHeapOffset);
+        updateSceneBvh();
+        mSceneBvh.cull(frustum.planes, Frustum::SideCount, mVisible[getDrawList(RenderPass::Main)].data());
+        FrameConstants frameConstants{};
+        for (uint32_t cascade = 0; cascade < ShadowMap::CascadeCount; cascade++)
+        {
+            // each cascade only keeps the casters shadowing its slice of the view
+            const ShadowCascades::Cascade& fit = mShadowCascades.getCascade(cascade);
+            const Frustum lightFrustum = Frustum::fromViewProjection(fit.viewProj);
+            ShadowCasterVolume casterVolume;
+            casterVolume.build(lightFrustum, fit.cameraFrustum, lightDir);
+            mSceneBvh.cull(casterVolume.getPlanes(), casterVolume.getPlaneCount(), mVisible[getDrawList(RenderPass::Shadow, cascade)].data());
+
+            // The cache has to hold the static casters whatever the camera sees, so they are only culled against
+            // the light frustum. Its near plane is skipped like in the caster volume.
+            mStaticShadowUpdates[cascade] = mShadowCaching && mShadowMap->updateStaticCache(cascade, fit.viewProj, mStaticCasterVersion);
+            if (mStaticShadowUpdates[cascade])
+            {
+                const Plane lightPlanes[]{ lightFrustum.planes[Frustum::Left], lightFrustum.planes[Frustum::Right], lightFrustum.planes[Frustum::Bottom], lightFrustum.planes[Frustum::Top], lightFrustum.planes[Frustum::Far] };
+                mSceneBvh.cull(lightPlanes, _countof(lightPlanes), mVisible[getStaticDrawList(cascade)].data());
+            }
+
+            XMStoreFloat4x4(&frameConstants.cascadeViewProj[cascade], XMMatrixTranspose(XMLoadFloat4x4(reinterpret_cast<const XMFLOAT4X4*>(fit.viewProj))));
+            frameConstants.cascadeSplits[cascade] = fit.splitFar;
+            frameConstants.cascadeBias[cascade] = ShadowBiasTexels * fit.texelSize / (fit.lightFarZ - fit.lightNearZ);
+        }
+        cullOccluded(viewProj);
+
+        assignLights(frameData);
+
+        XMStoreFloat4x4(&frameConstants.viewProj, XMMatrixTranspose(mViewMtx * mProjMtx));
+        frameConstants.lightDir = mLightDir;
+        frameConstants.clusterDepthScale = mLightClusters.getDepthScale();
+        frameConstants.clusterDepthBias = mLightClusters.getDepthBias();
+        frameConstants.clusterTileScale = { static_cast<float>(LightClusters::TileCountX) / mWidth, static_cast<float>(LightClusters::TileCountY) / mHeight };
+        memcpy(frameData, &frameConstants, sizeof(frameConstants));
+
+        mUploadManager->reclaim();
+        mDeletionQueue->collect();
+
+        HR_ERROR_CHECK_CALL(mShadowCommandAllocator[mFrameIndex]->Reset(), false, "Failed to reset shadow command allocator\n");
+        HR_ERROR_CHECK_CALL(mCommandAllocator[mFrameIndex]->Reset(), false, "Failed to reset command allocator\n");
+
+        // the material table occupies the start of the frame heap
+        uint32_t frameHeapOffset = SimpleShader::MaxMaterials;
+        if (!buildRenderGraph(&frameHeapOffset))
+        {
+            return false;
+        }
+
+        // both passes record at the same time, the render graph barriers order them on the GPU
+        JobCounter shadowCounter;
+        {
+            ID3D12GraphicsCommandList* shadowCommandList = mShadowCommandList.Get();
+            mJobSystem->run(shadowCounter, [this, shadowCommandList]()
+            {
+                populateShadowCommandList(shadowCommandList);
+            });
+        }
+
+        populateCommandList(mCommandList.Get());
+        mJobSystem->wait(shadowCounter);
+
+        ID3D12CommandList* ppCommadLists[] = { mShadowCommandList.Get(), mCommandList.Get() };
         mCommandQueue->ExecuteCommandLists(_countof(ppCommadLists), ppCommadLists);
 
+        auto submitTime = std::chrono::high_resolution_clock::now();
+        const double cpuFrameMs = std::chrono::duration<double, std::milli>(submitTime - currentTime).count();
+        mFrameTimes.add(cpuFrameMs);
+
+        ShadowCacheStats& cacheStats = mShadowCacheStats[mShadowCaching ? 1 : 0];
+        cacheStats.frames++;
+        cacheStats.cpuFrameMs += cpuFrameMs;
+        for (bool update : mStaticShadowUpdates)
+        {
+            cacheStats.cascadeUpdates += update ? 1 : 0;
+        }
+        // the GPU time of the shadow pass is read back once the frame completed
+        mFrameShadowCaching[mFrameIndex] = mShadowCaching;
+
+        return true;
+    }
+
+    // Presents the frame, ends it in the pacer and moves to the next frame in flight. A frame that recorded nothing
+    // presents the back buffer as it is and has no GPU timestamps to read back.
+    void presentFrame(uint64_t frameId, bool recorded)
+    {
         if (FAILED(mSwapChain->Present(1, 0)))
         {
             assert(false);
         }
 
+        mFramePacer->endFrame(frameId, getTimeMs());
+        mFrameIds[mFrameIndex] = recorded ? frameId : 0;
+        UINT presentCount = 0;
+        if (SUCCEEDED(mSwapChain->GetLastPresentCount(&presentCount)))
+        {
+            mPresentedFrames[presentCount % _countof(mPresentedFrames)] = { presentCount, frameId };
+        }
+
+        if (recorded)
+        {
+            reportStats();
+        }
         MoveToNextFrame();
     }
 
-private:
-
     bool loadPipeline(HWND hWnd)
     {
         UINT dxgiFactoryFlag{ 0 };
@@ -178,109 +522,137 @@ private:
 
         HR_ERROR_CHECK_CALL(mDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&mCommandQueue)), false, "Failed to create command queue!\n");
 
+        mRenderGraph = std::make_unique<D3D12RenderGraph>();
+        mRenderGraph->prepare(mDevice.Get(), mFrameCount);
+
+        mGpuAllocator = std::make_unique<GpuMemoryAllocator>();
+        if (!mGpuAllocator->prepare(mDevice.Get()))
+        {
+            LOG_ERROR("Failed to prepare GPU memory allocator\n");
+            return false;
+        }
+
         DXGI_SWAP_CHAIN_DESC1 swapChainDesc{};
-        swapChainDesc.BufferCount = FrameCount;
+        swapChainDesc.BufferCount = mBackBufferCount;
         swapChainDesc.Width = mWidth;
         swapChainDesc.Height = mHeight;
         swapChainDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
         swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
         swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
         swapChainDesc.SampleDesc.Count = 1;
+        swapChainDesc.Flags = mFramePacer->getMode() == PacingMode::Waitable ? DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT : 0;
 
         ComPtr<IDXGISwapChain1> swapChain;
         HR_ERROR_CHECK_CALL(factory->CreateSwapChainForHwnd(mCommandQueue.Get(), hWnd, &swapChainDesc, nullptr, nullptr, &swapChain), false, "Failed to create swap chain!\n");
         HR_ERROR_CHECK_CALL(factory->MakeWindowAssociation(hWnd, DXGI_MWA_NO_ALT_ENTER), false, "Failed to change windows association!\n");
         HR_ERROR_CHECK_CALL(swapChain.As(&mSwapChain), false, "Failed to cast swap chain!\n");
 
-        mFrameIndex = mSwapChain->GetCurrentBackBufferIndex();
+        if (mFramePacer->getMode() == PacingMode::Waitable)
+        {
+            HR_ERROR_CHECK_CALL(mSwapChain->SetMaximumFrameLatency(mFrameCount), false, "Failed to set maximum frame latency!\n");
+            mFrameLatencyWaitable = mSwapChain->GetFrameLatencyWaitableObject();
+        }
+
+        mFrameIndex = 0;
+        mBackBufferIndex = mSwapChain->GetCurrentBackBufferIndex();
 
         D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc{};
-        rtvHeapDesc.NumDescriptors = FrameCount;
+        rtvHeapDesc.NumDescriptors = mBackBufferCount;
         rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
         rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
         HR_ERROR_CHECK_CALL(mDevice->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(&mRTVHeap)), false, "Failed to create RTV heap!\n");
 
         D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc{};
-        dsvHeapDesc.NumDescriptors = FrameCount;
+        dsvHeapDesc.NumDescriptors = 1;
         dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
         dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
         HR_ERROR_CHECK_CALL(mDevice->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(&mDSVHeap)), false, "Failed to create DSV heap!\n");
 
         D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc{};
-        srvHeapDesc.NumDescriptors = 64;
+        srvHeapDesc.NumDescriptors = MaxSRVDescriptors;
         srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
         srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
         HR_ERROR_CHECK_CALL(mDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSRVCBVHeap)), false, "Failed to create SRV CBV heap!\n");
 
-        for (UINT i = 0; i < FrameCount; i++)
+        for (UINT i = 0; i < mFrameCount; i++)
         {
             D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc{};
-            srvHeapDesc.NumDescriptors = 64;
+            srvHeapDesc.NumDescriptors = MaxSRVDescriptors;
             srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
             srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
             HR_ERROR_CHECK_CALL(mDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSRVCBVFrameHeap[i])), false, "Failed to create SRV CBV frame heap %u!\n", i);
         }
 
         mRTVDescriptorSize = mDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-        mDSVDescriptorSize = mDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
         mSRVCBVDescriptorSize = mDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
         CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(mRTVHeap->GetCPUDescriptorHandleForHeapStart());
-        CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(mDSVHeap->GetCPUDescriptorHandleForHeapStart());
-        for (UINT n = 0; n < FrameCount; n++)
+        for (UINT n = 0; n < mBackBufferCount; n++)
         {
             HR_ERROR_CHECK_CALL(mSwapChain->GetBuffer(n, IID_PPV_ARGS(&mRenderTargets[n])), false, "Unabled to get buffer for render target %u\n", n);
 
             mDevice->CreateRenderTargetView(mRenderTargets[n].Get(), nullptr, rtvHandle);
-
-            {
-                CD3DX12_RESOURCE_DESC depthTexDesc{
-                    D3D12_RESOURCE_DIMENSION_TEXTURE2D,
-                    0,
-                    mWidth,
-                    mHeight,
-                    1,
-                    1,
-                    DXGI_FORMAT_D32_FLOAT,
-                    1,
-                    0,
-                    D3D12_TEXTURE_LAYOUT_UNKNOWN,
-                    D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL | D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE
-                };
-
-                D3D12_CLEAR_VALUE clearVal;
-                clearVal.Format = DXGI_FORMAT_D32_FLOAT;
-                clearVal.DepthStencil.Depth = 1.f;
-                clearVal.DepthStencil.Stencil = 0;
-
-                HR_ERROR_CHECK_CALL(mDevice->CreateCommittedResource(
-                    &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-                    D3D12_HEAP_FLAG_NONE,
-                    &depthTexDesc,
-                    D3D12_RESOURCE_STATE_DEPTH_WRITE,
-                    &clearVal,
-                    IID_PPV_ARGS(mDepthStencils[n].GetAddressOf())), false, "Failed to create depth buffer %d\n", n);
-            }
-                                 
-            mDevice->CreateDepthStencilView(mDepthStencils[n].Get(), nullptr, dsvHandle);
-
             rtvHandle.Offset(1, mRTVDescriptorSize);
-            dsvHandle.Offset(1, mDSVDescriptorSize);
-        
+        }
+
+        // one depth buffer shared by every frame in flight, the frames run in order on the direct queue so the next
+        // frame only writes it once the previous one is done with it. The render graph places it with the transients.
+        mDepthDesc = CD3DX12_RESOURCE_DESC{
+            D3D12_RESOURCE_DIMENSION_TEXTURE2D,
+            0,
+            mWidth,
+            mHeight,
+            1,
+            1,
+            DXGI_FORMAT_D32_FLOAT,
+            1,
+            0,
+            D3D12_TEXTURE_LAYOUT_UNKNOWN,
+            D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL | D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE
+        };
+        mDepthClearValue.Format = DXGI_FORMAT_D32_FLOAT;
+        mDepthClearValue.DepthStencil.Depth = 1.f;
+        mDepthClearValue.DepthStencil.Stencil = 0;
+
+        for (UINT n = 0; n < mFrameCount; n++)
+        {
             HR_ERROR_CHECK_CALL(mDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&mCommandAllocator[n])), false, "failed to create command allocator %u\n", n);
+            HR_ERROR_CHECK_CALL(mDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&mShadowCommandAllocator[n])), false, "failed to create shadow command allocator %u\n", n);
         }
 
         {
             HR_ERROR_CHECK_CALL(mDevice->CreateCommittedResource(
                 &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
                 D3D12_HEAP_FLAG_NONE,
-                &CD3DX12_RESOURCE_DESC::Buffer(1024 * 120),
+                &CD3DX12_RESOURCE_DESC::Buffer(FrameDataSize * mFrameCount),
                 D3D12_RESOURCE_STATE_GENERIC_READ,
                 nullptr,
-                IID_PPV_ARGS(&mConstantBuffer)), false, "Failed to create constant buffer!\n");
+                IID_PPV_ARGS(&mFrameDataBuffer)), false, "Failed to create frame data buffer!\n");
 
             CD3DX12_RANGE readRange(0, 0);
-            HR_ERROR_CHECK_CALL(mConstantBuffer->Map(0, &readRange, reinterpret_cast<void**>(&mCBVDataBegin)), false, "Faild to map constant buffer\n");
+            HR_ERROR_CHECK_CALL(mFrameDataBuffer->Map(0, &readRange, reinterpret_cast<void**>(&mFrameDataBegin)), false, "Faild to map frame data buffer\n");
+        }
+
+        // GPU timestamps of the shadow pass and the end of frame, read back once the frame fence completed
+        {
+            D3D12_QUERY_HEAP_DESC queryHeapDesc{};
+            queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+            queryHeapDesc.Count = mFrameCount * TimestampCount;
+            HR_ERROR_CHECK_CALL(mDevice->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&mTimestampQueryHeap)), false, "Failed to create timestamp query heap!\n");
+
+            HR_ERROR_CHECK_CALL(mDevice->CreateCommittedResource(
+                &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+                D3D12_HEAP_FLAG_NONE,
+                &CD3DX12_RESOURCE_DESC::Buffer(sizeof(UINT64) * mFrameCount * TimestampCount),
+                D3D12_RESOURCE_STATE_COPY_DEST,
+                nullptr,
+                IID_PPV_ARGS(&mTimestampReadback)), false, "Failed to create timestamp readback buffer!\n");
+
+            QueryPerformanceFrequency(&mQPCFrequency);
+            if (!calibrateGPUClock())
+            {
+                return false;
+            }
         }
 
         return true;
@@ -289,58 +661,112 @@ private:
     bool loadAssets()
     {
         HR_ERROR_CHECK_CALL(mDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, mCommandAllocator[mFrameIndex].Get(), nullptr, IID_PPV_ARGS(&mCommandList)), false, "Failed to create command list\n");
+        HR_ERROR_CHECK_CALL(mDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, mShadowCommandAllocator[mFrameIndex].Get(), nullptr, IID_PPV_ARGS(&mShadowCommandList)), false, "Failed to create shadow command list\n");
+        HR_ERROR_CHECK_CALL(mShadowCommandList->Close(), false, "Failed to close shadow command list\n");
 
-        if (mSimpleShader->prepare(mDevice.Get()) == false)
+        mUploadManager = std::make_unique<UploadManager>();
+        if (!mUploadManager->prepare(mDevice.Get(), StagingSize))
         {
-            LOG_ERROR("Failed to prepare shader\n");
+            LOG_ERROR("Failed to prepare upload manager\n");
             return false;
         }
 
         UINT heapOffset = 0;
+
+        // mesh data is copied on the copy queue while the pipelines are created
+        for (auto const & mesh : mMeshRegistry.getMeshes())
+        {
+            if (!mesh->prepare(
+                mDevice.Get(),
+                mGpuAllocator.get(),
+                mUploadManager.get(),
+                mSRVCBVHeap.Get(),
+                heapOffset))
+            {
+                LOG_ERROR("Failed to prepare mesh %s\n", mesh->getName().c_str());
+                return false;
+            }
+        }
+
+        UINT64 uploadFenceValue = mUploadManager->submit();
+
+        auto pipelineStart = std::chrono::high_resolution_clock::now();
+        mPipelineCache = std::make_unique<PipelineCache>();
+        if (!mPipelineCache->prepare(mDevice.Get(), PipelineCacheDirectory))
+        {
+            LOG_ERROR("Failed to prepare pipeline cache\n");
+            return false;
+        }
+
+        // the shader pipeline is built while the shadow map resources are created
+        JobCounter shaderCounter;
+        bool shaderPrepared = false;
+        {
+            SimpleShader* shader = mSimpleShader.get();
+            ID3D12Device* device = mDevice.Get();
+            PipelineCache* pipelineCache = mPipelineCache.get();
+            bool* result = &shaderPrepared;
+            mJobSystem->run(shaderCounter, [shader, device, pipelineCache, result]()
+            {
+                *result = shader->prepare(device, pipelineCache);
+            });
+        }
+
         UINT cbDataOffset = 0;
 
-        if (!mShadowMap->prepare(
+        bool shadowMapPrepared = mShadowMap->prepare(
             mDevice.Get(),
+            mPipelineCache.get(),
             mCommandQueue.Get(),
             mCommandList.Get(),
             mSRVCBVHeap.Get(),
             heapOffset,
-            mConstantBuffer.Get(),
+            mFrameDataBuffer.Get(),
             cbDataOffset,
-            mCBVDataBegin,
-            FrameCount))
+            mFrameDataBegin,
+            mFrameCount);
+        mJobSystem->wait(shaderCounter);
+
+        if (shaderPrepared == false)
+        {
+            LOG_ERROR("Failed to prepare shader\n");
+            return false;
+        }
+
+        if (!shadowMapPrepared)
         {
             LOG_ERROR("Failed to prepare shadowmap\n");
             return false;
         }
 
-        for (auto const & model : mModels)
+        mPipelineCache->save();
+        PipelineCache::Stats pipelineStats = mPipelineCache->getStats();
+        LOG_INFO("Shaders and pipelines ready in %.2f ms: shaders %u loaded (%.1f KB) %.2f ms, %u cached %u compiled %.2f ms, pipelines %u cached %u created %.2f ms (summed over threads)\n",
+            std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - pipelineStart).count(),
+            pipelineStats.shaderLoads,
+            pipelineStats.shaderLoadBytes / 1024.0,
+            pipelineStats.shaderLoadMs,
+            pipelineStats.shaderHits,
+            pipelineStats.shaderMisses,
+            pipelineStats.shaderMs,
+            pipelineStats.pipelineHits,
+            pipelineStats.pipelineMisses,
+            pipelineStats.pipelineMs);
+
+        if (!prepareIndirectDraws())
         {
-            if (!model->prepare(
-                mDevice.Get(),
-                mCommandQueue.Get(),
-                mCommandList.Get(),
-                mSRVCBVHeap.Get(),
-                heapOffset,
-                mSimpleShader.get(),
-                mShadowMap.get(),
-                mConstantBuffer.Get(),
-                cbDataOffset,
-                mCBVDataBegin,
-                FrameCount))
-            {
-                LOG_ERROR("Failed to prepare model\n");
-                return false;
-            }
+            return false;
         }
 
         HR_ERROR_CHECK_CALL(mCommandList->Close(), false, "Failed to close commandlist\n");
+        mUploadManager->waitOnQueue(mCommandQueue.Get(), uploadFenceValue);
         ID3D12CommandList* ppCommandLists[] = { mCommandList.Get() };
         mCommandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
 
         HR_ERROR_CHECK_CALL(mDevice->CreateFence(mFenceValue[mFrameIndex], D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)), false, "Failed to create fence\n");
 
         mFenceValue[mFrameIndex]++;
+        mDeletionQueue = std::make_unique<ResourceDeletionQueue>(D3D12CompletedFence{ mFence.Get() });
         mFenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
         if (mFenceEvent == nullptr)
         {
@@ -350,83 +776,774 @@ private:
 
         waitForGPU();
 
+        GpuMemoryAllocator::Stats memoryStats = mGpuAllocator->getStats();
+        LOG_INFO("GPU memory: %u heaps, %.2f / %.2f MB used by %u placed resources and %u small buffers, %u committed resources %.2f MB\n%s",
+            memoryStats.heapCount,
+            memoryStats.usedBytes / (1024. * 1024.),
+            memoryStats.heapBytes / (1024. * 1024.),
+            memoryStats.placedResources,
+            memoryStats.smallBuffers,
+            memoryStats.committedResources,
+            memoryStats.committedBytes / (1024. * 1024.),
+            mGpuAllocator->getReport().c_str());
+        reportDepthMemory();
+
         return true;
     }
 
-    void populateShadowCommandList(uint32_t &frameHeapOffset)
+    // What sharing one depth buffer saves over one per frame in flight, at this and the common resolutions.
+    void reportDepthMemory()
     {
-        HR_ERROR_CHECK_CALL(mCommandList->Reset(mCommandAllocator[mFrameIndex].Get(), nullptr), void(), "Failed to reset command list\n");
+        const UINT resolutions[][2] = { { mWidth, mHeight }, { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 } };
+        for (auto const& resolution : resolutions)
+        {
+            D3D12_RESOURCE_DESC desc = mDepthDesc;
+            desc.Width = resolution[0];
+            desc.Height = resolution[1];
+            UINT64 size = mDevice->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+            LOG_INFO("Depth memory %ux%u: %.2f MB shared instead of %u x %.2f MB = %.2f MB, saves %.2f MB\n",
+                resolution[0],
+                resolution[1],
+                size / (1024. * 1024.),
+                mFrameCount,
+                size / (1024. * 1024.),
+                size * mFrameCount / (1024. * 1024.),
+                size * (mFrameCount - 1) / (1024. * 1024.));
+        }
+    }
 
-        ID3D12DescriptorHeap* ppHeaps[] = { mSRVCBVFrameHeap[mFrameIndex].Get() };
-        mCommandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+    bool prepareIndirectDraws()
+    {
+        static_assert(sizeof(D3D12_VERTEX_BUFFER_VIEW) == 16 && sizeof(D3D12_INDEX_BUFFER_VIEW) == 16, "Buffer views do not match IndirectDrawCommand");
+        static_assert(sizeof(D3D12_DRAW_INDEXED_ARGUMENTS) == 20, "Draw arguments do not match IndirectDrawCommand");
+
+        D3D12_INDIRECT_ARGUMENT_DESC argumentDescs[4]{};
+        argumentDescs[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+        argumentDescs[0].Constant.DestOffsetIn32BitValues = 0;
+        argumentDescs[0].Constant.Num32BitValuesToSet = SimpleShader::DrawConstantCount;
+        argumentDescs[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW;
+        argumentDescs[1].VertexBuffer.Slot = 0;
+        argumentDescs[2].Type = D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW;
+        argumentDescs[3].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+        D3D12_COMMAND_SIGNATURE_DESC commandSignatureDesc{};
+        commandSignatureDesc.ByteStride = sizeof(IndirectDrawCommand);
+        commandSignatureDesc.NumArgumentDescs = _countof(argumentDescs);
+        commandSignatureDesc.pArgumentDescs = argumentDescs;
+
+        // the constants argument names a root parameter, so every root signature needs its own command signature
+        // the cascade index is set once per cascade, outside the indirect arguments
+        argumentDescs[0].Constant.RootParameterIndex = ShadowMap::RootDrawConstants;
+        HR_ERROR_CHECK_CALL(mDevice->CreateCommandSignature(&commandSignatureDesc, mShadowMap->getRootSignature().Get(), IID_PPV_ARGS(&mCommandSignatures[static_cast<uint32_t>(RenderPass::Shadow)])), false, "Failed to create shadow command signature\n");
+
+        argumentDescs[0].Constant.RootParameterIndex = SimpleShader::RootDrawConstants;
+        HR_ERROR_CHECK_CALL(mDevice->CreateCommandSignature(&commandSignatureDesc, mSimpleShader->getRootSignature().Get(), IID_PPV_ARGS(&mCommandSignatures[static_cast<uint32_t>(RenderPass::Main)])), false, "Failed to create main command signature\n");
+
+        // one template per mesh LOD, indexed by getTemplateIndex, the mesh id is also the material index
+        auto const& meshes = mMeshRegistry.getMeshes();
+        mIndirectTemplates.resize(meshes.size() * Mesh::MaxLods);
+        for (auto const& mesh : meshes)
         {
-            auto pipelineState = mShadowMap->getPipelineState().Get();
-            mCommandList->SetPipelineState(pipelineState);
-            mCommandList->SetGraphicsRootSignature(mShadowMap->getRootSignature().Get());
+            const D3D12_VERTEX_BUFFER_VIEW& vertexBufferView = mesh->getVertexBufferView();
+            const D3D12_INDEX_BUFFER_VIEW& indexBufferView = mesh->getIndexBufferView();
+
+            for (uint32_t lod = 0; lod < mesh->getLodCount(); lod++)
+            {
+                IndirectDrawCommand& command = mIndirectTemplates[getTemplateIndex(mesh->getId(), lod)];
+                command = IndirectDrawCommand{};
+                command.materialIndex = mesh->getId();
+                command.vertexBufferLocation = vertexBufferView.BufferLocation;
+                command.vertexBufferSize = vertexBufferView.SizeInBytes;
+                command.vertexStride = vertexBufferView.StrideInBytes;
+                command.indexBufferLocation = indexBufferView.BufferLocation;
+                command.indexBufferSize = indexBufferView.SizeInBytes;
+                command.indexFormat = indexBufferView.Format;
+                command.indexCountPerInstance = mesh->getLod(lod).indexCount;
+                command.startIndexLocation = mesh->getLod(lod).indexOffset;
+            }
+
+            // the material table never changes, copy it to the start of every frame heap once
+            for (UINT i = 0; i < mFrameCount; i++)
+            {
+                CD3DX12_CPU_DESCRIPTOR_HANDLE materialHandle(mSRVCBVFrameHeap[i]->GetCPUDescriptorHandleForHeapStart(), mesh->getId(), mSRVCBVDescriptorSize);
+                mDevice->CopyDescriptorsSimple(1, materialHandle, mesh->getSRVHandle(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+            }
+        }
+
+        return true;
+    }
 
-            mCommandList->RSSetViewports(1, &mShadowViewport);
-            mCommandList->RSSetScissorRects(1, &mShadowScissorRect);
+    // Declares the passes of this frame, the graph derives their barriers and places the shadow map.
+    bool buildRenderGraph(uint32_t* frameHeapOffset)
+    {
+        mRenderGraph->reset();
 
-            CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(mShadowMap->getDSVHeap()->GetCPUDescriptorHandleForHeapStart());
-            mCommandList->OMSetRenderTargets(0, nullptr, FALSE, &dsvHandle);
-            mCommandList->ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+        auto backBuffer = mRenderGraph->importResource("back buffer", mRenderTargets[mBackBufferIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT);
+        auto depth = mRenderGraph->createTexture("depth", mDepthDesc, &mDepthClearValue);
+        D3D12_CLEAR_VALUE shadowClearValue = ShadowMap::getDepthClearValue();
+        auto shadowMap = mRenderGraph->createTexture("shadow map", ShadowMap::getDepthTextureDesc(), &shadowClearValue);
 
-            for (auto const& model : mModels)
+        // With the cache the shadow map starts as a copy of the static casters, it is cleared otherwise
+        if (mShadowCaching)
+        {
+            auto staticShadowMap = mRenderGraph->importResource("static shadow cache", mShadowMap->getStaticDepthTexture(), mStaticShadowState, D3D12_RESOURCE_STATE_COPY_SOURCE);
+
+            bool updateCache = false;
+            for (bool update : mStaticShadowUpdates)
+            {
+                updateCache = updateCache || update;
+            }
+            if (updateCache)
             {
-                model->updateShadowDescriptors(mDevice.Get(), mCommandList.Get(), mSRVCBVFrameHeap[mFrameIndex].Get(), frameHeapOffset, mFrameIndex);
-                mCommandList->ExecuteBundle(model->getShadowBundle().Get());
+                auto staticShadowPass = mRenderGraph->addPass("static shadow", static_cast<uint32_t>(RenderPass::Shadow), [this](ID3D12GraphicsCommandList* commandList)
+                {
+                    recordStaticShadowPass(commandList);
+                });
+                mRenderGraph->write(staticShadowPass, staticShadowMap, D3D12_RESOURCE_STATE_DEPTH_WRITE);
             }
 
-            mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mShadowMap->getDepthTexture().Get(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+            auto shadowCopyPass = mRenderGraph->addPass("shadow cache copy", static_cast<uint32_t>(RenderPass::Shadow), [this](ID3D12GraphicsCommandList* commandList)
+            {
+                commandList->CopyResource(mShadowMap->getDepthTexture(), mShadowMap->getStaticDepthTexture());
+            });
+            mRenderGraph->read(shadowCopyPass, staticShadowMap, D3D12_RESOURCE_STATE_COPY_SOURCE);
+            mRenderGraph->write(shadowCopyPass, shadowMap, D3D12_RESOURCE_STATE_COPY_DEST);
+        }
+
+        auto shadowPass = mRenderGraph->addPass("shadow", static_cast<uint32_t>(RenderPass::Shadow), [this](ID3D12GraphicsCommandList* commandList)
+        {
+            recordShadowPass(commandList);
+        });
+        mRenderGraph->write(shadowPass, shadowMap, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+        auto mainPass = mRenderGraph->addPass("main", static_cast<uint32_t>(RenderPass::Main), [this, frameHeapOffset](ID3D12GraphicsCommandList* commandList)
+        {
+            recordMainPass(commandList, *frameHeapOffset);
+        });
+        mRenderGraph->read(mainPass, shadowMap, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        mRenderGraph->write(mainPass, backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        mRenderGraph->write(mainPass, depth, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+        if (!mRenderGraph->compile())
+        {
+            return false;
+        }
+        if (mShadowCaching)
+        {
+            // the cache is created writable and stays a copy source between frames
+            mStaticShadowState = D3D12_RESOURCE_STATE_COPY_SOURCE;
         }
 
-        HR_ERROR_CHECK_CALL(mCommandList->Close(), void(), "Failed to close command list\n");
+        // transients stay the same resources while the graph does not change, views are only rewritten when they do
+        mShadowMap->setDepthTexture(mDevice.Get(), mRenderGraph->getResource(shadowMap));
+        ID3D12Resource* depthStencil = mRenderGraph->getResource(depth);
+        if (depthStencil != mDepthStencil)
+        {
+            mDevice->CreateDepthStencilView(depthStencil, nullptr, mDSVHeap->GetCPUDescriptorHandleForHeapStart());
+            mDepthStencil = depthStencil;
+        }
+        return true;
     }
 
-    void populateCommandList(uint32_t &frameHeapOffset)
+    void populateShadowCommandList(ID3D12GraphicsCommandList* commandList)
     {
-        HR_ERROR_CHECK_CALL(mCommandList->Reset(mCommandAllocator[mFrameIndex].Get(), nullptr), void(), "Failed to reset command list\n");
+        auto recordStart = std::chrono::high_resolution_clock::now();
+        // with the cache on the shadow pass only draws the moving casters over the copy of the static ones
+        const CasterFilter casters = mShadowCaching ? CasterFilter::Dynamic : CasterFilter::All;
+        for (uint32_t cascade = 0; cascade < ShadowMap::CascadeCount; cascade++)
+        {
+            buildDrawBatches(RenderPass::Shadow, cascade, getDrawList(RenderPass::Shadow, cascade), casters, mShadowBatches[cascade]);
+            mStaticShadowBatches[cascade].clear();
+            if (mStaticShadowUpdates[cascade])
+            {
+                buildDrawBatches(RenderPass::Shadow, cascade, getStaticDrawList(cascade), CasterFilter::Static, mStaticShadowBatches[cascade]);
+            }
+        }
+
+        HR_ERROR_CHECK_CALL(commandList->Reset(mShadowCommandAllocator[mFrameIndex].Get(), nullptr), void(), "Failed to reset shadow command list\n");
 
         ID3D12DescriptorHeap* ppHeaps[] = { mSRVCBVFrameHeap[mFrameIndex].Get() };
-        mCommandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+        commandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+        commandList->EndQuery(mTimestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, mFrameIndex * TimestampCount + ShadowBeginTimestamp);
+        mRenderGraph->record(static_cast<uint32_t>(RenderPass::Shadow), commandList);
+        commandList->EndQuery(mTimestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, mFrameIndex * TimestampCount + ShadowEndTimestamp);
+        mRenderGraph->finish(static_cast<uint32_t>(RenderPass::Shadow), commandList);
+
+        HR_ERROR_CHECK_CALL(commandList->Close(), void(), "Failed to close command list\n");
+        addRecordTime(RenderPass::Shadow, recordStart);
+    }
+
+    void populateCommandList(ID3D12GraphicsCommandList* commandList)
+    {
+        auto recordStart = std::chrono::high_resolution_clock::now();
+        buildDrawBatches(RenderPass::Main, 0, getDrawList(RenderPass::Main), CasterFilter::All, mMainBatches);
+
+        HR_ERROR_CHECK_CALL(commandList->Reset(mCommandAllocator[mFrameIndex].Get(), nullptr), void(), "Failed to reset command list\n");
+
+        ID3D12DescriptorHeap* ppHeaps[] = { mSRVCBVFrameHeap[mFrameIndex].Get() };
+        commandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+        mRenderGraph->record(static_cast<uint32_t>(RenderPass::Main), commandList);
+
+        // resolves the shadow pass timestamps too, the shadow command list runs first
+        const UINT firstTimestamp = mFrameIndex * TimestampCount;
+        commandList->EndQuery(mTimestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, firstTimestamp + FrameEndTimestamp);
+        commandList->ResolveQueryData(mTimestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, firstTimestamp, TimestampCount, mTimestampReadback.Get(), firstTimestamp * sizeof(UINT64));
+
+        // the back buffer and shadow map transitions started after the main pass overlap the timestamp work
+        mRenderGraph->finish(static_cast<uint32_t>(RenderPass::Main), commandList);
+
+        HR_ERROR_CHECK_CALL(commandList->Close(), void(), "Failed to close command list\n");
+        addRecordTime(RenderPass::Main, recordStart);
+    }
+
+    // Draws the static casters of the cascades whose cache is out of date.
+    void recordStaticShadowPass(ID3D12GraphicsCommandList* commandList)
+    {
+        commandList->SetPipelineState(mShadowMap->getPipelineState().Get());
+        commandList->SetGraphicsRootSignature(mShadowMap->getRootSignature().Get());
+
+        commandList->RSSetViewports(1, &mShadowViewport);
+        commandList->RSSetScissorRects(1, &mShadowScissorRect);
+
+        D3D12_GPU_VIRTUAL_ADDRESS frameData = mFrameDataBuffer->GetGPUVirtualAddress() + mFrameIndex * FrameDataSize;
+        commandList->SetGraphicsRootConstantBufferView(ShadowMap::RootFrameConstants, frameData);
+        commandList->SetGraphicsRootShaderResourceView(ShadowMap::RootInstances, frameData + InstanceDataOffset);
+        commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+        for (uint32_t cascade = 0; cascade < ShadowMap::CascadeCount; cascade++)
         {
-            auto pipelineState = mSimpleShader->getPipelineState().Get();
-            mCommandList->SetPipelineState(pipelineState);
-            mCommandList->SetGraphicsRootSignature(mSimpleShader->getRootSignature().Get());
+            if (!mStaticShadowUpdates[cascade])
+            {
+                continue;
+            }
 
-            mCommandList->RSSetViewports(1, &mViewport);
-            mCommandList->RSSetScissorRects(1, &mScissorRect);
+            D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = mShadowMap->getStaticDSVHandle(cascade);
+            commandList->OMSetRenderTargets(0, nullptr, FALSE, &dsvHandle);
+            commandList->ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
-            mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mRenderTargets[mFrameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+            const uint32_t drawList = getStaticDrawList(cascade);
+            commandList->SetGraphicsRoot32BitConstant(ShadowMap::RootCascade, cascade, 0);
+            commandList->SetGraphicsRootShaderResourceView(ShadowMap::RootInstanceIndices, frameData + getInstanceIndexOffset(drawList));
+            executeIndirectDraws(commandList, RenderPass::Shadow, drawList, mStaticShadowBatches[cascade]);
+        }
+    }
+
+    void recordShadowPass(ID3D12GraphicsCommandList* commandList)
+    {
+        auto pipelineState = mShadowMap->getPipelineState().Get();
+        commandList->SetPipelineState(pipelineState);
+        commandList->SetGraphicsRootSignature(mShadowMap->getRootSignature().Get());
 
-            CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(mRTVHeap->GetCPUDescriptorHandleForHeapStart(), mFrameIndex, mRTVDescriptorSize);
-            CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(mDSVHeap->GetCPUDescriptorHandleForHeapStart(), mFrameIndex, mDSVDescriptorSize);
+        commandList->RSSetViewports(1, &mShadowViewport);
+        commandList->RSSetScissorRects(1, &mShadowScissorRect);
 
-            mCommandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
+        D3D12_GPU_VIRTUAL_ADDRESS frameData = mFrameDataBuffer->GetGPUVirtualAddress() + mFrameIndex * FrameDataSize;
+        commandList->SetGraphicsRootConstantBufferView(ShadowMap::RootFrameConstants, frameData);
+        commandList->SetGraphicsRootShaderResourceView(ShadowMap::RootInstances, frameData + InstanceDataOffset);
+        commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-            const float clearColor[] = { 0.0f, 0.2f, 0.4f, 1.0f };
-            mCommandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
-            mCommandList->ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
-            
-            for (auto const& model : mModels)
+        for (uint32_t cascade = 0; cascade < ShadowMap::CascadeCount; cascade++)
+        {
+            D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = mShadowMap->getDSVHandle(cascade);
+            commandList->OMSetRenderTargets(0, nullptr, FALSE, &dsvHandle);
+            if (!mShadowCaching)
             {
-                model->updateDescriptors(mDevice.Get(), mCommandList.Get(), mSRVCBVFrameHeap[mFrameIndex].Get(), frameHeapOffset, mFrameIndex);
-                mCommandList->ExecuteBundle(model->getBundle().Get());
+                commandList->ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
             }
 
-            mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mRenderTargets[mFrameIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
-            mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mShadowMap->getDepthTexture().Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE));
+            const uint32_t drawList = getDrawList(RenderPass::Shadow, cascade);
+            commandList->SetGraphicsRoot32BitConstant(ShadowMap::RootCascade, cascade, 0);
+            commandList->SetGraphicsRootShaderResourceView(ShadowMap::RootInstanceIndices, frameData + getInstanceIndexOffset(drawList));
+            executeIndirectDraws(commandList, RenderPass::Shadow, drawList, mShadowBatches[cascade]);
         }
+    }
+
+    void recordMainPass(ID3D12GraphicsCommandList* commandList, uint32_t &frameHeapOffset)
+    {
+        auto pipelineState = mSimpleShader->getPipelineState();
+        commandList->SetPipelineState(pipelineState);
+        commandList->SetGraphicsRootSignature(mSimpleShader->getRootSignature().Get());
+
+        commandList->RSSetViewports(1, &mViewport);
+        commandList->RSSetScissorRects(1, &mScissorRect);
+
+        CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(mRTVHeap->GetCPUDescriptorHandleForHeapStart(), mBackBufferIndex, mRTVDescriptorSize);
+        CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(mDSVHeap->GetCPUDescriptorHandleForHeapStart());
 
-        HR_ERROR_CHECK_CALL(mCommandList->Close(), void(), "Failed to close command list\n");
+        commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
+
+        const float clearColor[] = { 0.0f, 0.2f, 0.4f, 1.0f };
+        commandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
+        commandList->ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+
+        D3D12_GPU_VIRTUAL_ADDRESS frameData = mFrameDataBuffer->GetGPUVirtualAddress() + mFrameIndex * FrameDataSize;
+        commandList->SetGraphicsRootConstantBufferView(SimpleShader::RootFrameConstants, frameData);
+        commandList->SetGraphicsRootShaderResourceView(SimpleShader::RootInstances, frameData + InstanceDataOffset);
+        commandList->SetGraphicsRootShaderResourceView(SimpleShader::RootInstanceIndices, frameData + getInstanceIndexOffset(getDrawList(RenderPass::Main)));
+        commandList->SetGraphicsRootShaderResourceView(SimpleShader::RootLights, frameData + LightDataOffset);
+        commandList->SetGraphicsRootShaderResourceView(SimpleShader::RootLightCells, frameData + LightCellOffset);
+        commandList->SetGraphicsRootShaderResourceView(SimpleShader::RootLightIndices, frameData + LightIndexOffset);
+        commandList->SetGraphicsRootDescriptorTable(SimpleShader::RootShadowMap, copyToFrameHeap(mShadowMap->getSRVHandle(), frameHeapOffset));
+        commandList->SetGraphicsRootDescriptorTable(SimpleShader::RootTextures, mSRVCBVFrameHeap[mFrameIndex]->GetGPUDescriptorHandleForHeapStart());
+        commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+        executeIndirectDraws(commandList, RenderPass::Main, getDrawList(RenderPass::Main), mMainBatches);
     }
 
-    void insertGPUFence()
+    D3D12_GPU_DESCRIPTOR_HANDLE copyToFrameHeap(D3D12_CPU_DESCRIPTOR_HANDLE srcHandle, uint32_t &frameHeapOffset)
     {
-        HR_ERROR_CHECK_CALL(mCommandQueue->Signal(mFence.Get(), mFenceValue[mFrameIndex]), void(), "Failed to signal command queue!\n");
-        HR_ERROR_CHECK_CALL(mCommandQueue->Wait(mFence.Get(), mFenceValue[mFrameIndex]), void(), "Failed to signal command queue!\n");
+        assert(frameHeapOffset < MaxSRVDescriptors);
+        ID3D12DescriptorHeap* frameHeap = mSRVCBVFrameHeap[mFrameIndex].Get();
+        CD3DX12_CPU_DESCRIPTOR_HANDLE cpuHandle(frameHeap->GetCPUDescriptorHandleForHeapStart(), frameHeapOffset, mSRVCBVDescriptorSize);
+        CD3DX12_GPU_DESCRIPTOR_HANDLE gpuHandle(frameHeap->GetGPUDescriptorHandleForHeapStart(), frameHeapOffset, mSRVCBVDescriptorSize);
+        mDevice->CopyDescriptorsSimple(1, cpuHandle, srcHandle, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        frameHeapOffset++;
+        return gpuHandle;
+    }
 
-        mFenceValue[mFrameIndex]++;
+    // Packs the batches into the argument region of the draw list and submits them with one ExecuteIndirect.
+    void executeIndirectDraws(ID3D12GraphicsCommandList* commandList, RenderPass pass, uint32_t drawList, const std::vector<IndirectDrawBatch>& batches)
+    {
+        if (batches.empty())
+        {
+            return;
+        }
+
+        UINT64 commandOffset = mFrameIndex * FrameDataSize + getIndirectCommandOffset(drawList);
+        IndirectDrawCommand* commands = reinterpret_cast<IndirectDrawCommand*>(mFrameDataBegin + commandOffset);
+        packIndirectDrawCommands(mIndirectTemplates.data(), batches.data(), batches.size(), commands);
+
+        commandList->ExecuteIndirect(
+            mCommandSignatures[static_cast<uint32_t>(pass)].Get(),
+            static_cast<UINT>(batches.size()),
+            mFrameDataBuffer.Get(),
+            commandOffset,
+            nullptr,
+            0);
+    }
+
+    // the shadow pass draws one list per cascade, the main pass one
+    static uint32_t getDrawList(RenderPass pass, uint32_t cascade = 0)
+    {
+        return pass == RenderPass::Shadow ? cascade : ShadowMap::CascadeCount;
+    }
+
+    // static casters redrawn into the shadow cache, after the lists of the passes
+    static uint32_t getStaticDrawList(uint32_t cascade)
+    {
+        return ShadowMap::CascadeCount + 1 + cascade;
+    }
+
+    // indirect template of a mesh LOD, also the mesh field of the draw sort keys
+    static uint32_t getTemplateIndex(uint32_t meshId, uint32_t lod)
+    {
+        return meshId * Mesh::MaxLods + lod;
+    }
+
+    static LodConfig makeLodConfig()
+    {
+        LodConfig config;
+        // a clustered vertex moves by less than the diagonal of its cell
+        config.errorScale = Mesh::LodCellScale * 1.7320508f;
+        config.maxErrorPixels = LodMaxErrorPixels;
+        config.triangleBudget = LodTriangleBudget;
+        return config;
+    }
+
+    static UINT64 getInstanceIndexOffset(uint32_t drawList)
+    {
+        return InstanceIndexOffset + static_cast<UINT64>(drawList) * MaxInstances * sizeof(uint32_t);
+    }
+
+    static UINT64 getIndirectCommandOffset(uint32_t drawList)
+    {
+        return IndirectCommandOffset + static_cast<UINT64>(drawList) * MaxInstances * sizeof(IndirectDrawCommand);
+    }
+
+    // Rasterizes the largest visible models into the occlusion buffer and drops the main pass models hidden behind
+    // them. Shadow casters are kept, a model hidden from the camera can still shadow a visible one.
+    void cullOccluded(const XMFLOAT4X4& viewProj)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<uint8_t>& visible = mVisible[getDrawList(RenderPass::Main)];
+
+        const ModelTransform* transforms = mModels.getTransforms();
+        const Bounds* bounds = mModels.getWorldBounds();
+        mOccluders.clear();
+        for (uint32_t i = 0; i < mModels.getCount(); i++)
+        {
+            const float viewDepth = transforms[i].viewDepth;
+            if (!visible[i] || viewDepth <= NearZ)
+            {
+                continue;
+            }
+
+            const float size = bounds[i].radius / viewDepth;
+            if (size >= MinOccluderSize)
+            {
+                mOccluders.push_back({ size, i });
+            }
+        }
+        std::sort(mOccluders.begin(), mOccluders.end(), [](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) { return a.first > b.first; });
+
+        mOcclusionBuffer.clear();
+        XMMATRIX viewProjMtx = XMLoadFloat4x4(&viewProj);
+        uint32_t occluderCount = 0;
+        uint32_t triangleBudget = OccluderTriangleBudget;
+        for (const std::pair<float, uint32_t>& occluder : mOccluders)
+        {
+            const std::vector<Float3>& triangles = mModels.getMeshes()[occluder.second].mesh->getOccluderTriangles();
+            const uint32_t triangleCount = static_cast<uint32_t>(triangles.size() / 3);
+            if (triangleCount == 0 || triangleCount > triangleBudget)
+            {
+                continue;
+            }
+
+            // the stored world matrix is transposed for the shaders
+            XMFLOAT4X4 worldViewProj;
+            XMStoreFloat4x4(&worldViewProj, XMMatrixTranspose(XMLoadFloat4x4(&transforms[occluder.second].world)) * viewProjMtx);
+            mOcclusionBuffer.renderTriangles(triangles.data(), triangleCount, &worldViewProj.m[0][0]);
+            triangleBudget -= triangleCount;
+            if (++occluderCount == MaxOccluders)
+            {
+                break;
+            }
+        }
+
+        // occluders are tested too, their own triangles never hide them but other occluders can
+        if (occluderCount > 0)
+        {
+            for (uint32_t i = 0; i < mModels.getCount(); i++)
+            {
+                if (visible[i] && !mOcclusionBuffer.testBox(bounds[i], &viewProj.m[0][0]))
+                {
+                    visible[i] = 0;
+                    mOcclusionStats.culled++;
+                }
+            }
+        }
+
+        mOcclusionStats.occluders += occluderCount;
+        mOcclusionStats.ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // Point lights scattered over the scene, every SpotLightInterval-th one a spot light pointing down.
+    void createSceneLights()
+    {
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        mLights.resize(SceneLightCount);
+        mLightBounds.resize(SceneLightCount);
+        for (uint32_t i = 0; i < SceneLightCount; i++)
+        {
+            LightData& light = mLights[i];
+            light.position = { unit(random) * 12.f - 6.f, unit(random) * 2.5f - 1.5f, unit(random) * 12.f - 6.f };
+            light.range = 0.5f + unit(random);
+            XMStoreFloat3(&light.color, XMVector3Normalize(XMVectorSet(unit(random), unit(random), unit(random), 0.f)) * 0.6f);
+
+            const Float3 position{ light.position.x, light.position.y, light.position.z };
+            if (i % SpotLightInterval == 0)
+            {
+                light.direction = { 0.f, -1.f, 0.f };
+                light.spotCosOuter = std::cos(0.6f);
+                light.spotCosInner = std::cos(0.4f);
+                light.range *= 2.f;
+                mLightBounds[i] = LightClusters::boundCone(position, { 0.f, -1.f, 0.f }, light.range, light.spotCosOuter);
+            }
+            else
+            {
+                light.direction = { 0.f, 0.f, 1.f };
+                light.spotCosOuter = -2.f;
+                light.spotCosInner = -1.f;
+                mLightBounds[i] = { position, light.range };
+            }
+        }
+    }
+
+    // Assigns the lights to the clusters of the view and writes the lights, cells and index list to the frame data.
+    void assignLights(UINT8* frameData)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        const uint32_t lightCount = static_cast<uint32_t>(mLights.size());
+        mViewLights.resize(lightCount);
+        for (uint32_t i = 0; i < lightCount; i++)
+        {
+            const Float3& center = mLightBounds[i].center;
+            XMFLOAT3 viewCenter;
+            XMStoreFloat3(&viewCenter, XMVector3TransformCoord(XMVectorSet(center.x, center.y, center.z, 1.f), mViewMtx));
+            mViewLights[i] = { { viewCenter.x, viewCenter.y, viewCenter.z }, mLightBounds[i].radius };
+        }
+
+        memcpy(frameData + LightDataOffset, mLights.data(), lightCount * sizeof(LightData));
+        mLightClusters.assign(mViewLights.data(), lightCount,
+            reinterpret_cast<LightClusters::Cell*>(frameData + LightCellOffset),
+            reinterpret_cast<uint32_t*>(frameData + LightIndexOffset), MaxLightIndices);
+
+        const LightClusters::Stats& clusterStats = mLightClusters.getStats();
+        mLightStats.visibleLights += clusterStats.visibleLights;
+        mLightStats.indices += clusterStats.indices;
+        mLightStats.droppedIndices += clusterStats.droppedIndices;
+        mLightStats.maxClusterLights = std::max(mLightStats.maxClusterLights, clusterStats.maxClusterLights);
+        mLightStats.ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    void updateSceneBvh()
+    {
+        const uint32_t count = mModels.getCount();
+        if (mSceneBvh.getCount() != count || mSceneBvh.getStats().sahCost > BvhRebuildCostRatio * mSceneBvhBuildCost)
+        {
+            mSceneBvh.build(mModels.getWorldBounds(), count);
+            mSceneBvhBuildCost = mSceneBvh.getStats().sahCost;
+            mBvhStats.builds++;
+        }
+        else
+        {
+            mSceneBvh.refit(mModels.getWorldBounds(), true);
+            mBvhStats.rotations += mSceneBvh.getStats().rotations;
+        }
+    }
+
+    void buildDrawPackets(RenderPass pass, uint32_t cascade, uint32_t drawList, CasterFilter casters)
+    {
+        // each draw list owns its packets so both passes can be built concurrently
+        std::vector<DrawPacket>& packets = mDrawPackets[drawList];
+        std::vector<DrawPacket>& scratch = mDrawPacketScratch[drawList];
+        const uint32_t modelCount = mModels.getCount();
+        packets.resize(modelCount);
+        scratch.resize(modelCount);
+
+        const std::vector<uint8_t>& visible = mVisible[drawList];
+        const ModelTransform* transforms = mModels.getTransforms();
+        const ModelMesh* meshes = mModels.getMeshes();
+        const ModelMaterial* materials = mModels.getMaterials();
+        const ModelLod* lods = mModels.getLods();
+        uint32_t packetCount = 0;
+        uint32_t culled = 0;
+        LodStats lodStats;
+        for (uint32_t i = 0; i < modelCount; i++)
+        {
+            if (!visible[i])
+            {
+                culled++;
+                continue;
+            }
+
+            const ModelTransform& transform = transforms[i];
+            if (casters != CasterFilter::All && transform.isStatic() != (casters == CasterFilter::Static))
+            {
+                continue;
+            }
+
+            const uint32_t templateIndex = getTemplateIndex(meshes[i].id, lods[i].level);
+            const uint32_t materialIndex = materials[i].index;
+            DrawPacket& packet = packets[packetCount++];
+            if (pass == RenderPass::Shadow)
+            {
+                const ShadowCascades::Cascade& fit = mShadowCascades.getCascade(cascade);
+                uint32_t depthBucket = DrawSortKey::quantizeDepth(transform.shadowViewDepth, fit.lightNearZ, fit.lightFarZ);
+                packet.key = DrawSortKey::make(pass, ShadowRootSignatureId, ShadowPipelineId, materialIndex, templateIndex, depthBucket);
+            }
+            else
+            {
+                uint32_t depthBucket = DrawSortKey::quantizeDepth(transform.viewDepth, NearZ, FarZ);
+                packet.key = DrawSortKey::make(pass, MainRootSignatureId, MainPipelineId, materialIndex, templateIndex, depthBucket);
+                lodStats.lastTriangles += meshes[i].mesh->getLod(lods[i].level).indexCount / 3;
+                lodStats.models[lods[i].level]++;
+            }
+            packet.drawIndex = i;
+        }
+        packets.resize(packetCount);
+
+        // only the main list counts, it is built by one job
+        if (pass == RenderPass::Main)
+        {
+            mLodStats.lastTriangles = lodStats.lastTriangles;
+            mLodStats.triangles += lodStats.lastTriangles;
+            mLodStats.bias += mLodSelector.getBias();
+            for (uint32_t lod = 0; lod < Mesh::MaxLods; lod++)
+            {
+                mLodStats.models[lod] += lodStats.models[lod];
+            }
+        }
+
+        // the static lists cull the same models as their cascade, they are only counted once
+        PassStats& stats = mPassStats[static_cast<uint32_t>(pass)];
+        stats.culled += casters != CasterFilter::Static ? culled : 0;
+        accumulateStats(stats.unsorted, countStateChanges(packets.data(), packets.size()));
+        radixSortDrawPackets(packets.data(), scratch.data(), packets.size());
+        accumulateStats(stats.sorted, countStateChanges(packets.data(), packets.size()));
+    }
+
+    // Sorts the draws of the list and merges runs sharing every state into instanced batches.
+    // The instance indices of the batches are written to the list region of the frame data.
+    void buildDrawBatches(RenderPass pass, uint32_t cascade, uint32_t drawList, CasterFilter casters, std::vector<IndirectDrawBatch>& batches)
+    {
+        buildDrawPackets(pass, cascade, drawList, casters);
+        const std::vector<DrawPacket>& packets = mDrawPackets[drawList];
+
+        uint32_t* instanceIndices = reinterpret_cast<uint32_t*>(mFrameDataBegin + mFrameIndex * FrameDataSize + getInstanceIndexOffset(drawList));
+        uint64_t batchState = ~0ull;
+        batches.clear();
+        for (uint32_t i = 0; i < packets.size(); i++)
+        {
+            const DrawPacket& packet = packets[i];
+            instanceIndices[i] = packet.drawIndex;
+
+            // everything above the depth bucket is state
+            uint64_t state = packet.key >> DrawSortKey::MeshShift;
+            if (state != batchState)
+            {
+                batches.push_back({ DrawSortKey::getMesh(packet.key), i, 0, 0 });
+                batchState = state;
+            }
+            batches.back().instanceCount++;
+        }
+
+        PassStats& stats = mPassStats[static_cast<uint32_t>(pass)];
+        stats.drawCalls += static_cast<uint32_t>(batches.size());
+        stats.instances += static_cast<uint32_t>(packets.size());
+    }
+
+    void addRecordTime(RenderPass pass, std::chrono::high_resolution_clock::time_point recordStart)
+    {
+        auto recordEnd = std::chrono::high_resolution_clock::now();
+        mPassStats[static_cast<uint32_t>(pass)].recordMs += std::chrono::duration<double, std::milli>(recordEnd - recordStart).count();
+    }
+
+    static void accumulateStats(StateChangeStats& total, const StateChangeStats& frame)
+    {
+        total.draws += frame.draws;
+        total.rootSignatureChanges += frame.rootSignatureChanges;
+        total.pipelineChanges += frame.pipelineChanges;
+        total.materialChanges += frame.materialChanges;
+        total.meshChanges += frame.meshChanges;
+        total.redundantBinds += frame.redundantBinds;
+    }
+
+    void reportStats()
+    {
+        if (++mStatsFrameCount < StatsReportInterval)
+        {
+            return;
+        }
+
+        const char* passNames[] = { "shadow", "main" };
+        for (uint32_t i = 0; i < _countof(mPassStats); i++)
+        {
+            PassStats& stats = mPassStats[i];
+            LOG_INFO("[%s] instances/frame %u, culled/frame %u, indirect draws/frame %u, record %.3f ms/frame, state changes/frame unsorted %u sorted %u, redundant binds/frame %u\n",
+                passNames[i],
+                stats.instances / mStatsFrameCount,
+                stats.culled / mStatsFrameCount,
+                stats.drawCalls / mStatsFrameCount,
+                stats.recordMs / mStatsFrameCount,
+                stats.unsorted.getStateChanges() / mStatsFrameCount,
+                stats.sorted.getStateChanges() / mStatsFrameCount,
+                stats.sorted.redundantBinds / mStatsFrameCount);
+            stats = PassStats{};
+        }
+
+        const Bvh::Stats& bvhStats = mSceneBvh.getStats();
+        LOG_INFO("Scene BVH: %u objects, %u nodes, depth %u, SAH cost %.1f (%.1f when built), %u builds, rotations/frame %.2f\n",
+            mSceneBvh.getCount(),
+            bvhStats.wideNodes,
+            bvhStats.depth,
+            bvhStats.sahCost,
+            mSceneBvhBuildCost,
+            mBvhStats.builds,
+            static_cast<float>(mBvhStats.rotations) / mStatsFrameCount);
+        mBvhStats = BvhStats{};
+
+        LOG_INFO("Scene graph: %u nodes, updated nodes/frame %u, %u rebuilds, %.3f ms/frame\n",
+            mSceneGraph.getNodeCount(),
+            mSceneGraphStats.updatedNodes / mStatsFrameCount,
+            mSceneGraphStats.rebuilds,
+            mSceneGraphStats.ms / mStatsFrameCount);
+        mSceneGraphStats = SceneGraphStats{};
+
+        LOG_INFO("Clustered lights: %zu lights, visible/frame %u, cluster indices/frame %u (%u dropped), at most %u lights in a cluster, assignment %.3f ms/frame\n",
+            mLights.size(),
+            mLightStats.visibleLights / mStatsFrameCount,
+            mLightStats.indices / mStatsFrameCount,
+            mLightStats.droppedIndices,
+            mLightStats.maxClusterLights,
+            mLightStats.ms / mStatsFrameCount);
+        mLightStats = LightStats{};
+
+        LOG_INFO("LOD: triangles/frame %llu (budget %llu), bias %.2f, models/frame per LOD %u %u %u %u\n",
+            mLodStats.triangles / mStatsFrameCount,
+            mLodSelector.getConfig().triangleBudget,
+            mLodStats.bias / mStatsFrameCount,
+            mLodStats.models[0] / mStatsFrameCount,
+            mLodStats.models[1] / mStatsFrameCount,
+            mLodStats.models[2] / mStatsFrameCount,
+            mLodStats.models[3] / mStatsFrameCount);
+        mLodStats = LodStats{ mLodStats.lastTriangles };
+
+        const MaskedOcclusionBuffer::Stats& occlusionStats = mOcclusionBuffer.getStats();
+        LOG_INFO("Occlusion: occluders/frame %.1f, triangles/frame %u (%u rasterized), culled/frame %u, %.3f ms/frame\n",
+            static_cast<float>(mOcclusionStats.occluders) / mStatsFrameCount,
+            occlusionStats.triangles / mStatsFrameCount,
+            occlusionStats.rasterizedTriangles / mStatsFrameCount,
+            mOcclusionStats.culled / mStatsFrameCount,
+            mOcclusionStats.ms / mStatsFrameCount);
+        mOcclusionBuffer.resetStats();
+        mOcclusionStats = OcclusionStats{};
+
+        // both modes are reported when caching was toggled during the interval
+        for (uint32_t mode = 0; mode < _countof(mShadowCacheStats); mode++)
+        {
+            ShadowCacheStats& stats = mShadowCacheStats[mode];
+            if (stats.frames > 0)
+            {
+                LOG_INFO("Shadow cache %s: %u frames, shadow pass GPU %.3f ms/frame, CPU frame %.3f ms/frame, cascade cache redraws/frame %.2f\n",
+                    mode == 1 ? "on" : "off",
+                    stats.frames,
+                    stats.gpuFrames > 0 ? stats.gpuShadowMs / stats.gpuFrames : 0.,
+                    stats.cpuFrameMs / stats.frames,
+                    static_cast<float>(stats.cascadeUpdates) / stats.frames);
+            }
+            stats = ShadowCacheStats{};
+        }
+
+        // update, recording and submission, Present and the frame fence wait excluded
+        LOG_INFO("CPU frame time: %s", mFrameTimes.toString().c_str());
+        mFrameTimes.reset();
+
+        LOG_INFO("Input to present latency (%u frames in flight, %s pacing, predicted cpu %.2f ms gpu %.2f ms refresh %.2f ms, %u missed deadlines): %s",
+            mFrameCount,
+            mFramePacer->getMode() == PacingMode::Waitable ? "waitable" : "fence",
+            mFramePacer->getPredictedCpuMs(),
+            mFramePacer->getPredictedGpuMs(),
+            mFramePacer->getRefreshIntervalMs(),
+            mFramePacer->getMissedDeadlines(),
+            mFramePacer->getLatency().toString().c_str());
+        mFramePacer->resetStats();
+
+        const RenderGraph::Stats& graphStats = mRenderGraph->getGraph().getStats();
+        LOG_INFO("Render graph: compile %.3f ms, %u passes (%u culled), %u barriers in %u batches and %u ResourceBarrier calls, %u split, %u aliasing, transients %.2f MB (%.2f MB unaliased) in %.2f MB of heaps\n",
+            mRenderGraph->getCompileMs(),
+            graphStats.passes,
+            graphStats.culledPasses,
+            graphStats.barriers,
+            graphStats.barrierBatches,
+            mRenderGraph->getBarrierCallCount(),
+            graphStats.splitBarriers,
+            graphStats.aliasingBarriers,
+            graphStats.transientBytes / (1024. * 1024.),
+            graphStats.unaliasedBytes / (1024. * 1024.),
+            mRenderGraph->getHeapBytes() / (1024. * 1024.));
+
+        if (mDeletionQueue->getPendingCount() > 0 || mDeletionQueue->getReleasedCount() > 0)
+        {
+            LOG_INFO("Deferred deletion: %zu resources pending, %zu released\n", mDeletionQueue->getPendingCount(), mDeletionQueue->getReleasedCount());
+        }
+
+        // keep the GPU to CPU clock conversion from drifting
+        calibrateGPUClock();
+
+        mStatsFrameCount = 0;
     }
 
     void waitForGPU()
@@ -444,18 +1561,260 @@ private:
         const UINT64 currentFenceValue = mFenceValue[mFrameIndex];
         HR_ERROR_CHECK_CALL(mCommandQueue->Signal(mFence.Get(), currentFenceValue), void(), "Failed to signal command queue!\n");
 
-        mFrameIndex = mSwapChain->GetCurrentBackBufferIndex();
+        // frame resources cycle through the frames in flight, independently of the back buffers
+        mFrameIndex = (mFrameIndex + 1) % mFrameCount;
+        mBackBufferIndex = mSwapChain->GetCurrentBackBufferIndex();
 
+        // with the waitable swap chain the latency wait already throttled the CPU, this rarely blocks
         if (mFence->GetCompletedValue() < mFenceValue[mFrameIndex])
         {
             HR_ERROR_CHECK_CALL(mFence->SetEventOnCompletion(mFenceValue[mFrameIndex], mFenceEvent), void(), "Failed to set event on completion\n");
             WaitForSingleObjectEx(mFenceEvent, INFINITE, FALSE);
         }
 
+        reportGPUCompletion();
         mFenceValue[mFrameIndex] = currentFenceValue + 1;
     }
 
-    static const UINT FrameCount{ 2 };
+    // Waits on the swap chain until it accepts a new frame, then sleeps until the pacer start deadline
+    // so the frame samples input as late as it can while still making its display slot.
+    void waitForFrameStart()
+    {
+        if (mFramePacer->getMode() != PacingMode::Waitable)
+        {
+            reportDisplayedFrames();
+            return;
+        }
+
+        WaitForSingleObjectEx(mFrameLatencyWaitable, FrameLatencyTimeoutMs, TRUE);
+        reportDisplayedFrames();
+
+        double now = getTimeMs();
+        double deadline = mFramePacer->getStartDeadline();
+        double refreshMs = mFramePacer->getRefreshIntervalMs();
+        if (deadline > now + refreshMs)
+        {
+            deadline = now + refreshMs;
+        }
+
+        // Sleep is only accurate to the scheduler tick, spin the last millisecond
+        while (deadline - now > 2.)
+        {
+            Sleep(static_cast<DWORD>(deadline - now - 1.));
+            now = getTimeMs();
+        }
+
+        while (now < deadline)
+        {
+            YieldProcessor();
+            now = getTimeMs();
+        }
+    }
+
+    void reportGPUCompletion()
+    {
+        if (mFrameIds[mFrameIndex] == 0)
+        {
+            return;
+        }
+
+        UINT64* timestamps = nullptr;
+        const UINT firstTimestamp = mFrameIndex * TimestampCount;
+        CD3DX12_RANGE readRange(firstTimestamp * sizeof(UINT64), (firstTimestamp + TimestampCount) * sizeof(UINT64));
+        if (SUCCEEDED(mTimestampReadback->Map(0, &readRange, reinterpret_cast<void**>(&timestamps))))
+        {
+            UINT64 gpuTimestamp = timestamps[firstTimestamp + FrameEndTimestamp];
+            UINT64 shadowTicks = timestamps[firstTimestamp + ShadowEndTimestamp] - timestamps[firstTimestamp + ShadowBeginTimestamp];
+            CD3DX12_RANGE writeRange(0, 0);
+            mTimestampReadback->Unmap(0, &writeRange);
+
+            double gpuMs = (static_cast<double>(gpuTimestamp) - static_cast<double>(mGPUCalibrationTimestamp)) * 1000. / static_cast<double>(mGPUTimestampFrequency);
+            mFramePacer->onFrameGpuCompleted(mFrameIds[mFrameIndex], mCPUCalibrationMs + gpuMs);
+
+            ShadowCacheStats& cacheStats = mShadowCacheStats[mFrameShadowCaching[mFrameIndex] ? 1 : 0];
+            cacheStats.gpuFrames++;
+            cacheStats.gpuShadowMs += static_cast<double>(shadowTicks) * 1000. / static_cast<double>(mGPUTimestampFrequency);
+        }
+
+        mFrameIds[mFrameIndex] = 0;
+    }
+
+    void reportDisplayedFrames()
+    {
+        DXGI_FRAME_STATISTICS frameStatistics{};
+        if (FAILED(mSwapChain->GetFrameStatistics(&frameStatistics)))
+        {
+            // statistics are not available until the first frames reached the display
+            return;
+        }
+
+        const PresentedFrame& presented = mPresentedFrames[frameStatistics.PresentCount % _countof(mPresentedFrames)];
+        if (presented.presentCount == frameStatistics.PresentCount && presented.frameId != 0)
+        {
+            mFramePacer->onFrameDisplayed(presented.frameId, static_cast<double>(frameStatistics.SyncQPCTime.QuadPart) * 1000. / static_cast<double>(mQPCFrequency.QuadPart));
+        }
+    }
+
+    bool calibrateGPUClock()
+    {
+        HR_ERROR_CHECK_CALL(mCommandQueue->GetTimestampFrequency(&mGPUTimestampFrequency), false, "Failed to get timestamp frequency\n");
+        UINT64 cpuTimestamp = 0;
+        HR_ERROR_CHECK_CALL(mCommandQueue->GetClockCalibration(&mGPUCalibrationTimestamp, &cpuTimestamp), false, "Failed to get clock calibration\n");
+        mCPUCalibrationMs = static_cast<double>(cpuTimestamp) * 1000. / static_cast<double>(mQPCFrequency.QuadPart);
+        return true;
+    }
+
+    double getTimeMs() const
+    {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return static_cast<double>(counter.QuadPart) * 1000. / static_cast<double>(mQPCFrequency.QuadPart);
+    }
+
+    static const UINT MaxFrameCount{ FramePacer::MaxFramesInFlight };
+    static const DWORD FrameLatencyTimeoutMs{ 1000 };
+    static const uint32_t ModelUpdateGrainSize{ 64 };
+    // refits let the BVH degrade as models move, it is rebuilt once its SAH cost grew by this factor
+    static constexpr float BvhRebuildCostRatio{ 1.5f };
+    // a quarter of 1280x720 in each direction, whole 32x4 tiles
+    static const uint32_t OcclusionWidth{ 320 };
+    static const uint32_t OcclusionHeight{ 180 };
+    // the largest models on screen occlude, as long as their triangles fit the budget
+    static const uint32_t MaxOccluders{ 8 };
+    static const uint32_t OccluderTriangleBudget{ Mesh::MaxOccluderTriangles };
+    // bounding sphere radius over view depth, models smaller than this hide too little to be worth rasterizing
+    static constexpr float MinOccluderSize{ 0.05f };
+    static const uint32_t StatsReportInterval{ 600 };
+    static const UINT64 StagingSize{ 32 * 1024 * 1024 };
+
+    static const UINT MaxSRVDescriptors{ 1024 };
+    static const uint32_t MaxInstances{ 16384 };
+    static const uint32_t PassCount{ 2 };
+    // a draw list per shadow cascade, one for the main pass and one per cascade for the static shadow cache, see
+    // getDrawList and getStaticDrawList
+    static const uint32_t DrawListCount{ 2 * ShadowMap::CascadeCount + 1 };
+    static_assert(ShaderCascadeCount == ShadowMap::CascadeCount, "FrameConstants does not match the shadow cascades");
+
+    static const uint32_t MaxLights{ 4096 };
+    // cluster references of every light, the clusters past the end lose their lights
+    static const uint32_t MaxLightIndices{ 256 * 1024 };
+    static const uint32_t SceneLightCount{ 256 };
+    static const uint32_t SpotLightInterval{ 8 };
+    static_assert(SceneLightCount <= MaxLights, "The scene lights do not fit the light buffer");
+    static_assert(sizeof(LightClusters::Cell) == 8, "LightClusters::Cell does not match the uint2 cells of the shader");
+
+    // triangles the main pass aims for, past it the LOD bias coarsens the models
+    static const uint64_t LodTriangleBudget{ 4 * 1024 * 1024 };
+    // projected error of a LOD, in pixels, under which it is drawn without bias
+    static constexpr float LodMaxErrorPixels{ 1.f };
+    static_assert(SimpleShader::MaxMaterials * Mesh::MaxLods <= (1u << DrawSortKey::MeshBits), "The mesh LODs do not fit the mesh field of the sort keys");
+
+    // per frame data: frame constants | instance data | instance indices of every draw list | indirect commands of every draw list
+    //                 | lights | light cells | light indices
+    static const UINT64 FrameConstantsSize{ (sizeof(FrameConstants) + 255) & ~255 };
+    static const UINT64 InstanceDataOffset{ FrameConstantsSize };
+    static const UINT64 InstanceIndexOffset{ InstanceDataOffset + MaxInstances * sizeof(InstanceData) };
+    static const UINT64 IndirectCommandOffset{ (InstanceIndexOffset + DrawListCount * MaxInstances * sizeof(uint32_t) + 255) & ~255 };
+    static const UINT64 LightDataOffset{ (IndirectCommandOffset + DrawListCount * MaxInstances * sizeof(IndirectDrawCommand) + 255) & ~255 };
+    static const UINT64 LightCellOffset{ (LightDataOffset + MaxLights * sizeof(LightData) + 255) & ~255 };
+    static const UINT64 LightIndexOffset{ (LightCellOffset + LightClusters::ClusterCount * sizeof(LightClusters::Cell) + 255) & ~255 };
+    static const UINT64 FrameDataSize{ (LightIndexOffset + MaxLightIndices * sizeof(uint32_t) + 255) & ~255 };
+
+    static constexpr const char* PipelineCacheDirectory{ "cache" };
+    static constexpr float FovY{ 45.f / 180.f * 3.1415926f };
+    static constexpr float NearZ{ 0.1f };
+    static constexpr float FarZ{ 10.f };
+    // blend of logarithmic and uniform cascade splits, 1 is fully logarithmic
+    static constexpr float ShadowSplitLambda{ 0.75f };
+    // depth bias in texels of the cascade, constant in world units whatever the cascade depth range
+    static constexpr float ShadowBiasTexels{ 3.f };
+
+    // timestamps of each frame in flight
+    enum : UINT
+    {
+        ShadowBeginTimestamp,
+        ShadowEndTimestamp,
+        FrameEndTimestamp,
+        TimestampCount
+    };
+
+    // shadow casters a draw list keeps among the visible models
+    enum class CasterFilter
+    {
+        All,
+        Static,
+        Dynamic,
+    };
+
+    enum : uint32_t
+    {
+        ShadowRootSignatureId = 0,
+        MainRootSignatureId = 1,
+    };
+
+    enum : uint32_t
+    {
+        ShadowPipelineId = 0,
+        MainPipelineId = 1,
+    };
+
+    struct PassStats
+    {
+        StateChangeStats unsorted;
+        StateChangeStats sorted;
+        uint32_t instances{ 0 };
+        uint32_t culled{ 0 };
+        uint32_t drawCalls{ 0 };
+        double recordMs{ 0. };
+    };
+
+    struct OcclusionStats
+    {
+        uint32_t occluders{ 0 };
+        uint32_t culled{ 0 };
+        double ms{ 0. };
+    };
+
+    struct LightStats
+    {
+        uint32_t visibleLights{ 0 };
+        uint32_t indices{ 0 };
+        uint32_t droppedIndices{ 0 };
+        uint32_t maxClusterLights{ 0 };
+        double ms{ 0. };
+    };
+
+    struct LodStats
+    {
+        // main pass triangles of the last frame, fed back to the LOD selector
+        uint64_t lastTriangles{ 0 };
+        uint64_t triangles{ 0 };
+        float bias{ 0.f };
+        uint32_t models[Mesh::MaxLods]{};
+    };
+
+    struct ShadowCacheStats
+    {
+        uint32_t frames{ 0 };
+        uint32_t cascadeUpdates{ 0 };
+        double cpuFrameMs{ 0. };
+        // frames whose timestamps were read back
+        uint32_t gpuFrames{ 0 };
+        double gpuShadowMs{ 0. };
+    };
+
+    struct BvhStats
+    {
+        uint32_t builds{ 0 };
+        uint32_t rotations{ 0 };
+    };
+
+    struct SceneGraphStats
+    {
+        uint32_t updatedNodes{ 0 };
+        uint32_t rebuilds{ 0 };
+        double ms{ 0. };
+    };
 
     uint32_t mWidth;
     uint32_t mHeight;
@@ -468,32 +1827,112 @@ private:
     CD3DX12_RECT mShadowScissorRect;
 
     ComPtr<ID3D12Device> mDevice;
+    // declared before everything holding a GpuAllocation so it outlives them
+    std::unique_ptr<GpuMemoryAllocator> mGpuAllocator;
     ComPtr<ID3D12CommandQueue> mCommandQueue;
     ComPtr<IDXGISwapChain3> mSwapChain;
     ComPtr<ID3D12DescriptorHeap> mRTVHeap;
     ComPtr<ID3D12DescriptorHeap> mDSVHeap;
     ComPtr<ID3D12DescriptorHeap> mSRVCBVHeap;
-    ComPtr<ID3D12DescriptorHeap> mSRVCBVFrameHeap[FrameCount];
-    ComPtr<ID3D12Resource> mRenderTargets[FrameCount];
-    ComPtr<ID3D12Resource> mDepthStencils[FrameCount];
-    ComPtr<ID3D12CommandAllocator> mCommandAllocator[FrameCount];
+    ComPtr<ID3D12DescriptorHeap> mSRVCBVFrameHeap[MaxFrameCount];
+    ComPtr<ID3D12Resource> mRenderTargets[MaxFrameCount];
+    CD3DX12_RESOURCE_DESC mDepthDesc;
+    D3D12_CLEAR_VALUE mDepthClearValue{};
+    // render graph transient, shared by the frames in flight
+    ID3D12Resource* mDepthStencil{ nullptr };
+    ComPtr<ID3D12CommandAllocator> mCommandAllocator[MaxFrameCount];
+    ComPtr<ID3D12CommandAllocator> mShadowCommandAllocator[MaxFrameCount];
     ComPtr<ID3D12GraphicsCommandList> mCommandList;
+    ComPtr<ID3D12GraphicsCommandList> mShadowCommandList;
     ComPtr<ID3D12Fence> mFence;
 
-    ComPtr<ID3D12Resource> mConstantBuffer;
-    UINT8* mCBVDataBegin{ nullptr };
-
+    ComPtr<ID3D12Resource> mFrameDataBuffer;
+    UINT8* mFrameDataBegin{ nullptr };
+
+    XMMATRIX mViewMtx;
+    XMMATRIX mProjMtx;
+    ShadowCascades mShadowCascades;
+    bool mShadowCaching{ true };
+    // bumped whenever static models are added or removed, the shadow cache is redrawn when it changes
+    uint64_t mStaticCasterVersion{ 0 };
+    bool mStaticShadowUpdates[ShadowMap::CascadeCount]{};
+    D3D12_RESOURCE_STATES mStaticShadowState{ D3D12_RESOURCE_STATE_DEPTH_WRITE };
+    // index 0 without the cache, 1 with it
+    ShadowCacheStats mShadowCacheStats[2];
+    bool mFrameShadowCaching[MaxFrameCount]{};
+    XMFLOAT3 mLightDir;
+    std::chrono::high_resolution_clock::time_point mStartTime{ std::chrono::high_resolution_clock::now() };
+
+    UINT mFrameCount{ 2 };
+    UINT mBackBufferCount{ 2 };
     UINT mFrameIndex;
+    UINT mBackBufferIndex;
     UINT mRTVDescriptorSize;
-    UINT mDSVDescriptorSize;
     UINT mSRVCBVDescriptorSize;
-    UINT64 mFenceValue[FrameCount]{};
+    UINT64 mFenceValue[MaxFrameCount]{};
 
     HANDLE mFenceEvent;
+    HANDLE mFrameLatencyWaitable{ nullptr };
 
-    std::vector<std::unique_ptr<Model>> mModels;
+    struct PresentedFrame
+    {
+        UINT presentCount;
+        uint64_t frameId;
+    };
+
+    std::unique_ptr<FramePacer> mFramePacer;
+    // pacer frame id recorded in each frame in flight slot, 0 once reported
+    uint64_t mFrameIds[MaxFrameCount]{};
+    PresentedFrame mPresentedFrames[16]{};
+    ComPtr<ID3D12QueryHeap> mTimestampQueryHeap;
+    ComPtr<ID3D12Resource> mTimestampReadback;
+    LARGE_INTEGER mQPCFrequency{};
+    UINT64 mGPUTimestampFrequency{ 0 };
+    UINT64 mGPUCalibrationTimestamp{ 0 };
+    double mCPUCalibrationMs{ 0. };
+
+    MeshRegistry mMeshRegistry;
+    // declared before the models, they release their nodes when destroyed
+    SceneGraph mSceneGraph;
+    SceneGraphStats mSceneGraphStats;
+    ModelStore mModels{ mSceneGraph };
+    std::unique_ptr<PipelineCache> mPipelineCache;
     std::unique_ptr<SimpleShader> mSimpleShader;
     std::unique_ptr<ShadowMap> mShadowMap;
+    std::unique_ptr<D3D12RenderGraph> mRenderGraph;
+
+    std::unique_ptr<JobSystem> mJobSystem;
+    std::unique_ptr<UploadManager> mUploadManager;
+    std::unique_ptr<ResourceDeletionQueue> mDeletionQueue;
+
+    Bvh mSceneBvh;
+    float mSceneBvhBuildCost{ 0.f };
+    BvhStats mBvhStats;
+    MaskedOcclusionBuffer mOcclusionBuffer;
+    LightClusters mLightClusters;
+    // the lights in their shader layout, and their world space bounding spheres
+    std::vector<LightData> mLights;
+    std::vector<LightClusters::Light> mLightBounds;
+    std::vector<LightClusters::Light> mViewLights;
+    LightStats mLightStats;
+    LodSelector mLodSelector{ makeLodConfig() };
+    LodStats mLodStats;
+    // screen size estimate and index of the models that may occlude others this frame
+    std::vector<std::pair<float, uint32_t>> mOccluders;
+    OcclusionStats mOcclusionStats;
+    // visibility of each model per draw list, culled in the BVH. Shadow visibility is culled against the caster
+    // volume of the cascade, not just its light frustum.
+    std::vector<uint8_t> mVisible[DrawListCount];
+    std::vector<DrawPacket> mDrawPackets[DrawListCount];
+    std::vector<DrawPacket> mDrawPacketScratch[DrawListCount];
+    std::vector<IndirectDrawBatch> mShadowBatches[ShadowMap::CascadeCount];
+    std::vector<IndirectDrawBatch> mStaticShadowBatches[ShadowMap::CascadeCount];
+    std::vector<IndirectDrawBatch> mMainBatches;
+    std::vector<IndirectDrawCommand> mIndirectTemplates;
+    ComPtr<ID3D12CommandSignature> mCommandSignatures[PassCount];
+    PassStats mPassStats[2];
+    FrameTimeHistogram mFrameTimes;
+    uint32_t mStatsFrameCount{ 0 };
 
     bool mIsInitialized{ false };
 };
@@ -0,0 +1,105 @@
+#include "DrawSort.h"
+
+#include <cstring>
+#include <utility>
+
+namespace HDX
+{
+
+void radixSortDrawPackets(DrawPacket* packets, DrawPacket* scratch, size_t count)
+{
+    static const uint32_t DigitBits{ 8 };
+    static const uint32_t DigitCount{ 1 << DigitBits };
+    static const uint32_t PassCount{ 64 / DigitBits };
+
+    if (count < 2)
+    {
+        return;
+    }
+
+    // one read over the keys builds the histograms of every pass
+    uint32_t histograms[PassCount][DigitCount];
+    memset(histograms, 0, sizeof(histograms));
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t key = packets[i].key;
+        for (uint32_t pass = 0; pass < PassCount; pass++)
+        {
+            histograms[pass][(key >> (pass * DigitBits)) & (DigitCount - 1)]++;
+        }
+    }
+
+    DrawPacket* src = packets;
+    DrawPacket* dst = scratch;
+    for (uint32_t pass = 0; pass < PassCount; pass++)
+    {
+        uint32_t* histogram = histograms[pass];
+        uint32_t shift = pass * DigitBits;
+
+        if (histogram[(src[0].key >> shift) & (DigitCount - 1)] == count)
+        {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < DigitCount; digit++)
+        {
+            uint32_t digitCount = histogram[digit];
+            histogram[digit] = offset;
+            offset += digitCount;
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            dst[histogram[(src[i].key >> shift) & (DigitCount - 1)]++] = src[i];
+        }
+
+        std::swap(src, dst);
+    }
+
+    if (src != packets)
+    {
+        memcpy(packets, src, count * sizeof(DrawPacket));
+    }
+}
+
+StateChangeStats countStateChanges(const DrawPacket* packets, size_t count)
+{
+    StateChangeStats stats;
+    stats.draws = static_cast<uint32_t>(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t key = packets[i].key;
+        if (i == 0)
+        {
+            stats.rootSignatureChanges++;
+            stats.pipelineChanges++;
+            stats.materialChanges++;
+            stats.meshChanges++;
+            continue;
+        }
+
+        uint64_t prevKey = packets[i - 1].key;
+        auto countField = [&](uint32_t(*getter)(uint64_t), uint32_t& changes)
+        {
+            if (getter(key) != getter(prevKey))
+            {
+                changes++;
+            }
+            else
+            {
+                stats.redundantBinds++;
+            }
+        };
+
+        countField(&DrawSortKey::getRootSignature, stats.rootSignatureChanges);
+        countField(&DrawSortKey::getPipeline, stats.pipelineChanges);
+        countField(&DrawSortKey::getMaterial, stats.materialChanges);
+        countField(&DrawSortKey::getMesh, stats.meshChanges);
+    }
+
+    return stats;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,189 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace HDX
+{
+
+namespace
+{
+
+const double SmoothingFactor{ 0.1 };
+const double RefreshDriftFactor{ 0.01 };
+// mean absolute deviations of the CPU and GPU times budgeted on top of their averages
+const double DeviationFactor{ 2.0 };
+// spacing below this is a timing glitch, not a refresh interval
+const double MinRefreshMs{ 2.0 };
+// frames older than this are forgotten even if they were never reported displayed
+const size_t MaxTrackedFrames{ 16 };
+
+double smooth(double average, double sample)
+{
+    return average == 0. ? sample : average + (sample - average) * SmoothingFactor;
+}
+
+// the deviation starts at 0 with the first sample, unlike the averages it is 0 in steady state
+void smoothWithDeviation(double& average, double& deviation, double sample)
+{
+    if (average != 0.)
+    {
+        deviation += (std::fabs(sample - average) - deviation) * SmoothingFactor;
+    }
+    average = smooth(average, sample);
+}
+
+}
+
+FramePacer::FramePacer(const FramePacerConfig& config)
+    : mFramesInFlight(config.framesInFlight < 1 ? 1 : (config.framesInFlight > MaxFramesInFlight ? MaxFramesInFlight : config.framesInFlight))
+    , mMode(config.mode)
+    , mBaseMarginMs(config.safetyMarginMs)
+    , mMarginMs(config.safetyMarginMs)
+    , mLatency(1.)
+{
+}
+
+void FramePacer::onInput(double timeMs)
+{
+    if (mPendingInputMs < 0.)
+    {
+        mPendingInputMs = timeMs;
+    }
+}
+
+double FramePacer::getStartDeadline() const
+{
+    if (mMode != PacingMode::Waitable || mLastDisplayedId == 0 || mRefreshMs == 0.)
+    {
+        return 0.;
+    }
+
+    return predictDisplay(mNextFrameId) - getPredictedFrameMs() - mMarginMs;
+}
+
+uint64_t FramePacer::beginFrame(double timeMs)
+{
+    FrameRecord frame{};
+    frame.id = mNextFrameId++;
+    frame.inputMs = mPendingInputMs;
+    frame.beginMs = timeMs;
+    frame.endMs = -1.;
+    frame.predictedDisplayMs = mLastDisplayedId == 0 || mRefreshMs == 0. ? -1. : predictDisplay(frame.id);
+    mPendingInputMs = -1.;
+
+    mFrames.push_back(frame);
+    if (mFrames.size() > MaxTrackedFrames)
+    {
+        mFrames.pop_front();
+    }
+
+    return frame.id;
+}
+
+void FramePacer::endFrame(uint64_t frameId, double timeMs)
+{
+    FrameRecord* frame = findFrame(frameId);
+    if (frame == nullptr)
+    {
+        return;
+    }
+
+    frame->endMs = timeMs;
+    smoothWithDeviation(mCpuMs, mCpuDeviationMs, timeMs - frame->beginMs);
+}
+
+void FramePacer::onFrameGpuCompleted(uint64_t frameId, double timeMs)
+{
+    FrameRecord* frame = findFrame(frameId);
+    if (frame == nullptr || frame->endMs < 0.)
+    {
+        return;
+    }
+
+    smoothWithDeviation(mGpuMs, mGpuDeviationMs, std::max(timeMs - frame->endMs, 0.));
+}
+
+void FramePacer::onFrameDisplayed(uint64_t frameId, double timeMs)
+{
+    if (frameId <= mLastDisplayedId)
+    {
+        return;
+    }
+
+    if (mLastDisplayedId + 1 == frameId && timeMs - mLastDisplayMs > MinRefreshMs)
+    {
+        // consecutive frames are at least one refresh apart, drift up slowly in case the refresh rate dropped
+        double interval = timeMs - mLastDisplayMs;
+        if (mRefreshMs == 0. || interval < mRefreshMs)
+        {
+            mRefreshMs = interval;
+        }
+        else if (interval < mRefreshMs * 1.5)
+        {
+            mRefreshMs += (interval - mRefreshMs) * RefreshDriftFactor;
+        }
+    }
+
+    mLastDisplayedId = frameId;
+    mLastDisplayMs = timeMs;
+
+    FrameRecord* frame = findFrame(frameId);
+    if (frame != nullptr)
+    {
+        if (frame->inputMs >= 0.)
+        {
+            mLatency.add(timeMs - frame->inputMs);
+        }
+
+        if (frame->predictedDisplayMs >= 0.)
+        {
+            if (timeMs > frame->predictedDisplayMs + mRefreshMs * 0.5)
+            {
+                mMissedDeadlines++;
+                mMarginMs = std::min(mMarginMs + 0.5, mRefreshMs);
+            }
+            else
+            {
+                mMarginMs = std::max(mMarginMs - 0.05, mBaseMarginMs);
+            }
+        }
+    }
+
+    while (!mFrames.empty() && mFrames.front().id <= frameId)
+    {
+        mFrames.pop_front();
+    }
+}
+
+void FramePacer::resetStats()
+{
+    mLatency.reset();
+    mMissedDeadlines = 0;
+}
+
+FramePacer::FrameRecord* FramePacer::findFrame(uint64_t frameId)
+{
+    for (FrameRecord& frame : mFrames)
+    {
+        if (frame.id == frameId)
+        {
+            return &frame;
+        }
+    }
+
+    return nullptr;
+}
+
+double FramePacer::getPredictedFrameMs() const
+{
+    return mCpuMs + mGpuMs + (mCpuDeviationMs + mGpuDeviationMs) * DeviationFactor;
+}
+
+double FramePacer::predictDisplay(uint64_t frameId) const
+{
+    // every frame queued ahead of it takes at least one refresh
+    return mLastDisplayMs + mRefreshMs * static_cast<double>(frameId - mLastDisplayedId);
+}
+
+}
\ No newline at end of file
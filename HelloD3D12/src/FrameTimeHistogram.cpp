@@ -0,0 +1,98 @@
+#include "FrameTimeHistogram.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace HDX
+{
+
+FrameTimeHistogram::FrameTimeHistogram(double bucketWidthMs)
+    : mBucketWidthMs(bucketWidthMs)
+{
+    reset();
+}
+
+void FrameTimeHistogram::add(double ms)
+{
+    // negative and NaN samples count as 0, huge ones are clamped to the overflow bucket before the cast
+    ms = ms > 0. ? ms : 0.;
+    const double position = ms / mBucketWidthMs;
+    const uint32_t bucket = position < BucketCount ? static_cast<uint32_t>(position) : BucketCount;
+    mBuckets[bucket]++;
+    mCount++;
+    mTotalMs += ms;
+    mMaxMs = ms > mMaxMs ? ms : mMaxMs;
+}
+
+void FrameTimeHistogram::reset()
+{
+    memset(mBuckets, 0, sizeof(mBuckets));
+    mCount = 0;
+    mTotalMs = 0.;
+    mMaxMs = 0.;
+}
+
+double FrameTimeHistogram::getPercentile(double percentile) const
+{
+    if (mCount == 0)
+    {
+        return 0.;
+    }
+
+    // rank of the sample at the percentile, 1 based
+    uint32_t rank = static_cast<uint32_t>(percentile / 100. * (mCount - 1)) + 1;
+    uint32_t seen = 0;
+    for (uint32_t i = 0; i < BucketCount; i++)
+    {
+        seen += mBuckets[i];
+        if (seen >= rank)
+        {
+            return (i + 1) * mBucketWidthMs;
+        }
+    }
+
+    return mMaxMs;
+}
+
+std::string FrameTimeHistogram::toString() const
+{
+    static const uint32_t BarWidth{ 40 };
+
+    char line[128];
+    snprintf(line, sizeof(line), "frames %u, mean %.3f ms, p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.3f ms\n",
+        mCount, getMean(), getPercentile(50.), getPercentile(90.), getPercentile(99.), mMaxMs);
+    std::string result = line;
+
+    uint32_t largest = 0;
+    for (uint32_t count : mBuckets)
+    {
+        largest = count > largest ? count : largest;
+    }
+
+    for (uint32_t i = 0; i <= BucketCount; i++)
+    {
+        if (mBuckets[i] == 0)
+        {
+            continue;
+        }
+
+        char bar[BarWidth + 1];
+        uint32_t barLength = (mBuckets[i] * BarWidth + largest - 1) / largest;
+        memset(bar, '#', barLength);
+        bar[barLength] = '\0';
+
+        if (i < BucketCount)
+        {
+            snprintf(line, sizeof(line), "%6.2f - %6.2f ms %6u %s\n", i * mBucketWidthMs, (i + 1) * mBucketWidthMs, mBuckets[i], bar);
+        }
+        else
+        {
+            snprintf(line, sizeof(line), "%6.2f +        ms %6u %s\n", i * mBucketWidthMs, mBuckets[i], bar);
+        }
+        result += line;
+    }
+
+    return result;
+}
+
+}
\ No newline at end of file
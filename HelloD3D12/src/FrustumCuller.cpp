@@ -0,0 +1,176 @@
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#else
+#include <xmmintrin.h>
+#endif
+
+namespace HDX
+{
+
+void FrustumCuller::resize(uint32_t count)
+{
+    mCount = count;
+    // padding to the widest vector, whatever this build uses
+    const size_t paddedCount = (static_cast<size_t>(count) + 7) & ~static_cast<size_t>(7);
+    std::vector<float>* components[] = { &mCenterX, &mCenterY, &mCenterZ, &mExtentX, &mExtentY, &mExtentZ, &mRadius };
+    for (std::vector<float>* component : components)
+    {
+        component->resize(paddedCount, 0.f);
+    }
+}
+
+void FrustumCuller::setBounds(uint32_t index, const Bounds& bounds)
+{
+    mCenterX[index] = bounds.center.x;
+    mCenterY[index] = bounds.center.y;
+    mCenterZ[index] = bounds.center.z;
+    mExtentX[index] = bounds.extents.x;
+    mExtentY[index] = bounds.extents.y;
+    mExtentZ[index] = bounds.extents.z;
+    mRadius[index] = bounds.radius;
+}
+
+// visible flags of 4 objects as the bytes of a little endian uint32, indexed by 4 bits of the lane mask
+static const uint32_t MaskToBytes[16]
+{
+    0x00000000, 0x00000001, 0x00000100, 0x00000101, 0x00010000, 0x00010001, 0x00010100, 0x00010101,
+    0x01000000, 0x01000001, 0x01000100, 0x01000101, 0x01010000, 0x01010001, 0x01010100, 0x01010101,
+};
+
+static const uint8_t MaskBitCount[16]{ 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+uint32_t FrustumCuller::cull(const Plane* planes, uint32_t planeCount, uint32_t begin, uint32_t end, uint8_t* visible) const
+{
+    assert(planeCount <= MaxPlanes);
+    end = std::min(end, mCount);
+    if (begin >= end)
+    {
+        return 0;
+    }
+
+#ifdef __AVX__
+    typedef __m256 Vector;
+#define SIMD_SET1 _mm256_set1_ps
+#define SIMD_LOAD _mm256_loadu_ps
+#define SIMD_ADD _mm256_add_ps
+#define SIMD_MUL _mm256_mul_ps
+#define SIMD_MIN _mm256_min_ps
+#define SIMD_AND _mm256_and_ps
+#define SIMD_CMPGE(a, b) _mm256_cmp_ps(a, b, _CMP_GE_OQ)
+#define SIMD_MOVEMASK _mm256_movemask_ps
+#else
+    typedef __m128 Vector;
+#define SIMD_SET1 _mm_set1_ps
+#define SIMD_LOAD _mm_loadu_ps
+#define SIMD_ADD _mm_add_ps
+#define SIMD_MUL _mm_mul_ps
+#define SIMD_MIN _mm_min_ps
+#define SIMD_AND _mm_and_ps
+#define SIMD_CMPGE _mm_cmpge_ps
+#define SIMD_MOVEMASK _mm_movemask_ps
+#endif
+
+    // plane components broadcast once, absolute normals for the box radius
+    Vector nx[MaxPlanes];
+    Vector ny[MaxPlanes];
+    Vector nz[MaxPlanes];
+    Vector nd[MaxPlanes];
+    Vector ax[MaxPlanes];
+    Vector ay[MaxPlanes];
+    Vector az[MaxPlanes];
+    for (uint32_t side = 0; side < planeCount; side++)
+    {
+        const Plane& plane = planes[side];
+        nx[side] = SIMD_SET1(plane.normal.x);
+        ny[side] = SIMD_SET1(plane.normal.y);
+        nz[side] = SIMD_SET1(plane.normal.z);
+        nd[side] = SIMD_SET1(plane.distance);
+        ax[side] = SIMD_SET1(std::fabs(plane.normal.x));
+        ay[side] = SIMD_SET1(std::fabs(plane.normal.y));
+        az[side] = SIMD_SET1(std::fabs(plane.normal.z));
+    }
+    const Vector zero = SIMD_SET1(0.f);
+
+    uint32_t visibleCount = 0;
+    // blocks start at multiples of the width, lanes outside [begin, end) are computed but not written
+    for (uint32_t block = begin & ~(SimdWidth - 1); block < end; block += SimdWidth)
+    {
+        const Vector cx = SIMD_LOAD(&mCenterX[block]);
+        const Vector cy = SIMD_LOAD(&mCenterY[block]);
+        const Vector cz = SIMD_LOAD(&mCenterZ[block]);
+        const Vector ex = SIMD_LOAD(&mExtentX[block]);
+        const Vector ey = SIMD_LOAD(&mExtentY[block]);
+        const Vector ez = SIMD_LOAD(&mExtentZ[block]);
+        const Vector radius = SIMD_LOAD(&mRadius[block]);
+
+        Vector inside = SIMD_CMPGE(radius, radius);
+        for (uint32_t side = 0; side < planeCount; side++)
+        {
+            Vector distance = SIMD_ADD(SIMD_ADD(SIMD_MUL(cx, nx[side]), SIMD_MUL(cy, ny[side])), SIMD_ADD(SIMD_MUL(cz, nz[side]), nd[side]));
+            Vector boxRadius = SIMD_ADD(SIMD_ADD(SIMD_MUL(ex, ax[side]), SIMD_MUL(ey, ay[side])), SIMD_MUL(ez, az[side]));
+            inside = SIMD_AND(inside, SIMD_CMPGE(SIMD_ADD(distance, SIMD_MIN(boxRadius, radius)), zero));
+        }
+        const uint32_t mask = static_cast<uint32_t>(SIMD_MOVEMASK(inside));
+
+        if (block >= begin && block + SimdWidth <= end)
+        {
+            for (uint32_t lane = 0; lane < SimdWidth; lane += 4)
+            {
+                const uint32_t bits = (mask >> lane) & 0xf;
+                memcpy(visible + block + lane, &MaskToBytes[bits], 4);
+                visibleCount += MaskBitCount[bits];
+            }
+            continue;
+        }
+
+        const uint32_t first = std::max(block, begin);
+        const uint32_t last = std::min(block + SimdWidth, end);
+        for (uint32_t i = first; i < last; i++)
+        {
+            const uint8_t isVisible = static_cast<uint8_t>((mask >> (i - block)) & 1);
+            visible[i] = isVisible;
+            visibleCount += isVisible;
+        }
+    }
+
+#undef SIMD_SET1
+#undef SIMD_LOAD
+#undef SIMD_ADD
+#undef SIMD_MUL
+#undef SIMD_MIN
+#undef SIMD_AND
+#undef SIMD_CMPGE
+#undef SIMD_MOVEMASK
+
+    return visibleCount;
+}
+
+uint32_t FrustumCuller::cullScalar(const Plane* planes, uint32_t planeCount, uint32_t begin, uint32_t end, uint8_t* visible) const
+{
+    assert(planeCount <= MaxPlanes);
+    end = std::min(end, mCount);
+    uint32_t visibleCount = 0;
+    for (uint32_t i = begin; i < end; i++)
+    {
+        bool inside = true;
+        for (uint32_t side = 0; side < planeCount; side++)
+        {
+            const Plane& plane = planes[side];
+            float distance = mCenterX[i] * plane.normal.x + mCenterY[i] * plane.normal.y + (mCenterZ[i] * plane.normal.z + plane.distance);
+            float boxRadius = mExtentX[i] * std::fabs(plane.normal.x) + mExtentY[i] * std::fabs(plane.normal.y) + mExtentZ[i] * std::fabs(plane.normal.z);
+            inside = inside && distance + std::min(boxRadius, mRadius[i]) >= 0.f;
+        }
+        visible[i] = inside ? 1 : 0;
+        visibleCount += inside ? 1 : 0;
+    }
+    return visibleCount;
+}
+
+}
\ No newline at end of file
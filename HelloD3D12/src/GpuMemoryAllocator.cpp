@@ -0,0 +1,341 @@
+#include "stdafx.h"
+
+#include <assert.h>
+#include "GpuMemoryAllocator.h"
+
+namespace HDX
+{
+
+GpuAllocation::GpuAllocation(GpuAllocation&& other)
+{
+    *this = std::move(other);
+}
+
+GpuAllocation& GpuAllocation::operator=(GpuAllocation&& other)
+{
+    if (this != &other)
+    {
+        reset();
+        mResource = std::move(other.mResource);
+        mAllocator = other.mAllocator;
+        mOffset = other.mOffset;
+        mSize = other.mSize;
+        mPool = other.mPool;
+        mBlock = other.mBlock;
+        mHandle = other.mHandle;
+        other.mAllocator = nullptr;
+        other.mHandle = TLSFAllocator::InvalidHandle;
+    }
+    return *this;
+}
+
+GpuAllocation::~GpuAllocation()
+{
+    reset();
+}
+
+void GpuAllocation::reset()
+{
+    if (mAllocator)
+    {
+        mAllocator->free(*this);
+        mAllocator = nullptr;
+    }
+    mResource.Reset();
+    mOffset = 0;
+    mSize = 0;
+    mHandle = TLSFAllocator::InvalidHandle;
+}
+
+GpuMemoryAllocator::~GpuMemoryAllocator()
+{
+    for (auto const& pool : mPools)
+    {
+        for (auto const& block : pool.blocks)
+        {
+            if (!block->allocator.isEmpty())
+            {
+                LOG_ERROR("GPU memory block destroyed with %u live allocations\n", block->allocator.getAllocationCount());
+            }
+        }
+    }
+}
+
+bool GpuMemoryAllocator::prepare(ID3D12Device* device)
+{
+    mDevice = device;
+
+    mPools[PoolBuffers].heapFlags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+    mPools[PoolBuffers].blockSize = HeapBlockSize;
+    mPools[PoolTextures].heapFlags = D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+    mPools[PoolTextures].blockSize = HeapBlockSize;
+    mPools[PoolRenderTargets].heapFlags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+    mPools[PoolRenderTargets].blockSize = HeapBlockSize;
+    mPools[PoolSmallBuffers].heapFlags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+    mPools[PoolSmallBuffers].blockSize = SmallBufferBlockSize;
+
+    return true;
+}
+
+bool GpuMemoryAllocator::createBuffer(UINT64 size, GpuAllocation& allocation)
+{
+    allocation.reset();
+
+    if (size <= SmallBufferSize)
+    {
+        uint32_t block;
+        TLSFAllocator::Allocation range;
+        if (!allocateRange(PoolSmallBuffers, size, SmallBufferAlignment, block, range))
+        {
+            return false;
+        }
+
+        allocation.mResource = mPools[PoolSmallBuffers].blocks[block]->buffer;
+        allocation.mAllocator = this;
+        allocation.mOffset = range.offset;
+        allocation.mSize = size;
+        allocation.mPool = PoolSmallBuffers;
+        allocation.mBlock = block;
+        allocation.mHandle = range.handle;
+        return true;
+    }
+
+    return createResource(CD3DX12_RESOURCE_DESC::Buffer(size), D3D12_RESOURCE_STATE_COMMON, nullptr, allocation);
+}
+
+bool GpuMemoryAllocator::createResource(
+    const D3D12_RESOURCE_DESC& desc,
+    D3D12_RESOURCE_STATES initialState,
+    const D3D12_CLEAR_VALUE* clearValue,
+    GpuAllocation& allocation
+)
+{
+    allocation.reset();
+
+    uint32_t pool = PoolTextures;
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    {
+        pool = PoolBuffers;
+    }
+    else if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+    {
+        pool = PoolRenderTargets;
+    }
+
+    // small textures may be placed at 4KB, the runtime reports the default alignment when they cannot
+    D3D12_RESOURCE_DESC placedDesc = desc;
+    D3D12_RESOURCE_ALLOCATION_INFO info{};
+    if (pool == PoolTextures && placedDesc.Alignment == 0)
+    {
+        placedDesc.Alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+        info = mDevice->GetResourceAllocationInfo(0, 1, &placedDesc);
+        if (info.Alignment != D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT)
+        {
+            placedDesc.Alignment = 0;
+            info = mDevice->GetResourceAllocationInfo(0, 1, &placedDesc);
+        }
+    }
+    else
+    {
+        info = mDevice->GetResourceAllocationInfo(0, 1, &placedDesc);
+    }
+
+    if (info.SizeInBytes == UINT64_MAX)
+    {
+        LOG_ERROR("Invalid resource description\n");
+        return false;
+    }
+
+    // heaps are created with the default 64KB alignment, MSAA resources and anything larger than half a block get their own heap
+    if (info.Alignment > D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT || info.SizeInBytes > mPools[pool].blockSize / 2)
+    {
+        return createCommitted(desc, initialState, clearValue, info.SizeInBytes, allocation);
+    }
+
+    uint32_t block;
+    TLSFAllocator::Allocation range;
+    if (!allocateRange(pool, info.SizeInBytes, info.Alignment, block, range))
+    {
+        return false;
+    }
+
+    ComPtr<ID3D12Resource> resource;
+    HRESULT hr = mDevice->CreatePlacedResource(
+        mPools[pool].blocks[block]->heap.Get(),
+        range.offset,
+        &placedDesc,
+        initialState,
+        clearValue,
+        IID_PPV_ARGS(&resource));
+    if (FAILED(hr))
+    {
+        LOG_ERROR("Failed to create placed resource (0x%08x)\n", static_cast<uint32_t>(hr));
+        mPools[pool].blocks[block]->allocator.free(range.handle);
+        return false;
+    }
+
+    allocation.mResource = std::move(resource);
+    allocation.mAllocator = this;
+    allocation.mOffset = 0;
+    allocation.mSize = info.SizeInBytes;
+    allocation.mPool = pool;
+    allocation.mBlock = block;
+    allocation.mHandle = range.handle;
+    return true;
+}
+
+GpuMemoryAllocator::Stats GpuMemoryAllocator::getStats() const
+{
+    Stats stats;
+    for (uint32_t pool = 0; pool < PoolCount; pool++)
+    {
+        for (auto const& block : mPools[pool].blocks)
+        {
+            stats.heapCount++;
+            stats.heapBytes += block->allocator.getCapacity();
+            stats.usedBytes += block->allocator.getUsed();
+            if (pool == PoolSmallBuffers)
+            {
+                stats.smallBuffers += block->allocator.getAllocationCount();
+            }
+            else
+            {
+                stats.placedResources += block->allocator.getAllocationCount();
+            }
+
+            float fragmentation = block->allocator.getFragmentation();
+            stats.fragmentation = fragmentation > stats.fragmentation ? fragmentation : stats.fragmentation;
+        }
+    }
+    stats.committedResources = mCommittedResources;
+    stats.committedBytes = mCommittedBytes;
+    return stats;
+}
+
+std::string GpuMemoryAllocator::getReport() const
+{
+    static const char* PoolNames[PoolCount] = { "buffers", "textures", "render targets", "small buffers" };
+
+    std::string report;
+    char line[256];
+    for (uint32_t pool = 0; pool < PoolCount; pool++)
+    {
+        for (size_t i = 0; i < mPools[pool].blocks.size(); i++)
+        {
+            const TLSFAllocator& allocator = mPools[pool].blocks[i]->allocator;
+            snprintf(line, sizeof(line), "  %s #%zu: %.2f / %.2f MB, %u allocations, %u free blocks, fragmentation %.2f\n",
+                PoolNames[pool],
+                i,
+                allocator.getUsed() / (1024. * 1024.),
+                allocator.getCapacity() / (1024. * 1024.),
+                allocator.getAllocationCount(),
+                allocator.getFreeBlockCount(),
+                allocator.getFragmentation());
+            report += line;
+        }
+    }
+
+    if (mCommittedResources > 0)
+    {
+        snprintf(line, sizeof(line), "  committed: %u resources, %.2f MB\n", mCommittedResources, mCommittedBytes / (1024. * 1024.));
+        report += line;
+    }
+    return report;
+}
+
+bool GpuMemoryAllocator::allocateRange(uint32_t pool, UINT64 size, UINT64 alignment, uint32_t &block, TLSFAllocator::Allocation &range)
+{
+    auto& blocks = mPools[pool].blocks;
+    for (block = 0; block < blocks.size(); block++)
+    {
+        if (blocks[block]->allocator.allocate(size, alignment, range))
+        {
+            return true;
+        }
+    }
+
+    if (!createBlock(pool))
+    {
+        return false;
+    }
+
+    block = static_cast<uint32_t>(blocks.size() - 1);
+    if (!blocks[block]->allocator.allocate(size, alignment, range))
+    {
+        LOG_ERROR("Allocation of %llu bytes does not fit an empty heap block\n", size);
+        return false;
+    }
+    return true;
+}
+
+bool GpuMemoryAllocator::createBlock(uint32_t pool)
+{
+    Pool& target = mPools[pool];
+    auto block = std::make_unique<Block>(target.blockSize);
+
+    CD3DX12_HEAP_DESC heapDesc(target.blockSize, D3D12_HEAP_TYPE_DEFAULT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT, target.heapFlags);
+    HR_ERROR_CHECK_CALL(mDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(&block->heap)), false, "Failed to create %llu byte heap\n", target.blockSize);
+
+    if (pool == PoolSmallBuffers)
+    {
+        HR_ERROR_CHECK_CALL(mDevice->CreatePlacedResource(
+            block->heap.Get(),
+            0,
+            &CD3DX12_RESOURCE_DESC::Buffer(target.blockSize),
+            D3D12_RESOURCE_STATE_COMMON,
+            nullptr,
+            IID_PPV_ARGS(&block->buffer)), false, "Failed to create shared buffer\n");
+    }
+
+    target.blocks.push_back(std::move(block));
+    return true;
+}
+
+bool GpuMemoryAllocator::createCommitted(
+    const D3D12_RESOURCE_DESC& desc,
+    D3D12_RESOURCE_STATES initialState,
+    const D3D12_CLEAR_VALUE* clearValue,
+    UINT64 size,
+    GpuAllocation& allocation
+)
+{
+    HR_ERROR_CHECK_CALL(mDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &desc,
+        initialState,
+        clearValue,
+        IID_PPV_ARGS(&allocation.mResource)), false, "Failed to create committed resource\n");
+
+    allocation.mAllocator = this;
+    allocation.mOffset = 0;
+    allocation.mSize = size;
+    allocation.mBlock = CommittedBlock;
+    mCommittedResources++;
+    mCommittedBytes += size;
+    return true;
+}
+
+void GpuMemoryAllocator::free(GpuAllocation& allocation)
+{
+    if (allocation.mBlock == CommittedBlock)
+    {
+        mCommittedResources--;
+        mCommittedBytes -= allocation.mSize;
+        return;
+    }
+
+    // placed resources must go before their heap range is reused
+    allocation.mResource.Reset();
+
+    auto& blocks = mPools[allocation.mPool].blocks;
+    blocks[allocation.mBlock]->allocator.free(allocation.mHandle);
+
+    // keep the first block of each pool around, empty blocks at the end are given back
+    while (blocks.size() > 1 && blocks.back()->allocator.isEmpty())
+    {
+        blocks.pop_back();
+    }
+}
+
+}
\ No newline at end of file
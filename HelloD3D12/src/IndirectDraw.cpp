@@ -0,0 +1,63 @@
+#include "IndirectDraw.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define HDX_INDIRECT_DRAW_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace HDX
+{
+
+void packIndirectDrawCommandsScalar(const IndirectDrawCommand* templates, const IndirectDrawBatch* batches, size_t count, IndirectDrawCommand* commands)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const IndirectDrawBatch& batch = batches[i];
+        IndirectDrawCommand command = templates[batch.templateIndex];
+        command.instanceBase = batch.firstInstance;
+        command.instanceCount = batch.instanceCount;
+        commands[i] = command;
+    }
+}
+
+#ifdef HDX_INDIRECT_DRAW_SSE2
+
+void packIndirectDrawCommands(const IndirectDrawCommand* templates, const IndirectDrawBatch* batches, size_t count, IndirectDrawCommand* commands)
+{
+    // the command is 4 vectors, instanceBase is lane 0 of the first one, instanceCount lane 3 of the third one
+    const __m128i instanceBaseMask = _mm_set_epi32(0, 0, 0, -1);
+    const __m128i instanceCountMask = _mm_set_epi32(-1, 0, 0, 0);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        __m128i batch = _mm_loadu_si128(reinterpret_cast<const __m128i*>(batches + i));
+        const __m128i* src = reinterpret_cast<const __m128i*>(templates + batches[i].templateIndex);
+        __m128i* dst = reinterpret_cast<__m128i*>(commands + i);
+
+        // firstInstance (lane 1) to lane 0, instanceCount (lane 2) to lane 3
+        __m128i instanceBase = _mm_shuffle_epi32(batch, _MM_SHUFFLE(1, 1, 1, 1));
+        __m128i instanceCount = _mm_shuffle_epi32(batch, _MM_SHUFFLE(2, 2, 2, 2));
+
+        __m128i v0 = _mm_or_si128(_mm_andnot_si128(instanceBaseMask, _mm_loadu_si128(src + 0)), _mm_and_si128(instanceBaseMask, instanceBase));
+        __m128i v2 = _mm_or_si128(_mm_andnot_si128(instanceCountMask, _mm_loadu_si128(src + 2)), _mm_and_si128(instanceCountMask, instanceCount));
+
+        _mm_stream_si128(dst + 0, v0);
+        _mm_stream_si128(dst + 1, _mm_loadu_si128(src + 1));
+        _mm_stream_si128(dst + 2, v2);
+        _mm_stream_si128(dst + 3, _mm_loadu_si128(src + 3));
+    }
+
+    // make the streamed commands visible before the command list referencing them is submitted
+    _mm_sfence();
+}
+
+#else
+
+void packIndirectDrawCommands(const IndirectDrawCommand* templates, const IndirectDrawBatch* batches, size_t count, IndirectDrawCommand* commands)
+{
+    packIndirectDrawCommandsScalar(templates, batches, count, commands);
+}
+
+#endif
+
+}
\ No newline at end of file
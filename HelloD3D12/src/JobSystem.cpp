@@ -0,0 +1,361 @@
+#include "JobSystem.h"
+
+#include <cassert>
+
+namespace HDX
+{
+
+static thread_local const JobSystem* tJobSystem{ nullptr };
+static thread_local uint32_t tWorkerIndex{ 0 };
+
+WorkStealingQueue::WorkStealingQueue(uint32_t capacity)
+    : mJobs(new std::atomic<Job*>[capacity])
+    , mMask(static_cast<int64_t>(capacity) - 1)
+{
+    assert((capacity & (capacity - 1)) == 0);
+}
+
+bool WorkStealingQueue::push(Job* job)
+{
+    int64_t bottom = mBottom.load(std::memory_order_relaxed);
+    int64_t top = mTop.load(std::memory_order_acquire);
+    if (bottom - top > mMask)
+    {
+        return false;
+    }
+
+    mJobs[bottom & mMask].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    mBottom.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+}
+
+Job* WorkStealingQueue::pop()
+{
+    int64_t bottom = mBottom.load(std::memory_order_relaxed) - 1;
+    mBottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = mTop.load(std::memory_order_relaxed);
+
+    if (top > bottom)
+    {
+        mBottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = mJobs[bottom & mMask].load(std::memory_order_relaxed);
+    if (top == bottom)
+    {
+        // last element, race against stealers
+        if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            job = nullptr;
+        }
+        mBottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    return job;
+}
+
+Job* WorkStealingQueue::steal()
+{
+    int64_t top = mTop.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = mBottom.load(std::memory_order_acquire);
+
+    if (top >= bottom)
+    {
+        return nullptr;
+    }
+
+    Job* job = mJobs[top & mMask].load(std::memory_order_relaxed);
+    if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+    {
+        return nullptr;
+    }
+
+    return job;
+}
+
+JobSystem::JobSystem(uint32_t workerCount)
+{
+    if (workerCount == 0)
+    {
+        workerCount = std::thread::hardware_concurrency();
+        if (workerCount == 0)
+        {
+            workerCount = 1;
+        }
+    }
+
+    assert(tJobSystem == nullptr);
+    tJobSystem = this;
+    tWorkerIndex = 0;
+
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        mWorkers.push_back(std::make_unique<Worker>());
+        mWorkers.back()->mRandom = 0x9E3779B9u * (i + 1);
+    }
+
+    // worker 0 is the thread owning the job system, it only runs jobs while waiting
+    for (uint32_t i = 1; i < workerCount; i++)
+    {
+        mWorkers[i]->mThread = std::thread(&JobSystem::workerMain, this, i);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(mWakeMutex);
+        mQuit.store(true);
+    }
+    mWakeCondition.notify_all();
+
+    for (auto& worker : mWorkers)
+    {
+        if (worker->mThread.joinable())
+        {
+            worker->mThread.join();
+        }
+    }
+
+    tJobSystem = nullptr;
+}
+
+void JobSystem::wait(const JobCounter& counter)
+{
+    uint32_t workerIndex = getCurrentWorkerIndex();
+    while (!counter.isDone())
+    {
+        if (!tryRunJob(workerIndex))
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+Job* JobSystem::allocateJob()
+{
+    uint32_t workerIndex = getCurrentWorkerIndex();
+    Worker& worker = *mWorkers[workerIndex];
+
+    for (;;)
+    {
+        Job* job = &worker.mJobs[worker.mNextJob++ & (JobsPerWorker - 1)];
+        if (job->mBusy.load(std::memory_order_acquire) == 0)
+        {
+            job->mBusy.store(1, std::memory_order_relaxed);
+            return job;
+        }
+
+        // every slot of the ring is still in flight, help draining it
+        if (!tryRunJob(workerIndex))
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::submit(Job* job)
+{
+    if (job->mDependency && park(job))
+    {
+        return;
+    }
+    enqueue(job);
+}
+
+void JobSystem::enqueue(Job* job)
+{
+    uint32_t workerIndex = getCurrentWorkerIndex();
+    if (!mWorkers[workerIndex]->mQueue.push(job))
+    {
+        // never run it inline, its dependency may not be done
+        pushOverflow(job);
+    }
+
+    mQueuedJobs.fetch_add(1);
+    if (mSleepingWorkers.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(mWakeMutex);
+        mWakeCondition.notify_one();
+    }
+}
+
+Job* JobSystem::findJob(uint32_t workerIndex)
+{
+    Worker& worker = *mWorkers[workerIndex];
+    Job* job = worker.mQueue.pop();
+    if (job)
+    {
+        return job;
+    }
+
+    uint32_t workerCount = static_cast<uint32_t>(mWorkers.size());
+    if (workerCount == 1)
+    {
+        return popOverflow();
+    }
+
+    // xorshift to pick a victim, then sweep the others
+    worker.mRandom ^= worker.mRandom << 13;
+    worker.mRandom ^= worker.mRandom >> 17;
+    worker.mRandom ^= worker.mRandom << 5;
+    uint32_t start = worker.mRandom % workerCount;
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        uint32_t victim = (start + i) % workerCount;
+        if (victim == workerIndex)
+        {
+            continue;
+        }
+
+        job = mWorkers[victim]->mQueue.steal();
+        if (job)
+        {
+            return job;
+        }
+    }
+
+    return popOverflow();
+}
+
+void JobSystem::pushOverflow(Job* job)
+{
+    std::lock_guard<std::mutex> lock(mOverflowMutex);
+    mOverflowJobs.push_back(job);
+    mOverflowCount.fetch_add(1, std::memory_order_release);
+}
+
+Job* JobSystem::popOverflow()
+{
+    if (mOverflowCount.load(std::memory_order_acquire) == 0)
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mOverflowMutex);
+    if (mOverflowJobs.empty())
+    {
+        return nullptr;
+    }
+
+    Job* job = mOverflowJobs.front();
+    mOverflowJobs.pop_front();
+    mOverflowCount.fetch_sub(1, std::memory_order_relaxed);
+    return job;
+}
+
+// Parks the job until its dependency is done, returns false when the dependency is already done.
+bool JobSystem::park(Job* job)
+{
+    std::lock_guard<std::mutex> lock(mParkMutex);
+    // The count goes up before the dependency is checked, and execute() decrements a counter before reading the
+    // count, both sequentially consistent: either the check sees the dependency done, or the job completing it
+    // sees a parked job and scans the list once this lock is released.
+    mParkedCount.fetch_add(1);
+    if (job->mDependency->mValue.load() == 0)
+    {
+        mParkedCount.fetch_sub(1);
+        return false;
+    }
+
+    mParkedJobs.push_back(job);
+    return true;
+}
+
+// Queues every parked job whose dependency is done. Only the dependencies of parked jobs are read, they are alive
+// until their dependents start, while the counter that just completed may already be gone.
+void JobSystem::releaseParked()
+{
+    std::lock_guard<std::mutex> lock(mParkMutex);
+    size_t kept = 0;
+    for (size_t i = 0; i < mParkedJobs.size(); i++)
+    {
+        Job* job = mParkedJobs[i];
+        if (job->mDependency->mValue.load() == 0)
+        {
+            enqueue(job);
+        }
+        else
+        {
+            mParkedJobs[kept++] = job;
+        }
+    }
+
+    mParkedCount.fetch_sub(static_cast<int32_t>(mParkedJobs.size() - kept));
+    mParkedJobs.resize(kept);
+}
+
+bool JobSystem::tryRunJob(uint32_t workerIndex)
+{
+    for (;;)
+    {
+        Job* job = findJob(workerIndex);
+        if (!job)
+        {
+            return false;
+        }
+
+        mQueuedJobs.fetch_sub(1);
+        // a dependency not done when the job was submitted may still be running, the job then waits off the queues
+        if (job->mDependency && park(job))
+        {
+            continue;
+        }
+
+        execute(job);
+        return true;
+    }
+}
+
+void JobSystem::execute(Job* job)
+{
+    JobCounter* counter = job->mCounter;
+    job->mEntry(*job);
+    job->mBusy.store(0, std::memory_order_release);
+    if (counter->mValue.fetch_sub(1) == 1 && mParkedCount.load() > 0)
+    {
+        releaseParked();
+    }
+}
+
+void JobSystem::workerMain(uint32_t workerIndex)
+{
+    tJobSystem = this;
+    tWorkerIndex = workerIndex;
+
+    const uint32_t SpinCount{ 64 };
+    uint32_t idleSpins = 0;
+
+    while (!mQuit.load(std::memory_order_relaxed))
+    {
+        if (tryRunJob(workerIndex))
+        {
+            idleSpins = 0;
+            continue;
+        }
+
+        if (++idleSpins < SpinCount)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mWakeMutex);
+        mSleepingWorkers.fetch_add(1);
+        mWakeCondition.wait(lock, [this]() { return mQueuedJobs.load() > 0 || mQuit.load(); });
+        mSleepingWorkers.fetch_sub(1);
+        idleSpins = 0;
+    }
+}
+
+uint32_t JobSystem::getCurrentWorkerIndex() const
+{
+    assert(tJobSystem == this && "Jobs can only be issued from worker threads or the owning thread");
+    return tWorkerIndex;
+}
+
+}
\ No newline at end of file
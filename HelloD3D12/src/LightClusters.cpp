@@ -0,0 +1,197 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include <xmmintrin.h>
+
+namespace HDX
+{
+
+static_assert(LightClusters::TileCountX % 4 == 0, "a row of tiles is tested 4 at a time");
+static_assert(LightClusters::ClusterCount <= 4096, "cluster indices are packed in 12 bits");
+
+LightClusters::Light LightClusters::boundCone(const Float3& apex, const Float3& direction, float range, float cosHalfAngle)
+{
+    if (cosHalfAngle <= 0.f)
+    {
+        // a half space or more, the sphere of the range
+        return { apex, range };
+    }
+
+    // Wide cones are bounded by the sphere through the rim of their cap, narrow ones by the sphere through the
+    // apex and the rim, whose center is further along the axis.
+    float distance;
+    float radius;
+    if (cosHalfAngle < 0.70710678f)
+    {
+        distance = range * cosHalfAngle;
+        radius = range * std::sqrt(1.f - cosHalfAngle * cosHalfAngle);
+    }
+    else
+    {
+        distance = range / (2.f * cosHalfAngle);
+        radius = distance;
+    }
+    return { { apex.x + direction.x * distance, apex.y + direction.y * distance, apex.z + direction.z * distance }, radius };
+}
+
+void LightClusters::setProjection(float fovY, float aspectRatio, float nearZ, float farZ)
+{
+    assert(nearZ > 0.f && farZ > nearZ);
+    mNearZ = nearZ;
+    mFarZ = farZ;
+
+    const float logRange = std::log(farZ / nearZ);
+    mDepthScale = static_cast<float>(SliceCount) / logRange;
+    mDepthBias = -static_cast<float>(SliceCount) * std::log(nearZ) / logRange;
+
+    const float tanY = std::tan(fovY * 0.5f);
+    const float tanX = tanY * aspectRatio;
+    for (uint32_t slice = 0; slice < SliceCount; slice++)
+    {
+        const float sliceNear = nearZ * std::pow(farZ / nearZ, static_cast<float>(slice) / SliceCount);
+        const float sliceFar = slice + 1 < SliceCount ? nearZ * std::pow(farZ / nearZ, static_cast<float>(slice + 1) / SliceCount) : farZ;
+        mSliceNear[slice] = sliceNear;
+        mSliceFar[slice] = sliceFar;
+
+        // the tile sides are planes through the eye, x = slope * z, so the box spans both ends of the slice
+        for (uint32_t x = 0; x < TileCountX; x++)
+        {
+            const float left = tanX * (2.f * x / TileCountX - 1.f);
+            const float right = tanX * (2.f * (x + 1) / TileCountX - 1.f);
+            mTileMinX[slice][x] = std::min(left * sliceNear, left * sliceFar);
+            mTileMaxX[slice][x] = std::max(right * sliceNear, right * sliceFar);
+        }
+        // rows count from the top of the screen
+        for (uint32_t y = 0; y < TileCountY; y++)
+        {
+            const float top = tanY * (1.f - 2.f * y / TileCountY);
+            const float bottom = tanY * (1.f - 2.f * (y + 1) / TileCountY);
+            mTileMinY[slice][y] = std::min(bottom * sliceNear, bottom * sliceFar);
+            mTileMaxY[slice][y] = std::max(top * sliceNear, top * sliceFar);
+        }
+    }
+}
+
+uint32_t LightClusters::getSlice(float depth) const
+{
+    if (depth <= mNearZ)
+    {
+        return 0;
+    }
+
+    const float slice = std::floor(std::log(depth) * mDepthScale + mDepthBias);
+    return std::min(static_cast<uint32_t>(std::max(slice, 0.f)), SliceCount - 1);
+}
+
+void LightClusters::assign(const Light* lights, uint32_t count, Cell* cells, uint32_t* indices, uint32_t maxIndices)
+{
+    mStats = Stats{};
+    mStats.lights = count;
+    mPairs.clear();
+    assert(count <= (1u << (32 - ClusterBits)));
+
+    const __m128 zero = _mm_setzero_ps();
+    for (uint32_t lightIndex = 0; lightIndex < count; lightIndex++)
+    {
+        const Light& light = lights[lightIndex];
+        const Float3& center = light.center;
+        if (center.z + light.radius < mNearZ || center.z - light.radius > mFarZ)
+        {
+            continue;
+        }
+
+        const float radiusSq = light.radius * light.radius;
+        const __m128 centerX = _mm_set1_ps(center.x);
+        const uint32_t lastSlice = getSlice(center.z + light.radius);
+        bool touched = false;
+        for (uint32_t slice = getSlice(center.z - light.radius); slice <= lastSlice; slice++)
+        {
+            const float dz = std::max(std::max(mSliceNear[slice] - center.z, center.z - mSliceFar[slice]), 0.f);
+            const float sliceRadiusSq = radiusSq - dz * dz;
+            if (sliceRadiusSq < 0.f)
+            {
+                continue;
+            }
+
+            // squared x distance to every tile column of the slice
+            __m128 dxSq[TileCountX / 4];
+            for (uint32_t group = 0; group < TileCountX / 4; group++)
+            {
+                const __m128 minX = _mm_loadu_ps(&mTileMinX[slice][group * 4]);
+                const __m128 maxX = _mm_loadu_ps(&mTileMaxX[slice][group * 4]);
+                const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, centerX), _mm_sub_ps(centerX, maxX)), zero);
+                dxSq[group] = _mm_mul_ps(dx, dx);
+            }
+
+            for (uint32_t y = 0; y < TileCountY; y++)
+            {
+                const float dy = std::max(std::max(mTileMinY[slice][y] - center.y, center.y - mTileMaxY[slice][y]), 0.f);
+                const float rowRadiusSq = sliceRadiusSq - dy * dy;
+                if (rowRadiusSq < 0.f)
+                {
+                    continue;
+                }
+
+                const __m128 rowRadius = _mm_set1_ps(rowRadiusSq);
+                const uint32_t rowPair = (lightIndex << ClusterBits) | ((slice * TileCountY + y) * TileCountX);
+                for (uint32_t group = 0; group < TileCountX / 4; group++)
+                {
+                    int mask = _mm_movemask_ps(_mm_cmple_ps(dxSq[group], rowRadius));
+                    touched |= mask != 0;
+                    for (uint32_t lane = group * 4; mask != 0; lane++, mask >>= 1)
+                    {
+                        if (mask & 1)
+                        {
+                            mPairs.push_back(rowPair + lane);
+                        }
+                    }
+                }
+            }
+        }
+        mStats.visibleLights += touched ? 1 : 0;
+    }
+
+    // counting sort by cluster, stable so a cluster lists its lights in the order of the lights array
+    mClusterCounts.assign(ClusterCount, 0);
+    const uint32_t clusterMask = (1u << ClusterBits) - 1;
+    for (uint32_t pair : mPairs)
+    {
+        mClusterCounts[pair & clusterMask]++;
+    }
+
+    mCells.resize(ClusterCount);
+    uint32_t offset = 0;
+    for (uint32_t cluster = 0; cluster < ClusterCount; cluster++)
+    {
+        const uint32_t clusterCount = mClusterCounts[cluster];
+        const uint32_t stored = std::min(clusterCount, maxIndices - offset);
+        mCells[cluster] = { offset, stored };
+        offset += stored;
+        mStats.droppedIndices += clusterCount - stored;
+        mStats.maxClusterLights = std::max(mStats.maxClusterLights, clusterCount);
+        // from here on the number of lights written to the cluster
+        mClusterCounts[cluster] = 0;
+    }
+    mStats.indices = offset;
+
+    // the scatter reads the cells back, it must not touch the output
+    mIndices.resize(offset);
+    for (uint32_t pair : mPairs)
+    {
+        const uint32_t cluster = pair & clusterMask;
+        const uint32_t slot = mClusterCounts[cluster]++;
+        if (slot < mCells[cluster].count)
+        {
+            mIndices[mCells[cluster].offset + slot] = pair >> ClusterBits;
+        }
+    }
+
+    memcpy(cells, mCells.data(), ClusterCount * sizeof(Cell));
+    memcpy(indices, mIndices.data(), offset * sizeof(uint32_t));
+}
+
+}
\ No newline at end of file
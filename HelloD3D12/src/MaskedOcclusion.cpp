@@ -0,0 +1,442 @@
+#include "MaskedOcclusion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+#include <emmintrin.h>
+
+#ifdef _MSC_VER
+#pragma warning(disable:4996)
+#endif
+
+namespace HDX
+{
+
+static const float FarDepth{ 1.f };
+
+// 1 << n for n in [0, 31] without the per lane shifts SSE2 lacks: 2^n built as a float exponent and converted back,
+// n = 31 overflows the conversion into 0x80000000, which is the right bit pattern
+static inline __m128i pow2(__m128i n)
+{
+    return _mm_cvttps_epi32(_mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23)));
+}
+
+// floor of values already clamped to [-64, 64], truncation rounds down once they are offset to positive
+static inline __m128i floorClamped(__m128 value)
+{
+    return _mm_sub_epi32(_mm_cvttps_epi32(_mm_add_ps(value, _mm_set1_ps(64.f))), _mm_set1_epi32(64));
+}
+
+static inline __m128 clampToTile(__m128 value)
+{
+    return _mm_min_ps(_mm_max_ps(value, _mm_set1_ps(-1.f)), _mm_set1_ps(static_cast<float>(MaskedOcclusionBuffer::TileWidth + 1)));
+}
+
+static inline __m128i clampCount(__m128i value)
+{
+    // SSE2 has no integer min/max for 32 bit lanes
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i width = _mm_set1_epi32(MaskedOcclusionBuffer::TileWidth);
+    value = _mm_and_si128(value, _mm_cmpgt_epi32(value, zero));
+    __m128i above = _mm_cmpgt_epi32(value, width);
+    return _mm_or_si128(_mm_andnot_si128(above, value), _mm_and_si128(above, width));
+}
+
+void MaskedOcclusionBuffer::resize(uint32_t width, uint32_t height)
+{
+    mTilesX = (width + TileWidth - 1) / TileWidth;
+    mTilesY = (height + TileHeight - 1) / TileHeight;
+    mMasks.resize(static_cast<size_t>(mTilesX) * mTilesY * TileHeight);
+    mZMax0.resize(static_cast<size_t>(mTilesX) * mTilesY);
+    mZMax1.resize(static_cast<size_t>(mTilesX) * mTilesY);
+    clear();
+}
+
+void MaskedOcclusionBuffer::clear()
+{
+    std::fill(mMasks.begin(), mMasks.end(), 0u);
+    std::fill(mZMax0.begin(), mZMax0.end(), FarDepth);
+    std::fill(mZMax1.begin(), mZMax1.end(), 0.f);
+}
+
+void MaskedOcclusionBuffer::renderTriangles(const Float3* positions, uint32_t triangleCount, const float* worldViewProj)
+{
+    const __m128 row0 = _mm_loadu_ps(worldViewProj);
+    const __m128 row1 = _mm_loadu_ps(worldViewProj + 4);
+    const __m128 row2 = _mm_loadu_ps(worldViewProj + 8);
+    const __m128 row3 = _mm_loadu_ps(worldViewProj + 12);
+    const float width = static_cast<float>(getWidth());
+    const float height = static_cast<float>(getHeight());
+
+    for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+    {
+        mStats.triangles++;
+
+        ScreenTriangle screen;
+        bool clipped = false;
+        for (uint32_t corner = 0; corner < 3 && !clipped; corner++)
+        {
+            const Float3& position = positions[triangle * 3 + corner];
+            __m128 clip = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(position.x), row0), _mm_mul_ps(_mm_set1_ps(position.y), row1)),
+                                     _mm_add_ps(_mm_mul_ps(_mm_set1_ps(position.z), row2), row3));
+            alignas(16) float c[4];
+            _mm_store_ps(c, clip);
+            if (c[2] < 0.f || c[3] <= 0.f)
+            {
+                clipped = true;
+                break;
+            }
+
+            const float invW = 1.f / c[3];
+            screen.x[corner] = (c[0] * invW * 0.5f + 0.5f) * width;
+            screen.y[corner] = (0.5f - c[1] * invW * 0.5f) * height;
+            screen.z[corner] = c[2] * invW;
+        }
+
+        if (!clipped)
+        {
+            rasterize(screen);
+        }
+    }
+}
+
+void MaskedOcclusionBuffer::rasterize(const ScreenTriangle& triangle)
+{
+    const float* x = triangle.x;
+    const float* y = triangle.y;
+    const float* z = triangle.z;
+
+    // clockwise on screen with y down is front facing, the edge functions below assume it
+    const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (!(area > 0.f))
+    {
+        return;
+    }
+
+    const float minX = std::min(std::min(x[0], x[1]), x[2]);
+    const float maxX = std::max(std::max(x[0], x[1]), x[2]);
+    const float minY = std::min(std::min(y[0], y[1]), y[2]);
+    const float maxY = std::max(std::max(y[0], y[1]), y[2]);
+    const float width = static_cast<float>(getWidth());
+    const float height = static_cast<float>(getHeight());
+    if (maxX < 0.f || maxY < 0.f || minX >= width || minY >= height)
+    {
+        return;
+    }
+
+    const uint32_t tileX0 = static_cast<uint32_t>(std::max(minX, 0.f)) / TileWidth;
+    const uint32_t tileX1 = std::min(static_cast<uint32_t>(maxX) / TileWidth, mTilesX - 1);
+    const uint32_t tileY0 = static_cast<uint32_t>(std::max(minY, 0.f)) / TileHeight;
+    const uint32_t tileY1 = std::min(static_cast<uint32_t>(maxY) / TileHeight, mTilesY - 1);
+
+    // depth plane z = z0 + dzdx (x - x0) + dzdy (y - y0), its extremes over a tile are at the tile corners
+    const float dzdx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+    const float dzdy = ((x[1] - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (z[1] - z[0])) / area;
+    const float minZ = std::min(std::min(z[0], z[1]), z[2]);
+    const float maxZ = std::max(std::max(z[0], z[1]), z[2]);
+
+    // Each edge bounds the covered pixels of a row from the left or from the right, depending on its direction.
+    // Horizontal edges cover whole rows or none.
+    struct Edge
+    {
+        float x;
+        float y;
+        float slope;
+    };
+    Edge leftEdges[3];
+    Edge rightEdges[3];
+    Edge flatEdges[3];
+    uint32_t leftCount = 0;
+    uint32_t rightCount = 0;
+    uint32_t flatCount = 0;
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        const uint32_t j = (i + 1) % 3;
+        const float dy = y[j] - y[i];
+        if (dy < 0.f)
+        {
+            leftEdges[leftCount++] = { x[i], y[i], (x[j] - x[i]) / dy };
+        }
+        else if (dy > 0.f)
+        {
+            rightEdges[rightCount++] = { x[i], y[i], (x[j] - x[i]) / dy };
+        }
+        else
+        {
+            flatEdges[flatCount++] = { x[i], y[i], x[j] - x[i] };
+        }
+    }
+
+    const __m128 rowOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i width32 = _mm_set1_epi32(TileWidth);
+    bool rasterized = false;
+    for (uint32_t tileY = tileY0; tileY <= tileY1; tileY++)
+    {
+        const float top = static_cast<float>(tileY * TileHeight);
+        const __m128 rowY = _mm_add_ps(_mm_set1_ps(top), rowOffsets);
+
+        // pixel px of a row is covered when its center px + 0.5 is within [left, right]
+        __m128 left = _mm_set1_ps(-1e30f);
+        __m128 right = _mm_set1_ps(1e30f);
+        for (uint32_t i = 0; i < leftCount; i++)
+        {
+            const Edge& edge = leftEdges[i];
+            __m128 edgeX = _mm_add_ps(_mm_set1_ps(edge.x), _mm_mul_ps(_mm_sub_ps(rowY, _mm_set1_ps(edge.y)), _mm_set1_ps(edge.slope)));
+            left = _mm_max_ps(left, edgeX);
+        }
+        for (uint32_t i = 0; i < rightCount; i++)
+        {
+            const Edge& edge = rightEdges[i];
+            __m128 edgeX = _mm_add_ps(_mm_set1_ps(edge.x), _mm_mul_ps(_mm_sub_ps(rowY, _mm_set1_ps(edge.y)), _mm_set1_ps(edge.slope)));
+            right = _mm_min_ps(right, edgeX);
+        }
+        __m128i rows = _mm_set1_epi32(-1);
+        for (uint32_t i = 0; i < flatCount; i++)
+        {
+            const Edge& edge = flatEdges[i];
+            __m128 inside = _mm_cmpge_ps(_mm_mul_ps(_mm_set1_ps(edge.slope), _mm_sub_ps(rowY, _mm_set1_ps(edge.y))), _mm_setzero_ps());
+            rows = _mm_and_si128(rows, _mm_castps_si128(inside));
+        }
+        left = _mm_sub_ps(left, _mm_set1_ps(0.5f));
+        right = _mm_sub_ps(right, _mm_set1_ps(0.5f));
+
+        for (uint32_t tileX = tileX0; tileX <= tileX1; tileX++)
+        {
+            const __m128 tileLeft = _mm_set1_ps(static_cast<float>(tileX * TileWidth));
+
+            // first covered pixel ceil(left) and one past the last covered pixel floor(right) + 1, within the tile
+            __m128i first = clampCount(_mm_sub_epi32(_mm_setzero_si128(), floorClamped(_mm_sub_ps(_mm_setzero_ps(), clampToTile(_mm_sub_ps(left, tileLeft))))));
+            __m128i last = clampCount(_mm_add_epi32(floorClamped(clampToTile(_mm_sub_ps(right, tileLeft))), one));
+            __m128i fromFirst = _mm_andnot_si128(_mm_cmpeq_epi32(first, width32), _mm_sub_epi32(_mm_setzero_si128(), pow2(first)));
+            __m128i beforeLast = _mm_or_si128(_mm_cmpeq_epi32(last, width32), _mm_sub_epi32(pow2(last), one));
+            __m128i coverage = _mm_and_si128(_mm_and_si128(fromFirst, beforeLast), rows);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(coverage, _mm_setzero_si128())) == 0xffff)
+            {
+                continue;
+            }
+
+            const float tileX0f = static_cast<float>(tileX * TileWidth) - x[0];
+            const float tileY0f = top - y[0];
+            const float tileZMax = std::min(maxZ, z[0] + std::max(dzdx * tileX0f, dzdx * (tileX0f + TileWidth)) + std::max(dzdy * tileY0f, dzdy * (tileY0f + TileHeight)));
+            const float tileZMin = std::max(minZ, z[0] + std::min(dzdx * tileX0f, dzdx * (tileX0f + TileWidth)) + std::min(dzdy * tileY0f, dzdy * (tileY0f + TileHeight)));
+            const uint32_t tile = tileY * mTilesX + tileX;
+            if (tileZMin >= mZMax0[tile])
+            {
+                // behind everything already in the tile
+                continue;
+            }
+
+            alignas(16) uint32_t rowCoverage[TileHeight];
+            _mm_store_si128(reinterpret_cast<__m128i*>(rowCoverage), coverage);
+            updateTile(tile, rowCoverage, tileZMax);
+            rasterized = true;
+        }
+    }
+
+    if (rasterized)
+    {
+        mStats.rasterizedTriangles++;
+    }
+}
+
+void MaskedOcclusionBuffer::updateTile(uint32_t tile, const uint32_t* coverage, float triangleZMax)
+{
+    mStats.tileUpdates++;
+
+    float& zMax0 = mZMax0[tile];
+    float& zMax1 = mZMax1[tile];
+    __m128i* maskRows = reinterpret_cast<__m128i*>(&mMasks[tile * TileHeight]);
+    __m128i mask = _mm_loadu_si128(maskRows);
+
+    // the covered pixels are no deeper than the reference layer whatever the triangle depth
+    const float depth = std::min(triangleZMax, zMax0);
+    if (depth - zMax1 > zMax0 - depth)
+    {
+        // closer to the reference layer than to the working layer, merging would push the working layer back
+        zMax1 = 0.f;
+        mask = _mm_setzero_si128();
+    }
+    zMax1 = std::max(zMax1, depth);
+    mask = _mm_or_si128(mask, _mm_loadu_si128(reinterpret_cast<const __m128i*>(coverage)));
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(mask, _mm_set1_epi32(-1))) == 0xffff)
+    {
+        // the working layer covers the tile, it is the new reference
+        zMax0 = zMax1;
+        zMax1 = 0.f;
+        mask = _mm_setzero_si128();
+    }
+    _mm_storeu_si128(maskRows, mask);
+}
+
+bool MaskedOcclusionBuffer::testBox(const Bounds& bounds, const float* viewProj) const
+{
+    if (mTilesX == 0 || mTilesY == 0)
+    {
+        return true;
+    }
+
+    const __m128 row0 = _mm_loadu_ps(viewProj);
+    const __m128 row1 = _mm_loadu_ps(viewProj + 4);
+    const __m128 row2 = _mm_loadu_ps(viewProj + 8);
+    const __m128 row3 = _mm_loadu_ps(viewProj + 12);
+    const __m128 center = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(bounds.center.x), row0), _mm_mul_ps(_mm_set1_ps(bounds.center.y), row1)),
+                                     _mm_add_ps(_mm_mul_ps(_mm_set1_ps(bounds.center.z), row2), row3));
+    const __m128 axisX = _mm_mul_ps(_mm_set1_ps(bounds.extents.x), row0);
+    const __m128 axisY = _mm_mul_ps(_mm_set1_ps(bounds.extents.y), row1);
+    const __m128 axisZ = _mm_mul_ps(_mm_set1_ps(bounds.extents.z), row2);
+
+    const float width = static_cast<float>(getWidth());
+    const float height = static_cast<float>(getHeight());
+    float minX = std::numeric_limits<float>::max();
+    float maxX = -std::numeric_limits<float>::max();
+    float minY = std::numeric_limits<float>::max();
+    float maxY = -std::numeric_limits<float>::max();
+    float minZ = FarDepth;
+    for (uint32_t corner = 0; corner < 8; corner++)
+    {
+        __m128 clip = center;
+        clip = (corner & 1) ? _mm_add_ps(clip, axisX) : _mm_sub_ps(clip, axisX);
+        clip = (corner & 2) ? _mm_add_ps(clip, axisY) : _mm_sub_ps(clip, axisY);
+        clip = (corner & 4) ? _mm_add_ps(clip, axisZ) : _mm_sub_ps(clip, axisZ);
+        alignas(16) float c[4];
+        _mm_store_ps(c, clip);
+        if (c[2] < 0.f || c[3] <= 0.f)
+        {
+            // crosses the near plane
+            return true;
+        }
+
+        const float invW = 1.f / c[3];
+        const float screenX = (c[0] * invW * 0.5f + 0.5f) * width;
+        const float screenY = (0.5f - c[1] * invW * 0.5f) * height;
+        minX = std::min(minX, screenX);
+        maxX = std::max(maxX, screenX);
+        minY = std::min(minY, screenY);
+        maxY = std::max(maxY, screenY);
+        minZ = std::min(minZ, c[2] * invW);
+    }
+
+    if (maxX < 0.f || maxY < 0.f || minX >= width || minY >= height)
+    {
+        // off screen, that is for the frustum culling to decide
+        return true;
+    }
+
+    const uint32_t x0 = static_cast<uint32_t>(std::max(minX, 0.f));
+    const uint32_t x1 = std::min(static_cast<uint32_t>(maxX), getWidth() - 1);
+    const uint32_t y0 = static_cast<uint32_t>(std::max(minY, 0.f));
+    const uint32_t y1 = std::min(static_cast<uint32_t>(maxY), getHeight() - 1);
+    const uint32_t tileX0 = x0 / TileWidth;
+    const uint32_t tileX1 = x1 / TileWidth;
+
+    // the box may be visible in a tile unless its nearest depth is behind the tile reference layer, or behind the
+    // working layer with every pixel of the box rectangle in the tile mask
+    auto visibleInTile = [this, x0, x1, y0, y1, minZ](uint32_t tileX, uint32_t tileY)
+    {
+        const uint32_t tile = tileY * mTilesX + tileX;
+        if (minZ > mZMax0[tile])
+        {
+            return false;
+        }
+        if (!(minZ > mZMax1[tile]))
+        {
+            return true;
+        }
+
+        const uint32_t first = std::max(x0, tileX * TileWidth) - tileX * TileWidth;
+        const uint32_t last = std::min(x1, tileX * TileWidth + TileWidth - 1) - tileX * TileWidth;
+        const uint32_t bits = (last - first == TileWidth - 1 ? 0xffffffffu : ((1u << (last - first + 1)) - 1)) << first;
+        for (uint32_t y = std::max(y0, tileY * TileHeight); y <= std::min(y1, tileY * TileHeight + TileHeight - 1); y++)
+        {
+            if ((mMasks[tile * TileHeight + y % TileHeight] & bits) != bits)
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // reference layers of four tiles of a row per compare
+    const __m128 boxZ = _mm_set1_ps(minZ);
+    for (uint32_t tileY = y0 / TileHeight; tileY <= y1 / TileHeight; tileY++)
+    {
+        const float* zMax0 = &mZMax0[tileY * mTilesX];
+        uint32_t tileX = tileX0;
+        for (; tileX + 4 <= tileX1 + 1; tileX += 4)
+        {
+            uint32_t candidates = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(boxZ, _mm_loadu_ps(zMax0 + tileX))));
+            for (uint32_t lane = 0; candidates; lane++, candidates >>= 1)
+            {
+                if ((candidates & 1) && visibleInTile(tileX + lane, tileY))
+                {
+                    return true;
+                }
+            }
+        }
+        for (; tileX <= tileX1; tileX++)
+        {
+            if (visibleInTile(tileX, tileY))
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+float MaskedOcclusionBuffer::getPixelDepth(uint32_t x, uint32_t y) const
+{
+    const uint32_t tile = (y / TileHeight) * mTilesX + x / TileWidth;
+    const uint32_t row = mMasks[tile * TileHeight + y % TileHeight];
+    return ((row >> (x % TileWidth)) & 1) ? mZMax1[tile] : mZMax0[tile];
+}
+
+bool MaskedOcclusionBuffer::saveDepthImage(const char* path) const
+{
+    const uint32_t width = getWidth();
+    const uint32_t height = getHeight();
+
+    // stretch the rendered depth range over the gray levels, perspective depth bunches up near 1
+    float nearest = FarDepth;
+    float farthest = 0.f;
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            const float depth = getPixelDepth(x, y);
+            if (depth < FarDepth)
+            {
+                nearest = std::min(nearest, depth);
+                farthest = std::max(farthest, depth);
+            }
+        }
+    }
+    const float scale = farthest > nearest ? 254.f / (farthest - nearest) : 0.f;
+
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            const float depth = getPixelDepth(x, y);
+            pixels[y * width + x] = depth < FarDepth ? static_cast<uint8_t>(255.f - (depth - nearest) * scale) : 0;
+        }
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        return false;
+    }
+    bool written = fprintf(file, "P5\n%u %u\n255\n", width, height) > 0;
+    written = fwrite(pixels.data(), pixels.size(), 1, file) == 1 && written;
+    return fclose(file) == 0 && written;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,334 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <string>
+
+#include "Asset.h"
+#include "GpuMemoryAllocator.h"
+#include "Mesh.h"
+#include "MeshLod.h"
+#include "UploadManager.h"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "ext/tiny_obj_loader.h"
+
+#pragma warning( push )  
+#pragma warning( disable : 4100 )  
+#define STB_IMAGE_IMPLEMENTATION
+#include "ext/stb_image.h"
+#pragma warning( pop )   
+
+template<typename CharT, typename TraitsT = std::char_traits<CharT> >
+class vectorwrapbuf : public std::basic_streambuf<CharT, TraitsT> {
+public:
+    vectorwrapbuf(std::vector<CharT> &vec) {
+        this->setg(vec.data(), vec.data(), vec.data() + vec.size());
+    }
+};
+
+namespace HDX
+{
+
+const float Mesh::LodCellScale{ 1.f / 64.f };
+
+// A LOD is kept when it has at most this fraction of the triangles of the previous one, past that the mesh has no
+// detail left at the scale of the cells and coarser LODs would only be drawn sooner for the same savings.
+static const float MinLodReduction{ 0.9f };
+
+Mesh::Mesh(std::string name, uint32_t id)
+    : mName(name)
+    , mId(id)
+{
+}
+
+Mesh::~Mesh()
+{
+    if (mTexturePixels)
+    {
+        stbi_image_free(mTexturePixels);
+    }
+}
+
+bool Mesh::load()
+{
+    {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string err;
+
+        std::string modelPath = "models/" + mName + ".obj";
+        Asset obj(modelPath, 0);
+        auto size = obj.getLength();
+        std::vector<char> objData(size);
+        obj.read(objData.data(), size);
+        obj.close();
+
+        vectorwrapbuf<char> databuf(objData);
+        std::istream is(&databuf);
+
+        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, &is))
+        {
+            LOG_ERROR("Failed to load %s: %s\n", modelPath.c_str(), err.c_str());
+            return false;
+        }
+
+        for (const auto& shape : shapes)
+        {
+            for (const auto& index : shape.mesh.indices)
+            {
+                Vertex vertex = {};
+
+                vertex.pos = {
+                    attrib.vertices[3 * index.vertex_index + 0],
+                    attrib.vertices[3 * index.vertex_index + 1],
+                    attrib.vertices[3 * index.vertex_index + 2]
+                };
+
+                vertex.uv = {
+                    attrib.texcoords[2 * index.texcoord_index + 0],
+                    1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+                };
+
+                vertex.normal = {
+                    attrib.normals[3 * index.normal_index + 0],
+                    attrib.normals[3 * index.normal_index + 1],
+                    attrib.normals[3 * index.normal_index + 2]
+                };
+
+                mVertices.push_back(vertex);
+                mIndices.push_back(static_cast<uint32_t>(mIndices.size()));
+            }
+        }
+
+        if (mVertices.empty())
+        {
+            LOG_ERROR("%s has no vertices\n", modelPath.c_str());
+            return false;
+        }
+
+        Float3 minCorner{ mVertices[0].pos.x, mVertices[0].pos.y, mVertices[0].pos.z };
+        Float3 maxCorner = minCorner;
+        for (const Vertex& vertex : mVertices)
+        {
+            minCorner = { std::min(minCorner.x, vertex.pos.x), std::min(minCorner.y, vertex.pos.y), std::min(minCorner.z, vertex.pos.z) };
+            maxCorner = { std::max(maxCorner.x, vertex.pos.x), std::max(maxCorner.y, vertex.pos.y), std::max(maxCorner.z, vertex.pos.z) };
+        }
+        mBounds = makeBounds(minCorner, maxCorner);
+
+        // the sphere around the box center that actually touches the vertices, tighter than the box diagonal
+        float radiusSq = 0.f;
+        for (const Vertex& vertex : mVertices)
+        {
+            float dx = vertex.pos.x - mBounds.center.x;
+            float dy = vertex.pos.y - mBounds.center.y;
+            float dz = vertex.pos.z - mBounds.center.z;
+            radiusSq = std::max(radiusSq, dx * dx + dy * dy + dz * dz);
+        }
+        mBounds.radius = std::sqrt(radiusSq);
+
+        // the vertices are not shared, every index is a triangle corner
+        if (mIndices.size() / 3 <= MaxOccluderTriangles)
+        {
+            mOccluderTriangles.reserve(mIndices.size());
+            for (uint32_t index : mIndices)
+            {
+                const XMFLOAT3& pos = mVertices[index].pos;
+                mOccluderTriangles.push_back({ pos.x, pos.y, pos.z });
+            }
+        }
+
+        // coarser LODs index the same vertices and follow LOD 0 in the index buffer
+        const uint32_t sourceIndexCount = static_cast<uint32_t>(mIndices.size());
+        mLods[0] = { 0, sourceIndexCount };
+        mLodCount = 1;
+        const Float3 origin{ mBounds.center.x - mBounds.extents.x, mBounds.center.y - mBounds.extents.y, mBounds.center.z - mBounds.extents.z };
+        while (mLodCount < MaxLods && mBounds.radius > 0.f)
+        {
+            const float cellSize = mBounds.radius * LodCellScale * static_cast<float>(1u << (mLodCount - 1));
+            const uint32_t indexOffset = static_cast<uint32_t>(mIndices.size());
+            const uint32_t triangleCount = buildClusteredLod(&mVertices[0].pos.x, sizeof(Vertex), mIndices.data(), sourceIndexCount, origin, cellSize, mIndices);
+            if (triangleCount == 0 || triangleCount * 3 > mLods[mLodCount - 1].indexCount * MinLodReduction)
+            {
+                mIndices.resize(indexOffset);
+                break;
+            }
+            mLods[mLodCount++] = { indexOffset, triangleCount * 3 };
+        }
+    }
+
+    {
+        std::string texturePath = "textures/" + mName + ".jpg";
+        int32_t texChannels;
+        Asset texFile(texturePath, 0);
+        auto size = texFile.getLength();
+        std::vector<uint8_t> texData(size);
+        texFile.read(texData.data(), size);
+        texFile.close();
+
+        mTexturePixels = stbi_load_from_memory(texData.data(), size, &mTextureWidth, &mTextureHeight, &texChannels, STBI_rgb_alpha);
+        if (!mTexturePixels)
+        {
+            LOG_ERROR("Failed to decode %s\n", texturePath.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Mesh::prepare(
+    ID3D12Device* device,
+    GpuMemoryAllocator* allocator,
+    UploadManager* uploadManager,
+    ID3D12DescriptorHeap* srvCBVHeap,
+    UINT &heapOffset
+)
+{
+    // resources start in COMMON, the copy queue promotes them to COPY_DEST and the direct queue to their read state
+    {
+        const UINT vertexBufferSize = static_cast<UINT>(sizeof(Vertex) * mVertices.size());
+
+        if (!allocator->createBuffer(vertexBufferSize, mVertexBuffer))
+        {
+            LOG_ERROR("Failed to create vertex buffer of %s\n", mName.c_str());
+            return false;
+        }
+
+        if (!uploadManager->uploadBuffer(mVertexBuffer.getResource(), mVertexBuffer.getOffset(), mVertices.data(), vertexBufferSize))
+        {
+            LOG_ERROR("Failed to upload vertex buffer of %s\n", mName.c_str());
+            return false;
+        }
+
+        mVertexBufferView.BufferLocation = mVertexBuffer.getGPUAddress();
+        mVertexBufferView.StrideInBytes = sizeof(Vertex);
+        mVertexBufferView.SizeInBytes = vertexBufferSize;
+    }
+
+    {
+        const UINT indexBufferSize = static_cast<UINT>(sizeof(uint32_t) * mIndices.size());
+
+        if (!allocator->createBuffer(indexBufferSize, mIndexBuffer))
+        {
+            LOG_ERROR("Failed to create index buffer of %s\n", mName.c_str());
+            return false;
+        }
+
+        if (!uploadManager->uploadBuffer(mIndexBuffer.getResource(), mIndexBuffer.getOffset(), mIndices.data(), indexBufferSize))
+        {
+            LOG_ERROR("Failed to upload index buffer of %s\n", mName.c_str());
+            return false;
+        }
+
+        mIndexBufferView.BufferLocation = mIndexBuffer.getGPUAddress();
+        mIndexBufferView.SizeInBytes = indexBufferSize;
+        mIndexBufferView.Format = DXGI_FORMAT_R32_UINT;
+    }
+
+    mIndexCount = static_cast<UINT>(mIndices.size());
+
+    // the data is in staging memory now
+    std::vector<Vertex>().swap(mVertices);
+    std::vector<uint32_t>().swap(mIndices);
+
+    CD3DX12_CPU_DESCRIPTOR_HANDLE srvCBVHandle(srvCBVHeap->GetCPUDescriptorHandleForHeapStart());
+    UINT srvCBVDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    srvCBVHandle.Offset(1, heapOffset);
+    mSRVDescriptorStart = srvCBVHandle;
+    heapOffset += srvCBVDescriptorSize;
+    {
+        D3D12_RESOURCE_DESC textureDesc{};
+        textureDesc.MipLevels = 1;
+        textureDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+        textureDesc.Width = mTextureWidth;
+        textureDesc.Height = mTextureHeight;
+        textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+        textureDesc.DepthOrArraySize = 1;
+        textureDesc.SampleDesc.Count = 1;
+        textureDesc.SampleDesc.Quality = 0;
+        textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+
+        if (!allocator->createResource(textureDesc, D3D12_RESOURCE_STATE_COMMON, nullptr, mTexture))
+        {
+            LOG_ERROR("Failed to create texture of %s\n", mName.c_str());
+            return false;
+        }
+
+        D3D12_SUBRESOURCE_DATA textureData{};
+        textureData.pData = mTexturePixels;
+        textureData.RowPitch = mTextureWidth * TexturePixelSize;
+        textureData.SlicePitch = textureData.RowPitch * mTextureHeight;
+
+        if (!uploadManager->uploadTexture(mTexture.getResource(), textureData))
+        {
+            LOG_ERROR("Failed to upload texture of %s\n", mName.c_str());
+            return false;
+        }
+
+        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
+        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        srvDesc.Format = textureDesc.Format;
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+        srvDesc.Texture2D.MipLevels = 1;
+        device->CreateShaderResourceView(mTexture.getResource(), &srvDesc, srvCBVHandle);
+
+        stbi_image_free(mTexturePixels);
+        mTexturePixels = nullptr;
+    }
+
+    return true;
+}
+
+void Mesh::release(ResourceDeletionQueue& deletionQueue, UINT64 lastUseFenceValue)
+{
+    if (!isResident())
+    {
+        return;
+    }
+
+    deletionQueue.enqueue(std::move(mVertexBuffer), lastUseFenceValue);
+    deletionQueue.enqueue(std::move(mIndexBuffer), lastUseFenceValue);
+    deletionQueue.enqueue(std::move(mTexture), lastUseFenceValue);
+    mVertexBufferView = {};
+    mIndexBufferView = {};
+    mIndexCount = 0;
+}
+
+std::shared_ptr<Mesh> MeshRegistry::acquire(const std::string &name)
+{
+    auto it = mMeshes.find(name);
+    if (it != mMeshes.end())
+    {
+        return it->second;
+    }
+
+    auto mesh = std::make_shared<Mesh>(name, static_cast<uint32_t>(mMeshList.size()));
+    mMeshes.emplace(name, mesh);
+    mMeshList.push_back(mesh);
+    return mesh;
+}
+
+uint32_t MeshRegistry::releaseUnused(ResourceDeletionQueue& deletionQueue, UINT64 lastUseFenceValue)
+{
+    uint32_t released = 0;
+    for (auto it = mMeshes.begin(); it != mMeshes.end();)
+    {
+        // the map and the list hold the only references left
+        if (it->second.use_count() == 2)
+        {
+            it->second->release(deletionQueue, lastUseFenceValue);
+            it = mMeshes.erase(it);
+            released++;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    return released;
+}
+
+}
\ No newline at end of file
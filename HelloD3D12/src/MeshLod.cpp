@@ -0,0 +1,184 @@
+#include "MeshLod.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include <emmintrin.h>
+
+namespace HDX
+{
+
+uint32_t buildClusteredLod(const float* positions, size_t stride, const uint32_t* indices, uint32_t indexCount,
+                           const Float3& origin, float cellSize, std::vector<uint32_t>& lodIndices)
+{
+    assert(cellSize > 0.f);
+    const float invCellSize = 1.f / cellSize;
+    const uint32_t cellMask = (1u << 21) - 1;
+
+    // first vertex of each cell, keyed by the 21 bit cell coordinates
+    std::unordered_map<uint64_t, uint32_t> cells;
+    cells.reserve(indexCount / 3);
+    auto getRepresentative = [&](uint32_t vertex)
+    {
+        const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + vertex * stride);
+        const uint64_t x = static_cast<uint32_t>(std::max(std::floor((p[0] - origin.x) * invCellSize), 0.f)) & cellMask;
+        const uint64_t y = static_cast<uint32_t>(std::max(std::floor((p[1] - origin.y) * invCellSize), 0.f)) & cellMask;
+        const uint64_t z = static_cast<uint32_t>(std::max(std::floor((p[2] - origin.z) * invCellSize), 0.f)) & cellMask;
+        return cells.emplace(x | (y << 21) | (z << 42), vertex).first->second;
+    };
+
+    std::vector<std::array<uint32_t, 3>> triangles;
+    triangles.reserve(indexCount / 3);
+    for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        std::array<uint32_t, 3> triangle{ { getRepresentative(indices[i]), getRepresentative(indices[i + 1]), getRepresentative(indices[i + 2]) } };
+        if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2])
+        {
+            continue;
+        }
+
+        // smallest index first, rotating keeps the winding, so equal triangles compare equal
+        while (triangle[0] > triangle[1] || triangle[0] > triangle[2])
+        {
+            std::rotate(triangle.begin(), triangle.begin() + 1, triangle.end());
+        }
+        triangles.push_back(triangle);
+    }
+
+    std::sort(triangles.begin(), triangles.end());
+    triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+
+    lodIndices.reserve(lodIndices.size() + triangles.size() * 3);
+    for (const std::array<uint32_t, 3>& triangle : triangles)
+    {
+        lodIndices.insert(lodIndices.end(), triangle.begin(), triangle.end());
+    }
+    return static_cast<uint32_t>(triangles.size());
+}
+
+void LodSelector::resize(uint32_t count)
+{
+    mCount = count;
+    const size_t paddedCount = (static_cast<size_t>(count) + 3) & ~static_cast<size_t>(3);
+    std::vector<float>* components[] = { &mCenterX, &mCenterY, &mCenterZ, &mRadius, &mInvRadius, &mMaxLod };
+    for (std::vector<float>* component : components)
+    {
+        component->resize(paddedCount, 0.f);
+    }
+}
+
+void LodSelector::setObject(uint32_t index, const Bounds& bounds, uint32_t lodCount)
+{
+    assert(lodCount > 0 && lodCount <= 256);
+    mCenterX[index] = bounds.center.x;
+    mCenterY[index] = bounds.center.y;
+    mCenterZ[index] = bounds.center.z;
+    mRadius[index] = bounds.radius;
+    mInvRadius[index] = bounds.radius > 0.f ? 1.f / bounds.radius : 0.f;
+    mMaxLod[index] = static_cast<float>(lodCount - 1);
+}
+
+// Objects closer than this to their bounding sphere count as inside it.
+static const float MinDistance{ 1e-6f };
+
+// floor(log2(x)) + 1, the exponent of x once written as m * 2^e with m in [0.5, 1)
+static int getLevel(float x)
+{
+    int exponent;
+    std::frexp(x, &exponent);
+    return exponent;
+}
+
+static __m128 getLevels(__m128 x)
+{
+    const __m128i exponent = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(x), 23), _mm_set1_epi32(126));
+    return _mm_cvtepi32_ps(exponent);
+}
+
+void LodSelector::selectScalar(const Float3& cameraPosition, float projectionScale, uint32_t begin, uint32_t end, uint8_t* lods) const
+{
+    // x = distance / radius * scale is 1 where the error of LOD 1 projects to the threshold
+    const float scale = mConfig.maxErrorPixels * mBias / (mConfig.errorScale * projectionScale);
+    const float fineScale = scale * (1.f - mConfig.hysteresis);
+    const float coarseScale = scale * (1.f + mConfig.hysteresis);
+    for (uint32_t i = begin; i < end; i++)
+    {
+        const float dx = mCenterX[i] - cameraPosition.x;
+        const float dy = mCenterY[i] - cameraPosition.y;
+        const float dz = mCenterZ[i] - cameraPosition.z;
+        const float distance = std::max(std::sqrt(dx * dx + dy * dy + dz * dz) - mRadius[i], MinDistance);
+        const float x = distance * mInvRadius[i];
+
+        const int maxLod = static_cast<int>(mMaxLod[i]);
+        const int fine = std::min(std::max(getLevel(x * fineScale), 0), maxLod);
+        const int coarse = std::min(std::max(getLevel(x * coarseScale), 0), maxLod);
+        lods[i] = static_cast<uint8_t>(std::min(std::max(static_cast<int>(lods[i]), fine), coarse));
+    }
+}
+
+void LodSelector::select(const Float3& cameraPosition, float projectionScale, uint32_t begin, uint32_t end, uint8_t* lods) const
+{
+    assert(end <= mCount);
+    const float scale = mConfig.maxErrorPixels * mBias / (mConfig.errorScale * projectionScale);
+    const __m128 fineScale = _mm_set1_ps(scale * (1.f - mConfig.hysteresis));
+    const __m128 coarseScale = _mm_set1_ps(scale * (1.f + mConfig.hysteresis));
+    const __m128 cameraX = _mm_set1_ps(cameraPosition.x);
+    const __m128 cameraY = _mm_set1_ps(cameraPosition.y);
+    const __m128 cameraZ = _mm_set1_ps(cameraPosition.z);
+    const __m128 minDistance = _mm_set1_ps(MinDistance);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128i zeroInt = _mm_setzero_si128();
+
+    uint32_t i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        const __m128 dx = _mm_sub_ps(_mm_loadu_ps(&mCenterX[i]), cameraX);
+        const __m128 dy = _mm_sub_ps(_mm_loadu_ps(&mCenterY[i]), cameraY);
+        const __m128 dz = _mm_sub_ps(_mm_loadu_ps(&mCenterZ[i]), cameraZ);
+        const __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        const __m128 distance = _mm_max_ps(_mm_sub_ps(_mm_sqrt_ps(lengthSq), _mm_loadu_ps(&mRadius[i])), minDistance);
+        const __m128 x = _mm_mul_ps(distance, _mm_loadu_ps(&mInvRadius[i]));
+
+        // the levels are small integers, exact in floats, so the clamps stay in SSE
+        const __m128 maxLod = _mm_loadu_ps(&mMaxLod[i]);
+        const __m128 fine = _mm_min_ps(_mm_max_ps(getLevels(_mm_mul_ps(x, fineScale)), zero), maxLod);
+        const __m128 coarse = _mm_min_ps(_mm_max_ps(getLevels(_mm_mul_ps(x, coarseScale)), zero), maxLod);
+
+        int32_t packed;
+        memcpy(&packed, lods + i, sizeof(packed));
+        const __m128i current = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zeroInt), zeroInt);
+        const __m128 lod = _mm_min_ps(_mm_max_ps(_mm_cvtepi32_ps(current), fine), coarse);
+
+        const __m128i lod16 = _mm_packs_epi32(_mm_cvttps_epi32(lod), zeroInt);
+        packed = _mm_cvtsi128_si32(_mm_packus_epi16(lod16, zeroInt));
+        memcpy(lods + i, &packed, sizeof(packed));
+    }
+    selectScalar(cameraPosition, projectionScale, i, end, lods);
+}
+
+void LodSelector::updateBias(uint64_t triangles)
+{
+    if (mConfig.triangleBudget == 0)
+    {
+        mBias = 1.f;
+        return;
+    }
+
+    const float ratio = static_cast<float>(triangles) / static_cast<float>(mConfig.triangleBudget);
+    if (ratio > 1.f)
+    {
+        // the triangles of a surface fall with the square of the error, so this about meets the budget next frame
+        mBias = std::min(mBias * std::sqrt(ratio), mConfig.maxBias);
+    }
+    else if (ratio < 0.8f)
+    {
+        // refine slowly, well under the budget only, so the bias does not oscillate around a LOD switch
+        mBias = std::max(mBias * 0.98f, 1.f);
+    }
+}
+
+}
\ No newline at end of file
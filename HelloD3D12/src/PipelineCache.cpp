@@ -0,0 +1,381 @@
+#include "stdafx.h"
+
+#include <assert.h>
+#include <chrono>
+#include <d3d12shader.h>
+#include "Asset.h"
+#include "Hash.h"
+#include "PipelineCache.h"
+
+namespace HDX
+{
+
+static void hashBytecode(Hasher& hasher, const D3D12_SHADER_BYTECODE& bytecode)
+{
+    hasher.add(static_cast<uint64_t>(bytecode.BytecodeLength));
+    hasher.addBytes(bytecode.pShaderBytecode, bytecode.BytecodeLength);
+}
+
+// Resolves #include "file" to assets/shaders/file.
+class AssetInclude : public ID3DInclude
+{
+public:
+    HRESULT __stdcall Open(D3D_INCLUDE_TYPE /*includeType*/, LPCSTR fileName, LPCVOID /*parentData*/, LPCVOID* data, UINT* bytes) override
+    {
+        Asset asset(std::string("shaders/") + fileName, 0);
+        uint32_t size = asset.getLength();
+        if (size == 0)
+        {
+            return E_FAIL;
+        }
+
+        char* buffer = new char[size];
+        asset.read(buffer, size);
+        asset.close();
+        *data = buffer;
+        *bytes = size;
+        return S_OK;
+    }
+
+    HRESULT __stdcall Close(LPCVOID data) override
+    {
+        delete[] static_cast<const char*>(data);
+        return S_OK;
+    }
+};
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool PipelineCache::prepare(ID3D12Device* device, const char* directory)
+{
+    mDevice = device;
+    CreateDirectoryA(directory, nullptr);
+    mShaderPath = std::string(directory) + "/shaders.bin";
+    mLibraryPath = std::string(directory) + "/pipelines.bin";
+
+    // bytecode from another compiler version is not reused
+    mShaders = CacheFile(Hasher().addString("D3DCompile").add(static_cast<uint32_t>(D3D_COMPILER_VERSION)).get());
+    mShaders.load(mShaderPath.c_str());
+    if (mShaders.getCorruptEntryCount() > 0)
+    {
+        LOG_INFO("Dropped %u corrupt shader cache entries\n", mShaders.getCorruptEntryCount());
+    }
+
+    ComPtr<ID3D12Device1> device1;
+    if (FAILED(mDevice.As(&device1)))
+    {
+        LOG_INFO("ID3D12PipelineLibrary is not supported, pipelines are not cached\n");
+        return true;
+    }
+
+    mLibraryFile = CacheFile(Hasher().addString("ID3D12PipelineLibrary").get());
+    mLibraryFile.load(mLibraryPath.c_str());
+    const std::vector<uint8_t>* blob = mLibraryFile.find(LibraryKey);
+    if (blob && !blob->empty())
+    {
+        mLibraryData = *blob;
+        HRESULT hr = device1->CreatePipelineLibrary(mLibraryData.data(), mLibraryData.size(), IID_PPV_ARGS(&mLibrary));
+        if (FAILED(hr))
+        {
+            // D3D12_ERROR_DRIVER_VERSION_MISMATCH or D3D12_ERROR_ADAPTER_NOT_FOUND, the pipelines are compiled again
+            LOG_INFO("Pipeline library rejected (0x%08x), rebuilding it\n", static_cast<unsigned>(hr));
+            mLibrary = nullptr;
+            mLibraryData.clear();
+        }
+    }
+
+    if (!mLibrary)
+    {
+        HR_ERROR_CHECK_CALL(device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&mLibrary)), false, "Failed to create pipeline library\n");
+        mLibraryDirty = true;
+    }
+
+    return true;
+}
+
+bool PipelineCache::compileShader(const char* source,
+                                  size_t sourceSize,
+                                  const D3D_SHADER_MACRO* defines,
+                                  const char* entryPoint,
+                                  const char* target,
+                                  UINT flags,
+                                  ComPtr<ID3DBlob>& bytecode)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    const uint64_t key = hashShader(source, sourceSize, defines, entryPoint, target, flags);
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        const std::vector<uint8_t>* cached = mShaders.find(key);
+        if (cached)
+        {
+            HR_ERROR_CHECK_CALL(D3DCreateBlob(cached->size(), &bytecode), false, "Failed to create shader blob\n");
+            memcpy(bytecode->GetBufferPointer(), cached->data(), cached->size());
+            mStats.shaderHits++;
+            mStats.shaderMs += elapsedMs(start);
+            return true;
+        }
+    }
+
+    ComPtr<ID3DBlob> errorMsg;
+    if (FAILED(D3DCompile(source, sourceSize, nullptr, defines, nullptr, entryPoint, target, flags, 0, &bytecode, &errorMsg)))
+    {
+        if (errorMsg)
+        {
+            LOG_ERROR(reinterpret_cast<const char*>(errorMsg->GetBufferPointer()));
+        }
+
+        assert(false);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mShaders.insert(key, bytecode->GetBufferPointer(), bytecode->GetBufferSize());
+    mStats.shaderMisses++;
+    mStats.shaderMs += elapsedMs(start);
+    return true;
+}
+
+bool PipelineCache::compileShaderAsset(const char* name,
+                                       const D3D_SHADER_MACRO* defines,
+                                       const char* entryPoint,
+                                       const char* target,
+                                       UINT flags,
+                                       ComPtr<ID3DBlob>& bytecode)
+{
+    std::string path = std::string("shaders/") + name + ".hlsl";
+    Asset asset(path, 0);
+    std::vector<char> source(asset.getLength());
+    if (source.empty())
+    {
+        LOG_ERROR("Missing shader source %s\n", path.c_str());
+        return false;
+    }
+    asset.read(source.data(), static_cast<uint32_t>(source.size()));
+    asset.close();
+
+    // the defines are applied by the preprocessor, the expanded text alone identifies the shader
+    AssetInclude include;
+    ComPtr<ID3DBlob> preprocessed;
+    ComPtr<ID3DBlob> errorMsg;
+    if (FAILED(D3DPreprocess(source.data(), source.size(), path.c_str(), defines, &include, &preprocessed, &errorMsg)))
+    {
+        if (errorMsg)
+        {
+            LOG_ERROR(reinterpret_cast<const char*>(errorMsg->GetBufferPointer()));
+        }
+        return false;
+    }
+
+    return compileShader(reinterpret_cast<const char*>(preprocessed->GetBufferPointer()), preprocessed->GetBufferSize(), nullptr, entryPoint, target, flags, bytecode);
+}
+
+bool PipelineCache::loadShader(const char* name, ComPtr<ID3DBlob>& bytecode)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    Asset asset(std::string("shaders/") + name + ".cso", 0);
+    uint32_t size = asset.getLength();
+    if (size == 0)
+    {
+        LOG_ERROR("Missing shader %s, is the shader build step up to date?\n", name);
+        return false;
+    }
+
+    HR_ERROR_CHECK_CALL(D3DCreateBlob(size, &bytecode), false, "Failed to create shader blob\n");
+    asset.read(bytecode->GetBufferPointer(), size);
+    asset.close();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStats.shaderLoads++;
+    mStats.shaderLoadBytes += size;
+    mStats.shaderLoadMs += elapsedMs(start);
+    return true;
+}
+
+bool PipelineCache::findShaderBinding(ID3DBlob* bytecode, const char* name, D3D12_SHADER_INPUT_BIND_DESC& binding)
+{
+    ComPtr<ID3D12ShaderReflection> reflection;
+    HR_ERROR_CHECK_CALL(D3DReflect(bytecode->GetBufferPointer(), bytecode->GetBufferSize(), IID_PPV_ARGS(&reflection)), false, "Failed to reflect shader\n");
+    return SUCCEEDED(reflection->GetResourceBindingDescByName(name, &binding));
+}
+
+bool PipelineCache::createRootSignature(const void* blob, size_t size, ComPtr<ID3D12RootSignature>& rootSignature)
+{
+    HR_ERROR_CHECK_CALL(mDevice->CreateRootSignature(0, blob, size, IID_PPV_ARGS(&rootSignature)), false, "Failed to create root signature\n");
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRootSignatureHashes[rootSignature.Get()] = hashBytes(blob, size);
+    return true;
+}
+
+bool PipelineCache::createGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, ComPtr<ID3D12PipelineState>& pipelineState)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    uint64_t rootSignatureHash = 0;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mRootSignatureHashes.find(desc.pRootSignature);
+        assert(it != mRootSignatureHashes.end());
+        if (it != mRootSignatureHashes.end())
+        {
+            rootSignatureHash = it->second;
+        }
+    }
+
+    wchar_t name[17];
+    swprintf_s(name, L"%016llx", hashPipelineDesc(desc, rootSignatureHash));
+
+    if (mLibrary)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        // fails with E_INVALIDARG when the name is missing or the stored description differs
+        if (SUCCEEDED(mLibrary->LoadGraphicsPipeline(name, &desc, IID_PPV_ARGS(&pipelineState))))
+        {
+            mStats.pipelineHits++;
+            mStats.pipelineMs += elapsedMs(start);
+            return true;
+        }
+    }
+
+    // compile outside the lock, pipelines of other threads keep loading meanwhile
+    HR_ERROR_CHECK_CALL(mDevice->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipelineState)), false, "Failed to create graphics pipeline state\n");
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mLibrary && SUCCEEDED(mLibrary->StorePipeline(name, pipelineState.Get())))
+    {
+        mLibraryDirty = true;
+    }
+    mStats.pipelineMisses++;
+    mStats.pipelineMs += elapsedMs(start);
+    return true;
+}
+
+bool PipelineCache::save()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    bool saved = true;
+    if (mShaders.isDirty() && !mShaders.save(mShaderPath.c_str()))
+    {
+        LOG_ERROR("Failed to save shader cache %s\n", mShaderPath.c_str());
+        saved = false;
+    }
+
+    if (mLibrary && mLibraryDirty)
+    {
+        std::vector<uint8_t> blob(mLibrary->GetSerializedSize());
+        HR_ERROR_CHECK_CALL(mLibrary->Serialize(blob.data(), blob.size()), false, "Failed to serialize pipeline library\n");
+        mLibraryFile.insert(LibraryKey, blob.data(), blob.size());
+        if (mLibraryFile.save(mLibraryPath.c_str()))
+        {
+            mLibraryDirty = false;
+        }
+        else
+        {
+            LOG_ERROR("Failed to save pipeline library %s\n", mLibraryPath.c_str());
+            saved = false;
+        }
+    }
+
+    return saved;
+}
+
+PipelineCache::Stats PipelineCache::getStats()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+uint64_t PipelineCache::hashShader(const char* source, size_t sourceSize, const D3D_SHADER_MACRO* defines, const char* entryPoint, const char* target, UINT flags)
+{
+    Hasher hasher;
+    hasher.add(static_cast<uint64_t>(sourceSize));
+    hasher.addBytes(source, sourceSize);
+    for (const D3D_SHADER_MACRO* define = defines; define && define->Name; define++)
+    {
+        hasher.addString(define->Name).addString(define->Definition);
+    }
+    hasher.addString(entryPoint).addString(target).add(static_cast<uint32_t>(flags));
+    return hasher.get();
+}
+
+uint64_t PipelineCache::hashPipelineDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureHash)
+{
+    Hasher hasher;
+    hasher.add(rootSignatureHash);
+    hashBytecode(hasher, desc.VS);
+    hashBytecode(hasher, desc.PS);
+    hashBytecode(hasher, desc.DS);
+    hashBytecode(hasher, desc.HS);
+    hashBytecode(hasher, desc.GS);
+
+    const D3D12_STREAM_OUTPUT_DESC& streamOutput = desc.StreamOutput;
+    hasher.add(static_cast<uint32_t>(streamOutput.NumEntries));
+    for (UINT i = 0; i < streamOutput.NumEntries; i++)
+    {
+        const D3D12_SO_DECLARATION_ENTRY& entry = streamOutput.pSODeclaration[i];
+        hasher.add(static_cast<uint32_t>(entry.Stream)).addString(entry.SemanticName).add(static_cast<uint32_t>(entry.SemanticIndex));
+        hasher.add(static_cast<uint32_t>(entry.StartComponent)).add(static_cast<uint32_t>(entry.ComponentCount)).add(static_cast<uint32_t>(entry.OutputSlot));
+    }
+    hasher.add(static_cast<uint32_t>(streamOutput.NumStrides));
+    for (UINT i = 0; i < streamOutput.NumStrides; i++)
+    {
+        hasher.add(static_cast<uint32_t>(streamOutput.pBufferStrides[i]));
+    }
+    hasher.add(static_cast<uint32_t>(streamOutput.RasterizedStream));
+
+    const D3D12_BLEND_DESC& blend = desc.BlendState;
+    hasher.add(static_cast<uint32_t>(blend.AlphaToCoverageEnable)).add(static_cast<uint32_t>(blend.IndependentBlendEnable));
+    for (const D3D12_RENDER_TARGET_BLEND_DESC& target : blend.RenderTarget)
+    {
+        hasher.add(static_cast<uint32_t>(target.BlendEnable)).add(static_cast<uint32_t>(target.LogicOpEnable));
+        hasher.add(static_cast<uint32_t>(target.SrcBlend)).add(static_cast<uint32_t>(target.DestBlend)).add(static_cast<uint32_t>(target.BlendOp));
+        hasher.add(static_cast<uint32_t>(target.SrcBlendAlpha)).add(static_cast<uint32_t>(target.DestBlendAlpha)).add(static_cast<uint32_t>(target.BlendOpAlpha));
+        hasher.add(static_cast<uint32_t>(target.LogicOp)).add(static_cast<uint32_t>(target.RenderTargetWriteMask));
+    }
+    hasher.add(static_cast<uint32_t>(desc.SampleMask));
+
+    const D3D12_RASTERIZER_DESC& rasterizer = desc.RasterizerState;
+    hasher.add(static_cast<uint32_t>(rasterizer.FillMode)).add(static_cast<uint32_t>(rasterizer.CullMode)).add(static_cast<uint32_t>(rasterizer.FrontCounterClockwise));
+    hasher.add(static_cast<int32_t>(rasterizer.DepthBias)).add(rasterizer.DepthBiasClamp).add(rasterizer.SlopeScaledDepthBias);
+    hasher.add(static_cast<uint32_t>(rasterizer.DepthClipEnable)).add(static_cast<uint32_t>(rasterizer.MultisampleEnable));
+    hasher.add(static_cast<uint32_t>(rasterizer.AntialiasedLineEnable)).add(static_cast<uint32_t>(rasterizer.ForcedSampleCount));
+    hasher.add(static_cast<uint32_t>(rasterizer.ConservativeRaster));
+
+    const D3D12_DEPTH_STENCIL_DESC& depthStencil = desc.DepthStencilState;
+    hasher.add(static_cast<uint32_t>(depthStencil.DepthEnable)).add(static_cast<uint32_t>(depthStencil.DepthWriteMask)).add(static_cast<uint32_t>(depthStencil.DepthFunc));
+    hasher.add(static_cast<uint32_t>(depthStencil.StencilEnable)).add(static_cast<uint32_t>(depthStencil.StencilReadMask)).add(static_cast<uint32_t>(depthStencil.StencilWriteMask));
+    const D3D12_DEPTH_STENCILOP_DESC* faces[] = { &depthStencil.FrontFace, &depthStencil.BackFace };
+    for (const D3D12_DEPTH_STENCILOP_DESC* face : faces)
+    {
+        hasher.add(static_cast<uint32_t>(face->StencilFailOp)).add(static_cast<uint32_t>(face->StencilDepthFailOp));
+        hasher.add(static_cast<uint32_t>(face->StencilPassOp)).add(static_cast<uint32_t>(face->StencilFunc));
+    }
+
+    hasher.add(static_cast<uint32_t>(desc.InputLayout.NumElements));
+    for (UINT i = 0; i < desc.InputLayout.NumElements; i++)
+    {
+        const D3D12_INPUT_ELEMENT_DESC& element = desc.InputLayout.pInputElementDescs[i];
+        hasher.addString(element.SemanticName).add(static_cast<uint32_t>(element.SemanticIndex)).add(static_cast<uint32_t>(element.Format));
+        hasher.add(static_cast<uint32_t>(element.InputSlot)).add(static_cast<uint32_t>(element.AlignedByteOffset));
+        hasher.add(static_cast<uint32_t>(element.InputSlotClass)).add(static_cast<uint32_t>(element.InstanceDataStepRate));
+    }
+
+    hasher.add(static_cast<uint32_t>(desc.IBStripCutValue)).add(static_cast<uint32_t>(desc.PrimitiveTopologyType));
+    hasher.add(static_cast<uint32_t>(desc.NumRenderTargets));
+    for (DXGI_FORMAT format : desc.RTVFormats)
+    {
+        hasher.add(static_cast<uint32_t>(format));
+    }
+    hasher.add(static_cast<uint32_t>(desc.DSVFormat));
+    hasher.add(static_cast<uint32_t>(desc.SampleDesc.Count)).add(static_cast<uint32_t>(desc.SampleDesc.Quality));
+    hasher.add(static_cast<uint32_t>(desc.NodeMask)).add(static_cast<uint32_t>(desc.Flags));
+    return hasher.get();
+}
+
+}
\ No newline at end of file
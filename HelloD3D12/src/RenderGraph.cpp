@@ -0,0 +1,556 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <assert.h>
+
+namespace HDX
+{
+
+static const uint32_t WriteStates = ResourceStateRenderTarget | ResourceStateUnorderedAccess | ResourceStateDepthWrite | ResourceStateCopyDest;
+
+void RenderGraph::reset()
+{
+    mResources.clear();
+    mPasses.clear();
+    mAccesses.clear();
+    mAccessesSorted = true;
+    mSchedule.clear();
+    mBarriers.clear();
+    mAliasGroupSizes.clear();
+    mStats = Stats();
+}
+
+RenderGraph::ResourceHandle RenderGraph::importResource(const char* name, uint32_t initialState, uint32_t finalState)
+{
+    Resource resource{};
+    resource.name = name;
+    resource.initialState = initialState;
+    resource.finalState = finalState;
+    resource.imported = true;
+    mResources.push_back(resource);
+    return static_cast<ResourceHandle>(mResources.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::createTransient(const char* name, const RenderGraphResourceDesc& desc)
+{
+    assert(desc.alignment != 0 && (desc.alignment & (desc.alignment - 1)) == 0);
+
+    Resource resource{};
+    resource.name = name;
+    resource.desc = desc;
+    resource.imported = false;
+    mResources.push_back(resource);
+    return static_cast<ResourceHandle>(mResources.size() - 1);
+}
+
+RenderGraph::PassHandle RenderGraph::addPass(const char* name, uint32_t commandList, bool hasSideEffects)
+{
+    Pass pass{};
+    pass.name = name;
+    pass.commandList = commandList;
+    pass.hasSideEffects = hasSideEffects;
+    mPasses.push_back(pass);
+    return static_cast<PassHandle>(mPasses.size() - 1);
+}
+
+void RenderGraph::read(PassHandle pass, ResourceHandle resource, uint32_t state)
+{
+    assert(isReadState(state) || state == ResourceStateCommon);
+    addAccess(pass, resource, state, false);
+}
+
+void RenderGraph::write(PassHandle pass, ResourceHandle resource, uint32_t state)
+{
+    addAccess(pass, resource, state, true);
+}
+
+bool RenderGraph::compile()
+{
+    if (!mAccessesSorted)
+    {
+        std::stable_sort(mAccesses.begin(), mAccesses.end(), [](const Access& a, const Access& b) { return a.pass < b.pass; });
+        mAccessesSorted = true;
+    }
+
+    // accesses of pass p are [mAccessBegin[p], mAccessBegin[p + 1])
+    mAccessBegin.assign(mPasses.size() + 1, 0);
+    for (const Access& access : mAccesses)
+    {
+        mAccessBegin[access.pass + 1]++;
+    }
+    for (size_t pass = 0; pass < mPasses.size(); pass++)
+    {
+        mAccessBegin[pass + 1] += mAccessBegin[pass];
+    }
+
+    cullPasses();
+    if (!buildSchedule())
+    {
+        return false;
+    }
+    placeTransients();
+    buildBarriers();
+    return true;
+}
+
+uint64_t RenderGraph::getAliasGroupSize(uint32_t aliasGroup) const
+{
+    return aliasGroup < mAliasGroupSizes.size() ? mAliasGroupSizes[aliasGroup] : 0;
+}
+
+bool RenderGraph::isReadState(uint32_t state)
+{
+    return state != ResourceStateCommon && (state & WriteStates) == 0;
+}
+
+void RenderGraph::addAccess(PassHandle pass, ResourceHandle resource, uint32_t state, bool write)
+{
+    assert(pass < mPasses.size() && resource < mResources.size());
+
+    if (!mAccesses.empty() && mAccesses.back().pass > pass)
+    {
+        mAccessesSorted = false;
+    }
+    mAccesses.push_back({ pass, resource, state, write });
+}
+
+void RenderGraph::cullPasses()
+{
+    for (Resource& resource : mResources)
+    {
+        resource.readers = 0;
+    }
+    for (Pass& pass : mPasses)
+    {
+        pass.culled = false;
+        pass.writes = 0;
+    }
+
+    for (const Access& access : mAccesses)
+    {
+        if (access.write)
+        {
+            mPasses[access.pass].writes++;
+        }
+        else
+        {
+            mResources[access.resource].readers++;
+        }
+    }
+
+    auto cull = [this](PassHandle pass)
+    {
+        mPasses[pass].culled = true;
+        for (uint32_t i = mAccessBegin[pass]; i < mAccessBegin[pass + 1]; i++)
+        {
+            const Access& access = mAccesses[i];
+            if (!access.write && --mResources[access.resource].readers == 0 && !mResources[access.resource].imported)
+            {
+                mCullStack.push_back(access.resource);
+            }
+        }
+    };
+
+    // imported resources are read by whatever comes after the graph, they are never unreferenced
+    mCullStack.clear();
+    for (ResourceHandle resource = 0; resource < mResources.size(); resource++)
+    {
+        if (mResources[resource].readers == 0 && !mResources[resource].imported)
+        {
+            mCullStack.push_back(resource);
+        }
+    }
+    for (PassHandle pass = 0; pass < mPasses.size(); pass++)
+    {
+        if (mPasses[pass].writes == 0 && !mPasses[pass].hasSideEffects)
+        {
+            cull(pass);
+        }
+    }
+
+    while (!mCullStack.empty())
+    {
+        ResourceHandle resource = mCullStack.back();
+        mCullStack.pop_back();
+
+        // graphs are a handful of passes, scanning the accesses is cheaper than indexing writers per resource
+        for (const Access& access : mAccesses)
+        {
+            if (!access.write || access.resource != resource)
+            {
+                continue;
+            }
+
+            Pass& pass = mPasses[access.pass];
+            if (!pass.culled && --pass.writes == 0 && !pass.hasSideEffects)
+            {
+                cull(access.pass);
+            }
+        }
+    }
+}
+
+bool RenderGraph::buildSchedule()
+{
+    mSchedule.clear();
+    for (PassHandle pass = 0; pass < mPasses.size(); pass++)
+    {
+        if (mPasses[pass].culled)
+        {
+            mStats.culledPasses++;
+            continue;
+        }
+
+        if (!mSchedule.empty() && mSchedule.back().commandList > mPasses[pass].commandList)
+        {
+            return false;
+        }
+
+        mSchedule.push_back({ pass, mPasses[pass].commandList, 0, 0, 0, 0 });
+    }
+    mStats.passes = static_cast<uint32_t>(mPasses.size());
+
+    for (Resource& resource : mResources)
+    {
+        resource.firstUse = InvalidHandle;
+        resource.lastUse = InvalidHandle;
+        resource.offset = 0;
+    }
+
+    for (uint32_t index = 0; index < mSchedule.size(); index++)
+    {
+        PassHandle pass = mSchedule[index].pass;
+        for (uint32_t i = mAccessBegin[pass]; i < mAccessBegin[pass + 1]; i++)
+        {
+            Resource& resource = mResources[mAccesses[i].resource];
+            if (resource.firstUse == InvalidHandle)
+            {
+                resource.firstUse = index;
+            }
+            resource.lastUse = index;
+        }
+    }
+
+    return true;
+}
+
+void RenderGraph::placeTransients()
+{
+    mPlacementOrder.clear();
+    for (ResourceHandle resource = 0; resource < mResources.size(); resource++)
+    {
+        const Resource& r = mResources[resource];
+        if (!r.imported && r.firstUse != InvalidHandle)
+        {
+            mPlacementOrder.push_back(resource);
+            if (r.desc.aliasGroup >= mAliasGroupSizes.size())
+            {
+                mAliasGroupSizes.resize(r.desc.aliasGroup + 1, 0);
+            }
+        }
+    }
+
+    // largest first packs best, the remaining resources fill the gaps around them
+    std::sort(mPlacementOrder.begin(), mPlacementOrder.end(), [this](ResourceHandle a, ResourceHandle b)
+    {
+        const Resource& ra = mResources[a];
+        const Resource& rb = mResources[b];
+        if (ra.desc.size != rb.desc.size)
+        {
+            return ra.desc.size > rb.desc.size;
+        }
+        return ra.firstUse < rb.firstUse;
+    });
+
+    for (size_t placed = 0; placed < mPlacementOrder.size(); placed++)
+    {
+        Resource& resource = mResources[mPlacementOrder[placed]];
+        const uint64_t alignment = resource.desc.alignment;
+
+        // placed resources alive at the same time, by offset: take the first aligned gap that fits
+        mLiveNeighbours.clear();
+        for (size_t i = 0; i < placed; i++)
+        {
+            const Resource& other = mResources[mPlacementOrder[i]];
+            if (other.desc.aliasGroup == resource.desc.aliasGroup && resource.firstUse <= other.lastUse && other.firstUse <= resource.lastUse)
+            {
+                mLiveNeighbours.push_back(mPlacementOrder[i]);
+            }
+        }
+        std::sort(mLiveNeighbours.begin(), mLiveNeighbours.end(), [this](ResourceHandle a, ResourceHandle b)
+        {
+            return mResources[a].offset < mResources[b].offset;
+        });
+
+        uint64_t offset = 0;
+        for (ResourceHandle neighbour : mLiveNeighbours)
+        {
+            const Resource& other = mResources[neighbour];
+            if (offset + resource.desc.size <= other.offset)
+            {
+                break;
+            }
+            offset = std::max(offset, (other.offset + other.desc.size + alignment - 1) & ~(alignment - 1));
+        }
+
+        resource.offset = offset;
+        uint64_t& groupSize = mAliasGroupSizes[resource.desc.aliasGroup];
+        groupSize = std::max(groupSize, offset + resource.desc.size);
+        mStats.unaliasedBytes += resource.desc.size;
+    }
+
+    for (uint64_t groupSize : mAliasGroupSizes)
+    {
+        mStats.transientBytes += groupSize;
+    }
+}
+
+void RenderGraph::buildBarriers()
+{
+    const uint32_t scheduleSize = static_cast<uint32_t>(mSchedule.size());
+    if (mBarriersBefore.size() < scheduleSize)
+    {
+        mBarriersBefore.resize(scheduleSize);
+        mBarriersAfter.resize(scheduleSize);
+    }
+    for (uint32_t i = 0; i < scheduleSize; i++)
+    {
+        mBarriersBefore[i].clear();
+        mBarriersAfter[i].clear();
+    }
+
+    const uint32_t commandListCount = scheduleSize > 0 ? mSchedule.back().commandList + 1 : 0;
+    if (mBarriersTail.size() < commandListCount)
+    {
+        mBarriersTail.resize(commandListCount);
+    }
+    for (std::vector<Barrier>& tail : mBarriersTail)
+    {
+        tail.clear();
+    }
+
+    for (ResourceHandle handle : mPlacementOrder)
+    {
+        mResources[handle].nextOccupantUse = InvalidHandle;
+    }
+
+    // aliasing barriers go first so the transitions of a point apply to the activated resources
+    for (ResourceHandle handle : mPlacementOrder)
+    {
+        const Resource& resource = mResources[handle];
+        bool aliased = false;
+        ResourceHandle previous = InvalidHandle;
+        for (ResourceHandle otherHandle : mPlacementOrder)
+        {
+            const Resource& other = mResources[otherHandle];
+            if (otherHandle == handle || other.desc.aliasGroup != resource.desc.aliasGroup
+                || resource.offset >= other.offset + other.desc.size || other.offset >= resource.offset + resource.desc.size)
+            {
+                continue;
+            }
+
+            aliased = true;
+            if (other.lastUse < resource.firstUse && (previous == InvalidHandle || mResources[previous].lastUse < other.lastUse))
+            {
+                previous = otherHandle;
+            }
+        }
+
+        if (aliased)
+        {
+            mBarriersBefore[resource.firstUse].push_back({ BarrierType::Aliasing, BarrierSplit::Full, handle, previous, 0, 0 });
+        }
+        if (previous != InvalidHandle)
+        {
+            Resource& retired = mResources[previous];
+            retired.nextOccupantUse = std::min(retired.nextOccupantUse, resource.firstUse);
+        }
+    }
+
+    for (ResourceHandle handle = 0; handle < mResources.size(); handle++)
+    {
+        Resource& resource = mResources[handle];
+        if (resource.firstUse == InvalidHandle)
+        {
+            continue;
+        }
+
+        // state of a run of uses: a write, or the union of the reads up to the next write
+        uint32_t useIndex = resource.firstUse;
+        auto nextRun = [this, handle, &useIndex, &resource](uint32_t &runStart, uint32_t &runEnd) -> uint32_t
+        {
+            uint32_t state = 0;
+            bool started = false;
+            for (; useIndex <= resource.lastUse; useIndex++)
+            {
+                PassHandle pass = mSchedule[useIndex].pass;
+                uint32_t passState = 0;
+                bool uses = false;
+                for (uint32_t i = mAccessBegin[pass]; i < mAccessBegin[pass + 1]; i++)
+                {
+                    if (mAccesses[i].resource == handle)
+                    {
+                        passState |= mAccesses[i].state;
+                        uses = true;
+                    }
+                }
+                if (!uses)
+                {
+                    continue;
+                }
+
+                if (!started)
+                {
+                    runStart = useIndex;
+                    state = passState;
+                    started = true;
+                    if (!isReadState(state))
+                    {
+                        runEnd = useIndex++;
+                        return state;
+                    }
+                }
+                else if (isReadState(passState))
+                {
+                    state |= passState;
+                }
+                else
+                {
+                    break;
+                }
+                runEnd = useIndex;
+            }
+            return state;
+        };
+
+        uint32_t runStart = 0;
+        uint32_t runEnd = 0;
+        uint32_t state = nextRun(runStart, runEnd);
+        if (!resource.imported)
+        {
+            resource.initialState = state;
+            resource.finalState = state;
+        }
+        resource.state = resource.initialState;
+
+        uint32_t lastUse = InvalidHandle;
+        for (;;)
+        {
+            // a combined read state already covering the run needs no barrier
+            bool covered = resource.state == state || (isReadState(resource.state) && (resource.state & state) == state);
+            if (!covered)
+            {
+                addTransition(lastUse, runStart, handle, resource.state, state);
+                resource.state = state;
+            }
+            lastUse = runEnd;
+
+            if (useIndex > resource.lastUse)
+            {
+                break;
+            }
+            state = nextRun(runStart, runEnd);
+        }
+
+        if (resource.state != resource.finalState)
+        {
+            if (!resource.imported && resource.nextOccupantUse != InvalidHandle)
+            {
+                retire(lastUse, resource.nextOccupantUse, handle, resource.state, resource.finalState);
+            }
+            else
+            {
+                addTransition(lastUse, InvalidHandle, handle, resource.state, resource.finalState);
+            }
+            resource.state = resource.finalState;
+        }
+    }
+
+    mBarriers.clear();
+    for (uint32_t i = 0; i < scheduleSize; i++)
+    {
+        ScheduledPass& scheduled = mSchedule[i];
+        scheduled.firstBarrierBefore = static_cast<uint32_t>(mBarriers.size());
+        scheduled.barrierBeforeCount = static_cast<uint32_t>(mBarriersBefore[i].size());
+        mBarriers.insert(mBarriers.end(), mBarriersBefore[i].begin(), mBarriersBefore[i].end());
+        scheduled.firstBarrierAfter = static_cast<uint32_t>(mBarriers.size());
+        scheduled.barrierAfterCount = static_cast<uint32_t>(mBarriersAfter[i].size());
+        mBarriers.insert(mBarriers.end(), mBarriersAfter[i].begin(), mBarriersAfter[i].end());
+
+        mStats.barrierBatches += (scheduled.barrierBeforeCount > 0 ? 1 : 0) + (scheduled.barrierAfterCount > 0 ? 1 : 0);
+    }
+
+    mTails.resize(commandListCount);
+    for (uint32_t commandList = 0; commandList < commandListCount; commandList++)
+    {
+        mTails[commandList].firstBarrier = static_cast<uint32_t>(mBarriers.size());
+        mTails[commandList].barrierCount = static_cast<uint32_t>(mBarriersTail[commandList].size());
+        mBarriers.insert(mBarriers.end(), mBarriersTail[commandList].begin(), mBarriersTail[commandList].end());
+
+        mStats.barrierBatches += mTails[commandList].barrierCount > 0 ? 1 : 0;
+    }
+
+    for (const Barrier& barrier : mBarriers)
+    {
+        if (barrier.type == BarrierType::Aliasing)
+        {
+            mStats.aliasingBarriers++;
+        }
+        else if (barrier.split == BarrierSplit::Begin)
+        {
+            mStats.splitBarriers++;
+        }
+    }
+    mStats.barriers = static_cast<uint32_t>(mBarriers.size());
+}
+
+void RenderGraph::addTransition(uint32_t fromUse, uint32_t toUse, ResourceHandle resource, uint32_t stateBefore, uint32_t stateAfter)
+{
+    // nothing follows the end of the graph, the transition can start right after the last use and end as late
+    // as the tail of its command list
+    if (toUse == InvalidHandle)
+    {
+        if (fromUse == InvalidHandle)
+        {
+            mBarriersTail[mSchedule.back().commandList].push_back({ BarrierType::Transition, BarrierSplit::Full, resource, InvalidHandle, stateBefore, stateAfter });
+            return;
+        }
+
+        mBarriersAfter[fromUse].push_back({ BarrierType::Transition, BarrierSplit::Begin, resource, InvalidHandle, stateBefore, stateAfter });
+        mBarriersTail[mSchedule[fromUse].commandList].push_back({ BarrierType::Transition, BarrierSplit::End, resource, InvalidHandle, stateBefore, stateAfter });
+        return;
+    }
+
+    // other passes run between the two uses: start the transition after the first use and finish it before
+    // the second one. Both halves must be recorded in the same command list.
+    bool split = fromUse != InvalidHandle
+        && fromUse + 1 < toUse
+        && mSchedule[fromUse].commandList == mSchedule[toUse].commandList;
+
+    if (split)
+    {
+        mBarriersAfter[fromUse].push_back({ BarrierType::Transition, BarrierSplit::Begin, resource, InvalidHandle, stateBefore, stateAfter });
+        mBarriersBefore[toUse].push_back({ BarrierType::Transition, BarrierSplit::End, resource, InvalidHandle, stateBefore, stateAfter });
+    }
+    else
+    {
+        mBarriersBefore[toUse].push_back({ BarrierType::Transition, BarrierSplit::Full, resource, InvalidHandle, stateBefore, stateAfter });
+    }
+}
+
+void RenderGraph::retire(uint32_t lastUse, uint32_t nextOccupantUse, ResourceHandle resource, uint32_t stateBefore, uint32_t stateAfter)
+{
+    // the transition has to complete before the aliasing barrier activating the next occupant of the memory
+    std::vector<Barrier>& activation = mBarriersBefore[nextOccupantUse];
+    if (lastUse + 1 < nextOccupantUse && mSchedule[lastUse].commandList == mSchedule[nextOccupantUse].commandList)
+    {
+        mBarriersAfter[lastUse].push_back({ BarrierType::Transition, BarrierSplit::Begin, resource, InvalidHandle, stateBefore, stateAfter });
+        activation.insert(activation.begin(), { BarrierType::Transition, BarrierSplit::End, resource, InvalidHandle, stateBefore, stateAfter });
+    }
+    else
+    {
+        mBarriersAfter[lastUse].push_back({ BarrierType::Transition, BarrierSplit::Full, resource, InvalidHandle, stateBefore, stateAfter });
+    }
+}
+
+}
\ No newline at end of file
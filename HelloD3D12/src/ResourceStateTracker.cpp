@@ -0,0 +1,204 @@
+#include "ResourceStateTracker.h"
+
+#include <assert.h>
+
+namespace HDX
+{
+
+static const uint32_t NoSubresourceStates{ 0xffffffff };
+
+void ResourceStateTracker::reset()
+{
+    mResources.clear();
+    mSubresourceStates.clear();
+    mPending.clear();
+}
+
+uint32_t ResourceStateTracker::track(uint32_t subresourceCount, uint32_t state)
+{
+    assert(subresourceCount > 0);
+    mResources.push_back({ subresourceCount, true, state, NoSubresourceStates });
+    return static_cast<uint32_t>(mResources.size() - 1);
+}
+
+void ResourceStateTracker::transition(uint32_t resource, uint32_t subresource, uint32_t state, std::vector<StateTransition>& transitions)
+{
+    assert(resource < mResources.size());
+    // a single subresource is the whole resource, keep its transitions whole as well
+    if (mResources[resource].subresourceCount == 1)
+    {
+        subresource = AllSubresources;
+    }
+
+    endOverlapping(resource, subresource, transitions);
+    record(resource, subresource, state, TransitionSplit::Full, subresource, transitions);
+}
+
+void ResourceStateTracker::beginTransition(uint32_t resource, uint32_t subresource, uint32_t state, std::vector<StateTransition>& transitions)
+{
+    assert(resource < mResources.size());
+    if (mResources[resource].subresourceCount == 1)
+    {
+        subresource = AllSubresources;
+    }
+
+    endOverlapping(resource, subresource, transitions);
+    record(resource, subresource, state, TransitionSplit::Begin, subresource, transitions);
+}
+
+void ResourceStateTracker::endTransition(uint32_t resource, uint32_t subresource, std::vector<StateTransition>& transitions)
+{
+    assert(resource < mResources.size());
+    if (mResources[resource].subresourceCount == 1)
+    {
+        subresource = AllSubresources;
+    }
+
+    for (size_t i = 0; i < mPending.size();)
+    {
+        if (mPending[i].resource == resource && mPending[i].key == subresource)
+        {
+            endPending(i, transitions);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+uint32_t ResourceStateTracker::getState(uint32_t resource, uint32_t subresource) const
+{
+    const Resource& r = mResources[resource];
+    if (r.uniform)
+    {
+        return r.state;
+    }
+
+    // the resource as a whole has no single state once its subresources diverged, report the first one
+    assert(subresource == AllSubresources || subresource < r.subresourceCount);
+    return mSubresourceStates[r.firstSubresource + (subresource == AllSubresources ? 0 : subresource)];
+}
+
+bool ResourceStateTracker::hasPending(uint32_t resource, uint32_t subresource) const
+{
+    for (const Pending& pending : mPending)
+    {
+        if (pending.resource == resource && overlaps(pending.subresource, subresource))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ResourceStateTracker::record(uint32_t resource, uint32_t subresource, uint32_t state, TransitionSplit split, uint32_t key, std::vector<StateTransition>& transitions)
+{
+    Resource& r = mResources[resource];
+
+    auto add = [&](uint32_t target, uint32_t stateBefore)
+    {
+        transitions.push_back({ resource, target, stateBefore, state, split });
+        if (split == TransitionSplit::Begin)
+        {
+            mPending.push_back({ resource, key, target, stateBefore, state });
+        }
+    };
+
+    if (subresource == AllSubresources && !r.uniform)
+    {
+        // every subresource moves from its own state, each needs its own transition
+        for (uint32_t i = 0; i < r.subresourceCount; i++)
+        {
+            uint32_t stateBefore = mSubresourceStates[r.firstSubresource + i];
+            if (stateBefore != state)
+            {
+                add(i, stateBefore);
+            }
+        }
+    }
+    else
+    {
+        uint32_t stateBefore = getState(resource, subresource);
+        if (stateBefore != state)
+        {
+            add(subresource, stateBefore);
+        }
+    }
+
+    if (split == TransitionSplit::Full)
+    {
+        setState(resource, subresource, state);
+    }
+}
+
+void ResourceStateTracker::setState(uint32_t resource, uint32_t subresource, uint32_t state)
+{
+    Resource& r = mResources[resource];
+    if (subresource == AllSubresources)
+    {
+        r.uniform = true;
+        r.state = state;
+        return;
+    }
+
+    assert(subresource < r.subresourceCount);
+    if (r.uniform)
+    {
+        if (r.state == state)
+        {
+            return;
+        }
+
+        if (r.firstSubresource == NoSubresourceStates)
+        {
+            r.firstSubresource = static_cast<uint32_t>(mSubresourceStates.size());
+            mSubresourceStates.resize(mSubresourceStates.size() + r.subresourceCount);
+        }
+        for (uint32_t i = 0; i < r.subresourceCount; i++)
+        {
+            mSubresourceStates[r.firstSubresource + i] = r.state;
+        }
+        r.uniform = false;
+    }
+
+    uint32_t* states = &mSubresourceStates[r.firstSubresource];
+    states[subresource] = state;
+    for (uint32_t i = 0; i < r.subresourceCount; i++)
+    {
+        if (states[i] != state)
+        {
+            return;
+        }
+    }
+
+    // the subresources agree again, the states stay allocated for the next time they diverge
+    r.uniform = true;
+    r.state = state;
+}
+
+void ResourceStateTracker::endOverlapping(uint32_t resource, uint32_t subresource, std::vector<StateTransition>& transitions)
+{
+    for (size_t i = 0; i < mPending.size();)
+    {
+        if (mPending[i].resource == resource && overlaps(mPending[i].subresource, subresource))
+        {
+            endPending(i, transitions);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+void ResourceStateTracker::endPending(size_t index, std::vector<StateTransition>& transitions)
+{
+    Pending pending = mPending[index];
+    mPending.erase(mPending.begin() + index);
+
+    transitions.push_back({ pending.resource, pending.subresource, pending.stateBefore, pending.stateAfter, TransitionSplit::End });
+    setState(pending.resource, pending.subresource, pending.stateAfter);
+}
+
+}
\ No newline at end of file
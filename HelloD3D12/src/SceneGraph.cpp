@@ -0,0 +1,315 @@
+#include "SceneGraph.h"
+
+#include <cassert>
+#include <cstring>
+
+#include <xmmintrin.h>
+
+namespace HDX
+{
+
+static const float Identity[16]{
+    1.f, 0.f, 0.f, 0.f,
+    0.f, 1.f, 0.f, 0.f,
+    0.f, 0.f, 1.f, 0.f,
+    0.f, 0.f, 0.f, 1.f
+};
+
+// result = a * b, row major. Each result row is a sum of the rows of b scaled by one element of a.
+static void multiply(const float* a, const float* b, float* result)
+{
+    const __m128 b0 = _mm_loadu_ps(b);
+    const __m128 b1 = _mm_loadu_ps(b + 4);
+    const __m128 b2 = _mm_loadu_ps(b + 8);
+    const __m128 b3 = _mm_loadu_ps(b + 12);
+    for (int row = 0; row < 4; row++)
+    {
+        const float* r = a + row * 4;
+        __m128 sum = _mm_mul_ps(_mm_set1_ps(r[0]), b0);
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(r[1]), b1));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(r[2]), b2));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(r[3]), b3));
+        _mm_storeu_ps(result + row * 4, sum);
+    }
+}
+
+SceneGraph::NodeId SceneGraph::createNode(NodeId parent)
+{
+    assert(parent == InvalidNode || mNodes[parent].index != InvalidIndex);
+
+    NodeId node;
+    if (!mFreeNodes.empty())
+    {
+        node = mFreeNodes.back();
+        mFreeNodes.pop_back();
+    }
+    else
+    {
+        node = static_cast<NodeId>(mNodes.size());
+        mNodes.push_back({});
+    }
+
+    const uint32_t index = static_cast<uint32_t>(mOrder.size());
+    const uint32_t parentIndex = parent != InvalidNode ? mNodes[parent].index : InvalidIndex;
+    mNodes[node] = { InvalidNode, index, InvalidNode, InvalidNode, InvalidNode };
+    link(node, parent);
+    mOrder.push_back(node);
+    mParentIndices.push_back(parentIndex);
+    mSubtreeSizes.push_back(1);
+    mLocal.emplace_back();
+    memcpy(mLocal.back().m, Identity, sizeof(Identity));
+    mWorld.emplace_back();
+    mDirty.push_back(1);
+    mUpdateStamps.push_back(0);
+
+    // Appending keeps the subtrees contiguous for roots, and for children of a subtree ending at the end of the
+    // arrays, e.g. when a hierarchy is created depth first. The ancestors of such a parent end there too.
+    if (parent != InvalidNode && !mOrderStale)
+    {
+        if (parentIndex + mSubtreeSizes[parentIndex] == index)
+        {
+            for (uint32_t ancestor = parentIndex; ancestor != InvalidIndex; ancestor = mParentIndices[ancestor])
+            {
+                mSubtreeSizes[ancestor]++;
+            }
+        }
+        else
+        {
+            mOrderStale = true;
+        }
+    }
+    return node;
+}
+
+void SceneGraph::destroyNode(NodeId node)
+{
+    assert(mNodes[node].index != InvalidIndex);
+
+    const NodeId parent = mNodes[node].parent;
+    unlink(node);
+    NodeId child = mNodes[node].firstChild;
+    while (child != InvalidNode)
+    {
+        const NodeId next = mNodes[child].nextSibling;
+        link(child, parent);
+        mDirty[mNodes[child].index] = 1;
+        child = next;
+    }
+
+    // the entry stays in the arrays until the order is rebuilt
+    mNodes[node] = { InvalidNode, InvalidIndex, InvalidNode, InvalidNode, InvalidNode };
+    mFreeNodes.push_back(node);
+    mOrderStale = true;
+}
+
+void SceneGraph::setParent(NodeId node, NodeId parent)
+{
+    if (mNodes[node].parent == parent)
+    {
+        return;
+    }
+
+    unlink(node);
+    link(node, parent);
+    mDirty[mNodes[node].index] = 1;
+    mOrderStale = true;
+}
+
+void SceneGraph::link(NodeId node, NodeId parent)
+{
+    Node& entry = mNodes[node];
+    entry.parent = parent;
+    entry.previousSibling = InvalidNode;
+    entry.nextSibling = InvalidNode;
+    if (parent != InvalidNode)
+    {
+        entry.nextSibling = mNodes[parent].firstChild;
+        if (entry.nextSibling != InvalidNode)
+        {
+            mNodes[entry.nextSibling].previousSibling = node;
+        }
+        mNodes[parent].firstChild = node;
+    }
+}
+
+void SceneGraph::unlink(NodeId node)
+{
+    const Node& entry = mNodes[node];
+    if (entry.previousSibling != InvalidNode)
+    {
+        mNodes[entry.previousSibling].nextSibling = entry.nextSibling;
+    }
+    else if (entry.parent != InvalidNode)
+    {
+        mNodes[entry.parent].firstChild = entry.nextSibling;
+    }
+    if (entry.nextSibling != InvalidNode)
+    {
+        mNodes[entry.nextSibling].previousSibling = entry.previousSibling;
+    }
+}
+
+void SceneGraph::setLocal(NodeId node, const float* local)
+{
+    const uint32_t index = mNodes[node].index;
+    memcpy(mLocal[index].m, local, sizeof(Matrix));
+    mDirty[index] = 1;
+}
+
+void SceneGraph::update()
+{
+    mUpdateCount++;
+    mStats = Stats{};
+    if (mOrderStale)
+    {
+        rebuildOrder();
+        mStats.rebuilt = true;
+    }
+
+    const uint32_t count = static_cast<uint32_t>(mOrder.size());
+    mStats.nodes = count;
+    const uint8_t* dirty = mDirty.data();
+    uint32_t index = 0;
+    while (index < count)
+    {
+        uint64_t flags;
+        if (index + sizeof(flags) <= count)
+        {
+            memcpy(&flags, dirty + index, sizeof(flags));
+            if (flags == 0)
+            {
+                index += sizeof(flags);
+                continue;
+            }
+        }
+
+        if (!dirty[index])
+        {
+            index++;
+            continue;
+        }
+
+        // the parent was clean or is already done, so the whole subtree can be computed from it
+        const uint32_t end = index + mSubtreeSizes[index];
+        updateSubtree(index, end);
+        mStats.dirtySubtrees++;
+        index = end;
+    }
+}
+
+void SceneGraph::updateSubtree(uint32_t first, uint32_t end)
+{
+    memset(mDirty.data() + first, 0, end - first);
+    for (uint32_t index = first; index < end; index++)
+    {
+        const uint32_t parentIndex = mParentIndices[index];
+        if (parentIndex == InvalidIndex)
+        {
+            mWorld[index] = mLocal[index];
+        }
+        else
+        {
+            multiply(mLocal[index].m, mWorld[parentIndex].m, mWorld[index].m);
+        }
+        mUpdateStamps[index] = mUpdateCount;
+    }
+    mStats.updatedNodes += end - first;
+}
+
+void SceneGraph::rebuildOrder()
+{
+    const uint32_t nodeCount = static_cast<uint32_t>(mNodes.size());
+
+    // children of each node grouped by parent, in handle order
+    mChildStarts.assign(nodeCount + 3, 0);
+    for (NodeId node = 0; node < nodeCount; node++)
+    {
+        if (mNodes[node].index != InvalidIndex)
+        {
+            // roots are the children of the extra slot nodeCount
+            const NodeId parent = mNodes[node].parent != InvalidNode ? mNodes[node].parent : nodeCount;
+            mChildStarts[parent + 2]++;
+        }
+    }
+    for (uint32_t i = 2; i < nodeCount + 3; i++)
+    {
+        mChildStarts[i] += mChildStarts[i - 1];
+    }
+    const uint32_t aliveCount = static_cast<uint32_t>(mNodes.size() - mFreeNodes.size());
+    mChildren.resize(aliveCount);
+    for (NodeId node = 0; node < nodeCount; node++)
+    {
+        if (mNodes[node].index != InvalidIndex)
+        {
+            const NodeId parent = mNodes[node].parent != InvalidNode ? mNodes[node].parent : nodeCount;
+            mChildren[mChildStarts[parent + 1]++] = node;
+        }
+    }
+    // mChildStarts[p] .. mChildStarts[p + 1] are now the children of p
+
+    // depth first, the stack holds the nodes whose subtree comes next, first child on top
+    std::vector<uint32_t> oldIndices(aliveCount);
+    std::vector<NodeId> order(aliveCount);
+    std::vector<uint32_t> parentIndices(aliveCount);
+    mStack.clear();
+    for (uint32_t i = mChildStarts[nodeCount + 1]; i > mChildStarts[nodeCount]; i--)
+    {
+        mStack.push_back(mChildren[i - 1]);
+    }
+    uint32_t index = 0;
+    while (!mStack.empty())
+    {
+        const NodeId node = mStack.back();
+        mStack.pop_back();
+
+        const NodeId parent = mNodes[node].parent;
+        order[index] = node;
+        oldIndices[index] = mNodes[node].index;
+        // the parent was visited first and already has its new index
+        parentIndices[index] = parent != InvalidNode ? mNodes[parent].index : InvalidIndex;
+        mNodes[node].index = index;
+        index++;
+
+        for (uint32_t i = mChildStarts[node + 1]; i > mChildStarts[node]; i--)
+        {
+            mStack.push_back(mChildren[i - 1]);
+        }
+    }
+    assert(index == aliveCount);
+
+    mSubtreeSizes.assign(aliveCount, 1);
+    for (uint32_t i = aliveCount; i-- > 0;)
+    {
+        if (parentIndices[i] != InvalidIndex)
+        {
+            mSubtreeSizes[parentIndices[i]] += mSubtreeSizes[i];
+        }
+    }
+
+    // dirty flags and world matrices move with their nodes, only nodes flagged before are recomputed
+    std::vector<uint8_t> dirty(aliveCount);
+    for (uint32_t i = 0; i < aliveCount; i++)
+    {
+        dirty[i] = mDirty[oldIndices[i]];
+    }
+    mScratchMatrices.resize(aliveCount);
+    for (uint32_t i = 0; i < aliveCount; i++)
+    {
+        mScratchMatrices[i] = mLocal[oldIndices[i]];
+    }
+    mLocal.swap(mScratchMatrices);
+    mScratchMatrices.resize(aliveCount);
+    for (uint32_t i = 0; i < aliveCount; i++)
+    {
+        mScratchMatrices[i] = mWorld[oldIndices[i]];
+    }
+    mWorld.swap(mScratchMatrices);
+
+    mOrder.swap(order);
+    mParentIndices.swap(parentIndices);
+    mDirty.swap(dirty);
+    mUpdateStamps.assign(aliveCount, 0);
+    mOrderStale = false;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#include "ShaderPermutation.h"
+
+namespace HDX
+{
+
+const char* getShaderFeatureDefine(uint32_t feature)
+{
+    switch (feature)
+    {
+    case ShaderFeatureShadows:
+        return "SHADOWS";
+    case ShaderFeatureAlphaTest:
+        return "ALPHA_TEST";
+    case ShaderFeatureInstancing:
+        return "INSTANCING";
+    case ShaderFeatureQuantizedVertices:
+        return "QUANTIZED_VERTICES";
+    default:
+        return nullptr;
+    }
+}
+
+std::string describeShaderVariant(ShaderVariantKey key)
+{
+    std::string description;
+    for (uint32_t bit = 0; bit < 32; bit++)
+    {
+        const uint32_t feature = 1u << bit;
+        if ((key & feature) == 0)
+        {
+            continue;
+        }
+
+        if (!description.empty())
+        {
+            description += '|';
+        }
+        const char* define = getShaderFeatureDefine(feature);
+        description += define ? define : "?";
+    }
+    return description.empty() ? "none" : description;
+}
+
+}
\ No newline at end of file
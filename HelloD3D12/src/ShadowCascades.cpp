@@ -0,0 +1,174 @@
+#include "ShadowCascades.h"
+
+#include <cassert>
+#include <cmath>
+
+namespace HDX
+{
+
+// result = a * b, row major
+static void multiply(const float* a, const float* b, float* result)
+{
+    for (int row = 0; row < 4; row++)
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            float sum = 0.f;
+            for (int k = 0; k < 4; k++)
+            {
+                sum += a[row * 4 + k] * b[k * 4 + column];
+            }
+            result[row * 4 + column] = sum;
+        }
+    }
+}
+
+static Float3 transformPoint(const Float3& p, const float* m)
+{
+    return {
+        p.x * m[0] + p.y * m[4] + p.z * m[8] + m[12],
+        p.x * m[1] + p.y * m[5] + p.z * m[9] + m[13],
+        p.x * m[2] + p.y * m[6] + p.z * m[10] + m[14]
+    };
+}
+
+// Maps a view space point back to world space, the view matrix is affine.
+static Float3 viewToWorld(const Float3& p, const float* view)
+{
+    const float* m = view;
+    const float determinant =
+        m[0] * (m[5] * m[10] - m[6] * m[9]) -
+        m[1] * (m[4] * m[10] - m[6] * m[8]) +
+        m[2] * (m[4] * m[9] - m[5] * m[8]);
+    assert(determinant != 0.f);
+    const float scale = 1.f / determinant;
+
+    // inverse of the 3x3 part from its cofactors
+    const float inverse[9]{
+        (m[5] * m[10] - m[6] * m[9]) * scale, (m[2] * m[9] - m[1] * m[10]) * scale, (m[1] * m[6] - m[2] * m[5]) * scale,
+        (m[6] * m[8] - m[4] * m[10]) * scale, (m[0] * m[10] - m[2] * m[8]) * scale, (m[2] * m[4] - m[0] * m[6]) * scale,
+        (m[4] * m[9] - m[5] * m[8]) * scale, (m[1] * m[8] - m[0] * m[9]) * scale, (m[0] * m[5] - m[1] * m[4]) * scale
+    };
+
+    const Float3 q{ p.x - m[12], p.y - m[13], p.z - m[14] };
+    return {
+        q.x * inverse[0] + q.y * inverse[3] + q.z * inverse[6],
+        q.x * inverse[1] + q.y * inverse[4] + q.z * inverse[7],
+        q.x * inverse[2] + q.y * inverse[5] + q.z * inverse[8]
+    };
+}
+
+static Float3 normalize(const Float3& v)
+{
+    const float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+    return { v.x / length, v.y / length, v.z / length };
+}
+
+static Float3 cross(const Float3& a, const Float3& b)
+{
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+void ShadowCascades::computeSplits(float nearZ, float farZ, uint32_t count, float lambda, float* splits)
+{
+    splits[0] = nearZ;
+    for (uint32_t i = 1; i < count; i++)
+    {
+        const float t = static_cast<float>(i) / static_cast<float>(count);
+        const float logarithmic = nearZ * std::pow(farZ / nearZ, t);
+        const float uniform = nearZ + (farZ - nearZ) * t;
+        splits[i] = lambda * logarithmic + (1.f - lambda) * uniform;
+    }
+    splits[count] = farZ;
+}
+
+void ShadowCascades::fit(const Camera& camera, const Float3& lightDirection, uint32_t count, float lambda, uint32_t resolution)
+{
+    assert(count > 0 && count <= MaxCascades);
+    mCount = count;
+
+    // same basis as XMMatrixLookToLH from the origin
+    const Float3 forward = normalize(lightDirection);
+    const Float3 up = std::fabs(forward.y) < 0.99f ? Float3{ 0.f, 1.f, 0.f } : Float3{ 0.f, 0.f, 1.f };
+    const Float3 right = normalize(cross(up, forward));
+    const Float3 lightUp = cross(forward, right);
+    const float lightView[16]{
+        right.x, lightUp.x, forward.x, 0.f,
+        right.y, lightUp.y, forward.y, 0.f,
+        right.z, lightUp.z, forward.z, 0.f,
+        0.f, 0.f, 0.f, 1.f
+    };
+    for (int i = 0; i < 16; i++)
+    {
+        mLightView[i] = lightView[i];
+    }
+
+    float splits[MaxCascades + 1];
+    computeSplits(camera.nearZ, camera.farZ, count, lambda, splits);
+
+    const float tanY = std::tan(camera.fovY * 0.5f);
+    const float tanX = tanY * camera.aspectRatio;
+    // squared slope of the frustum corner edges
+    const float cornerSlopeSq = tanX * tanX + tanY * tanY;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        Cascade& cascade = mCascades[i];
+        const float n = splits[i];
+        const float f = splits[i + 1];
+        cascade.splitNear = n;
+        cascade.splitFar = f;
+
+        // The smallest sphere through the 8 corners is centered on the view axis, at the depth where the near and
+        // far corners are equally far. Long slices only need the far corners.
+        float centerZ = (n + f) * (1.f + cornerSlopeSq) * 0.5f;
+        float radius;
+        if (centerZ >= f)
+        {
+            centerZ = f;
+            radius = f * std::sqrt(cornerSlopeSq);
+        }
+        else
+        {
+            radius = std::sqrt((f - centerZ) * (f - centerZ) + f * f * cornerSlopeSq);
+        }
+        cascade.center = viewToWorld({ 0.f, 0.f, centerZ }, camera.view);
+        cascade.radius = radius;
+
+        // snapping moves the center by up to a texel, the projection is one texel wider on each side to keep
+        // the sphere covered
+        const float halfSize = radius * static_cast<float>(resolution) / static_cast<float>(resolution - 2);
+        const float texelSize = 2.f * halfSize / static_cast<float>(resolution);
+        cascade.texelSize = texelSize;
+
+        Float3 lightCenter = transformPoint(cascade.center, mLightView);
+        lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+        lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+        cascade.lightNearZ = lightCenter.z - radius;
+        cascade.lightFarZ = lightCenter.z + radius;
+
+        // XMMatrixOrthographicOffCenterLH around the snapped center
+        const float depthScale = 1.f / (cascade.lightFarZ - cascade.lightNearZ);
+        const float projection[16]{
+            1.f / halfSize, 0.f, 0.f, 0.f,
+            0.f, 1.f / halfSize, 0.f, 0.f,
+            0.f, 0.f, depthScale, 0.f,
+            -lightCenter.x / halfSize, -lightCenter.y / halfSize, -cascade.lightNearZ * depthScale, 1.f
+        };
+        multiply(mLightView, projection, cascade.viewProj);
+
+        // XMMatrixPerspectiveFovLH over the split range
+        const float depthRange = f / (f - n);
+        const float cameraProjection[16]{
+            1.f / tanX, 0.f, 0.f, 0.f,
+            0.f, 1.f / tanY, 0.f, 0.f,
+            0.f, 0.f, depthRange, 1.f,
+            0.f, 0.f, -n * depthRange, 0.f
+        };
+        float cameraViewProj[16];
+        multiply(camera.view, cameraProjection, cameraViewProj);
+        cascade.cameraFrustum = Frustum::fromViewProjection(cameraViewProj);
+    }
+}
+
+}
\ No newline at end of file
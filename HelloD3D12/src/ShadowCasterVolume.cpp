@@ -0,0 +1,26 @@
+#include "ShadowCasterVolume.h"
+
+namespace HDX
+{
+
+// planes of an orthographic light are parallel to its direction up to rounding, they must not be dropped
+static const float ParallelEpsilon{ 1e-4f };
+
+void ShadowCasterVolume::build(const Frustum& light, const Frustum& camera, const Float3& lightDirection)
+{
+    mPlaneCount = 0;
+    const Frustum* frustums[] = { &light, &camera };
+    for (const Frustum* frustum : frustums)
+    {
+        for (const Plane& plane : frustum->planes)
+        {
+            float facing = plane.normal.x * lightDirection.x + plane.normal.y * lightDirection.y + plane.normal.z * lightDirection.z;
+            if (facing <= ParallelEpsilon)
+            {
+                mPlanes[mPlaneCount++] = plane;
+            }
+        }
+    }
+}
+
+}
\ No newline at end of file
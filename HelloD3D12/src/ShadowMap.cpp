@@ -1,9 +1,11 @@
 #include "stdafx.h"
 
+#include <cstring>
 #include <vector>
 
 #include "ShadowMap.h"
-#include "Model.h"
+#include "Mesh.h"
+#include "PipelineCache.h"
 
 namespace HDX
 {
@@ -13,67 +15,74 @@ namespace HDX
 
 
 
-bool ShadowMap::prepare(ID3D12Device * device, ID3D12CommandQueue * commandQueue, ID3D12GraphicsCommandList * commandList, ID3D12DescriptorHeap * srvCBVHeap, UINT & heapOffset, ID3D12Resource * constantBuffer, UINT & constantBufferOffset, UINT8 * cbDataBegin, UINT frameCount)
+D3D12_RESOURCE_DESC ShadowMap::getDepthTextureDesc()
 {
-    // create depth texture
+    return CD3DX12_RESOURCE_DESC{
+        D3D12_RESOURCE_DIMENSION_TEXTURE2D,
+        0,
+        Size,
+        Size,
+        CascadeCount,
+        1,
+        DXGI_FORMAT_R32_TYPELESS,
+        1,
+        0,
+        D3D12_TEXTURE_LAYOUT_UNKNOWN,
+        D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL
+    };
+}
+
+D3D12_CLEAR_VALUE ShadowMap::getDepthClearValue()
+{
+    D3D12_CLEAR_VALUE clearVal;
+    clearVal.Format = DXGI_FORMAT_D32_FLOAT;
+    clearVal.DepthStencil.Depth = 1.f;
+    clearVal.DepthStencil.Stencil = 0;
+    return clearVal;
+}
+
+bool ShadowMap::prepare(ID3D12Device * device, PipelineCache * pipelineCache, ID3D12CommandQueue * commandQueue, ID3D12GraphicsCommandList * commandList, ID3D12DescriptorHeap * srvCBVHeap, UINT & heapOffset, ID3D12Resource * constantBuffer, UINT & constantBufferOffset, UINT8 * cbDataBegin, UINT frameCount)
+{
+    // descriptors of the depth texture, the texture itself comes from the render graph, then the static cache DSVs
     {
         D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc{};
-        dsvHeapDesc.NumDescriptors = frameCount;
+        dsvHeapDesc.NumDescriptors = 2 * CascadeCount;
         dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
         dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
         HR_ERROR_CHECK_CALL(device->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(&mDSVHeap)), false, "Failed to create shadow DSV heap!\n");
-
-        CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(mDSVHeap->GetCPUDescriptorHandleForHeapStart());
-        {
-            CD3DX12_RESOURCE_DESC depthTexDesc{
-                D3D12_RESOURCE_DIMENSION_TEXTURE2D,
-                0,
-                2048,
-                2048,
-                1,
-                1,
-                DXGI_FORMAT_R32_TYPELESS,
-                1,
-                0,
-                D3D12_TEXTURE_LAYOUT_UNKNOWN,
-                D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL
-            };
-
-            D3D12_CLEAR_VALUE clearVal;
-            clearVal.Format = DXGI_FORMAT_D32_FLOAT;
-            clearVal.DepthStencil.Depth = 1.f;
-            clearVal.DepthStencil.Stencil = 0;
-
-            HR_ERROR_CHECK_CALL(device->CreateCommittedResource(
-                &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-                D3D12_HEAP_FLAG_NONE,
-                &depthTexDesc,
-                D3D12_RESOURCE_STATE_DEPTH_WRITE,
-                &clearVal,
-                IID_PPV_ARGS(mDepthTexture.GetAddressOf())), false, "Failed to create shadow texture\n");
-        }
-
-        D3D12_DEPTH_STENCIL_VIEW_DESC depthStencilViewDesc{};
-        depthStencilViewDesc.Format = DXGI_FORMAT_D32_FLOAT;
-        depthStencilViewDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
-        depthStencilViewDesc.Texture2D.MipSlice = 0;
-        device->CreateDepthStencilView(mDepthTexture.Get(), &depthStencilViewDesc, dsvHandle);
+        mDSVDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
 
         CD3DX12_CPU_DESCRIPTOR_HANDLE srvCBVHandle(srvCBVHeap->GetCPUDescriptorHandleForHeapStart());
         UINT srvCBVDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
         srvCBVHandle.Offset(1, heapOffset);
         mSRVDescriptorStart = srvCBVHandle;
 
-        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
-        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-        srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-        srvDesc.Texture2D.MipLevels = 1;
-        device->CreateShaderResourceView(mDepthTexture.Get(), &srvDesc, srvCBVHandle);
-
         heapOffset += srvCBVDescriptorSize;
     }
 
+    // the static cache lives as long as the shadow map, it is only copied from while it is valid
+    {
+        D3D12_RESOURCE_DESC depthDesc = getDepthTextureDesc();
+        D3D12_CLEAR_VALUE clearValue = getDepthClearValue();
+        HR_ERROR_CHECK_CALL(device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+            D3D12_HEAP_FLAG_NONE,
+            &depthDesc,
+            D3D12_RESOURCE_STATE_DEPTH_WRITE,
+            &clearValue,
+            IID_PPV_ARGS(&mStaticDepthTexture)), false, "Failed to create static shadow cache!\n");
+
+        for (UINT cascade = 0; cascade < CascadeCount; cascade++)
+        {
+            D3D12_DEPTH_STENCIL_VIEW_DESC depthStencilViewDesc{};
+            depthStencilViewDesc.Format = DXGI_FORMAT_D32_FLOAT;
+            depthStencilViewDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2DARRAY;
+            depthStencilViewDesc.Texture2DArray.FirstArraySlice = cascade;
+            depthStencilViewDesc.Texture2DArray.ArraySize = 1;
+            device->CreateDepthStencilView(mStaticDepthTexture.Get(), &depthStencilViewDesc, getStaticDSVHandle(cascade));
+        }
+    }
+
     // Create pipeline
     {
         D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData{};
@@ -85,11 +94,12 @@ bool ShadowMap::prepare(ID3D12Device * device, ID3D12CommandQueue * commandQueue
             featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
         }
 
-        CD3DX12_DESCRIPTOR_RANGE1 ranges[1];
-        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC);
-
-        CD3DX12_ROOT_PARAMETER1 rootParameters[1];
-        rootParameters[0].InitAsDescriptorTable(1, &ranges[0], D3D12_SHADER_VISIBILITY_VERTEX);
+        CD3DX12_ROOT_PARAMETER1 rootParameters[RootParameterCount];
+        rootParameters[RootFrameConstants].InitAsConstantBufferView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_VERTEX);
+        rootParameters[RootInstances].InitAsShaderResourceView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_VERTEX);
+        rootParameters[RootInstanceIndices].InitAsShaderResourceView(1, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_VERTEX);
+        rootParameters[RootDrawConstants].InitAsConstants(DrawConstantCount, 1, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+        rootParameters[RootCascade].InitAsConstants(1, 2, 0, D3D12_SHADER_VISIBILITY_VERTEX);
 
         D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags =
             D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
@@ -105,58 +115,24 @@ bool ShadowMap::prepare(ID3D12Device * device, ID3D12CommandQueue * commandQueue
         ComPtr<ID3DBlob> error;
 
         HR_ERROR_CHECK_CALL(D3DX12SerializeVersionedRootSignature(&rootSignatureDesc, featureData.HighestVersion, &signature, &error), false, "Failed to serialize root signature\n");
-        HR_ERROR_CHECK_CALL(device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&mRootSignature)), false, "Failed to create root signature\n");
+        if (!pipelineCache->createRootSignature(signature->GetBufferPointer(), signature->GetBufferSize(), mRootSignature))
+        {
+            return false;
+        }
     }
 
     {
         ComPtr<ID3DBlob> vertexShader;
-        ComPtr<ID3DBlob> errorMsg;
-#ifdef _DEBUG
-        UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#else
-        UINT compileFlags = 0;
-#endif
-        const char* shader =
-            "cbuffer SceneConstantBuffer : register(b0)\n                      \n"
-            "{                                                                 \n"
-            "   float4x4 gWorldViewProj;                                       \n"
-            "}                                                                 \n"
-            "                                                                  \n"
-            "struct PSInput                                                    \n"
-            "{                                                                 \n"
-            "	float4 position : SV_POSITION;                                 \n"
-            "	float2 uv : TEXCOORD;                                          \n"
-            "   float3 normal : NORMAL;                                        \n"
-            "};                                                                \n"
-            "                                                                  \n"
-            "                                                                  \n"
-            "PSInput VSMain(float3 position : POSITION, float2 uv : TEXCOORD, float3 normal : NORMAL)  \n"
-            "{                                                                 \n"
-            "	PSInput result;                                                \n"
-            "                                                                  \n"
-            "	result.position = mul(float4(position, 1.0f), gWorldViewProj); \n"
-            "	result.uv = uv;                                                \n"
-            "   result.normal = normal;                                        \n"
-            "                                                                  \n"
-            "	return result;                                                 \n"
-            "}                                                                 \n";
-
-        if (FAILED(D3DCompile(shader, strlen(shader) + 1, nullptr, nullptr, nullptr, "VSMain", "vs_5_0", compileFlags, 0, &vertexShader, &errorMsg)))
+        if (!pipelineCache->loadShader("ShadowMapVS", vertexShader))
         {
-            if (errorMsg)
-            {
-                LOG_ERROR(reinterpret_cast<const char*>(errorMsg->GetBufferPointer()));
-            }
-
-            assert(false);
             return false;
         }
 
         D3D12_INPUT_ELEMENT_DESC inputElementDescs[]
         {
             {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-            {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof(Model::Vertex, uv), D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-            {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(Model::Vertex, normal), D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
+            {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof(Mesh::Vertex, uv), D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+            {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(Mesh::Vertex, normal), D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
         };
 
         D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc{};
@@ -164,6 +140,8 @@ bool ShadowMap::prepare(ID3D12Device * device, ID3D12CommandQueue * commandQueue
         psoDesc.pRootSignature = mRootSignature.Get();
         psoDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader.Get());
         psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+        // the cascades only cover the view, casters between them and the light are flattened onto the near plane
+        psoDesc.RasterizerState.DepthClipEnable = FALSE;
         psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
         psoDesc.DepthStencilState.DepthEnable = TRUE;
         psoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
@@ -176,12 +154,65 @@ bool ShadowMap::prepare(ID3D12Device * device, ID3D12CommandQueue * commandQueue
         psoDesc.SampleDesc.Count = 1;
         psoDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
 
-        HR_ERROR_CHECK_CALL(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&mPipelineState)), false, "Failed to create graphics pipeline state\n");
+        if (!pipelineCache->createGraphicsPipelineState(psoDesc, mPipelineState))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void ShadowMap::setDepthTexture(ID3D12Device* device, ID3D12Resource* depthTexture)
+{
+    if (depthTexture == mDepthTexture)
+    {
+        return;
+    }
+    mDepthTexture = depthTexture;
+
+    for (UINT cascade = 0; cascade < CascadeCount; cascade++)
+    {
+        D3D12_DEPTH_STENCIL_VIEW_DESC depthStencilViewDesc{};
+        depthStencilViewDesc.Format = DXGI_FORMAT_D32_FLOAT;
+        depthStencilViewDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2DARRAY;
+        depthStencilViewDesc.Texture2DArray.MipSlice = 0;
+        depthStencilViewDesc.Texture2DArray.FirstArraySlice = cascade;
+        depthStencilViewDesc.Texture2DArray.ArraySize = 1;
+        device->CreateDepthStencilView(depthTexture, &depthStencilViewDesc, getDSVHandle(cascade));
+    }
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+    srvDesc.Texture2DArray.MipLevels = 1;
+    srvDesc.Texture2DArray.ArraySize = CascadeCount;
+    device->CreateShaderResourceView(depthTexture, &srvDesc, mSRVDescriptorStart);
+}
+
+bool ShadowMap::updateStaticCache(UINT cascade, const float* viewProj, uint64_t staticVersion)
+{
+    // the projections are snapped to texels, an unchanged cascade has the exact same matrix
+    if (mStaticValid[cascade] && mStaticVersion[cascade] == staticVersion && memcmp(mStaticViewProj[cascade], viewProj, sizeof(mStaticViewProj[cascade])) == 0)
+    {
+        return false;
     }
 
+    memcpy(mStaticViewProj[cascade], viewProj, sizeof(mStaticViewProj[cascade]));
+    mStaticVersion[cascade] = staticVersion;
+    mStaticValid[cascade] = true;
     return true;
 }
 
+void ShadowMap::invalidateStaticCache()
+{
+    for (UINT cascade = 0; cascade < CascadeCount; cascade++)
+    {
+        mStaticValid[cascade] = false;
+    }
+}
+
 void ShadowMap::onRender(ID3D12GraphicsCommandList* cmdList)
 {
     cmdList->SetGraphicsRootSignature(mRootSignature.Get());
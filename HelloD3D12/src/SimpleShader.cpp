@@ -1,13 +1,18 @@
 #include "stdafx.h"
 
+#include <vector>
+
 #include "SimpleShader.h"
-#include "Model.h"
+#include "Mesh.h"
+#include "PipelineCache.h"
 
 namespace HDX
 {
 
-bool SimpleShader::prepare(ID3D12Device* device)
+bool SimpleShader::prepare(ID3D12Device* device, PipelineCache* pipelineCache)
 {
+    mPipelineCache = pipelineCache;
+
     {
         D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData{};
 
@@ -18,15 +23,21 @@ bool SimpleShader::prepare(ID3D12Device* device)
             featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
         }
 
-        CD3DX12_DESCRIPTOR_RANGE1 ranges[3];
-        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC);
-        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 2, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC);
-        ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1);
-
-        CD3DX12_ROOT_PARAMETER1 rootParameters[3];
-        rootParameters[0].InitAsDescriptorTable(1, &ranges[0], D3D12_SHADER_VISIBILITY_PIXEL);
-        rootParameters[1].InitAsDescriptorTable(1, &ranges[1], D3D12_SHADER_VISIBILITY_ALL);
-        rootParameters[2].InitAsDescriptorTable(1, &ranges[2], D3D12_SHADER_VISIBILITY_PIXEL);
+        CD3DX12_DESCRIPTOR_RANGE1 ranges[2];
+        // the material table is only partially filled, unused descriptors are never read
+        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, MaxMaterials, 0, 1, D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE | D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC);
+        ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1);
+
+        CD3DX12_ROOT_PARAMETER1 rootParameters[RootParameterCount];
+        rootParameters[RootTextures].InitAsDescriptorTable(1, &ranges[0], D3D12_SHADER_VISIBILITY_PIXEL);
+        rootParameters[RootFrameConstants].InitAsConstantBufferView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_ALL);
+        rootParameters[RootShadowMap].InitAsDescriptorTable(1, &ranges[1], D3D12_SHADER_VISIBILITY_PIXEL);
+        rootParameters[RootInstances].InitAsShaderResourceView(2, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_VERTEX);
+        rootParameters[RootInstanceIndices].InitAsShaderResourceView(3, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_VERTEX);
+        rootParameters[RootDrawConstants].InitAsConstants(DrawConstantCount, 1, 0, D3D12_SHADER_VISIBILITY_ALL);
+        rootParameters[RootLights].InitAsShaderResourceView(4, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_PIXEL);
+        rootParameters[RootLightCells].InitAsShaderResourceView(5, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_PIXEL);
+        rootParameters[RootLightIndices].InitAsShaderResourceView(6, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_PIXEL);
 
         D3D12_STATIC_SAMPLER_DESC sampler{};
         sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_POINT;
@@ -73,121 +84,142 @@ bool SimpleShader::prepare(ID3D12Device* device)
         ComPtr<ID3DBlob> error;
 
         HR_ERROR_CHECK_CALL(D3DX12SerializeVersionedRootSignature(&rootSignatureDesc, featureData.HighestVersion, &signature, &error), false, "Failed to serialize root signature\n");
-        HR_ERROR_CHECK_CALL(device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&mRootSignature)), false, "Failed to create root signature\n");
+        if (!pipelineCache->createRootSignature(signature->GetBufferPointer(), signature->GetBufferSize(), mRootSignature))
+        {
+            return false;
+        }
     }
 
+    return getPipelineState(DefaultVariant) != nullptr;
+}
+
+bool SimpleShader::precompile(const ShaderVariantKey* keys, size_t count)
+{
+    bool compiled = true;
+    for (size_t i = 0; i < count; i++)
     {
-        ComPtr<ID3DBlob> vertexShader;
-        ComPtr<ID3DBlob> pixelShader;
-        ComPtr<ID3DBlob> errorMsg;
+        compiled = getPipelineState(keys[i]) != nullptr && compiled;
+    }
+    return compiled;
+}
+
+ID3D12PipelineState* SimpleShader::getPipelineState(ShaderVariantKey key)
+{
+    PipelineVariant* variant = mPipelineStates.resolve(key, [this](ShaderVariantKey variantKey)
+    {
+        return createPipelineState(variantKey);
+    });
+    return variant ? variant->pipelineState.Get() : nullptr;
+}
+
+ID3DBlob* SimpleShader::getShader(VariantTable<ShaderVariant>& shaders, ShaderVariantKey key, ShaderVariantKey cookedKey, const char* name, const char* entryPoint, const char* target)
+{
+    ShaderVariant* variant = shaders.resolve(key, [this, cookedKey, name, entryPoint, target](ShaderVariantKey variantKey)
+    {
+        std::unique_ptr<ShaderVariant> shader = std::make_unique<ShaderVariant>();
+
+        // the default variant is cooked by the build, the others are compiled once and then come from the cache
+        if (variantKey == cookedKey)
+        {
+            if (!mPipelineCache->loadShader(name, shader->bytecode))
+            {
+                return std::unique_ptr<ShaderVariant>();
+            }
+            return shader;
+        }
+
 #ifdef _DEBUG
         UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
 #else
         UINT compileFlags = 0;
 #endif
-        const char* shader =
-            "cbuffer SceneConstantBuffer : register(b0)\n                      \n"
-            "{                                                                 \n"
-            "   float4x4 gWorldViewProj;                                       \n"  
-            "   float4x4 gWorld;                                               \n"
-            "                                                                  \n"
-            "}                                                                 \n"
-            "cbuffer SceneStaticConstantBuffer : register(b1)\n                \n"
-            "{                                                                 \n"
-            "   float4x4 gShadowViewProj;                                      \n"
-            "   float3   gLightDir;                                            \n"
-            "}                                                                 \n"
-            "                                                                  \n"
-            "struct PSInput                                                    \n"
-            "{                                                                 \n"
-            "	float4 position : SV_POSITION;                                 \n"
-            "	float2 uv : TEXCOORD;                                          \n"
-            "   float3 normal : NORMAL;                                        \n"
-            "   float4 shadowPosition : POSITION;                              \n"
-            "};                                                                \n"
-            "                                                                  \n"
-            "Texture2D g_texture : register(t0);                               \n"
-            "Texture2D g_shadowtexture : register(t1);                         \n"
-            "SamplerState g_sampler : register(s0);                            \n"
-            "                                                                  \n"
-            "PSInput VSMain(float3 position : POSITION, float2 uv : TEXCOORD, float3 normal : NORMAL)  \n"
-            "{                                                                 \n"
-            "	PSInput result;                                                \n"
-            "                                                                  \n"
-            "	result.position = mul(float4(position, 1.0f), gWorldViewProj); \n"
-            "	result.uv = uv;                                                \n"
-            "   result.normal = mul(float4(normal, 0.f), gWorld);              \n"
-            "   result.shadowPosition = mul(mul(float4(position, 1.0f), gWorld), gShadowViewProj); \n                                                \n"
-            "                                                                  \n"
-            "	return result;                                                 \n"
-            "}                                                                 \n"
-            "                                                                  \n"
-            "float4 PSMain(PSInput input) : SV_TARGET                          \n"
-            "{                                                                 \n"
-            "    float4 shadowPos = input.shadowPosition;                      \n"
-            "    shadowPos.xyz /= shadowPos.w;                                 \n"
-            "    float2 shadowCoord = 0.5f * shadowPos.xy + 0.5f;              \n"
-            "    shadowCoord.y = 1.0f - shadowCoord.y;                         \n"
-            "    float shadowDepth = shadowPos.z - 0.005f;                     \n"
-            "    float shadowMapDepth = g_shadowtexture.Sample(g_sampler, shadowCoord);  \n"
-            "    float shadowScale = shadowMapDepth > shadowDepth ? 1.f : 0.2f;\n"
-            "    float3 wNormal = normalize(input.normal);                     \n"
-            "    float intensity = saturate(dot(wNormal, -gLightDir)) *shadowScale; \n"
-            "    return g_texture.Sample(g_sampler, input.uv) * intensity;     \n"
-            "}                                                                 \n"
-            ;
-
-        if (FAILED(D3DCompile(shader, strlen(shader) + 1, nullptr, nullptr, nullptr, "VSMain", "vs_5_0", compileFlags, 0, &vertexShader, &errorMsg)))
+        std::vector<D3D_SHADER_MACRO> defines;
+        for (uint32_t bit = 0; bit < ShaderFeatureCount; bit++)
         {
-            if (errorMsg)
+            const uint32_t feature = 1u << bit;
+            if (variantKey & feature)
             {
-                LOG_ERROR(reinterpret_cast<const char*>(errorMsg->GetBufferPointer()));
+                defines.push_back({ getShaderFeatureDefine(feature), "1" });
             }
-
-            assert(false);
-            return false;
         }
+        defines.push_back({ nullptr, nullptr });
 
-        if (FAILED(D3DCompile(shader, strlen(shader) + 1, nullptr, nullptr, nullptr, "PSMain", "ps_5_0", compileFlags, 0, &pixelShader, &errorMsg)))
+        if (!mPipelineCache->compileShaderAsset(name, defines.data(), entryPoint, target, compileFlags, shader->bytecode))
         {
-            if (errorMsg)
-            {
-                LOG_ERROR(reinterpret_cast<const char*>(errorMsg->GetBufferPointer()));
-            }
-
-            assert(false);
-            return false;
+            LOG_ERROR("Failed to compile %s variant %s\n", name, describeShaderVariant(variantKey).c_str());
+            return std::unique_ptr<ShaderVariant>();
         }
+        return shader;
+    });
+    return variant ? variant->bytecode.Get() : nullptr;
+}
 
-        D3D12_INPUT_ELEMENT_DESC inputElementDescs[]
-        {
-            {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-            {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof(Model::Vertex, uv), D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-            {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(Model::Vertex, normal), D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
-        };
+std::unique_ptr<SimpleShader::PipelineVariant> SimpleShader::createPipelineState(ShaderVariantKey key)
+{
+    // shader model 5.1 for the indexed texture array
+    ID3DBlob* vertexShader = getShader(mVertexShaders, key & VertexFeatures, DefaultVariant & VertexFeatures, "SimpleShaderVS", "VSMain", "vs_5_1");
+    ID3DBlob* pixelShader = getShader(mPixelShaders, key & PixelFeatures, DefaultVariant & PixelFeatures, "SimpleShaderPS", "PSMain", "ps_5_1");
+    if (!vertexShader || !pixelShader)
+    {
+        return nullptr;
+    }
 
-        D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc{};
-        psoDesc.InputLayout = { inputElementDescs, _countof(inputElementDescs) };
-        psoDesc.pRootSignature = mRootSignature.Get();
-        psoDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader.Get());
-        psoDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader.Get());
-        psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-        psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-        psoDesc.DepthStencilState.DepthEnable = TRUE;
-        psoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
-        psoDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
-        psoDesc.DepthStencilState.StencilEnable = FALSE;
-        psoDesc.SampleMask = UINT_MAX;
-        psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-        psoDesc.NumRenderTargets = 1;
-        psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-        psoDesc.SampleDesc.Count = 1;
-        psoDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
-
-        HR_ERROR_CHECK_CALL(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&mPipelineState)), false, "Failed to create graphics pipeline state\n");
+#ifdef _DEBUG
+    // the texture table is sized when the shader is built, it has to match the descriptor range
+    D3D12_SHADER_INPUT_BIND_DESC textures{};
+    if (!PipelineCache::findShaderBinding(pixelShader, "g_textures", textures) || textures.BindCount != MaxMaterials)
+    {
+        LOG_ERROR("SimpleShaderPS binds %u textures, expected %u\n", textures.BindCount, MaxMaterials);
+        return nullptr;
     }
+#endif
+
+    D3D12_INPUT_ELEMENT_DESC inputElementDescs[]
+    {
+        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof(Mesh::Vertex, uv), D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+        {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(Mesh::Vertex, normal), D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
+    };
 
-    return true;
+    // the input assembler expands the quantized formats, the vertex shader is the same
+    D3D12_INPUT_ELEMENT_DESC quantizedElementDescs[]
+    {
+        {"POSITION", 0, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+        {"TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, offsetof(Mesh::QuantizedVertex, uv), D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+        {"NORMAL", 0, DXGI_FORMAT_R8G8B8A8_SNORM, 0, offsetof(Mesh::QuantizedVertex, normal), D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
+    };
+
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc{};
+    if (key & ShaderFeatureQuantizedVertices)
+    {
+        psoDesc.InputLayout = { quantizedElementDescs, _countof(quantizedElementDescs) };
+    }
+    else
+    {
+        psoDesc.InputLayout = { inputElementDescs, _countof(inputElementDescs) };
+    }
+    psoDesc.pRootSignature = mRootSignature.Get();
+    psoDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader);
+    psoDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader);
+    psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+    psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+    psoDesc.DepthStencilState.DepthEnable = TRUE;
+    psoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
+    psoDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
+    psoDesc.DepthStencilState.StencilEnable = FALSE;
+    psoDesc.SampleMask = UINT_MAX;
+    psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+    psoDesc.NumRenderTargets = 1;
+    psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+    psoDesc.SampleDesc.Count = 1;
+    psoDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+
+    std::unique_ptr<PipelineVariant> variant = std::make_unique<PipelineVariant>();
+    if (!mPipelineCache->createGraphicsPipelineState(psoDesc, variant->pipelineState))
+    {
+        return nullptr;
+    }
+    return variant;
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include "StagingRing.h"
+
+#include <assert.h>
+
+namespace HDX
+{
+
+StagingRing::StagingRing(uint64_t capacity)
+    : mCapacity(capacity)
+{
+}
+
+bool StagingRing::allocate(uint64_t size, uint64_t alignment, uint64_t &offset)
+{
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+    if (size == 0 || size > mCapacity)
+    {
+        return false;
+    }
+
+    uint64_t start = (mHead + alignment - 1) & ~(alignment - 1);
+    if (start + size > mCapacity)
+    {
+        // skip the tail of the buffer, the allocation has to be contiguous
+        start = 0;
+    }
+
+    // free space is contiguous from mHead, the padding skipped to reach start is consumed with the allocation
+    uint64_t padding = start >= mHead ? start - mHead : mCapacity - mHead;
+    uint64_t required = padding + size;
+    if (mUsed + required > mCapacity)
+    {
+        return false;
+    }
+
+    mHead = start + size;
+    mUsed += required;
+    mPending += required;
+    offset = start;
+    return true;
+}
+
+void StagingRing::retire(uint64_t fenceValue)
+{
+    if (mPending == 0)
+    {
+        return;
+    }
+
+    assert(mRetired.empty() || mRetired.back().fenceValue < fenceValue);
+    mRetired.push_back({ fenceValue, mPending });
+    mPending = 0;
+}
+
+void StagingRing::reclaim(uint64_t completedFenceValue)
+{
+    while (!mRetired.empty() && mRetired.front().fenceValue <= completedFenceValue)
+    {
+        mUsed -= mRetired.front().size;
+        mRetired.pop_front();
+    }
+
+    if (mUsed == 0)
+    {
+        // restart at the beginning so the next allocations do not pay for a wrap
+        mHead = 0;
+    }
+}
+
+}
\ No newline at end of file
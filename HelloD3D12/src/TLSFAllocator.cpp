@@ -0,0 +1,325 @@
+#include "TLSFAllocator.h"
+
+#include <assert.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace HDX
+{
+
+static uint32_t findLowestBit(uint64_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(mask));
+#endif
+}
+
+static uint32_t findHighestBit(uint64_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, mask);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(63 - __builtin_clzll(mask));
+#endif
+}
+
+TLSFAllocator::TLSFAllocator(uint64_t capacity)
+    : mCapacity(capacity)
+{
+    for (auto &lists : mFreeLists)
+    {
+        for (auto &head : lists)
+        {
+            head = InvalidHandle;
+        }
+    }
+
+    if (capacity > 0)
+    {
+        uint32_t index = newBlock();
+        mBlocks[index].offset = 0;
+        mBlocks[index].size = capacity;
+        insertFree(index);
+    }
+}
+
+bool TLSFAllocator::allocate(uint64_t size, uint64_t alignment, Allocation &allocation)
+{
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+    if (size == 0 || size > getFree())
+    {
+        return false;
+    }
+
+    auto fitsAligned = [this, size, alignment](uint32_t index)
+    {
+        const Block &block = mBlocks[index];
+        uint64_t start = (block.offset + alignment - 1) & ~(alignment - 1);
+        return start - block.offset + size <= block.size;
+    };
+
+    // most blocks are already aligned, only pay for the worst case padding when the good fit is not
+    uint32_t index = findFree(size);
+    if (index == InvalidHandle || !fitsAligned(index))
+    {
+        index = findFree(size + alignment - 1);
+    }
+    if (index == InvalidHandle)
+    {
+        // both searches round up to the next bin, the first block of the bin of size itself may still fit,
+        // e.g. a request for all the free space left
+        uint32_t firstLevel, secondLevel;
+        mapping(size, firstLevel, secondLevel);
+        index = mFreeLists[firstLevel][secondLevel];
+        if (index == InvalidHandle || !fitsAligned(index))
+        {
+            return false;
+        }
+    }
+    assert(fitsAligned(index));
+
+    removeFree(index);
+
+    uint64_t padding = ((mBlocks[index].offset + alignment - 1) & ~(alignment - 1)) - mBlocks[index].offset;
+    if (padding > 0)
+    {
+        // the free neighbours of a free block are always merged into it, so the padding cannot merge either
+        uint32_t aligned = newBlock();
+        split(index, padding, aligned);
+        insertFree(index);
+        index = aligned;
+    }
+
+    if (mBlocks[index].size > size)
+    {
+        uint32_t remainder = newBlock();
+        split(index, size, remainder);
+        insertFree(remainder);
+    }
+
+    mUsed += size;
+    mAllocationCount++;
+
+    allocation.offset = mBlocks[index].offset;
+    allocation.size = size;
+    allocation.handle = index;
+    return true;
+}
+
+void TLSFAllocator::free(uint32_t handle)
+{
+    assert(handle < mBlocks.size() && !mBlocks[handle].isFree);
+
+    uint32_t index = handle;
+    mUsed -= mBlocks[index].size;
+    mAllocationCount--;
+
+    uint32_t prev = mBlocks[index].prevPhysical;
+    if (prev != InvalidHandle && mBlocks[prev].isFree)
+    {
+        removeFree(prev);
+        mBlocks[prev].size += mBlocks[index].size;
+        mBlocks[prev].nextPhysical = mBlocks[index].nextPhysical;
+        if (mBlocks[index].nextPhysical != InvalidHandle)
+        {
+            mBlocks[mBlocks[index].nextPhysical].prevPhysical = prev;
+        }
+        deleteBlock(index);
+        index = prev;
+    }
+
+    uint32_t next = mBlocks[index].nextPhysical;
+    if (next != InvalidHandle && mBlocks[next].isFree)
+    {
+        removeFree(next);
+        mBlocks[index].size += mBlocks[next].size;
+        mBlocks[index].nextPhysical = mBlocks[next].nextPhysical;
+        if (mBlocks[next].nextPhysical != InvalidHandle)
+        {
+            mBlocks[mBlocks[next].nextPhysical].prevPhysical = index;
+        }
+        deleteBlock(next);
+    }
+
+    insertFree(index);
+}
+
+uint64_t TLSFAllocator::getLargestFreeBlock() const
+{
+    if (mFirstLevelBitmap == 0)
+    {
+        return 0;
+    }
+
+    // the highest bin holds the largest blocks, but its blocks are not sorted
+    uint32_t firstLevel = findHighestBit(mFirstLevelBitmap);
+    uint32_t secondLevel = findHighestBit(mSecondLevelBitmaps[firstLevel]);
+    uint64_t largest = 0;
+    for (uint32_t index = mFreeLists[firstLevel][secondLevel]; index != InvalidHandle; index = mBlocks[index].nextFree)
+    {
+        largest = mBlocks[index].size > largest ? mBlocks[index].size : largest;
+    }
+    return largest;
+}
+
+float TLSFAllocator::getFragmentation() const
+{
+    uint64_t freeBytes = getFree();
+    if (freeBytes == 0)
+    {
+        return 0.f;
+    }
+    return 1.f - static_cast<float>(static_cast<double>(getLargestFreeBlock()) / static_cast<double>(freeBytes));
+}
+
+void TLSFAllocator::mapping(uint64_t size, uint32_t &firstLevel, uint32_t &secondLevel)
+{
+    if (size < SubdivisionCount)
+    {
+        firstLevel = 0;
+        secondLevel = static_cast<uint32_t>(size);
+        return;
+    }
+
+    uint32_t highestBit = findHighestBit(size);
+    firstLevel = highestBit - SubdivisionBits + 1;
+    secondLevel = static_cast<uint32_t>(size >> (highestBit - SubdivisionBits)) - SubdivisionCount;
+}
+
+uint32_t TLSFAllocator::newBlock()
+{
+    uint32_t index;
+    if (!mUnusedBlocks.empty())
+    {
+        index = mUnusedBlocks.back();
+        mUnusedBlocks.pop_back();
+    }
+    else
+    {
+        index = static_cast<uint32_t>(mBlocks.size());
+        mBlocks.emplace_back();
+    }
+
+    mBlocks[index] = { 0, 0, InvalidHandle, InvalidHandle, InvalidHandle, InvalidHandle, false };
+    return index;
+}
+
+void TLSFAllocator::deleteBlock(uint32_t index)
+{
+    mUnusedBlocks.push_back(index);
+}
+
+void TLSFAllocator::insertFree(uint32_t index)
+{
+    uint32_t firstLevel, secondLevel;
+    mapping(mBlocks[index].size, firstLevel, secondLevel);
+
+    uint32_t head = mFreeLists[firstLevel][secondLevel];
+    mBlocks[index].isFree = true;
+    mBlocks[index].prevFree = InvalidHandle;
+    mBlocks[index].nextFree = head;
+    if (head != InvalidHandle)
+    {
+        mBlocks[head].prevFree = index;
+    }
+
+    mFreeLists[firstLevel][secondLevel] = index;
+    mFirstLevelBitmap |= 1ull << firstLevel;
+    mSecondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+    mFreeBlockCount++;
+}
+
+void TLSFAllocator::removeFree(uint32_t index)
+{
+    uint32_t firstLevel, secondLevel;
+    mapping(mBlocks[index].size, firstLevel, secondLevel);
+
+    Block &block = mBlocks[index];
+    if (block.prevFree != InvalidHandle)
+    {
+        mBlocks[block.prevFree].nextFree = block.nextFree;
+    }
+    else
+    {
+        mFreeLists[firstLevel][secondLevel] = block.nextFree;
+        if (block.nextFree == InvalidHandle)
+        {
+            mSecondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+            if (mSecondLevelBitmaps[firstLevel] == 0)
+            {
+                mFirstLevelBitmap &= ~(1ull << firstLevel);
+            }
+        }
+    }
+
+    if (block.nextFree != InvalidHandle)
+    {
+        mBlocks[block.nextFree].prevFree = block.prevFree;
+    }
+
+    block.isFree = false;
+    block.prevFree = InvalidHandle;
+    block.nextFree = InvalidHandle;
+    mFreeBlockCount--;
+}
+
+uint32_t TLSFAllocator::findFree(uint64_t size) const
+{
+    // round up to the next bin boundary so every block of the bin found fits
+    if (size >= SubdivisionCount)
+    {
+        uint64_t roundUp = (1ull << (findHighestBit(size) - SubdivisionBits)) - 1;
+        if (size > UINT64_MAX - roundUp)
+        {
+            return InvalidHandle;
+        }
+        size += roundUp;
+    }
+
+    uint32_t firstLevel, secondLevel;
+    mapping(size, firstLevel, secondLevel);
+
+    uint32_t secondLevelMap = mSecondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+    if (secondLevelMap == 0)
+    {
+        uint64_t firstLevelMap = firstLevel + 1 < 64 ? mFirstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+        if (firstLevelMap == 0)
+        {
+            return InvalidHandle;
+        }
+        firstLevel = findLowestBit(firstLevelMap);
+        secondLevelMap = mSecondLevelBitmaps[firstLevel];
+    }
+
+    return mFreeLists[firstLevel][findLowestBit(secondLevelMap)];
+}
+
+void TLSFAllocator::split(uint32_t index, uint64_t size, uint32_t remainder)
+{
+    assert(size < mBlocks[index].size);
+
+    Block &block = mBlocks[index];
+    Block &rest = mBlocks[remainder];
+    rest.offset = block.offset + size;
+    rest.size = block.size - size;
+    rest.prevPhysical = index;
+    rest.nextPhysical = block.nextPhysical;
+    if (block.nextPhysical != InvalidHandle)
+    {
+        mBlocks[block.nextPhysical].prevPhysical = remainder;
+    }
+
+    block.size = size;
+    block.nextPhysical = remainder;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include "UploadManager.h"
+
+namespace HDX
+{
+
+UploadManager::~UploadManager()
+{
+    if (mFence)
+    {
+        waitIdle();
+    }
+
+    if (mFenceEvent)
+    {
+        CloseHandle(mFenceEvent);
+    }
+}
+
+bool UploadManager::prepare(ID3D12Device* device, UINT64 stagingSize)
+{
+    mDevice = device;
+
+    D3D12_COMMAND_QUEUE_DESC queueDesc{};
+    queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+    queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+    HR_ERROR_CHECK_CALL(device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&mCopyQueue)), false, "Failed to create copy queue!\n");
+
+    HR_ERROR_CHECK_CALL(device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(stagingSize),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&mStagingBuffer)), false, "Failed to create staging buffer!\n");
+
+    CD3DX12_RANGE readRange(0, 0);
+    HR_ERROR_CHECK_CALL(mStagingBuffer->Map(0, &readRange, reinterpret_cast<void**>(&mStagingBegin)), false, "Failed to map staging buffer\n");
+    mRing = std::make_unique<StagingRing>(stagingSize);
+
+    HR_ERROR_CHECK_CALL(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)), false, "Failed to create copy fence\n");
+    mFenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    if (mFenceEvent == nullptr)
+    {
+        LOG_ERROR("Failed to create copy fence event\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool UploadManager::uploadBuffer(ID3D12Resource* destination, UINT64 destinationOffset, const void* data, UINT64 size)
+{
+    const UINT8* src = reinterpret_cast<const UINT8*>(data);
+    UINT64 uploaded = 0;
+    while (uploaded < size)
+    {
+        UINT64 chunkSize = std::min(size - uploaded, mRing->getCapacity());
+        UINT64 stagingOffset = 0;
+        if (!allocateStaging(chunkSize, 16, stagingOffset))
+        {
+            return false;
+        }
+
+        memcpy(mStagingBegin + stagingOffset, src + uploaded, chunkSize);
+        mCommandList->CopyBufferRegion(destination, destinationOffset + uploaded, mStagingBuffer.Get(), stagingOffset, chunkSize);
+        uploaded += chunkSize;
+    }
+
+    return true;
+}
+
+bool UploadManager::uploadTexture(ID3D12Resource* destination, const D3D12_SUBRESOURCE_DATA& data)
+{
+    D3D12_RESOURCE_DESC desc = destination->GetDesc();
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+    UINT numRows = 0;
+    UINT64 rowSize = 0;
+    mDevice->GetCopyableFootprints(&desc, 0, 1, 0, &footprint, &numRows, &rowSize, nullptr);
+
+    // copy bands of rows so a texture larger than the ring streams through it
+    const UINT64 rowPitch = footprint.Footprint.RowPitch;
+    const UINT maxBandRows = static_cast<UINT>(std::min<UINT64>(numRows, (mRing->getCapacity() - D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT) / rowPitch));
+    if (maxBandRows == 0)
+    {
+        LOG_ERROR("Staging ring too small for a row of %llu bytes\n", rowPitch);
+        return false;
+    }
+
+    const UINT8* src = reinterpret_cast<const UINT8*>(data.pData);
+    for (UINT row = 0; row < numRows; row += maxBandRows)
+    {
+        UINT bandRows = std::min(maxBandRows, numRows - row);
+        UINT64 stagingOffset = 0;
+        if (!allocateStaging(rowPitch * bandRows, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, stagingOffset))
+        {
+            return false;
+        }
+
+        for (UINT i = 0; i < bandRows; i++)
+        {
+            memcpy(mStagingBegin + stagingOffset + i * rowPitch, src + (row + i) * data.RowPitch, static_cast<size_t>(rowSize));
+        }
+
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT bandFootprint = footprint;
+        bandFootprint.Offset = stagingOffset;
+        bandFootprint.Footprint.Height = bandRows;
+
+        CD3DX12_TEXTURE_COPY_LOCATION dst(destination, 0);
+        CD3DX12_TEXTURE_COPY_LOCATION srcLocation(mStagingBuffer.Get(), bandFootprint);
+        mCommandList->CopyTextureRegion(&dst, 0, row, 0, &srcLocation, nullptr);
+    }
+
+    return true;
+}
+
+UINT64 UploadManager::submit()
+{
+    if (!mIsRecording)
+    {
+        // nothing recorded since the last submit, its fence covers everything
+        return mNextFenceValue - 1;
+    }
+
+    mIsRecording = false;
+    HR_ERROR_CHECK_CALL(mCommandList->Close(), 0, "Failed to close copy command list\n");
+    ID3D12CommandList* ppCommandLists[] = { mCommandList.Get() };
+    mCopyQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+
+    UINT64 fenceValue = mNextFenceValue++;
+    HR_ERROR_CHECK_CALL(mCopyQueue->Signal(mFence.Get(), fenceValue), 0, "Failed to signal copy queue!\n");
+
+    mAllocators.push_back({ mCurrentAllocator, fenceValue });
+    mCurrentAllocator.Reset();
+    mRing->retire(fenceValue);
+    return fenceValue;
+}
+
+void UploadManager::waitOnQueue(ID3D12CommandQueue* queue, UINT64 fenceValue)
+{
+    HR_ERROR_CHECK_CALL(queue->Wait(mFence.Get(), fenceValue), void(), "Failed to wait on copy fence!\n");
+}
+
+void UploadManager::reclaim()
+{
+    mRing->reclaim(mFence->GetCompletedValue());
+}
+
+void UploadManager::waitIdle()
+{
+    submit();
+    waitForFence(mNextFenceValue - 1);
+    reclaim();
+}
+
+bool UploadManager::beginCommandList()
+{
+    if (mIsRecording)
+    {
+        return true;
+    }
+
+    if (!mAllocators.empty() && mAllocators.front().fenceValue <= mFence->GetCompletedValue())
+    {
+        mCurrentAllocator = mAllocators.front().allocator;
+        mAllocators.pop_front();
+        HR_ERROR_CHECK_CALL(mCurrentAllocator->Reset(), false, "Failed to reset copy command allocator\n");
+    }
+    else
+    {
+        HR_ERROR_CHECK_CALL(mDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&mCurrentAllocator)), false, "Failed to create copy command allocator\n");
+    }
+
+    if (!mCommandList)
+    {
+        HR_ERROR_CHECK_CALL(mDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, mCurrentAllocator.Get(), nullptr, IID_PPV_ARGS(&mCommandList)), false, "Failed to create copy command list\n");
+    }
+    else
+    {
+        HR_ERROR_CHECK_CALL(mCommandList->Reset(mCurrentAllocator.Get(), nullptr), false, "Failed to reset copy command list\n");
+    }
+
+    mIsRecording = true;
+    return true;
+}
+
+bool UploadManager::allocateStaging(UINT64 size, UINT64 alignment, UINT64 &offset)
+{
+    reclaim();
+    while (!mRing->allocate(size, alignment, offset))
+    {
+        // the ring is full: flush what is recorded and block on the oldest submission still holding staging memory
+        submit();
+        UINT64 oldestFenceValue = mRing->getOldestFenceValue();
+        if (oldestFenceValue == 0)
+        {
+            LOG_ERROR("Upload of %llu bytes does not fit the staging ring\n", size);
+            return false;
+        }
+
+        waitForFence(oldestFenceValue);
+        reclaim();
+    }
+
+    return beginCommandList();
+}
+
+void UploadManager::waitForFence(UINT64 fenceValue)
+{
+    if (mFence->GetCompletedValue() < fenceValue)
+    {
+        HR_ERROR_CHECK_CALL(mFence->SetEventOnCompletion(fenceValue, mFenceEvent), void(), "Failed to set event on completion\n");
+        WaitForSingleObjectEx(mFenceEvent, INFINITE, FALSE);
+    }
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace HDX;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static const uint32_t ObjectCount{ 100000 };
+static const int MotionFrames{ 200 };
+static const int QueryRepeats{ 50 };
+static const int RayCount{ 10000 };
+
+static double getMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void multiply(const float* a, const float* b, float* result)
+{
+    for (int row = 0; row < 4; row++)
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            float sum = 0.f;
+            for (int k = 0; k < 4; k++)
+            {
+                sum += a[row * 4 + k] * b[k * 4 + column];
+            }
+            result[row * 4 + column] = sum;
+        }
+    }
+}
+
+// camera at the origin looking down +z, 70 degree field of view, near 0.1, far 150
+static Frustum makeFrustum()
+{
+    const float n = 0.1f;
+    const float f = 150.f;
+    const float scale = 1.f / std::tan(0.6f);
+    const float projection[16] = {
+        scale, 0.f, 0.f, 0.f,
+        0.f, scale, 0.f, 0.f,
+        0.f, 0.f, f / (f - n), 1.f,
+        0.f, 0.f, -n * f / (f - n), 0.f
+    };
+    const float view[16] = {
+        1.f, 0.f, 0.f, 0.f,
+        0.f, 1.f, 0.f, 0.f,
+        0.f, 0.f, 1.f, 0.f,
+        0.f, 0.f, 0.f, 1.f
+    };
+    float viewProjection[16];
+    multiply(view, projection, viewProjection);
+    return Frustum::fromViewProjection(viewProjection);
+}
+
+static bool isBoxVisible(const Bounds& bounds, const Plane* planes, uint32_t planeCount)
+{
+    for (uint32_t i = 0; i < planeCount; i++)
+    {
+        const Plane& plane = planes[i];
+        const float distance = plane.normal.x * bounds.center.x + plane.normal.y * bounds.center.y + plane.normal.z * bounds.center.z + plane.distance;
+        const float radius = std::fabs(plane.normal.x) * bounds.extents.x + std::fabs(plane.normal.y) * bounds.extents.y + std::fabs(plane.normal.z) * bounds.extents.z;
+        if (distance + radius < 0.f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void measureCull(const char* name, const Bvh& bvh, const Frustum& frustum, std::vector<uint8_t>& visible)
+{
+    uint32_t count = 0;
+    const Clock::time_point start = Clock::now();
+    for (int repeat = 0; repeat < QueryRepeats; repeat++)
+    {
+        count = bvh.cull(frustum.planes, Frustum::SideCount, visible.data());
+    }
+    printf("%-28s %8.3f ms, %u visible\n", name, getMs(start) / QueryRepeats, count);
+}
+
+int main()
+{
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> position(-200.f, 200.f);
+    std::uniform_real_distribution<float> size(0.1f, 2.f);
+    std::uniform_real_distribution<float> speed(-0.3f, 0.3f);
+
+    std::vector<Bounds> bounds(ObjectCount);
+    std::vector<Float3> velocities(ObjectCount);
+    for (uint32_t i = 0; i < ObjectCount; i++)
+    {
+        const Float3 center{ position(random), position(random), position(random) };
+        const float extent = size(random);
+        bounds[i] = makeBounds({ center.x - extent, center.y - extent, center.z - extent }, { center.x + extent, center.y + extent, center.z + extent });
+        velocities[i] = { speed(random), speed(random), speed(random) };
+    }
+    const Frustum frustum = makeFrustum();
+    std::vector<uint8_t> visible(ObjectCount);
+
+    printf("%u objects\n", ObjectCount);
+    Bvh bvh;
+    Clock::time_point start = Clock::now();
+    bvh.build(bounds.data(), ObjectCount);
+    const double buildMs = getMs(start);
+    printf("%-28s %8.3f ms, %u binary nodes, %u BVH4 nodes, depth %u, SAH cost %.1f\n", "build", buildMs,
+        bvh.getStats().binaryNodes, bvh.getStats().wideNodes, bvh.getStats().depth, bvh.getStats().sahCost);
+    measureCull("cull", bvh, frustum, visible);
+
+    start = Clock::now();
+    uint32_t bruteCount = 0;
+    for (int repeat = 0; repeat < QueryRepeats; repeat++)
+    {
+        bruteCount = 0;
+        for (uint32_t i = 0; i < ObjectCount; i++)
+        {
+            visible[i] = isBoxVisible(bounds[i], frustum.planes, Frustum::SideCount) ? 1 : 0;
+            bruteCount += visible[i];
+        }
+    }
+    printf("%-28s %8.3f ms, %u visible\n", "cull, brute force", getMs(start) / QueryRepeats, bruteCount);
+
+    // objects oscillate along their velocity, the tree follows by refits only
+    for (int rotate = 0; rotate < 2; rotate++)
+    {
+        std::vector<Bounds> moved = bounds;
+        Bvh animated;
+        animated.build(moved.data(), ObjectCount);
+        double refitMs = 0.;
+        uint64_t rotations = 0;
+        for (int frame = 0; frame < MotionFrames; frame++)
+        {
+            for (uint32_t i = 0; i < ObjectCount; i++)
+            {
+                const float amount = std::sin(frame * 0.05f + i) * 10.f;
+                moved[i].center = { bounds[i].center.x + velocities[i].x * amount, bounds[i].center.y + velocities[i].y * amount, bounds[i].center.z + velocities[i].z * amount };
+            }
+            start = Clock::now();
+            animated.refit(moved.data(), rotate != 0);
+            refitMs += getMs(start);
+            rotations += animated.getStats().rotations;
+        }
+
+        Bvh rebuilt;
+        rebuilt.build(moved.data(), ObjectCount);
+        printf("%-28s %8.3f ms/frame, %llu rotations/frame, SAH cost %.1f after %d frames (rebuild %.1f)\n",
+            rotate ? "refit with rotations" : "refit", refitMs / MotionFrames, static_cast<unsigned long long>(rotations / MotionFrames),
+            animated.getStats().sahCost, MotionFrames, rebuilt.getStats().sahCost);
+        measureCull(rotate ? "cull after rotating refits" : "cull after refits", animated, frustum, visible);
+    }
+
+    std::vector<uint32_t> objects;
+    size_t found = 0;
+    start = Clock::now();
+    for (int query = 0; query < RayCount; query++)
+    {
+        objects.clear();
+        bvh.querySphere({ position(random), position(random), position(random) }, 10.f, objects);
+        found += objects.size();
+    }
+    printf("%-28s %8.4f ms/query, %.1f objects\n", "sphere query, radius 10", getMs(start) / RayCount, static_cast<double>(found) / RayCount);
+
+    uint32_t hits = 0;
+    start = Clock::now();
+    for (int ray = 0; ray < RayCount; ray++)
+    {
+        const Float3 origin{ position(random), position(random), position(random) };
+        Float3 direction{ position(random), position(random), position(random) };
+        const float length = std::sqrt(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+        direction = { direction.x / length, direction.y / length, direction.z / length };
+        float distance;
+        hits += bvh.raycast(origin, direction, 1000.f, &distance) != Bvh::InvalidIndex ? 1 : 0;
+    }
+    printf("%-28s %8.4f ms/ray, %u of %d rays hit\n", "ray pick", getMs(start) / RayCount, hits, RayCount);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,275 @@
+#include "Bvh.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace HDX;
+
+static const uint32_t ObjectCount{ 5000 };
+
+static void multiply(const float* a, const float* b, float* result)
+{
+    for (int row = 0; row < 4; row++)
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            float sum = 0.f;
+            for (int k = 0; k < 4; k++)
+            {
+                sum += a[row * 4 + k] * b[k * 4 + column];
+            }
+            result[row * 4 + column] = sum;
+        }
+    }
+}
+
+// camera at the origin turned by yaw around y, 70 degree field of view, near 0.1, far 150
+static Frustum makeFrustum(float yaw)
+{
+    const float c = std::cos(yaw);
+    const float s = std::sin(yaw);
+    const float view[16] = {
+        c, 0.f, s, 0.f,
+        0.f, 1.f, 0.f, 0.f,
+        -s, 0.f, c, 0.f,
+        0.f, 0.f, 0.f, 1.f
+    };
+    const float n = 0.1f;
+    const float f = 150.f;
+    const float scale = 1.f / std::tan(0.6f);
+    const float projection[16] = {
+        scale, 0.f, 0.f, 0.f,
+        0.f, scale, 0.f, 0.f,
+        0.f, 0.f, f / (f - n), 1.f,
+        0.f, 0.f, -n * f / (f - n), 0.f
+    };
+    float viewProjection[16];
+    multiply(view, projection, viewProjection);
+    return Frustum::fromViewProjection(viewProjection);
+}
+
+static std::vector<Bounds> makeObjects(std::mt19937& random, uint32_t count)
+{
+    std::uniform_real_distribution<float> position(-100.f, 100.f);
+    std::uniform_real_distribution<float> size(0.1f, 3.f);
+    std::vector<Bounds> bounds(count);
+    for (Bounds& object : bounds)
+    {
+        const Float3 center{ position(random), position(random), position(random) };
+        const float extent = size(random);
+        object = makeBounds({ center.x - extent, center.y - extent, center.z - extent }, { center.x + extent, center.y + extent, center.z + extent });
+    }
+    return bounds;
+}
+
+static bool isBoxVisible(const Bounds& bounds, const Plane* planes, uint32_t planeCount)
+{
+    for (uint32_t i = 0; i < planeCount; i++)
+    {
+        const Plane& plane = planes[i];
+        const float distance = plane.normal.x * bounds.center.x + plane.normal.y * bounds.center.y + plane.normal.z * bounds.center.z + plane.distance;
+        const float radius = std::fabs(plane.normal.x) * bounds.extents.x + std::fabs(plane.normal.y) * bounds.extents.y + std::fabs(plane.normal.z) * bounds.extents.z;
+        if (distance + radius < 0.f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool isBoxInSphere(const Bounds& bounds, const Float3& center, float radius)
+{
+    const float dx = std::max(std::fabs(center.x - bounds.center.x) - bounds.extents.x, 0.f);
+    const float dy = std::max(std::fabs(center.y - bounds.center.y) - bounds.extents.y, 0.f);
+    const float dz = std::max(std::fabs(center.z - bounds.center.z) - bounds.extents.z, 0.f);
+    return dx * dx + dy * dy + dz * dz <= radius * radius;
+}
+
+// slab test, the distance at which the ray enters the box, or a negative value when it misses
+static float getRayEntry(const Bounds& bounds, const Float3& origin, const Float3& direction, float maxDistance)
+{
+    const float o[3] = { origin.x, origin.y, origin.z };
+    const float d[3] = { direction.x, direction.y, direction.z };
+    const float c[3] = { bounds.center.x, bounds.center.y, bounds.center.z };
+    const float e[3] = { bounds.extents.x, bounds.extents.y, bounds.extents.z };
+    float entry = 0.f;
+    float exit = maxDistance;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (d[axis] == 0.f)
+        {
+            if (std::fabs(o[axis] - c[axis]) > e[axis])
+            {
+                return -1.f;
+            }
+            continue;
+        }
+        const float t0 = (c[axis] - e[axis] - o[axis]) / d[axis];
+        const float t1 = (c[axis] + e[axis] - o[axis]) / d[axis];
+        entry = std::max(entry, std::min(t0, t1));
+        exit = std::min(exit, std::max(t0, t1));
+    }
+    return entry <= exit ? entry : -1.f;
+}
+
+static uint32_t countCullMismatches(const Bvh& bvh, const std::vector<Bounds>& bounds)
+{
+    uint32_t mismatches = 0;
+    std::vector<uint8_t> visible(bounds.size());
+    for (int view = 0; view < 8; view++)
+    {
+        const Frustum frustum = makeFrustum(0.8f * view);
+        uint32_t expectedCount = 0;
+        const uint32_t count = bvh.cull(frustum.planes, Frustum::SideCount, visible.data());
+        for (size_t i = 0; i < bounds.size(); i++)
+        {
+            const bool expected = isBoxVisible(bounds[i], frustum.planes, Frustum::SideCount);
+            expectedCount += expected ? 1 : 0;
+            mismatches += expected != (visible[i] != 0) ? 1 : 0;
+        }
+        mismatches += count != expectedCount ? 1 : 0;
+    }
+    return mismatches;
+}
+
+static void testCullMatchesBruteForce()
+{
+    std::mt19937 random(1);
+    std::vector<Bounds> bounds = makeObjects(random, ObjectCount);
+    Bvh bvh;
+    bvh.build(bounds.data(), ObjectCount);
+    HDX_CHECK(bvh.getCount() == ObjectCount);
+    HDX_CHECK(countCullMismatches(bvh, bounds) == 0);
+
+    // objects move, the refitted tree still culls exactly, with and without rotations
+    std::uniform_real_distribution<float> offset(-5.f, 5.f);
+    for (int rotate = 0; rotate < 2; rotate++)
+    {
+        for (int frame = 0; frame < 10; frame++)
+        {
+            for (Bounds& object : bounds)
+            {
+                object.center.x += offset(random);
+                object.center.y += offset(random);
+                object.center.z += offset(random);
+            }
+            bvh.refit(bounds.data(), rotate != 0);
+        }
+        HDX_CHECK(countCullMismatches(bvh, bounds) == 0);
+    }
+}
+
+static void testSphereQueryMatchesBruteForce()
+{
+    std::mt19937 random(2);
+    const std::vector<Bounds> bounds = makeObjects(random, ObjectCount);
+    Bvh bvh;
+    bvh.build(bounds.data(), ObjectCount);
+
+    std::uniform_real_distribution<float> position(-100.f, 100.f);
+    std::vector<uint32_t> objects;
+    uint32_t mismatches = 0;
+    for (int query = 0; query < 200; query++)
+    {
+        const Float3 center{ position(random), position(random), position(random) };
+        const float radius = 2.f + static_cast<float>(query % 20);
+        objects.clear();
+        bvh.querySphere(center, radius, objects);
+
+        std::vector<uint8_t> found(ObjectCount, 0);
+        for (uint32_t object : objects)
+        {
+            mismatches += found[object] ? 1 : 0;
+            found[object] = 1;
+        }
+        for (uint32_t i = 0; i < ObjectCount; i++)
+        {
+            mismatches += isBoxInSphere(bounds[i], center, radius) != (found[i] != 0) ? 1 : 0;
+        }
+    }
+    HDX_CHECK(mismatches == 0);
+}
+
+static void testRaycastMatchesBruteForce()
+{
+    std::mt19937 random(3);
+    const std::vector<Bounds> bounds = makeObjects(random, ObjectCount);
+    Bvh bvh;
+    bvh.build(bounds.data(), ObjectCount);
+
+    std::uniform_real_distribution<float> position(-100.f, 100.f);
+    const float maxDistance = 400.f;
+    uint32_t mismatches = 0;
+    uint32_t hits = 0;
+    for (int ray = 0; ray < 500; ray++)
+    {
+        const Float3 origin{ position(random), position(random), position(random) };
+        Float3 direction{ position(random), position(random), position(random) };
+        // axis aligned rays take the zero direction paths
+        if (ray % 10 == 0)
+        {
+            direction = { 1.f, 0.f, 0.f };
+        }
+        const float length = std::sqrt(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+        direction = { direction.x / length, direction.y / length, direction.z / length };
+
+        float expectedDistance = maxDistance;
+        uint32_t expected = Bvh::InvalidIndex;
+        for (uint32_t i = 0; i < ObjectCount; i++)
+        {
+            const float entry = getRayEntry(bounds[i], origin, direction, maxDistance);
+            if (entry >= 0.f && entry < expectedDistance)
+            {
+                expectedDistance = entry;
+                expected = i;
+            }
+        }
+
+        float distance = 0.f;
+        const uint32_t hit = bvh.raycast(origin, direction, maxDistance, &distance);
+        hits += hit != Bvh::InvalidIndex ? 1 : 0;
+        if (hit != expected)
+        {
+            // two boxes entered at the same distance are both right
+            const bool tie = hit != Bvh::InvalidIndex && expected != Bvh::InvalidIndex && std::fabs(distance - expectedDistance) < 1e-3f;
+            mismatches += tie ? 0 : 1;
+        }
+        else if (hit != Bvh::InvalidIndex)
+        {
+            mismatches += std::fabs(distance - expectedDistance) < 1e-3f ? 0 : 1;
+        }
+    }
+    HDX_CHECK(hits > 0);
+    HDX_CHECK(mismatches == 0);
+}
+
+static void testDegenerateTrees()
+{
+    const Frustum frustum = makeFrustum(0.f);
+
+    Bvh empty;
+    empty.build(nullptr, 0);
+    HDX_CHECK(empty.getCount() == 0);
+    HDX_CHECK(empty.cull(frustum.planes, Frustum::SideCount, nullptr) == 0);
+    HDX_CHECK(empty.raycast({ 0.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, 10.f, nullptr) == Bvh::InvalidIndex);
+
+    // identical boxes cannot be split, the depth must stay bounded
+    const std::vector<Bounds> same(1000, makeBounds({ -1.f, -1.f, 4.f }, { 1.f, 1.f, 6.f }));
+    Bvh bvh;
+    bvh.build(same.data(), static_cast<uint32_t>(same.size()));
+    std::vector<uint8_t> visible(same.size());
+    HDX_CHECK(bvh.getStats().depth <= Bvh::MaxDepth);
+    HDX_CHECK(bvh.cull(frustum.planes, Frustum::SideCount, visible.data()) == same.size());
+}
+
+int main()
+{
+    testCullMatchesBruteForce();
+    testSphereQueryMatchesBruteForce();
+    testRaycastMatchesBruteForce();
+    testDegenerateTrees();
+    return HDX_TEST_RESULT();
+}
\ No newline at end of file
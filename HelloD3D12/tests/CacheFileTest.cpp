@@ -0,0 +1,200 @@
+#include "CacheFile.h"
+#include "Hash.h"
+#include "TestHarness.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace HDX;
+
+namespace
+{
+
+const uint64_t Tag{ 0x1234 };
+const char* const CachePath{ "CacheFileTest.bin" };
+
+// three entries: 3 -> "xy", 7 -> "hello", 9 -> empty
+CacheFile makeCache()
+{
+    CacheFile cache(Tag);
+    cache.insert(7, "hello", 5);
+    cache.insert(3, "xy", 2);
+    cache.insert(9, "", 0);
+    return cache;
+}
+
+bool hasEntry(const CacheFile& cache, uint64_t key, const char* value)
+{
+    const std::vector<uint8_t>* data = cache.find(key);
+    return data != nullptr && data->size() == strlen(value) && memcmp(data->data(), value, data->size()) == 0;
+}
+
+}
+
+static void testHash()
+{
+    // FNV-1a 64 reference values
+    HDX_CHECK(Hasher().get() == 0xcbf29ce484222325ull);
+    HDX_CHECK(hashBytes("a", 1) == 0xaf63dc4c8601ec8cull);
+    HDX_CHECK(hashBytes("foobar", 6) == 0x85944171f73967e8ull);
+
+    // integers are hashed least significant byte first, floats by their bits
+    HDX_CHECK(Hasher().add(uint32_t(0x64636261)).get() == hashBytes("abcd", 4));
+    HDX_CHECK(Hasher().add(uint64_t(0x6867666564636261ull)).get() == hashBytes("abcdefgh", 8));
+    HDX_CHECK(Hasher().add(int32_t(-1)).get() == Hasher().add(uint32_t(0xffffffff)).get());
+    HDX_CHECK(Hasher().add(1.f).get() == Hasher().add(uint32_t(0x3f800000)).get());
+    HDX_CHECK(Hasher().add(0.f).get() != Hasher().add(-0.f).get());
+
+    // the length prefix keeps string boundaries apart
+    HDX_CHECK(Hasher().addString("ab").addString("c").get() != Hasher().addString("a").addString("bc").get());
+    HDX_CHECK(Hasher().addString(nullptr).get() == Hasher().addString("").get());
+    // so does the width of integers
+    HDX_CHECK(Hasher().add(uint32_t(1)).get() != Hasher().add(uint64_t(1)).get());
+}
+
+static void testRoundTrip()
+{
+    const CacheFile cache = makeCache();
+    HDX_CHECK(cache.isDirty() && cache.getEntryCount() == 3);
+
+    std::vector<uint8_t> data;
+    cache.serialize(data);
+    HDX_CHECK(data.size() == CacheFile::HeaderSize + 3 * CacheFile::EntryHeaderSize + 7);
+    HDX_CHECK(memcmp(data.data(), "HDXC", 4) == 0);
+
+    CacheFile loaded(Tag);
+    HDX_CHECK(loaded.deserialize(data.data(), data.size()));
+    HDX_CHECK(loaded.getEntryCount() == 3 && loaded.getCorruptEntryCount() == 0 && !loaded.isDirty());
+    HDX_CHECK(hasEntry(loaded, 3, "xy") && hasEntry(loaded, 7, "hello") && hasEntry(loaded, 9, ""));
+    HDX_CHECK(loaded.find(8) == nullptr);
+
+    // entries are sorted by key, the same contents give the same bytes whatever the insertion order
+    CacheFile reordered(Tag);
+    reordered.insert(9, "", 0);
+    reordered.insert(3, "xy", 2);
+    reordered.insert(7, "hello", 5);
+    std::vector<uint8_t> reorderedData;
+    reordered.serialize(reorderedData);
+    HDX_CHECK(reorderedData == data);
+
+    // inserting an existing key replaces its data
+    reordered.insert(7, "bye", 3);
+    HDX_CHECK(reordered.getEntryCount() == 3 && hasEntry(reordered, 7, "bye"));
+}
+
+static void testRejectsOtherVersionsAndTags()
+{
+    std::vector<uint8_t> data;
+    makeCache().serialize(data);
+
+    CacheFile otherTag(Tag + 1);
+    HDX_CHECK(!otherTag.deserialize(data.data(), data.size()));
+    HDX_CHECK(otherTag.getEntryCount() == 0);
+
+    std::vector<uint8_t> otherVersion = data;
+    otherVersion[4] = static_cast<uint8_t>(CacheFile::Version + 1);
+    CacheFile cache(Tag);
+    HDX_CHECK(!cache.deserialize(otherVersion.data(), otherVersion.size()));
+    HDX_CHECK(cache.getEntryCount() == 0);
+
+    std::vector<uint8_t> otherMagic = data;
+    otherMagic[0] = 'X';
+    HDX_CHECK(!cache.deserialize(otherMagic.data(), otherMagic.size()));
+
+    // a failed load drops what was there before
+    HDX_CHECK(cache.deserialize(data.data(), data.size()) && cache.getEntryCount() == 3);
+    HDX_CHECK(!cache.deserialize(otherVersion.data(), otherVersion.size()));
+    HDX_CHECK(cache.getEntryCount() == 0);
+}
+
+static void testRejectsTruncatedFiles()
+{
+    std::vector<uint8_t> data;
+    makeCache().serialize(data);
+
+    // shorter than the header
+    CacheFile cache(Tag);
+    HDX_CHECK(!cache.deserialize(data.data(), CacheFile::HeaderSize - 1));
+    HDX_CHECK(!cache.deserialize(data.data(), 0));
+
+    // every cut keeps the entries read completely before it, and counts the others as corrupt
+    const size_t entryEnds[] = { CacheFile::HeaderSize + CacheFile::EntryHeaderSize + 2, CacheFile::HeaderSize + 2 * CacheFile::EntryHeaderSize + 7 };
+    for (size_t size = CacheFile::HeaderSize; size < data.size(); size++)
+    {
+        HDX_CHECK(cache.deserialize(data.data(), size));
+        const size_t complete = size >= entryEnds[1] ? 2 : (size >= entryEnds[0] ? 1 : 0);
+        HDX_CHECK(cache.getEntryCount() == complete);
+        HDX_CHECK(cache.getCorruptEntryCount() == 3 - complete);
+        HDX_CHECK(complete < 1 || hasEntry(cache, 3, "xy"));
+        HDX_CHECK(complete < 2 || hasEntry(cache, 7, "hello"));
+    }
+}
+
+static void testDropsCorruptedEntries()
+{
+    std::vector<uint8_t> data;
+    makeCache().serialize(data);
+
+    // flip one byte of the data of key 3, the first entry
+    std::vector<uint8_t> corrupted = data;
+    corrupted[CacheFile::HeaderSize + CacheFile::EntryHeaderSize] ^= 1;
+    CacheFile cache(Tag);
+    HDX_CHECK(cache.deserialize(corrupted.data(), corrupted.size()));
+    HDX_CHECK(cache.getEntryCount() == 2 && cache.getCorruptEntryCount() == 1);
+    HDX_CHECK(cache.find(3) == nullptr && hasEntry(cache, 7, "hello") && hasEntry(cache, 9, ""));
+
+    // a corrupted checksum drops the entry the same way
+    corrupted = data;
+    corrupted[CacheFile::HeaderSize + 8] ^= 0x80;
+    HDX_CHECK(cache.deserialize(corrupted.data(), corrupted.size()));
+    HDX_CHECK(cache.getEntryCount() == 2 && cache.find(3) == nullptr);
+
+    // a size running past the end of the file drops that entry and everything after it
+    corrupted = data;
+    corrupted[CacheFile::HeaderSize + 16 + 3] = 0x7f;
+    HDX_CHECK(cache.deserialize(corrupted.data(), corrupted.size()));
+    HDX_CHECK(cache.getEntryCount() == 0 && cache.getCorruptEntryCount() == 3);
+
+    // an entry count larger than the file holds
+    corrupted = data;
+    corrupted[16] = 200;
+    HDX_CHECK(cache.deserialize(corrupted.data(), corrupted.size()));
+    HDX_CHECK(cache.getEntryCount() == 3 && cache.getCorruptEntryCount() == 197);
+}
+
+static void testSaveAndLoad()
+{
+    CacheFile cache = makeCache();
+    HDX_CHECK(cache.save(CachePath));
+    HDX_CHECK(!cache.isDirty());
+
+    CacheFile loaded(Tag);
+    HDX_CHECK(loaded.load(CachePath));
+    HDX_CHECK(loaded.getEntryCount() == 3 && hasEntry(loaded, 7, "hello"));
+
+    // saving again replaces the file
+    loaded.insert(11, "more", 4);
+    HDX_CHECK(loaded.isDirty() && loaded.save(CachePath));
+    CacheFile reloaded(Tag);
+    HDX_CHECK(reloaded.load(CachePath) && reloaded.getEntryCount() == 4 && hasEntry(reloaded, 11, "more"));
+
+    // written by another producer
+    CacheFile otherTag(Tag + 1);
+    HDX_CHECK(!otherTag.load(CachePath) && otherTag.getEntryCount() == 0);
+
+    remove(CachePath);
+    CacheFile missing(Tag);
+    HDX_CHECK(!missing.load(CachePath) && missing.getEntryCount() == 0);
+}
+
+int main()
+{
+    testHash();
+    testRoundTrip();
+    testRejectsOtherVersionsAndTags();
+    testRejectsTruncatedFiles();
+    testDropsCorruptedEntries();
+    testSaveAndLoad();
+    return HDX_TEST_RESULT();
+}
\ No newline at end of file
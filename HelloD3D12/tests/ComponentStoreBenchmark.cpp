@@ -0,0 +1,196 @@
+#include "ComponentStore.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace HDX;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static const uint32_t EntityCount{ 100000 };
+static const int IterationRepeats{ 30 };
+
+static double getMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// the components of a renderable model, sized like the renderer's
+struct Transform
+{
+    float world[16];
+    float position[3];
+    float spin;
+    float viewDepth;
+    float shadowDepth;
+    uint32_t node;
+};
+
+struct MeshReference
+{
+    std::shared_ptr<int> mesh;
+    uint32_t meshId;
+};
+
+struct Material
+{
+    uint32_t index;
+};
+
+struct Bounds
+{
+    float center[3];
+    float extents[3];
+    float radius;
+};
+
+// the old layout: one heap object per model behind a vector of unique_ptr
+struct Model
+{
+    std::shared_ptr<int> mesh;
+    uint32_t meshId;
+    float position[3];
+    float spin;
+    uint32_t node;
+    uint32_t material;
+    float world[16];
+    float viewDepth;
+    float shadowDepth;
+    Bounds bounds;
+};
+
+typedef ComponentStore<Transform, MeshReference, Material, Bounds> ModelComponents;
+
+int main()
+{
+    std::mt19937 random(3);
+    const std::shared_ptr<int> mesh = std::make_shared<int>(1);
+
+    // heap objects allocated between blocks of other sizes and visited in shuffled order, like a heap that has been
+    // running for a while
+    std::vector<std::unique_ptr<Model>> models;
+    std::vector<std::unique_ptr<char[]>> clutter;
+    for (uint32_t i = 0; i < EntityCount; i++)
+    {
+        models.emplace_back(new Model{});
+        models.back()->mesh = mesh;
+        models.back()->meshId = 1;
+        models.back()->viewDepth = static_cast<float>(i % 100);
+        models.back()->bounds.radius = 1.f;
+        clutter.emplace_back(new char[64 + random() % 512]);
+    }
+    std::shuffle(models.begin(), models.end(), random);
+
+    EntityPool pool;
+    ModelComponents store;
+    Clock::time_point start = Clock::now();
+    for (uint32_t i = 0; i < EntityCount; i++)
+    {
+        Transform transform{};
+        transform.viewDepth = static_cast<float>(i % 100);
+        Bounds bounds{};
+        bounds.radius = 1.f;
+        store.add(pool.create(), transform, MeshReference{ mesh, 1 }, Material{ 1 }, bounds);
+    }
+    const double addMs = getMs(start);
+
+    // the culling and draw packet loops read the view depth, the bounds and the mesh id
+    volatile float sink = 0.f;
+    double heapMs = 1e9;
+    double denseMs = 1e9;
+    double boundsMs = 1e9;
+    for (int repeat = 0; repeat < IterationRepeats; repeat++)
+    {
+        start = Clock::now();
+        float sum = 0.f;
+        for (const std::unique_ptr<Model>& model : models)
+        {
+            sum += model->bounds.radius / (model->viewDepth + 1.f) + static_cast<float>(model->meshId & 1);
+        }
+        sink = sink + sum;
+        heapMs = std::min(heapMs, getMs(start));
+
+        start = Clock::now();
+        sum = 0.f;
+        const Transform* transforms = store.get<Transform>();
+        const MeshReference* meshes = store.get<MeshReference>();
+        const Bounds* bounds = store.get<Bounds>();
+        for (uint32_t i = 0; i < store.getCount(); i++)
+        {
+            sum += bounds[i].radius / (transforms[i].viewDepth + 1.f) + static_cast<float>(meshes[i].meshId & 1);
+        }
+        sink = sink + sum;
+        denseMs = std::min(denseMs, getMs(start));
+
+        start = Clock::now();
+        sum = 0.f;
+        for (uint32_t i = 0; i < store.getCount(); i++)
+        {
+            sum += bounds[i].radius;
+        }
+        sink = sink + sum;
+        boundsMs = std::min(boundsMs, getMs(start));
+    }
+
+    std::printf("%u entities, best of %d\n", EntityCount, IterationRepeats);
+    std::printf("%-28s %8.3f ms\n", "iterate heap objects", heapMs);
+    std::printf("%-28s %8.3f ms, %.1fx\n", "iterate dense components", denseMs, heapMs / denseMs);
+    std::printf("%-28s %8.3f ms\n", "iterate bounds only", boundsMs);
+
+    // churn: remove half at random, refill the freed slots, then look up the survivors
+    std::vector<Entity> entities;
+    for (uint32_t i = 0; i < store.getCount(); i++)
+    {
+        entities.push_back(store.getEntity(i));
+    }
+    std::shuffle(entities.begin(), entities.end(), random);
+    const uint32_t half = EntityCount / 2;
+
+    start = Clock::now();
+    for (uint32_t i = 0; i < half; i++)
+    {
+        store.remove(entities[i]);
+        pool.destroy(entities[i]);
+    }
+    const double removeMs = getMs(start);
+
+    start = Clock::now();
+    for (uint32_t i = 0; i < half; i++)
+    {
+        store.add(pool.create(), Transform{}, MeshReference{ mesh, 1 }, Material{ 1 }, Bounds{});
+    }
+    const double readdMs = getMs(start);
+
+    start = Clock::now();
+    uint32_t found = 0;
+    for (uint32_t i = half; i < EntityCount; i++)
+    {
+        found += store.contains(entities[i]);
+    }
+    const double lookupMs = getMs(start);
+
+    start = Clock::now();
+    for (uint32_t i = 0; i < half; i++)
+    {
+        models.pop_back();
+    }
+    const double heapRemoveMs = getMs(start);
+
+    start = Clock::now();
+    for (uint32_t i = 0; i < half; i++)
+    {
+        models.emplace_back(new Model{});
+        models.back()->mesh = mesh;
+    }
+    const double heapAddMs = getMs(start);
+
+    std::printf("%-28s %8.3f ms\n", "add", addMs);
+    std::printf("%-28s %8.3f ms, heap objects %.3f ms\n", "remove half at random", removeMs, heapRemoveMs);
+    std::printf("%-28s %8.3f ms, heap objects %.3f ms\n", "re-add into freed slots", readdMs, heapAddMs);
+    std::printf("%-28s %8.3f ms, %u found\n", "look up survivors", lookupMs, found);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "ComponentStore.h"
+#include "TestHarness.h"
+
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace HDX;
+
+static void testEntityGenerations()
+{
+    EntityPool pool;
+    const Entity a = pool.create();
+    const Entity b = pool.create();
+    HDX_CHECK(a != b);
+    HDX_CHECK(pool.isAlive(a) && pool.isAlive(b));
+    HDX_CHECK(pool.getCount() == 2);
+
+    pool.destroy(a);
+    HDX_CHECK(!pool.isAlive(a));
+    HDX_CHECK(pool.getCount() == 1);
+
+    // the slot is reused with a new generation, the stale handle stays dead
+    const Entity c = pool.create();
+    HDX_CHECK(EntityPool::getSlot(c) == EntityPool::getSlot(a));
+    HDX_CHECK(c != a);
+    HDX_CHECK(pool.isAlive(c));
+    HDX_CHECK(!pool.isAlive(a));
+    HDX_CHECK(!pool.isAlive(InvalidEntity));
+}
+
+static void testRemoveFromMiddle()
+{
+    EntityPool pool;
+    ComponentStore<int, float> store;
+    std::vector<Entity> entities;
+    for (int i = 0; i < 8; i++)
+    {
+        entities.push_back(pool.create());
+        HDX_CHECK(store.add(entities.back(), i, i * 0.5f) == static_cast<uint32_t>(i));
+    }
+
+    // the last entity moves into the hole
+    store.remove(entities[3]);
+    HDX_CHECK(store.getCount() == 7);
+    HDX_CHECK(!store.contains(entities[3]));
+    HDX_CHECK(store.getIndex(entities[3]) == store.InvalidIndex);
+    HDX_CHECK(store.getIndex(entities[7]) == 3);
+    HDX_CHECK(store.getEntity(3) == entities[7]);
+
+    store.remove(entities[0]);
+    store.remove(entities[5]);
+    HDX_CHECK(store.getCount() == 5);
+
+    // every remaining handle still resolves to its own components
+    for (int i = 0; i < 8; i++)
+    {
+        if (i == 0 || i == 3 || i == 5)
+        {
+            HDX_CHECK(!store.contains(entities[i]));
+            continue;
+        }
+        const uint32_t index = store.getIndex(entities[i]);
+        HDX_CHECK(index < store.getCount());
+        HDX_CHECK(store.getEntity(index) == entities[i]);
+        HDX_CHECK(store.get<int>()[index] == i);
+        HDX_CHECK(store.get<float>()[index] == i * 0.5f);
+    }
+
+    // removing the last dense entity moves nothing
+    const Entity last = store.getEntity(store.getCount() - 1);
+    store.remove(last);
+    HDX_CHECK(!store.contains(last));
+    HDX_CHECK(store.getCount() == 4);
+}
+
+static void testStaleHandleAfterSlotReuse()
+{
+    EntityPool pool;
+    ComponentStore<int> store;
+    const Entity a = pool.create();
+    store.add(a, 1);
+    store.remove(a);
+    pool.destroy(a);
+
+    // same slot, new generation: the old handle must not resolve to the new entity
+    const Entity b = pool.create();
+    HDX_CHECK(EntityPool::getSlot(b) == EntityPool::getSlot(a));
+    store.add(b, 2);
+    HDX_CHECK(store.contains(b));
+    HDX_CHECK(!store.contains(a));
+    HDX_CHECK(store.getIndex(a) == store.InvalidIndex);
+    HDX_CHECK(store.get<int>()[store.getIndex(b)] == 2);
+}
+
+static void testMoveOnlyComponents()
+{
+    EntityPool pool;
+    ComponentStore<std::unique_ptr<int>> store;
+    const Entity a = pool.create();
+    const Entity b = pool.create();
+    const Entity c = pool.create();
+    store.add(a, std::unique_ptr<int>(new int(1)));
+    store.add(b, std::unique_ptr<int>(new int(2)));
+    store.add(c, std::unique_ptr<int>(new int(3)));
+
+    store.remove(a);
+    HDX_CHECK(store.getCount() == 2);
+    HDX_CHECK(*store.get<std::unique_ptr<int>>()[store.getIndex(b)] == 2);
+    HDX_CHECK(*store.get<std::unique_ptr<int>>()[store.getIndex(c)] == 3);
+}
+
+// random add/remove churn checked against a map every 97 steps
+static void testRandomChurn()
+{
+    std::mt19937 random(7);
+    EntityPool pool;
+    ComponentStore<int, float> store;
+    std::map<Entity, int> reference;
+    std::vector<Entity> destroyed;
+    int mismatches = 0;
+
+    for (int step = 0; step < 20000; step++)
+    {
+        if (reference.empty() || random() % 3 != 0)
+        {
+            const Entity entity = pool.create();
+            const int value = static_cast<int>(random() & 0xffff);
+            store.add(entity, value, static_cast<float>(value & 1023));
+            reference[entity] = value;
+        }
+        else
+        {
+            std::map<Entity, int>::iterator victim = reference.begin();
+            std::advance(victim, random() % reference.size());
+            store.remove(victim->first);
+            pool.destroy(victim->first);
+            destroyed.push_back(victim->first);
+            reference.erase(victim);
+        }
+
+        if (step % 97 != 0)
+        {
+            continue;
+        }
+        mismatches += store.getCount() != reference.size();
+        mismatches += pool.getCount() != reference.size();
+        for (const auto& entry : reference)
+        {
+            const uint32_t index = store.getIndex(entry.first);
+            if (index == store.InvalidIndex || store.getEntity(index) != entry.first ||
+                store.get<int>()[index] != entry.second || store.get<float>()[index] != static_cast<float>(entry.second & 1023))
+            {
+                mismatches++;
+            }
+        }
+        for (Entity entity : destroyed)
+        {
+            mismatches += store.contains(entity);
+        }
+    }
+    HDX_CHECK(mismatches == 0);
+    HDX_CHECK(!reference.empty());
+}
+
+int main()
+{
+    testEntityGenerations();
+    testRemoveFromMiddle();
+    testStaleHandleAfterSlotReuse();
+    testMoveOnlyComponents();
+    testRandomChurn();
+    return HDX_TEST_RESULT();
+}
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "DeferredDeletionQueue.h"
+#include "TestHarness.h"
+
+#include <random>
+#include <vector>
+
+using namespace HDX;
+
+namespace
+{
+
+// a GPU fence stand-in, the test advances the completed value by hand
+struct CounterFence
+{
+    const uint64_t* completedValue;
+    uint32_t* readCount;
+
+    uint64_t getCompletedValue() const
+    {
+        (*readCount)++;
+        return *completedValue;
+    }
+};
+
+// records its id when it is destroyed, moved-from payloads record nothing
+class Payload
+{
+public:
+    Payload(int id, std::vector<int>* released)
+        : mId(id)
+        , mReleased(released)
+    {
+    }
+
+    Payload(Payload&& other)
+        : mId(other.mId)
+        , mReleased(other.mReleased)
+    {
+        other.mReleased = nullptr;
+    }
+
+    Payload& operator=(Payload&& other)
+    {
+        release();
+        mId = other.mId;
+        mReleased = other.mReleased;
+        other.mReleased = nullptr;
+        return *this;
+    }
+
+    Payload(const Payload&) = delete;
+    Payload& operator=(const Payload&) = delete;
+
+    ~Payload() { release(); }
+
+private:
+    void release()
+    {
+        if (mReleased)
+        {
+            mReleased->push_back(mId);
+            mReleased = nullptr;
+        }
+    }
+
+    int mId;
+    std::vector<int>* mReleased;
+};
+
+typedef DeferredDeletionQueue<CounterFence, Payload> TestQueue;
+
+}
+
+static void testNothingReleasedBeforeItsFence()
+{
+    uint64_t completed = 0;
+    uint32_t reads = 0;
+    std::vector<int> released;
+    TestQueue queue(CounterFence{ &completed, &reads });
+
+    // an empty queue does not read the fence
+    HDX_CHECK(queue.collect() == 0);
+    HDX_CHECK(reads == 0);
+
+    queue.enqueue(Payload(1, &released), 5);
+    queue.enqueue(Payload(2, &released), 5);
+    queue.enqueue(Payload(3, &released), 8);
+    HDX_CHECK(released.empty());
+    HDX_CHECK(queue.getPendingCount() == 3);
+    HDX_CHECK(queue.getOldestFenceValue() == 5);
+
+    completed = 4;
+    HDX_CHECK(queue.collect() == 0);
+    HDX_CHECK(released.empty());
+    HDX_CHECK(reads == 1);
+
+    completed = 5;
+    HDX_CHECK(queue.collect() == 2);
+    HDX_CHECK(released.size() == 2);
+    HDX_CHECK(queue.getPendingCount() == 1);
+    HDX_CHECK(queue.getOldestFenceValue() == 8);
+
+    completed = 7;
+    HDX_CHECK(queue.collect() == 0);
+    HDX_CHECK(released.size() == 2);
+
+    // a fence that jumps past several values releases them all at once
+    completed = 100;
+    HDX_CHECK(queue.collect() == 1);
+    HDX_CHECK(released.size() == 3 && released[2] == 3);
+    HDX_CHECK(queue.getPendingCount() == 0);
+    HDX_CHECK(queue.getReleasedCount() == 3);
+    HDX_CHECK(queue.getOldestFenceValue() == 0);
+    HDX_CHECK(reads == 4);
+}
+
+static void testReleasedInFenceOrder()
+{
+    uint64_t completed = 0;
+    uint32_t reads = 0;
+    std::vector<int> released;
+    TestQueue queue(CounterFence{ &completed, &reads });
+
+    // older fence values are sorted into place, including one between two batches and one before all of them
+    queue.enqueue(Payload(10, &released), 10);
+    queue.enqueue(Payload(30, &released), 30);
+    queue.enqueue(Payload(20, &released), 20);
+    queue.enqueue(Payload(5, &released), 5);
+    queue.enqueue(Payload(21, &released), 20);
+    queue.enqueue(Payload(31, &released), 30);
+    HDX_CHECK(queue.getOldestFenceValue() == 5);
+    HDX_CHECK(queue.getPendingCount() == 6);
+
+    completed = 20;
+    HDX_CHECK(queue.collect() == 4);
+    const std::vector<int> expected = { 5, 10, 20, 21 };
+    HDX_CHECK(released == expected);
+
+    completed = 30;
+    HDX_CHECK(queue.collect() == 2);
+    HDX_CHECK(released.size() == 6 && released[4] == 30 && released[5] == 31);
+}
+
+static void testFlush()
+{
+    uint64_t completed = 0;
+    uint32_t reads = 0;
+    std::vector<int> released;
+    {
+        TestQueue queue(CounterFence{ &completed, &reads });
+        queue.enqueue(Payload(1, &released), 1);
+        queue.enqueue(Payload(2, &released), UINT64_MAX);
+        HDX_CHECK(queue.flush() == 2);
+        HDX_CHECK(released.size() == 2);
+        HDX_CHECK(queue.getPendingCount() == 0);
+        HDX_CHECK(reads == 0);
+
+        // whatever is left when the queue goes away is released with it
+        queue.enqueue(Payload(3, &released), 50);
+    }
+    HDX_CHECK(released.size() == 3);
+}
+
+// random fence values around a fence that advances like frames in flight: no payload may be released before its
+// fence value completes, and every payload must be released once it does
+static void testRandomTraffic()
+{
+    std::mt19937 random(11);
+    uint64_t completed = 0;
+    uint32_t reads = 0;
+    std::vector<int> released;
+    std::vector<uint64_t> fenceValues;
+    TestQueue queue(CounterFence{ &completed, &reads });
+
+    int early = 0;
+    int late = 0;
+    int unordered = 0;
+    uint64_t submitted = 0;
+    for (int frame = 0; frame < 2000; frame++)
+    {
+        submitted++;
+        const uint32_t count = random() % 4;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            // mostly the current frame, sometimes a frame still in flight
+            const uint64_t fenceValue = submitted - random() % 3;
+            fenceValues.push_back(fenceValue);
+            queue.enqueue(Payload(static_cast<int>(fenceValues.size() - 1), &released), fenceValue);
+        }
+
+        completed = submitted > 2 ? submitted - 2 : 0;
+        const size_t before = released.size();
+        queue.collect();
+        for (size_t i = before; i < released.size(); i++)
+        {
+            early += fenceValues[released[i]] > completed;
+            unordered += i > 0 && fenceValues[released[i]] < fenceValues[released[i - 1]];
+        }
+        // the oldest batch left is still running
+        late += queue.getPendingCount() > 0 && queue.getOldestFenceValue() <= completed;
+    }
+    HDX_CHECK(early == 0);
+    HDX_CHECK(late == 0);
+    HDX_CHECK(unordered == 0);
+    HDX_CHECK(queue.getPendingCount() + released.size() == fenceValues.size());
+    HDX_CHECK(queue.getReleasedCount() == released.size());
+
+    queue.flush();
+    HDX_CHECK(released.size() == fenceValues.size());
+}
+
+int main()
+{
+    testNothingReleasedBeforeItsFence();
+    testReleasedInFenceOrder();
+    testFlush();
+    testRandomTraffic();
+    return HDX_TEST_RESULT();
+}
\ No newline at end of file
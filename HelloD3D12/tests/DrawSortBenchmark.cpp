@@ -0,0 +1,84 @@
+#include "DrawSort.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace HDX;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static const uint32_t PacketCount{ 100000 };
+static const uint32_t FrameCount{ 100 };
+
+// A frame of draws in submission order: both passes, a few pipelines, materials and meshes, random depths.
+static void makeFrame(std::mt19937& random, std::vector<DrawPacket>& packets)
+{
+    for (uint32_t i = 0; i < PacketCount; i++)
+    {
+        const RenderPass pass = random() % 4 == 0 ? RenderPass::Shadow : RenderPass::Main;
+        const uint32_t material = random() % 512;
+        packets[i].key = DrawSortKey::make(pass, pass == RenderPass::Shadow ? 0 : 1, random() % 8, material, material * 2 + random() % 2, random() % 65536);
+        packets[i].drawIndex = i;
+        packets[i].padding = 0;
+    }
+}
+
+static bool lessKey(const DrawPacket& a, const DrawPacket& b)
+{
+    return a.key < b.key;
+}
+
+int main()
+{
+    std::mt19937 random(1);
+    std::vector<std::vector<DrawPacket>> frames(FrameCount, std::vector<DrawPacket>(PacketCount));
+    for (std::vector<DrawPacket>& frame : frames)
+    {
+        makeFrame(random, frame);
+    }
+
+    std::vector<DrawPacket> packets(PacketCount);
+    std::vector<DrawPacket> scratch(PacketCount);
+    std::vector<DrawPacket> reference(PacketCount);
+    double radixMs = 0.;
+    double sortMs = 0.;
+    double stableSortMs = 0.;
+    uint32_t mismatches = 0;
+    StateChangeStats unsorted;
+    StateChangeStats sorted;
+    for (const std::vector<DrawPacket>& frame : frames)
+    {
+        packets = frame;
+        Clock::time_point start = Clock::now();
+        radixSortDrawPackets(packets.data(), scratch.data(), packets.size());
+        radixMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        reference = frame;
+        start = Clock::now();
+        std::sort(reference.begin(), reference.end(), lessKey);
+        sortMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        reference = frame;
+        start = Clock::now();
+        std::stable_sort(reference.begin(), reference.end(), lessKey);
+        stableSortMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        // the radix sort is stable, so it must match stable_sort exactly
+        for (uint32_t i = 0; i < PacketCount; i++)
+        {
+            mismatches += packets[i].key != reference[i].key || packets[i].drawIndex != reference[i].drawIndex ? 1 : 0;
+        }
+        unsorted = countStateChanges(frame.data(), frame.size());
+        sorted = countStateChanges(packets.data(), packets.size());
+    }
+
+    std::printf("%u packets, mean of %u frames\n", PacketCount, FrameCount);
+    std::printf("radix sort %.3f ms, std::sort %.3f ms, std::stable_sort %.3f ms, %u mismatches\n",
+        radixMs / FrameCount, sortMs / FrameCount, stableSortMs / FrameCount, mismatches);
+    std::printf("state changes %u unsorted, %u sorted, %u redundant binds sorted\n",
+        unsorted.getStateChanges(), sorted.getStateChanges(), sorted.redundantBinds);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,345 @@
+#include "FramePacer.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace HDX;
+
+namespace
+{
+
+const double RefreshMs{ 1000. / 60. };
+
+struct SimulationConfig
+{
+    PacingMode mode{ PacingMode::Waitable };
+    uint32_t framesInFlight{ 2 };
+    double cpuMs{ 3. };
+    double gpuMs{ 5. };
+    // relative jitter applied to the CPU and GPU times
+    double jitter{ 0. };
+    // every spikeInterval frames the GPU work takes spikeMs instead, 0 disables spikes
+    uint32_t spikeInterval{ 0 };
+    double spikeMs{ 0. };
+    uint32_t frameCount{ 2000 };
+    // stats are reset after the warm up frames
+    uint32_t warmUpFrames{ 200 };
+};
+
+struct SimulationResult
+{
+    double latencyMeanMs{ 0. };
+    double latencyP99Ms{ 0. };
+    uint32_t missedDeadlines{ 0 };
+    // frames started on a deadline that reached the display at the slot the deadline was computed for
+    uint32_t deadlineFrames{ 0 };
+    uint32_t deadlineHits{ 0 };
+    double maxMarginMs{ 0. };
+    double refreshMs{ 0. };
+    double marginMs{ 0. };
+    double predictedCpuMs{ 0. };
+    double predictedGpuMs{ 0. };
+    double framesPerSecond{ 0. };
+};
+
+// Drives the pacer against a simulated 60 Hz display. The present queue blocks a frame until the frame
+// framesInFlight ahead of it reached the display, the GPU runs frames in order and a frame is shown on the first
+// free vblank after its GPU work completes. Input arrives every 1 to 5 ms.
+SimulationResult simulate(const SimulationConfig& config)
+{
+    FramePacerConfig pacerConfig;
+    pacerConfig.framesInFlight = config.framesInFlight;
+    pacerConfig.mode = config.mode;
+    FramePacer pacer(pacerConfig);
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<double> jitter(1. - config.jitter, 1. + config.jitter);
+    std::uniform_real_distribution<double> inputSpacing(1., 5.);
+
+    std::vector<double> gpuDone;
+    std::vector<double> displayed;
+    std::vector<double> predicted;
+    size_t gpuReported = 0;
+    size_t displayReported = 0;
+    double now = 0.;
+    double gpuFree = 0.;
+    double lastVblank = -1.;
+    double nextInput = 0.;
+    double statsStart = 0.;
+
+    SimulationResult result;
+    for (uint32_t i = 0; i < config.frameCount; i++)
+    {
+        if (i >= config.framesInFlight)
+        {
+            now = std::max(now, displayed[i - config.framesInFlight]);
+        }
+
+        while (gpuReported < gpuDone.size() && gpuDone[gpuReported] <= now)
+        {
+            pacer.onFrameGpuCompleted(gpuReported + 1, gpuDone[gpuReported]);
+            gpuReported++;
+        }
+        while (displayReported < displayed.size() && displayed[displayReported] <= now)
+        {
+            pacer.onFrameDisplayed(displayReported + 1, displayed[displayReported]);
+            displayReported++;
+        }
+
+        double deadline = pacer.getStartDeadline();
+        double slot = -1.;
+        if (deadline > 0.)
+        {
+            slot = deadline + pacer.getPredictedFrameMs() + pacer.getMarginMs();
+            if (deadline > now)
+            {
+                now = std::min(deadline, now + RefreshMs);
+            }
+        }
+        predicted.push_back(slot);
+
+        while (nextInput <= now)
+        {
+            pacer.onInput(nextInput);
+            nextInput += inputSpacing(random);
+        }
+
+        uint64_t frameId = pacer.beginFrame(now);
+        HDX_CHECK(frameId == i + 1);
+        now += config.cpuMs * jitter(random);
+        pacer.endFrame(frameId, now);
+
+        bool spike = config.spikeInterval != 0 && i % config.spikeInterval == config.spikeInterval - 1;
+        gpuFree = std::max(now, gpuFree) + (spike ? config.spikeMs : config.gpuMs * jitter(random));
+        gpuDone.push_back(gpuFree);
+
+        double vblank = std::max(std::ceil(gpuFree / RefreshMs), lastVblank + 1.);
+        lastVblank = vblank;
+        displayed.push_back(vblank * RefreshMs);
+
+        result.maxMarginMs = std::max(result.maxMarginMs, pacer.getMarginMs());
+        if (i == config.warmUpFrames)
+        {
+            pacer.resetStats();
+            statsStart = now;
+        }
+    }
+
+    for (uint32_t i = config.warmUpFrames; i < config.frameCount; i++)
+    {
+        if (predicted[i] < 0.)
+        {
+            continue;
+        }
+
+        result.deadlineFrames++;
+        result.deadlineHits += std::fabs(displayed[i] - predicted[i]) < 0.5 ? 1 : 0;
+    }
+
+    const FrameTimeHistogram& latency = pacer.getLatency();
+    result.latencyMeanMs = latency.getMean();
+    result.latencyP99Ms = latency.getPercentile(99.);
+    result.missedDeadlines = pacer.getMissedDeadlines();
+    result.refreshMs = pacer.getRefreshIntervalMs();
+    result.marginMs = pacer.getMarginMs();
+    result.predictedCpuMs = pacer.getPredictedCpuMs();
+    result.predictedGpuMs = pacer.getPredictedGpuMs();
+    result.framesPerSecond = (config.frameCount - config.warmUpFrames) * 1000. / (now - statsStart);
+    return result;
+}
+
+}
+
+static void testConfigIsClamped()
+{
+    FramePacerConfig config;
+    config.framesInFlight = 0;
+    HDX_CHECK(FramePacer(config).getFramesInFlight() == 1);
+    config.framesInFlight = 9;
+    HDX_CHECK(FramePacer(config).getFramesInFlight() == FramePacer::MaxFramesInFlight);
+}
+
+static void testNoDeadlineWithoutDisplayHistory()
+{
+    FramePacerConfig config;
+    config.mode = PacingMode::Waitable;
+    FramePacer waitable(config);
+    config.mode = PacingMode::Fence;
+    FramePacer fence(config);
+
+    // nothing displayed yet, there is no refresh interval to predict from
+    HDX_CHECK(waitable.getStartDeadline() == 0.);
+
+    for (uint64_t i = 1; i <= 4; i++)
+    {
+        double begin = (i - 1) * RefreshMs;
+        HDX_CHECK(waitable.beginFrame(begin) == i);
+        HDX_CHECK(fence.beginFrame(begin) == i);
+        waitable.endFrame(i, begin + 2.);
+        fence.endFrame(i, begin + 2.);
+        waitable.onFrameGpuCompleted(i, begin + 6.);
+        fence.onFrameGpuCompleted(i, begin + 6.);
+        waitable.onFrameDisplayed(i, i * RefreshMs);
+        fence.onFrameDisplayed(i, i * RefreshMs);
+    }
+
+    HDX_CHECK(fence.getStartDeadline() == 0.);
+    HDX_CHECK_NEAR(waitable.getRefreshIntervalMs(), RefreshMs, 1e-9);
+    HDX_CHECK_NEAR(waitable.getPredictedCpuMs(), 2., 1e-9);
+    HDX_CHECK_NEAR(waitable.getPredictedGpuMs(), 4., 1e-9);
+    // frame 5 is shown one refresh after frame 4 and must start its CPU and GPU work plus margin before that
+    HDX_CHECK_NEAR(waitable.getStartDeadline(), 5. * RefreshMs - 4. - 2. - 1., 1e-9);
+
+    // a frame displayed late is a miss and widens the margin
+    waitable.beginFrame(waitable.getStartDeadline());
+    waitable.onFrameDisplayed(5, 6. * RefreshMs);
+    HDX_CHECK(waitable.getMissedDeadlines() == 1);
+    HDX_CHECK_NEAR(waitable.getMarginMs(), 1.5, 1e-9);
+    // the refresh interval is not stretched by the skipped vblank
+    HDX_CHECK_NEAR(waitable.getRefreshIntervalMs(), RefreshMs, 0.2);
+}
+
+static void testSteadyLoad()
+{
+    SimulationConfig config;
+    SimulationResult result = simulate(config);
+
+    HDX_CHECK_NEAR(result.refreshMs, RefreshMs, 0.01);
+    HDX_CHECK_NEAR(result.predictedCpuMs, config.cpuMs, 0.01);
+    HDX_CHECK_NEAR(result.predictedGpuMs, config.gpuMs, 0.01);
+    HDX_CHECK(result.missedDeadlines == 0);
+    HDX_CHECK_NEAR(result.marginMs, 1., 1e-9);
+    // every frame started on its deadline reaches the display at the predicted slot
+    HDX_CHECK(result.deadlineFrames == config.frameCount - config.warmUpFrames);
+    HDX_CHECK(result.deadlineHits == result.deadlineFrames);
+    HDX_CHECK_NEAR(result.framesPerSecond, 60., 0.1);
+    // input waits at most one frame to be sampled, then CPU, GPU and margin before the vblank
+    HDX_CHECK(result.latencyMeanMs < RefreshMs + config.cpuMs + config.gpuMs + 1.);
+    HDX_CHECK(result.latencyP99Ms <= RefreshMs + config.cpuMs + config.gpuMs + 2.);
+}
+
+static void testJitteredLoad()
+{
+    SimulationConfig config;
+    config.jitter = 0.2;
+    SimulationResult result = simulate(config);
+
+    HDX_CHECK_NEAR(result.refreshMs, RefreshMs, 0.01);
+    HDX_CHECK_NEAR(result.framesPerSecond, 60., 0.1);
+    // the deviation budget absorbs the jitter, every frame makes its slot at the cost of starting a little earlier
+    HDX_CHECK(result.missedDeadlines == 0);
+    HDX_CHECK(result.deadlineHits == result.deadlineFrames);
+    HDX_CHECK(result.latencyP99Ms <= RefreshMs + (config.cpuMs + config.gpuMs) * (1. + config.jitter) + 3.);
+}
+
+static void testFramesInFlight()
+{
+    double previousFenceLatency = 0.;
+    double firstWaitableLatency = 0.;
+    for (uint32_t framesInFlight = 1; framesInFlight <= FramePacer::MaxFramesInFlight; framesInFlight++)
+    {
+        SimulationConfig config;
+        config.framesInFlight = framesInFlight;
+        config.mode = PacingMode::Fence;
+        SimulationResult fence = simulate(config);
+        config.mode = PacingMode::Waitable;
+        SimulationResult waitable = simulate(config);
+
+        HDX_CHECK_NEAR(fence.framesPerSecond, 60., 0.1);
+        HDX_CHECK_NEAR(waitable.framesPerSecond, 60., 0.1);
+        HDX_CHECK(waitable.missedDeadlines == 0);
+
+        // without pacing every extra frame in flight queues up one more refresh of latency
+        if (framesInFlight > 1)
+        {
+            HDX_CHECK(fence.latencyMeanMs > previousFenceLatency + RefreshMs * 0.9);
+            HDX_CHECK(waitable.latencyMeanMs < fence.latencyMeanMs - RefreshMs * 0.9);
+            HDX_CHECK_NEAR(waitable.latencyMeanMs, firstWaitableLatency, 1.);
+        }
+        else
+        {
+            firstWaitableLatency = waitable.latencyMeanMs;
+        }
+        previousFenceLatency = fence.latencyMeanMs;
+    }
+}
+
+static void testSpikes()
+{
+    SimulationConfig config;
+    config.jitter = 0.1;
+    config.spikeInterval = 50;
+    config.spikeMs = 20.;
+    config.mode = PacingMode::Fence;
+    SimulationResult fence = simulate(config);
+    config.mode = PacingMode::Waitable;
+    SimulationResult spiky = simulate(config);
+
+    uint32_t spikes = (config.frameCount - config.warmUpFrames) / config.spikeInterval;
+    HDX_CHECK(spiky.missedDeadlines >= spikes / 2);
+    HDX_CHECK(spiky.missedDeadlines <= spikes * 3);
+    HDX_CHECK(spiky.maxMarginMs > 1.);
+    HDX_CHECK(spiky.maxMarginMs <= RefreshMs);
+    HDX_CHECK(spiky.deadlineHits * 10 >= spiky.deadlineFrames * 9);
+    HDX_CHECK(spiky.framesPerSecond >= fence.framesPerSecond * 0.98);
+    HDX_CHECK(spiky.latencyMeanMs < fence.latencyMeanMs);
+
+    // the spikes are not folded into the steady prediction
+    HDX_CHECK(spiky.predictedGpuMs < config.gpuMs * 2.);
+    HDX_CHECK_NEAR(spiky.refreshMs, RefreshMs, 0.01);
+
+    // between the spikes the margin decays back to the configured one
+    HDX_CHECK_NEAR(spiky.marginMs, 1., 1e-9);
+}
+
+static void testThroughputBound()
+{
+    // CPU and GPU each take most of a refresh, pacing must not drop the frame rate below the unpaced one
+    SimulationConfig config;
+    config.cpuMs = 12.;
+    config.gpuMs = 14.;
+    config.jitter = 0.1;
+    config.mode = PacingMode::Fence;
+    SimulationResult fence = simulate(config);
+    config.mode = PacingMode::Waitable;
+    SimulationResult waitable = simulate(config);
+
+    HDX_CHECK(waitable.framesPerSecond >= fence.framesPerSecond * 0.98);
+    HDX_CHECK(waitable.latencyMeanMs <= fence.latencyMeanMs);
+    HDX_CHECK(waitable.maxMarginMs <= RefreshMs);
+}
+
+static void testHistogramClampsSamples()
+{
+    FrameTimeHistogram histogram(1.);
+    histogram.add(std::numeric_limits<double>::quiet_NaN());
+    histogram.add(-5.);
+    histogram.add(1e300);
+    histogram.add(std::numeric_limits<double>::infinity());
+    histogram.add(2.5);
+
+    HDX_CHECK(histogram.getCount() == 5);
+    // NaN and negative samples count as 0, huge ones land in the overflow bucket
+    HDX_CHECK(histogram.getPercentile(0.) == 1.);
+    HDX_CHECK(histogram.getPercentile(50.) == 3.);
+    HDX_CHECK(histogram.getPercentile(100.) == histogram.getMax());
+    HDX_CHECK(!std::isnan(histogram.getMean()));
+    HDX_CHECK(!histogram.toString().empty());
+}
+
+int main()
+{
+    testConfigIsClamped();
+    testNoDeadlineWithoutDisplayHistory();
+    testSteadyLoad();
+    testJitteredLoad();
+    testFramesInFlight();
+    testSpikes();
+    testThroughputBound();
+    testHistogramClampsSamples();
+    return HDX_TEST_RESULT();
+}
\ No newline at end of file
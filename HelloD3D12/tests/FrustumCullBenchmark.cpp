@@ -0,0 +1,102 @@
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace HDX;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static const uint32_t ObjectCount{ 1000000 };
+static const uint32_t FrameCount{ 100 };
+
+static void multiply(const float* a, const float* b, float* result)
+{
+    for (int row = 0; row < 4; row++)
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            float sum = 0.f;
+            for (int k = 0; k < 4; k++)
+            {
+                sum += a[row * 4 + k] * b[k * 4 + column];
+            }
+            result[row * 4 + column] = sum;
+        }
+    }
+}
+
+// camera at the origin turning around y, 90 degree field of view, near 0.1, far 150
+static Frustum makeFrustum(uint32_t frame)
+{
+    const float yaw = 6.2831853f * static_cast<float>(frame) / static_cast<float>(FrameCount);
+    const float c = std::cos(yaw);
+    const float s = std::sin(yaw);
+    const float view[16] = {
+        c, 0.f, s, 0.f,
+        0.f, 1.f, 0.f, 0.f,
+        -s, 0.f, c, 0.f,
+        0.f, 0.f, 0.f, 1.f
+    };
+    const float n = 0.1f;
+    const float f = 150.f;
+    const float projection[16] = {
+        1.f, 0.f, 0.f, 0.f,
+        0.f, 1.f, 0.f, 0.f,
+        0.f, 0.f, f / (f - n), 1.f,
+        0.f, 0.f, -n * f / (f - n), 0.f
+    };
+    float viewProjection[16];
+    multiply(view, projection, viewProjection);
+    return Frustum::fromViewProjection(viewProjection);
+}
+
+int main()
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(-200.f, 200.f);
+    std::uniform_real_distribution<float> size(0.1f, 3.f);
+
+    FrustumCuller culler;
+    culler.resize(ObjectCount);
+    for (uint32_t i = 0; i < ObjectCount; i++)
+    {
+        const Float3 center{ position(random), position(random), position(random) };
+        const float extent = size(random);
+        culler.setBounds(i, makeBounds({ center.x - extent, center.y - extent, center.z - extent }, { center.x + extent, center.y + extent, center.z + extent }));
+    }
+
+    std::vector<uint8_t> visible(ObjectCount);
+    std::vector<uint8_t> reference(ObjectCount);
+    double simdMs = 0.;
+    double scalarMs = 0.;
+    uint64_t visibleCount = 0;
+    uint32_t mismatches = 0;
+    for (uint32_t frame = 0; frame < FrameCount; frame++)
+    {
+        const Frustum frustum = makeFrustum(frame);
+
+        Clock::time_point start = Clock::now();
+        visibleCount += culler.cull(frustum, 0, ObjectCount, visible.data());
+        simdMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        start = Clock::now();
+        culler.cullScalar(frustum.planes, Frustum::SideCount, 0, ObjectCount, reference.data());
+        scalarMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        for (uint32_t i = 0; i < ObjectCount; i++)
+        {
+            mismatches += visible[i] != reference[i] ? 1 : 0;
+        }
+    }
+
+    printf("%u objects, %u frames, %u objects per SIMD iteration\n", ObjectCount, FrameCount, static_cast<uint32_t>(FrustumCuller::SimdWidth));
+    printf("SIMD     %8.3f ms/frame\n", simdMs / FrameCount);
+    printf("scalar   %8.3f ms/frame\n", scalarMs / FrameCount);
+    printf("visible  %8.0f objects/frame, %u mismatches against the scalar path\n", static_cast<double>(visibleCount) / FrameCount, mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
\ No newline at end of file
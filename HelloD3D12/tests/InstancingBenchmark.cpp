@@ -0,0 +1,96 @@
+#include "DrawSort.h"
+#include "IndirectDraw.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace HDX;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static const uint32_t FrameCount{ 200 };
+
+struct alignas(16) AlignedCommand
+{
+    IndirectDrawCommand command;
+};
+
+// The CPU side of the main pass submission, as in D3D12Renderer::buildDrawBatches: draw packets keyed by material
+// and mesh are sorted, runs sharing every state above the depth merge into one instanced draw, and the indirect
+// commands are packed. Without instancing every model is its own draw.
+int main(int argc, char** argv)
+{
+    const uint32_t instanceCount = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 10000;
+    const uint32_t meshCount = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 2;
+
+    std::vector<IndirectDrawCommand> templates(meshCount);
+    for (uint32_t mesh = 0; mesh < meshCount; mesh++)
+    {
+        templates[mesh] = IndirectDrawCommand{};
+        templates[mesh].materialIndex = mesh;
+        templates[mesh].indexCountPerInstance = 36;
+    }
+
+    // every mesh drawn at least once, the other models spread over the meshes
+    std::mt19937 random(1);
+    std::vector<uint32_t> modelMeshes(instanceCount);
+    for (uint32_t i = 0; i < instanceCount; i++)
+    {
+        modelMeshes[i] = i < meshCount ? i : random() % meshCount;
+    }
+
+    std::vector<DrawPacket> packets(instanceCount);
+    std::vector<DrawPacket> scratch(instanceCount);
+    std::vector<IndirectDrawBatch> batches;
+    std::vector<uint32_t> instanceIndices(instanceCount);
+    std::vector<AlignedCommand> commands(instanceCount);
+    double instancedMs = 0.;
+    double perModelMs = 0.;
+    size_t instancedDraws = 0;
+    for (uint32_t frame = 0; frame < FrameCount; frame++)
+    {
+        Clock::time_point start = Clock::now();
+        for (uint32_t i = 0; i < instanceCount; i++)
+        {
+            packets[i].key = DrawSortKey::make(RenderPass::Main, 1, 1, modelMeshes[i], modelMeshes[i], random() % 65536);
+            packets[i].drawIndex = i;
+        }
+        radixSortDrawPackets(packets.data(), scratch.data(), packets.size());
+
+        uint64_t batchState = ~0ull;
+        batches.clear();
+        for (uint32_t i = 0; i < instanceCount; i++)
+        {
+            instanceIndices[i] = packets[i].drawIndex;
+            const uint64_t state = packets[i].key >> DrawSortKey::MeshShift;
+            if (state != batchState)
+            {
+                batches.push_back({ DrawSortKey::getMesh(packets[i].key), i, 0, 0 });
+                batchState = state;
+            }
+            batches.back().instanceCount++;
+        }
+        packIndirectDrawCommands(templates.data(), batches.data(), batches.size(), &commands[0].command);
+        instancedMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        instancedDraws = batches.size();
+
+        // one draw of one instance per model, in model order
+        start = Clock::now();
+        batches.resize(instanceCount);
+        for (uint32_t i = 0; i < instanceCount; i++)
+        {
+            batches[i] = { modelMeshes[i], i, 1, 0 };
+        }
+        packIndirectDrawCommands(templates.data(), batches.data(), batches.size(), &commands[0].command);
+        perModelMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    std::printf("%u models, %u meshes, mean of %u frames\n", instanceCount, meshCount, FrameCount);
+    std::printf("instanced: %zu draws, %.3f ms (sort, merge and pack)\n", instancedDraws, instancedMs / FrameCount);
+    std::printf("per model: %u draws, %.3f ms (pack)\n", instanceCount, perModelMs / FrameCount);
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace HDX;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double getMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// run + wait of empty jobs, the fixed cost of a job
+static double measureSpawn(JobSystem& jobSystem, uint32_t jobCount)
+{
+    double best = 1e30;
+    for (int repeat = 0; repeat < 5; repeat++)
+    {
+        const Clock::time_point start = Clock::now();
+        JobCounter counter;
+        for (uint32_t i = 0; i < jobCount; i++)
+        {
+            jobSystem.run(counter, []() {});
+        }
+        jobSystem.wait(counter);
+        best = std::min(best, getMs(start));
+    }
+    return best * 1e6 / jobCount;
+}
+
+// parallelFor over a compute bound loop, like the model updates
+static double measureParallelFor(JobSystem& jobSystem, std::vector<float>& data, uint32_t grainSize)
+{
+    double best = 1e30;
+    for (int repeat = 0; repeat < 5; repeat++)
+    {
+        const Clock::time_point start = Clock::now();
+        jobSystem.parallelFor(static_cast<uint32_t>(data.size()), grainSize, [&data](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                float x = data[i];
+                for (int step = 0; step < 64; step++)
+                {
+                    x = std::sqrt(x * x + 1.f) * 0.5f;
+                }
+                data[i] = x;
+            }
+        });
+        best = std::min(best, getMs(start));
+    }
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t maxWorkers = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : std::thread::hardware_concurrency();
+    maxWorkers = std::max(maxWorkers, 1u);
+    std::printf("hardware threads %u\n", std::thread::hardware_concurrency());
+
+    std::vector<float> data(1u << 20, 1.f);
+    double serialMs = 0.;
+    for (uint32_t workerCount = 1; workerCount <= maxWorkers; workerCount *= 2)
+    {
+        JobSystem jobSystem(workerCount);
+        const double spawnNs = measureSpawn(jobSystem, 100000);
+        const double forMs = measureParallelFor(jobSystem, data, 1024);
+        serialMs = workerCount == 1 ? forMs : serialMs;
+        std::printf("%2u workers: spawn + run %.1f ns/job, parallelFor 1M items %.2f ms, speedup %.2f\n",
+            workerCount, spawnNs, forMs, serialMs / forMs);
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include "JobSystem.h"
+#include "TestHarness.h"
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <vector>
+
+using namespace HDX;
+
+static void testParallelFor(uint32_t workerCount)
+{
+    JobSystem jobSystem(workerCount);
+    std::vector<std::atomic<uint32_t>> visits(100000);
+    for (std::atomic<uint32_t>& visit : visits)
+    {
+        visit.store(0);
+    }
+
+    jobSystem.parallelFor(static_cast<uint32_t>(visits.size()), 64, [&visits](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            visits[i].fetch_add(1);
+        }
+    });
+
+    uint32_t wrong = 0;
+    for (const std::atomic<uint32_t>& visit : visits)
+    {
+        wrong += visit.load() != 1 ? 1 : 0;
+    }
+    HDX_CHECK(wrong == 0);
+}
+
+static void testDependency(uint32_t workerCount)
+{
+    JobSystem jobSystem(workerCount);
+    JobCounter first;
+    JobCounter second;
+    std::atomic<bool> firstDone{ false };
+    std::atomic<bool> orderKept{ false };
+
+    // the dependent job is queued first, so it is found first
+    jobSystem.run(second, [&firstDone, &orderKept]() { orderKept.store(firstDone.load()); }, &first);
+    jobSystem.run(first, [&firstDone]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        firstDone.store(true);
+    });
+    jobSystem.wait(second);
+    HDX_CHECK(first.isDone());
+    HDX_CHECK(orderKept.load());
+}
+
+// More dependent jobs than a deque holds, queued over their dependency. They must neither run before it nor keep
+// being popped in its place.
+static void testDependencyOverflow(uint32_t workerCount)
+{
+    JobSystem jobSystem(workerCount);
+    JobCounter gate;
+    JobCounter dependents;
+    std::atomic<bool> gateDone{ false };
+    std::atomic<uint32_t> early{ 0 };
+    std::atomic<uint32_t> ran{ 0 };
+
+    jobSystem.run(gate, [&gateDone]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        gateDone.store(true);
+    });
+
+    const uint32_t DependentCount{ 3 * 4096 };
+    for (uint32_t i = 0; i < DependentCount; i++)
+    {
+        jobSystem.run(dependents, [&gateDone, &early, &ran]()
+        {
+            early.fetch_add(gateDone.load() ? 0 : 1);
+            ran.fetch_add(1);
+        }, &gate);
+    }
+    jobSystem.wait(dependents);
+    HDX_CHECK(early.load() == 0);
+    HDX_CHECK(ran.load() == DependentCount);
+}
+
+// Dependents of a long job must wait off the queues: workers with nothing else to run sleep instead of spinning on
+// them, which shows as process CPU time while the dependency only sleeps.
+static void testParkedDependentsDoNotSpin(uint32_t workerCount)
+{
+    JobSystem jobSystem(workerCount);
+    JobCounter gate;
+    JobCounter dependents;
+    std::atomic<bool> gateDone{ false };
+    std::atomic<uint32_t> early{ 0 };
+    std::atomic<uint32_t> ran{ 0 };
+
+    jobSystem.run(gate, [&gateDone]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        gateDone.store(true);
+    });
+
+    const uint32_t DependentCount{ 256 };
+    for (uint32_t i = 0; i < DependentCount; i++)
+    {
+        jobSystem.run(dependents, [&gateDone, &early, &ran]()
+        {
+            early.fetch_add(gateDone.load() ? 0 : 1);
+            ran.fetch_add(1);
+        }, &gate);
+    }
+
+    // the owning thread only runs jobs in wait(), it sleeps here so the time measured is the workers'
+    const std::clock_t cpuStart = std::clock();
+    const auto wallStart = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    const double cpuMs = 1000. * static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    const double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+
+    jobSystem.wait(dependents);
+    HDX_CHECK(early.load() == 0);
+    HDX_CHECK(ran.load() == DependentCount);
+    // spinning workers would burn close to (workerCount - 2) * wallMs, sleeping ones next to nothing
+    HDX_CHECK(cpuMs < 0.25 * wallMs);
+}
+
+// jobs spawning jobs, from every worker
+static void testNestedJobs(uint32_t workerCount)
+{
+    JobSystem jobSystem(workerCount);
+    std::atomic<uint32_t> leaves{ 0 };
+    jobSystem.parallelFor(64, 1, [&jobSystem, &leaves](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            jobSystem.parallelFor(1000, 10, [&leaves](uint32_t first, uint32_t last) { leaves.fetch_add(last - first); });
+        }
+    });
+    HDX_CHECK(leaves.load() == 64 * 1000);
+}
+
+int main()
+{
+    const uint32_t workerCounts[] = { 1, 2, 4 };
+    for (uint32_t workerCount : workerCounts)
+    {
+        testParallelFor(workerCount);
+        testDependency(workerCount);
+        testDependencyOverflow(workerCount);
+        testParkedDependentsDoNotSpin(workerCount);
+        testNestedJobs(workerCount);
+    }
+    return HDX_TEST_RESULT();
+}
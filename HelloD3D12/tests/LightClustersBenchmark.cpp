@@ -0,0 +1,126 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace HDX;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static const float FovY{ 0.785398f };
+static const float AspectRatio{ 16.f / 9.f };
+static const float NearZ{ 0.1f };
+static const float FarZ{ 100.f };
+static const int Repeats{ 20 };
+
+static double getMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+struct Box
+{
+    Float3 min;
+    Float3 max;
+};
+
+static std::vector<Box> makeClusterBoxes()
+{
+    const float tanY = std::tan(FovY * 0.5f);
+    const float tanX = tanY * AspectRatio;
+    std::vector<Box> boxes(LightClusters::ClusterCount);
+    for (uint32_t slice = 0; slice < LightClusters::SliceCount; slice++)
+    {
+        const float sliceNear = NearZ * std::pow(FarZ / NearZ, static_cast<float>(slice) / LightClusters::SliceCount);
+        const float sliceFar = NearZ * std::pow(FarZ / NearZ, static_cast<float>(slice + 1) / LightClusters::SliceCount);
+        for (uint32_t y = 0; y < LightClusters::TileCountY; y++)
+        {
+            const float top = tanY * (1.f - 2.f * y / LightClusters::TileCountY);
+            const float bottom = tanY * (1.f - 2.f * (y + 1) / LightClusters::TileCountY);
+            for (uint32_t x = 0; x < LightClusters::TileCountX; x++)
+            {
+                const float left = tanX * (2.f * x / LightClusters::TileCountX - 1.f);
+                const float right = tanX * (2.f * (x + 1) / LightClusters::TileCountX - 1.f);
+                Box& box = boxes[(slice * LightClusters::TileCountY + y) * LightClusters::TileCountX + x];
+                box.min = { std::min(left * sliceNear, left * sliceFar), std::min(bottom * sliceNear, bottom * sliceFar), sliceNear };
+                box.max = { std::max(right * sliceNear, right * sliceFar), std::max(top * sliceNear, top * sliceFar), sliceFar };
+            }
+        }
+    }
+    return boxes;
+}
+
+// every light against every cluster box, what the per axis split and the slice range of a light avoid
+static uint32_t assignBruteForce(const std::vector<Box>& boxes, const std::vector<LightClusters::Light>& lights,
+                                 std::vector<LightClusters::Cell>& cells, std::vector<uint32_t>& indices)
+{
+    uint32_t offset = 0;
+    for (uint32_t cluster = 0; cluster < LightClusters::ClusterCount; cluster++)
+    {
+        const Box& box = boxes[cluster];
+        cells[cluster].offset = offset;
+        for (uint32_t light = 0; light < lights.size(); light++)
+        {
+            const Float3& center = lights[light].center;
+            const float dx = std::max(std::max(box.min.x - center.x, center.x - box.max.x), 0.f);
+            const float dy = std::max(std::max(box.min.y - center.y, center.y - box.max.y), 0.f);
+            const float dz = std::max(std::max(box.min.z - center.z, center.z - box.max.z), 0.f);
+            if (dx * dx + dy * dy + dz * dz <= lights[light].radius * lights[light].radius && offset < indices.size())
+            {
+                indices[offset++] = light;
+            }
+        }
+        cells[cluster].count = offset - cells[cluster].offset;
+    }
+    return offset;
+}
+
+int main()
+{
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    const float tanY = std::tan(FovY * 0.5f);
+    const float tanX = tanY * AspectRatio;
+
+    LightClusters clusters;
+    clusters.setProjection(FovY, AspectRatio, NearZ, FarZ);
+    const std::vector<Box> boxes = makeClusterBoxes();
+    std::vector<LightClusters::Cell> cells(LightClusters::ClusterCount);
+    std::vector<uint32_t> indices(1 << 22);
+
+    printf("%u clusters (%u x %u x %u)\n", LightClusters::ClusterCount, LightClusters::TileCountX, LightClusters::TileCountY, LightClusters::SliceCount);
+    for (uint32_t lightCount : { 256u, 1024u, 4096u, 16384u })
+    {
+        // spread over the frustum and a little past its sides, denser near the camera
+        std::vector<LightClusters::Light> lights(lightCount);
+        for (LightClusters::Light& light : lights)
+        {
+            const float z = NearZ + (FarZ - NearZ) * unit(random) * unit(random);
+            light.center = { (unit(random) * 2.2f - 1.1f) * tanX * z, (unit(random) * 2.2f - 1.1f) * tanY * z, z - 1.f + unit(random) * 2.f };
+            light.radius = 0.2f + unit(random) * 1.5f;
+        }
+
+        double best = 1e9;
+        for (int repeat = 0; repeat < Repeats; repeat++)
+        {
+            const Clock::time_point start = Clock::now();
+            clusters.assign(lights.data(), lightCount, cells.data(), indices.data(), static_cast<uint32_t>(indices.size()));
+            best = std::min(best, getMs(start));
+        }
+        const LightClusters::Stats& stats = clusters.getStats();
+        char name[64];
+        snprintf(name, sizeof(name), "%u lights", lightCount);
+        printf("%-28s %8.3f ms, %u visible, %u indices, at most %u per cluster\n", name, best, stats.visibleLights, stats.indices, stats.maxClusterLights);
+
+        // the brute force pass is slow, one run is enough
+        const Clock::time_point start = Clock::now();
+        const uint32_t bruteIndices = assignBruteForce(boxes, lights, cells, indices);
+        snprintf(name, sizeof(name), "%u lights, brute force", lightCount);
+        printf("%-28s %8.3f ms, %u indices\n", name, getMs(start), bruteIndices);
+    }
+    return 0;
+}
\ No newline at end of file
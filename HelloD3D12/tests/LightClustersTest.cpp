@@ -0,0 +1,282 @@
+#include "LightClusters.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace HDX;
+
+namespace
+{
+
+typedef LightClusters::Light Light;
+typedef LightClusters::Cell Cell;
+
+const float FovY{ 0.785398f };
+const float AspectRatio{ 16.f / 9.f };
+const float NearZ{ 0.1f };
+const float FarZ{ 100.f };
+
+struct Box
+{
+    Float3 min;
+    Float3 max;
+};
+
+// view space box of each cluster, built independently of LightClusters from the slice and tile planes
+std::vector<Box> makeClusterBoxes()
+{
+    const float tanY = std::tan(FovY * 0.5f);
+    const float tanX = tanY * AspectRatio;
+    std::vector<Box> boxes(LightClusters::ClusterCount);
+    for (uint32_t slice = 0; slice < LightClusters::SliceCount; slice++)
+    {
+        const float sliceNear = NearZ * std::pow(FarZ / NearZ, static_cast<float>(slice) / LightClusters::SliceCount);
+        const float sliceFar = NearZ * std::pow(FarZ / NearZ, static_cast<float>(slice + 1) / LightClusters::SliceCount);
+        for (uint32_t y = 0; y < LightClusters::TileCountY; y++)
+        {
+            const float top = tanY * (1.f - 2.f * y / LightClusters::TileCountY);
+            const float bottom = tanY * (1.f - 2.f * (y + 1) / LightClusters::TileCountY);
+            for (uint32_t x = 0; x < LightClusters::TileCountX; x++)
+            {
+                const float left = tanX * (2.f * x / LightClusters::TileCountX - 1.f);
+                const float right = tanX * (2.f * (x + 1) / LightClusters::TileCountX - 1.f);
+                Box& box = boxes[(slice * LightClusters::TileCountY + y) * LightClusters::TileCountX + x];
+                box.min = { std::min(left * sliceNear, left * sliceFar), std::min(bottom * sliceNear, bottom * sliceFar), sliceNear };
+                box.max = { std::max(right * sliceNear, right * sliceFar), std::max(top * sliceNear, top * sliceFar), sliceFar };
+            }
+        }
+    }
+    return boxes;
+}
+
+float getDistanceSq(const Box& box, const Float3& point)
+{
+    const float dx = std::max(std::max(box.min.x - point.x, point.x - box.max.x), 0.f);
+    const float dy = std::max(std::max(box.min.y - point.y, point.y - box.max.y), 0.f);
+    const float dz = std::max(std::max(box.min.z - point.z, point.z - box.max.z), 0.f);
+    return dx * dx + dy * dy + dz * dz;
+}
+
+// lights spread over the frustum and a little past its sides, denser near the camera
+std::vector<Light> makeLights(uint32_t count, float maxRadius, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    const float tanY = std::tan(FovY * 0.5f);
+    const float tanX = tanY * AspectRatio;
+    std::vector<Light> lights(count);
+    for (Light& light : lights)
+    {
+        const float z = NearZ + (FarZ - NearZ) * unit(random) * unit(random);
+        light.center = { (unit(random) * 2.2f - 1.1f) * tanX * z, (unit(random) * 2.2f - 1.1f) * tanY * z, z - 1.f + unit(random) * 2.f };
+        light.radius = 0.2f + unit(random) * maxRadius;
+    }
+    return lights;
+}
+
+bool hasLight(const Cell& cell, const std::vector<uint32_t>& indices, uint32_t light)
+{
+    return std::find(indices.begin() + cell.offset, indices.begin() + cell.offset + cell.count, light) != indices.begin() + cell.offset + cell.count;
+}
+
+}
+
+static void testMatchesBruteForce()
+{
+    std::mt19937 random(7);
+    const std::vector<Light> lights = makeLights(2000, 3.f, random);
+    const std::vector<Box> boxes = makeClusterBoxes();
+
+    LightClusters clusters;
+    clusters.setProjection(FovY, AspectRatio, NearZ, FarZ);
+    std::vector<Cell> cells(LightClusters::ClusterCount);
+    std::vector<uint32_t> indices(1 << 20);
+    clusters.assign(lights.data(), static_cast<uint32_t>(lights.size()), cells.data(), indices.data(), static_cast<uint32_t>(indices.size()));
+    HDX_CHECK(clusters.getStats().droppedIndices == 0);
+    HDX_CHECK(clusters.getStats().lights == lights.size());
+
+    // the SSE path splits the distance per axis, so spheres grazing a box may round either way
+    uint32_t offset = 0;
+    uint32_t maxClusterLights = 0;
+    uint32_t missing = 0;
+    uint32_t extra = 0;
+    for (uint32_t cluster = 0; cluster < LightClusters::ClusterCount; cluster++)
+    {
+        const Cell& cell = cells[cluster];
+        HDX_CHECK(cell.offset == offset);
+        offset += cell.count;
+        maxClusterLights = std::max(maxClusterLights, cell.count);
+
+        for (uint32_t i = 1; i < cell.count; i++)
+        {
+            HDX_CHECK(indices[cell.offset + i - 1] < indices[cell.offset + i]);
+        }
+
+        for (uint32_t light = 0; light < lights.size(); light++)
+        {
+            const float distanceSq = getDistanceSq(boxes[cluster], lights[light].center);
+            const float radius = lights[light].radius;
+            if (distanceSq <= radius * radius * 0.999f && !hasLight(cell, indices, light))
+            {
+                missing++;
+            }
+            if (distanceSq > radius * radius * 1.001f && hasLight(cell, indices, light))
+            {
+                extra++;
+            }
+        }
+    }
+    HDX_CHECK(missing == 0);
+    HDX_CHECK(extra == 0);
+    HDX_CHECK(offset == clusters.getStats().indices);
+    HDX_CHECK(maxClusterLights == clusters.getStats().maxClusterLights);
+
+    uint32_t visible = 0;
+    for (const Light& light : lights)
+    {
+        bool touches = false;
+        for (const Box& box : boxes)
+        {
+            touches |= getDistanceSq(box, light.center) <= light.radius * light.radius;
+        }
+        visible += touches ? 1 : 0;
+    }
+    HDX_CHECK(visible > 0 && visible < lights.size());
+    HDX_CHECK(static_cast<uint32_t>(std::abs(static_cast<int>(visible) - static_cast<int>(clusters.getStats().visibleLights))) <= 2);
+}
+
+static void testPixelsFindTheirLights()
+{
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    const std::vector<Light> lights = makeLights(500, 3.f, random);
+
+    LightClusters clusters;
+    clusters.setProjection(FovY, AspectRatio, NearZ, FarZ);
+    std::vector<Cell> cells(LightClusters::ClusterCount);
+    std::vector<uint32_t> indices(1 << 18);
+    clusters.assign(lights.data(), static_cast<uint32_t>(lights.size()), cells.data(), indices.data(), static_cast<uint32_t>(indices.size()));
+
+    // points inside a light and the frustum, mapped to their cluster like the pixel shader does
+    const float tanY = std::tan(FovY * 0.5f);
+    const float tanX = tanY * AspectRatio;
+    uint32_t points = 0;
+    uint32_t missing = 0;
+    for (uint32_t light = 0; light < lights.size(); light++)
+    {
+        for (uint32_t sample = 0; sample < 100; sample++)
+        {
+            const Float3 offset{ unit(random), unit(random), unit(random) };
+            if (offset.x * offset.x + offset.y * offset.y + offset.z * offset.z > 1.f)
+            {
+                continue;
+            }
+
+            const Float3 point{ lights[light].center.x + offset.x * lights[light].radius, lights[light].center.y + offset.y * lights[light].radius,
+                lights[light].center.z + offset.z * lights[light].radius };
+            const float screenX = point.z > 0.f ? point.x / (point.z * tanX) : 2.f;
+            const float screenY = point.z > 0.f ? point.y / (point.z * tanY) : 2.f;
+            if (point.z <= NearZ || point.z >= FarZ || std::fabs(screenX) >= 1.f || std::fabs(screenY) >= 1.f)
+            {
+                continue;
+            }
+
+            const uint32_t tileX = std::min(static_cast<uint32_t>((screenX * 0.5f + 0.5f) * LightClusters::TileCountX), LightClusters::TileCountX - 1);
+            const uint32_t tileY = std::min(static_cast<uint32_t>((0.5f - screenY * 0.5f) * LightClusters::TileCountY), LightClusters::TileCountY - 1);
+            const float slice = std::floor(std::log(point.z) * clusters.getDepthScale() + clusters.getDepthBias());
+            const uint32_t sliceIndex = std::min(static_cast<uint32_t>(std::max(slice, 0.f)), LightClusters::SliceCount - 1);
+            const uint32_t cluster = (sliceIndex * LightClusters::TileCountY + tileY) * LightClusters::TileCountX + tileX;
+            points++;
+            missing += hasLight(cells[cluster], indices, light) ? 0 : 1;
+        }
+    }
+    HDX_CHECK(points > 10000);
+    HDX_CHECK(missing == 0);
+}
+
+static void testIndexListOverflow()
+{
+    std::mt19937 random(5);
+    const std::vector<Light> lights = makeLights(4096, 1.5f, random);
+
+    LightClusters clusters;
+    clusters.setProjection(FovY, AspectRatio, NearZ, FarZ);
+    std::vector<Cell> cells(LightClusters::ClusterCount);
+    std::vector<uint32_t> indices(1 << 20);
+    clusters.assign(lights.data(), static_cast<uint32_t>(lights.size()), cells.data(), indices.data(), static_cast<uint32_t>(indices.size()));
+    const uint32_t total = clusters.getStats().indices;
+    HDX_CHECK(total > 1000);
+
+    // a short list keeps the first clusters whole and drops the rest, counting what it dropped
+    const uint32_t MaxIndices{ 1000 };
+    std::vector<uint32_t> capped(MaxIndices + 1, 0xffffffffu);
+    clusters.assign(lights.data(), static_cast<uint32_t>(lights.size()), cells.data(), capped.data(), MaxIndices);
+    HDX_CHECK(clusters.getStats().indices == MaxIndices);
+    HDX_CHECK(clusters.getStats().droppedIndices == total - MaxIndices);
+    HDX_CHECK(capped[MaxIndices] == 0xffffffffu);
+    const Cell& last = cells[LightClusters::ClusterCount - 1];
+    HDX_CHECK(last.offset + last.count <= MaxIndices);
+}
+
+static void testLightsOutsideDepthRange()
+{
+    LightClusters clusters;
+    clusters.setProjection(FovY, AspectRatio, NearZ, FarZ);
+    const Light lights[] = { { { 0.f, 0.f, -5.f }, 1.f }, { { 0.f, 0.f, FarZ + 5.f }, 1.f }, { { 0.f, 0.f, 10.f }, 0.5f } };
+    std::vector<Cell> cells(LightClusters::ClusterCount);
+    std::vector<uint32_t> indices(1024);
+    clusters.assign(lights, 3, cells.data(), indices.data(), static_cast<uint32_t>(indices.size()));
+    HDX_CHECK(clusters.getStats().visibleLights == 1);
+    for (uint32_t i = 0; i < clusters.getStats().indices; i++)
+    {
+        HDX_CHECK(indices[i] == 2);
+    }
+}
+
+static void testConeBounds()
+{
+    const Float3 apex{ 1.f, 2.f, 3.f };
+    const float length = std::sqrt(3.f);
+    const Float3 direction{ 1.f / length, 1.f / length, -1.f / length };
+    // two axes perpendicular to the direction
+    const Float3 side{ 1.f / std::sqrt(2.f), -1.f / std::sqrt(2.f), 0.f };
+    const Float3 up{ direction.y * side.z - direction.z * side.y, direction.z * side.x - direction.x * side.z, direction.x * side.y - direction.y * side.x };
+    const float range = 10.f;
+    for (float halfAngle : { 0.1f, 0.5f, 0.9f, 1.4f, 2.f })
+    {
+        const Light bound = LightClusters::boundCone(apex, direction, range, std::cos(halfAngle));
+        HDX_CHECK(bound.radius <= range * 1.0001f);
+
+        // the apex, the tip of the cap and its rim are inside
+        std::vector<Float3> points = { apex, { apex.x + direction.x * range, apex.y + direction.y * range, apex.z + direction.z * range } };
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            const float angle = i * 0.785398f;
+            const float along = std::cos(halfAngle) * range;
+            const float across = std::sin(halfAngle) * range;
+            const float u = std::cos(angle) * across;
+            const float v = std::sin(angle) * across;
+            points.push_back({ apex.x + direction.x * along + side.x * u + up.x * v, apex.y + direction.y * along + side.y * u + up.y * v,
+                apex.z + direction.z * along + side.z * u + up.z * v });
+        }
+        for (const Float3& point : points)
+        {
+            const float dx = point.x - bound.center.x;
+            const float dy = point.y - bound.center.y;
+            const float dz = point.z - bound.center.z;
+            HDX_CHECK(std::sqrt(dx * dx + dy * dy + dz * dz) <= bound.radius * 1.0001f);
+        }
+    }
+}
+
+int main()
+{
+    testMatchesBruteForce();
+    testPixelsFindTheirLights();
+    testIndexListOverflow();
+    testLightsOutsideDepthRange();
+    testConeBounds();
+    return HDX_TEST_RESULT();
+}
\ No newline at end of file
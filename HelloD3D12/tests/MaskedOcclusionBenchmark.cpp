@@ -0,0 +1,137 @@
+#include "MaskedOcclusion.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace HDX;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static const int OccluderCount{ 200 };
+static const int BoxCount{ 10000 };
+static const int Repeats{ 200 };
+
+static double getMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void multiply(const float* a, const float* b, float* result)
+{
+    for (int row = 0; row < 4; row++)
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            float sum = 0.f;
+            for (int k = 0; k < 4; k++)
+            {
+                sum += a[row * 4 + k] * b[k * 4 + column];
+            }
+            result[row * 4 + column] = sum;
+        }
+    }
+}
+
+// camera at the origin looking down +z, near 0.1, far 100
+static void makeViewProjection(float aspectRatio, float* viewProjection)
+{
+    const float n = 0.1f;
+    const float f = 100.f;
+    const float scaleY = 1.f / std::tan(0.4f);
+    const float view[16] = {
+        1.f, 0.f, 0.f, 0.f,
+        0.f, 1.f, 0.f, 0.f,
+        0.f, 0.f, 1.f, 0.f,
+        0.f, 0.f, 0.f, 1.f
+    };
+    const float projection[16] = {
+        scaleY / aspectRatio, 0.f, 0.f, 0.f,
+        0.f, scaleY, 0.f, 0.f,
+        0.f, 0.f, f / (f - n), 1.f,
+        0.f, 0.f, -n * f / (f - n), 0.f
+    };
+    multiply(view, projection, viewProjection);
+}
+
+// the 12 triangles of a box, clockwise seen from outside
+static void appendBox(const Float3& center, const Float3& extents, std::vector<Float3>& triangles)
+{
+    Float3 corners[8];
+    for (int i = 0; i < 8; i++)
+    {
+        corners[i] = { center.x + ((i & 1) ? extents.x : -extents.x), center.y + ((i & 2) ? extents.y : -extents.y), center.z + ((i & 4) ? extents.z : -extents.z) };
+    }
+    const int faces[6][4] = { { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 } };
+    for (const int* face : faces)
+    {
+        const int order[6] = { 0, 1, 2, 0, 2, 3 };
+        for (int i : order)
+        {
+            triangles.push_back(corners[face[i]]);
+        }
+    }
+}
+
+int main()
+{
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> position(-15.f, 15.f);
+    std::uniform_real_distribution<float> depth(4.f, 40.f);
+    std::uniform_real_distribution<float> size(0.2f, 3.f);
+
+    // boxes in front of the camera as occluders, smaller boxes further back as occludees
+    std::vector<Float3> occluders;
+    for (int i = 0; i < OccluderCount; i++)
+    {
+        appendBox({ position(random), position(random) * 0.5f, depth(random) }, { size(random), size(random), size(random) }, occluders);
+    }
+    const uint32_t triangleCount = static_cast<uint32_t>(occluders.size() / 3);
+    std::vector<Bounds> boxes;
+    for (int i = 0; i < BoxCount; i++)
+    {
+        const Float3 center{ position(random), position(random) * 0.5f, depth(random) + 10.f };
+        const float extent = size(random) * 0.3f;
+        boxes.push_back(makeBounds({ center.x - extent, center.y - extent, center.z - extent }, { center.x + extent, center.y + extent, center.z + extent }));
+    }
+
+    printf("%u occluder triangles, %d box tests\n", triangleCount, BoxCount);
+    const uint32_t sizes[][2] = { { 320, 180 }, { 640, 360 }, { 1280, 720 } };
+    for (const uint32_t* size : sizes)
+    {
+        float viewProjection[16];
+        makeViewProjection(static_cast<float>(size[0]) / size[1], viewProjection);
+        MaskedOcclusionBuffer buffer;
+        buffer.resize(size[0], size[1]);
+
+        double renderMs = 0.;
+        double testMs = 0.;
+        uint32_t hidden = 0;
+        for (int repeat = 0; repeat < Repeats; repeat++)
+        {
+            Clock::time_point start = Clock::now();
+            buffer.clear();
+            buffer.renderTriangles(occluders.data(), triangleCount, viewProjection);
+            renderMs += getMs(start);
+
+            start = Clock::now();
+            hidden = 0;
+            for (const Bounds& bounds : boxes)
+            {
+                hidden += buffer.testBox(bounds, viewProjection) ? 0 : 1;
+            }
+            testMs += getMs(start);
+        }
+
+        const MaskedOcclusionBuffer::Stats& stats = buffer.getStats();
+        char name[64];
+        snprintf(name, sizeof(name), "%ux%u clear + render", size[0], size[1]);
+        printf("%-28s %8.3f ms, %u rasterized triangles, %u tile updates\n", name, renderMs / Repeats,
+            stats.rasterizedTriangles / Repeats, stats.tileUpdates / Repeats);
+        snprintf(name, sizeof(name), "%ux%u box tests", size[0], size[1]);
+        printf("%-28s %8.3f ms, %.1f ns/test, %u of %d hidden\n", name, testMs / Repeats, testMs / Repeats / BoxCount * 1e6, hidden, BoxCount);
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,361 @@
+#include "MaskedOcclusion.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace HDX;
+
+namespace
+{
+
+const uint32_t Width{ 320 };
+const uint32_t Height{ 180 };
+
+void multiply(const float* a, const float* b, float* result)
+{
+    for (int row = 0; row < 4; row++)
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            float sum = 0.f;
+            for (int k = 0; k < 4; k++)
+            {
+                sum += a[row * 4 + k] * b[k * 4 + column];
+            }
+            result[row * 4 + column] = sum;
+        }
+    }
+}
+
+void transform(const float* matrix, const Float3& point, float* clip)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        clip[i] = point.x * matrix[i] + point.y * matrix[4 + i] + point.z * matrix[8 + i] + matrix[12 + i];
+    }
+}
+
+// camera at the origin looking down +z, near 0.1, far 100
+void makeViewProjection(float* viewProjection)
+{
+    const float n = 0.1f;
+    const float f = 100.f;
+    const float scaleY = 1.f / std::tan(0.4f);
+    const float scaleX = scaleY * Height / Width;
+    const float view[16] = {
+        1.f, 0.f, 0.f, 0.f,
+        0.f, 1.f, 0.f, 0.f,
+        0.f, 0.f, 1.f, 0.f,
+        0.f, 0.f, 0.f, 1.f
+    };
+    const float projection[16] = {
+        scaleX, 0.f, 0.f, 0.f,
+        0.f, scaleY, 0.f, 0.f,
+        0.f, 0.f, f / (f - n), 1.f,
+        0.f, 0.f, -n * f / (f - n), 0.f
+    };
+    multiply(view, projection, viewProjection);
+}
+
+// the 12 triangles of a box, clockwise seen from outside
+void appendBox(const Float3& minCorner, const Float3& maxCorner, std::vector<Float3>& triangles)
+{
+    Float3 corners[8];
+    for (int i = 0; i < 8; i++)
+    {
+        corners[i] = { (i & 1) ? maxCorner.x : minCorner.x, (i & 2) ? maxCorner.y : minCorner.y, (i & 4) ? maxCorner.z : minCorner.z };
+    }
+    const int faces[6][4] = { { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 } };
+    for (const int* face : faces)
+    {
+        const int order[6] = { 0, 1, 2, 0, 2, 3 };
+        for (int i : order)
+        {
+            triangles.push_back(corners[face[i]]);
+        }
+    }
+}
+
+// Exact per pixel depth buffer with the same pixel centers, the reference the masked buffer must stay behind.
+class ReferenceDepth
+{
+public:
+    ReferenceDepth() : mDepth(Width * Height, 1.f) {}
+
+    float getDepth(uint32_t x, uint32_t y) const { return mDepth[y * Width + x]; }
+
+    void renderTriangle(const float* viewProjection, const Float3* corners)
+    {
+        float x[3];
+        float y[3];
+        float z[3];
+        for (int i = 0; i < 3; i++)
+        {
+            float clip[4];
+            transform(viewProjection, corners[i], clip);
+            if (clip[2] < 0.f || clip[3] <= 0.f)
+            {
+                return;
+            }
+            x[i] = (clip[0] / clip[3] * 0.5f + 0.5f) * Width;
+            y[i] = (0.5f - clip[1] / clip[3] * 0.5f) * Height;
+            z[i] = clip[2] / clip[3];
+        }
+
+        const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (!(area > 0.f))
+        {
+            return;
+        }
+
+        for (uint32_t py = 0; py < Height; py++)
+        {
+            for (uint32_t px = 0; px < Width; px++)
+            {
+                const float cx = px + 0.5f;
+                const float cy = py + 0.5f;
+                float weights[3];
+                bool inside = true;
+                for (int i = 0; i < 3 && inside; i++)
+                {
+                    const int j = (i + 1) % 3;
+                    const float edge = (x[j] - x[i]) * (cy - y[i]) - (y[j] - y[i]) * (cx - x[i]);
+                    inside = edge >= 0.f;
+                    weights[(i + 2) % 3] = edge / area;
+                }
+                if (inside)
+                {
+                    float& depth = mDepth[py * Width + px];
+                    depth = std::min(depth, weights[0] * z[0] + weights[1] * z[1] + weights[2] * z[2]);
+                }
+            }
+        }
+    }
+
+    // same screen rectangle and nearest depth as testBox, compared against every pixel
+    bool isBoxVisible(const float* viewProjection, const Bounds& bounds) const
+    {
+        float minX = 1e9f;
+        float maxX = -1e9f;
+        float minY = 1e9f;
+        float maxY = -1e9f;
+        float minZ = 1.f;
+        for (int i = 0; i < 8; i++)
+        {
+            const Float3 corner{ bounds.center.x + ((i & 1) ? bounds.extents.x : -bounds.extents.x),
+                bounds.center.y + ((i & 2) ? bounds.extents.y : -bounds.extents.y), bounds.center.z + ((i & 4) ? bounds.extents.z : -bounds.extents.z) };
+            float clip[4];
+            transform(viewProjection, corner, clip);
+            if (clip[2] < 0.f || clip[3] <= 0.f)
+            {
+                return true;
+            }
+            const float sx = (clip[0] / clip[3] * 0.5f + 0.5f) * Width;
+            const float sy = (0.5f - clip[1] / clip[3] * 0.5f) * Height;
+            minX = std::min(minX, sx);
+            maxX = std::max(maxX, sx);
+            minY = std::min(minY, sy);
+            maxY = std::max(maxY, sy);
+            minZ = std::min(minZ, clip[2] / clip[3]);
+        }
+
+        if (maxX < 0.f || maxY < 0.f || minX >= Width || minY >= Height)
+        {
+            return true;
+        }
+        const uint32_t x0 = static_cast<uint32_t>(std::max(minX, 0.f));
+        const uint32_t x1 = std::min(Width - 1, static_cast<uint32_t>(maxX));
+        const uint32_t y0 = static_cast<uint32_t>(std::max(minY, 0.f));
+        const uint32_t y1 = std::min(Height - 1, static_cast<uint32_t>(maxY));
+        for (uint32_t y = y0; y <= y1; y++)
+        {
+            for (uint32_t x = x0; x <= x1; x++)
+            {
+                if (!(minZ > getDepth(x, y)))
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+private:
+    std::vector<float> mDepth;
+};
+
+}
+
+static void testEmptyBufferHidesNothing()
+{
+    float viewProjection[16];
+    makeViewProjection(viewProjection);
+    MaskedOcclusionBuffer buffer;
+    buffer.resize(Width, Height);
+    HDX_CHECK(buffer.getWidth() == Width && buffer.getHeight() == Height);
+    HDX_CHECK(buffer.getPixelDepth(0, 0) == 1.f);
+    HDX_CHECK(buffer.testBox(makeBounds({ -1.f, -1.f, 50.f }, { 1.f, 1.f, 52.f }), viewProjection));
+
+    // sizes are rounded up to whole tiles
+    MaskedOcclusionBuffer odd;
+    odd.resize(100, 30);
+    HDX_CHECK(odd.getWidth() == 128 && odd.getHeight() == 32);
+}
+
+static void testFullScreenOccluder()
+{
+    float viewProjection[16];
+    makeViewProjection(viewProjection);
+    MaskedOcclusionBuffer buffer;
+    buffer.resize(Width, Height);
+
+    // a wall at z = 10, much wider than the view
+    std::vector<Float3> wall;
+    appendBox({ -100.f, -100.f, 10.f }, { 100.f, 100.f, 11.f }, wall);
+    buffer.renderTriangles(wall.data(), static_cast<uint32_t>(wall.size() / 3), viewProjection);
+    HDX_CHECK(buffer.getStats().triangles == 12);
+    HDX_CHECK(buffer.getStats().rasterizedTriangles > 0);
+    for (uint32_t y = 0; y < Height; y += 7)
+    {
+        for (uint32_t x = 0; x < Width; x += 13)
+        {
+            HDX_CHECK(buffer.getPixelDepth(x, y) < 1.f);
+        }
+    }
+
+    // behind the wall, anywhere on screen
+    HDX_CHECK(!buffer.testBox(makeBounds({ -1.f, -1.f, 20.f }, { 1.f, 1.f, 22.f }), viewProjection));
+    HDX_CHECK(!buffer.testBox(makeBounds({ 6.f, 2.f, 30.f }, { 8.f, 3.f, 31.f }), viewProjection));
+    HDX_CHECK(!buffer.testBox(makeBounds({ -15.f, -8.f, 60.f }, { 15.f, 8.f, 70.f }), viewProjection));
+    // in front of the wall, crossing it, or off screen
+    HDX_CHECK(buffer.testBox(makeBounds({ -1.f, -1.f, 5.f }, { 1.f, 1.f, 6.f }), viewProjection));
+    HDX_CHECK(buffer.testBox(makeBounds({ -1.f, -1.f, 8.f }, { 1.f, 1.f, 12.f }), viewProjection));
+    HDX_CHECK(buffer.testBox(makeBounds({ 500.f, -1.f, 20.f }, { 502.f, 1.f, 22.f }), viewProjection));
+    // crossing the near plane
+    HDX_CHECK(buffer.testBox(makeBounds({ -1.f, -1.f, -1.f }, { 1.f, 1.f, 22.f }), viewProjection));
+
+    buffer.clear();
+    HDX_CHECK(buffer.testBox(makeBounds({ -1.f, -1.f, 20.f }, { 1.f, 1.f, 22.f }), viewProjection));
+}
+
+static void testPartialOccluder()
+{
+    float viewProjection[16];
+    makeViewProjection(viewProjection);
+    MaskedOcclusionBuffer buffer;
+    buffer.resize(Width, Height);
+
+    // a wall covering the left half of the screen
+    std::vector<Float3> wall;
+    appendBox({ -100.f, -100.f, 10.f }, { 0.f, 100.f, 11.f }, wall);
+    buffer.renderTriangles(wall.data(), static_cast<uint32_t>(wall.size() / 3), viewProjection);
+
+    HDX_CHECK(!buffer.testBox(makeBounds({ -6.f, -1.f, 20.f }, { -4.f, 1.f, 22.f }), viewProjection));
+    // straddling the edge of the wall, or entirely right of it
+    HDX_CHECK(buffer.testBox(makeBounds({ -2.f, -1.f, 20.f }, { 2.f, 1.f, 22.f }), viewProjection));
+    HDX_CHECK(buffer.testBox(makeBounds({ 4.f, -1.f, 20.f }, { 6.f, 1.f, 22.f }), viewProjection));
+}
+
+static void testBackFacesAndNearPlane()
+{
+    float viewProjection[16];
+    makeViewProjection(viewProjection);
+    MaskedOcclusionBuffer buffer;
+    buffer.resize(Width, Height);
+    const Bounds behind = makeBounds({ -1.f, -1.f, 20.f }, { 1.f, 1.f, 22.f });
+
+    // one quad facing away from the camera does not occlude
+    const Float3 backFacing[] = { { -50.f, -50.f, 10.f }, { 50.f, 50.f, 10.f }, { -50.f, 50.f, 10.f }, { -50.f, -50.f, 10.f }, { 50.f, -50.f, 10.f }, { 50.f, 50.f, 10.f } };
+    buffer.renderTriangles(backFacing, 2, viewProjection);
+    HDX_CHECK(buffer.getStats().rasterizedTriangles == 0);
+    HDX_CHECK(buffer.testBox(behind, viewProjection));
+
+    // the same quad facing the camera does
+    const Float3 frontFacing[] = { { -50.f, -50.f, 10.f }, { -50.f, 50.f, 10.f }, { 50.f, 50.f, 10.f }, { -50.f, -50.f, 10.f }, { 50.f, 50.f, 10.f }, { 50.f, -50.f, 10.f } };
+    buffer.renderTriangles(frontFacing, 2, viewProjection);
+    HDX_CHECK(buffer.getStats().rasterizedTriangles == 2);
+    HDX_CHECK(!buffer.testBox(behind, viewProjection));
+
+    // triangles crossing the near plane are dropped, they only lose occlusion
+    buffer.clear();
+    buffer.resetStats();
+    const Float3 crossing[] = { { -50.f, -50.f, -5.f }, { -50.f, 50.f, 15.f }, { 50.f, 50.f, 15.f } };
+    buffer.renderTriangles(crossing, 1, viewProjection);
+    HDX_CHECK(buffer.getStats().rasterizedTriangles == 0);
+    HDX_CHECK(buffer.testBox(behind, viewProjection));
+}
+
+static void testConservativeAgainstExactDepth()
+{
+    float viewProjection[16];
+    makeViewProjection(viewProjection);
+    MaskedOcclusionBuffer buffer;
+    buffer.resize(Width, Height);
+
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> position(-15.f, 15.f);
+    std::uniform_real_distribution<float> depth(4.f, 40.f);
+    std::uniform_real_distribution<float> size(0.2f, 3.f);
+    uint32_t tests = 0;
+    uint32_t hiddenExact = 0;
+    uint32_t hidden = 0;
+    uint32_t wronglyHidden = 0;
+    uint32_t nearerPixels = 0;
+    for (int scene = 0; scene < 10; scene++)
+    {
+        buffer.clear();
+        ReferenceDepth reference;
+        std::vector<Float3> occluders;
+        for (int i = 0; i < 30; i++)
+        {
+            const Float3 center{ position(random), position(random) * 0.5f, depth(random) };
+            const Float3 extents{ size(random), size(random), size(random) };
+            appendBox({ center.x - extents.x, center.y - extents.y, center.z - extents.z }, { center.x + extents.x, center.y + extents.y, center.z + extents.z }, occluders);
+        }
+        buffer.renderTriangles(occluders.data(), static_cast<uint32_t>(occluders.size() / 3), viewProjection);
+        for (size_t i = 0; i < occluders.size(); i += 3)
+        {
+            reference.renderTriangle(viewProjection, &occluders[i]);
+        }
+
+        // the stored depth is an upper bound, never nearer than the exact one
+        for (uint32_t y = 0; y < Height; y++)
+        {
+            for (uint32_t x = 0; x < Width; x++)
+            {
+                nearerPixels += buffer.getPixelDepth(x, y) < reference.getDepth(x, y) - 1e-6f ? 1 : 0;
+            }
+        }
+
+        for (int i = 0; i < 500; i++)
+        {
+            const Float3 center{ position(random), position(random) * 0.5f, depth(random) + 10.f };
+            const float extent = size(random) * 0.3f;
+            const Bounds bounds = makeBounds({ center.x - extent, center.y - extent, center.z - extent }, { center.x + extent, center.y + extent, center.z + extent });
+            const bool visible = buffer.testBox(bounds, viewProjection);
+            const bool visibleExact = reference.isBoxVisible(viewProjection, bounds);
+            tests++;
+            hidden += visible ? 0 : 1;
+            hiddenExact += visibleExact ? 0 : 1;
+            wronglyHidden += !visible && visibleExact ? 1 : 0;
+        }
+    }
+    HDX_CHECK(nearerPixels == 0);
+    HDX_CHECK(wronglyHidden == 0);
+    // the two layers lose some occlusion, most of it is kept
+    HDX_CHECK(hiddenExact > tests / 5);
+    HDX_CHECK(hidden * 10 >= hiddenExact * 6);
+}
+
+int main()
+{
+    testEmptyBufferHidesNothing();
+    testFullScreenOccluder();
+    testPartialOccluder();
+    testBackFacesAndNearPlane();
+    testConservativeAgainstExactDepth();
+    return HDX_TEST_RESULT();
+}
\ No newline at end of file
@@ -0,0 +1,249 @@
+#include "MeshLod.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace HDX;
+
+namespace
+{
+
+const float ProjectionScale{ 500.f };
+
+// distance from the center of a unit sphere at which the error of LOD k projects to the threshold, k > 0
+float getSwitchDistance(const LodConfig& config, uint32_t lod)
+{
+    const float error = config.errorScale * std::ldexp(1.f, static_cast<int>(lod) - 1);
+    return error * ProjectionScale / config.maxErrorPixels + 1.f;
+}
+
+uint8_t selectAt(const LodSelector& selector, float distance, uint8_t current)
+{
+    selector.select(Float3{ 0.f, 0.f, distance }, ProjectionScale, 0, 1, &current);
+    return current;
+}
+
+}
+
+static void testLevelsFollowProjectedError()
+{
+    LodConfig config;
+    config.hysteresis = 0.f;
+    LodSelector selector(config);
+    selector.resize(1);
+    Bounds bounds{};
+    bounds.radius = 1.f;
+    selector.setObject(0, bounds, 4);
+
+    HDX_CHECK(selectAt(selector, 1.f, 0) == 0);
+    HDX_CHECK(selectAt(selector, getSwitchDistance(config, 1) * 0.99f, 0) == 0);
+    HDX_CHECK(selectAt(selector, getSwitchDistance(config, 1) * 1.01f, 0) == 1);
+    HDX_CHECK(selectAt(selector, getSwitchDistance(config, 2) * 0.99f, 0) == 1);
+    HDX_CHECK(selectAt(selector, getSwitchDistance(config, 2) * 1.01f, 0) == 2);
+    HDX_CHECK(selectAt(selector, getSwitchDistance(config, 3) * 1.01f, 0) == 3);
+    // clamped to the coarsest LOD of the mesh
+    HDX_CHECK(selectAt(selector, 1e6f, 0) == 3);
+    // a camera inside the bounds gets the finest LOD
+    HDX_CHECK(selectAt(selector, 0.f, 3) == 0);
+}
+
+static void testHysteresisDoesNotOscillate()
+{
+    LodConfig config;
+    LodSelector selector(config);
+    LodConfig noHysteresisConfig = config;
+    noHysteresisConfig.hysteresis = 0.f;
+    LodSelector noHysteresis(noHysteresisConfig);
+
+    Bounds bounds{};
+    bounds.radius = 1.f;
+    for (LodSelector* s : { &selector, &noHysteresis })
+    {
+        s->resize(1);
+        s->setObject(0, bounds, 4);
+    }
+
+    // the camera jitters across the LOD 1 switch distance, inside the hysteresis band
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> jitter(-0.1f, 0.1f);
+    const float switchDistance = getSwitchDistance(config, 1);
+    uint8_t lod = 0;
+    uint8_t noHysteresisLod = 0;
+    uint32_t changes = 0;
+    uint32_t noHysteresisChanges = 0;
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        const float distance = switchDistance * (1.f + jitter(random));
+        const uint8_t next = selectAt(selector, distance, lod);
+        const uint8_t noHysteresisNext = selectAt(noHysteresis, distance, noHysteresisLod);
+        changes += next != lod ? 1 : 0;
+        noHysteresisChanges += noHysteresisNext != noHysteresisLod ? 1 : 0;
+        lod = next;
+        noHysteresisLod = noHysteresisNext;
+    }
+    HDX_CHECK(changes == 0);
+    HDX_CHECK(noHysteresisChanges > 100);
+
+    // either LOD is kept inside the band, leaving it switches
+    HDX_CHECK(selectAt(selector, switchDistance * 1.1f, 0) == 0);
+    HDX_CHECK(selectAt(selector, switchDistance * 0.9f, 1) == 1);
+    HDX_CHECK(selectAt(selector, switchDistance * 1.25f, 0) == 1);
+    HDX_CHECK(selectAt(selector, switchDistance * 0.8f, 1) == 0);
+}
+
+static void testBiasFollowsBudget()
+{
+    LodConfig config;
+    config.triangleBudget = 1000;
+    LodSelector selector(config);
+    HDX_CHECK(selector.getBias() == 1.f);
+
+    // over budget the bias rises with the square root of the excess
+    selector.updateBias(4000);
+    HDX_CHECK_NEAR(selector.getBias(), 2.f, 1e-5f);
+    selector.updateBias(2250);
+    HDX_CHECK_NEAR(selector.getBias(), 3.f, 1e-5f);
+    selector.updateBias(1000000000);
+    HDX_CHECK(selector.getBias() == config.maxBias);
+
+    // just under budget it holds, well under it decays slowly and stops at 1
+    selector.updateBias(900);
+    HDX_CHECK(selector.getBias() == config.maxBias);
+    float previous = selector.getBias();
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        selector.updateBias(500);
+        HDX_CHECK(selector.getBias() < previous);
+        HDX_CHECK(selector.getBias() > previous * 0.95f);
+        previous = selector.getBias();
+    }
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        selector.updateBias(0);
+    }
+    HDX_CHECK(selector.getBias() == 1.f);
+
+    // a raised bias coarsens the selection
+    Bounds bounds{};
+    bounds.radius = 1.f;
+    selector.resize(1);
+    selector.setObject(0, bounds, 4);
+    const float distance = getSwitchDistance(config, 1) * 1.3f;
+    HDX_CHECK(selectAt(selector, distance, 0) == 1);
+    selector.updateBias(16000);
+    HDX_CHECK(selectAt(selector, distance, 0) == 3);
+
+    // without a budget there is no bias
+    selector.setConfig(LodConfig());
+    selector.updateBias(1000000);
+    HDX_CHECK(selector.getBias() == 1.f);
+}
+
+static void testVectorMatchesScalar()
+{
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> position(-200.f, 200.f);
+    std::uniform_real_distribution<float> radius(0.1f, 5.f);
+    std::uniform_int_distribution<uint32_t> lodCount(1, 6);
+
+    for (uint32_t count = 1; count <= 67; count++)
+    {
+        LodSelector selector;
+        selector.resize(count);
+        std::vector<uint8_t> current(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            Bounds bounds{};
+            bounds.center = Float3{ position(random), position(random), position(random) };
+            bounds.radius = radius(random);
+            const uint32_t lods = lodCount(random);
+            selector.setObject(i, bounds, lods);
+            current[i] = static_cast<uint8_t>(random() % lods);
+        }
+
+        // ranges that start and end off a multiple of 4
+        std::uniform_int_distribution<uint32_t> split(0, count);
+        uint32_t begin = split(random);
+        uint32_t end = split(random);
+        if (begin > end)
+        {
+            std::swap(begin, end);
+        }
+
+        const Float3 camera{ position(random), position(random), position(random) };
+        std::vector<uint8_t> vector = current;
+        std::vector<uint8_t> scalar = current;
+        selector.select(camera, ProjectionScale, 0, count, vector.data());
+        selector.selectScalar(camera, ProjectionScale, 0, count, scalar.data());
+        HDX_CHECK(vector == scalar);
+
+        vector = current;
+        scalar = current;
+        selector.select(camera, ProjectionScale, begin, end, vector.data());
+        selector.selectScalar(camera, ProjectionScale, begin, end, scalar.data());
+        HDX_CHECK(vector == scalar);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (i < begin || i >= end)
+            {
+                HDX_CHECK(vector[i] == current[i]);
+            }
+        }
+    }
+}
+
+static void testClusteredLodReducesTriangles()
+{
+    // 32 x 32 quad grid on the unit square
+    const uint32_t Quads{ 32 };
+    std::vector<float> positions;
+    for (uint32_t y = 0; y <= Quads; y++)
+    {
+        for (uint32_t x = 0; x <= Quads; x++)
+        {
+            positions.push_back(static_cast<float>(x) / Quads);
+            positions.push_back(static_cast<float>(y) / Quads);
+            positions.push_back(0.f);
+        }
+    }
+    std::vector<uint32_t> indices;
+    for (uint32_t y = 0; y < Quads; y++)
+    {
+        for (uint32_t x = 0; x < Quads; x++)
+        {
+            const uint32_t corner = y * (Quads + 1) + x;
+            const uint32_t quad[] = { corner, corner + Quads + 1, corner + 1, corner + 1, corner + Quads + 1, corner + Quads + 2 };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+    const uint32_t triangleCount = Quads * Quads * 2;
+    const uint32_t vertexCount = static_cast<uint32_t>(positions.size() / 3);
+
+    // cells smaller than the grid spacing keep every triangle
+    std::vector<uint32_t> lod;
+    HDX_CHECK(buildClusteredLod(positions.data(), sizeof(float) * 3, indices.data(), triangleCount * 3, Float3{ -0.001f, -0.001f, -0.001f }, 0.5f / Quads, lod) == triangleCount);
+    HDX_CHECK(lod.size() == triangleCount * 3);
+
+    // cells of 4 x 4 quads leave about a sixteenth, all indexing the source vertices
+    lod.clear();
+    const uint32_t coarse = buildClusteredLod(positions.data(), sizeof(float) * 3, indices.data(), triangleCount * 3, Float3{ -0.001f, -0.001f, -0.001f }, 4.f / Quads, lod);
+    HDX_CHECK(coarse > 0 && coarse <= triangleCount / 8);
+    HDX_CHECK(lod.size() == coarse * 3);
+    for (uint32_t index : lod)
+    {
+        HDX_CHECK(index < vertexCount);
+    }
+}
+
+int main()
+{
+    testLevelsFollowProjectedError();
+    testHysteresisDoesNotOscillate();
+    testBiasFollowsBudget();
+    testVectorMatchesScalar();
+    testClusteredLodReducesTriangles();
+    return HDX_TEST_RESULT();
+}
\ No newline at end of file
@@ -0,0 +1,422 @@
+#include "RenderGraph.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace HDX;
+
+namespace
+{
+
+typedef RenderGraph::Barrier Barrier;
+typedef RenderGraph::BarrierSplit BarrierSplit;
+typedef RenderGraph::BarrierType BarrierType;
+
+RenderGraphResourceDesc makeDesc(uint64_t size, uint64_t alignment = 65536, uint32_t aliasGroup = 0)
+{
+    RenderGraphResourceDesc desc;
+    desc.size = size;
+    desc.alignment = alignment;
+    desc.aliasGroup = aliasGroup;
+    return desc;
+}
+
+// index of the pass in the schedule, InvalidHandle when it was culled
+uint32_t findScheduled(const RenderGraph& graph, RenderGraph::PassHandle pass)
+{
+    const std::vector<RenderGraph::ScheduledPass>& schedule = graph.getSchedule();
+    for (uint32_t i = 0; i < schedule.size(); i++)
+    {
+        if (schedule[i].pass == pass)
+        {
+            return i;
+        }
+    }
+    return RenderGraph::InvalidHandle;
+}
+
+std::vector<Barrier> getBarriersBefore(const RenderGraph& graph, RenderGraph::PassHandle pass)
+{
+    const RenderGraph::ScheduledPass& scheduled = graph.getSchedule()[findScheduled(graph, pass)];
+    const Barrier* first = graph.getBarriers().data() + scheduled.firstBarrierBefore;
+    return std::vector<Barrier>(first, first + scheduled.barrierBeforeCount);
+}
+
+std::vector<Barrier> getBarriersAfter(const RenderGraph& graph, RenderGraph::PassHandle pass)
+{
+    const RenderGraph::ScheduledPass& scheduled = graph.getSchedule()[findScheduled(graph, pass)];
+    const Barrier* first = graph.getBarriers().data() + scheduled.firstBarrierAfter;
+    return std::vector<Barrier>(first, first + scheduled.barrierAfterCount);
+}
+
+std::vector<Barrier> getTail(const RenderGraph& graph, uint32_t commandList)
+{
+    const RenderGraph::CommandListTail& tail = graph.getCommandListTails()[commandList];
+    const Barrier* first = graph.getBarriers().data() + tail.firstBarrier;
+    return std::vector<Barrier>(first, first + tail.barrierCount);
+}
+
+bool isTransition(const Barrier& barrier, BarrierSplit split, RenderGraph::ResourceHandle resource, uint32_t before, uint32_t after)
+{
+    return barrier.type == BarrierType::Transition && barrier.split == split && barrier.resource == resource
+        && barrier.stateBefore == before && barrier.stateAfter == after;
+}
+
+}
+
+static void testCullsUnusedPasses()
+{
+    RenderGraph graph;
+    const RenderGraph::ResourceHandle backBuffer = graph.importResource("back buffer", ResourceStatePresent, ResourceStatePresent);
+    const RenderGraph::ResourceHandle scene = graph.createTransient("scene", makeDesc(1 << 20));
+    const RenderGraph::ResourceHandle blurInput = graph.createTransient("blur input", makeDesc(1 << 20));
+    const RenderGraph::ResourceHandle blurred = graph.createTransient("blurred", makeDesc(1 << 20));
+    const RenderGraph::ResourceHandle counters = graph.createTransient("counters", makeDesc(256, 256));
+    const RenderGraph::ResourceHandle unused = graph.createTransient("unused", makeDesc(1 << 20));
+
+    const RenderGraph::PassHandle draw = graph.addPass("draw", 0);
+    graph.write(draw, scene, ResourceStateRenderTarget);
+    // a chain whose end result nobody reads, culled back to its start
+    const RenderGraph::PassHandle downsample = graph.addPass("downsample", 0);
+    graph.read(downsample, scene, ResourceStatePixelShaderResource);
+    graph.write(downsample, blurInput, ResourceStateRenderTarget);
+    const RenderGraph::PassHandle blur = graph.addPass("blur", 0);
+    graph.read(blur, blurInput, ResourceStatePixelShaderResource);
+    graph.write(blur, blurred, ResourceStateRenderTarget);
+    // writes nothing, kept for its side effects
+    const RenderGraph::PassHandle readback = graph.addPass("readback", 0, true);
+    graph.read(readback, scene, ResourceStateCopySource);
+    // reads nothing and writes nothing anyone reads
+    const RenderGraph::PassHandle clear = graph.addPass("clear", 0);
+    graph.write(clear, unused, ResourceStateUnorderedAccess);
+    // writes a transient only the culled blur chain would read, and the back buffer
+    const RenderGraph::PassHandle compose = graph.addPass("compose", 0);
+    graph.read(compose, scene, ResourceStatePixelShaderResource);
+    graph.write(compose, counters, ResourceStateUnorderedAccess);
+    graph.write(compose, backBuffer, ResourceStateRenderTarget);
+
+    HDX_CHECK(graph.compile());
+    HDX_CHECK(!graph.isCulled(draw));
+    HDX_CHECK(graph.isCulled(downsample));
+    HDX_CHECK(graph.isCulled(blur));
+    HDX_CHECK(!graph.isCulled(readback));
+    HDX_CHECK(graph.isCulled(clear));
+    HDX_CHECK(!graph.isCulled(compose));
+    HDX_CHECK(graph.getStats().passes == 6);
+    HDX_CHECK(graph.getStats().culledPasses == 3);
+    HDX_CHECK(graph.getSchedule().size() == 3);
+
+    HDX_CHECK(graph.isPlaced(scene) && graph.isPlaced(counters));
+    HDX_CHECK(!graph.isPlaced(blurInput) && !graph.isPlaced(blurred) && !graph.isPlaced(unused));
+
+    // no barrier touches a culled resource
+    for (const Barrier& barrier : graph.getBarriers())
+    {
+        HDX_CHECK(barrier.resource != blurInput && barrier.resource != blurred && barrier.resource != unused);
+    }
+}
+
+static void testRejectsCommandListsOutOfOrder()
+{
+    RenderGraph graph;
+    const RenderGraph::ResourceHandle output = graph.importResource("output", ResourceStateCommon, ResourceStateCommon);
+    graph.write(graph.addPass("late", 1), output, ResourceStateRenderTarget);
+    graph.write(graph.addPass("early", 0), output, ResourceStateRenderTarget);
+    HDX_CHECK(!graph.compile());
+}
+
+// Random graphs: a chain of passes, each writing one transient and reading a few earlier ones, sizes and
+// alignments vary. Transients alive at the same time must not share memory, the lifetimes come from the
+// declarations and the schedule independently of the compiler.
+static void testTransientsDoNotOverlapWhileLive()
+{
+    std::mt19937 random(5);
+    RenderGraph graph;
+    uint32_t aliasedGraphs = 0;
+    for (int iteration = 0; iteration < 200; iteration++)
+    {
+        graph.reset();
+        const uint32_t passCount = 4 + random() % 20;
+        const RenderGraph::ResourceHandle output = graph.importResource("output", ResourceStatePresent, ResourceStatePresent);
+        std::vector<RenderGraph::ResourceHandle> transients;
+        std::vector<std::vector<RenderGraph::ResourceHandle>> uses(passCount);
+        for (uint32_t pass = 0; pass < passCount; pass++)
+        {
+            const RenderGraph::PassHandle handle = graph.addPass("pass", pass * 3 / passCount);
+            for (uint32_t read = 0; read < 2 && !transients.empty(); read++)
+            {
+                // mostly recent results, sometimes an old one to stretch its lifetime
+                const size_t back = random() % 4 == 0 ? random() % transients.size() : random() % std::min<size_t>(2, transients.size());
+                const RenderGraph::ResourceHandle resource = transients[transients.size() - 1 - back];
+                graph.read(handle, resource, random() % 2 ? ResourceStatePixelShaderResource : ResourceStateNonPixelShaderResource);
+                uses[pass].push_back(resource);
+            }
+
+            if (pass + 1 == passCount)
+            {
+                graph.write(handle, output, ResourceStateRenderTarget);
+                break;
+            }
+            const uint64_t alignment = 256ull << (random() % 9);
+            const RenderGraph::ResourceHandle resource = graph.createTransient("transient", makeDesc(4096 + random() % (4 << 20), alignment, random() % 2));
+            graph.write(handle, resource, random() % 2 ? ResourceStateRenderTarget : ResourceStateUnorderedAccess);
+            uses[pass].push_back(resource);
+            transients.push_back(resource);
+        }
+        HDX_CHECK(graph.compile());
+
+        std::vector<uint32_t> firstUse(graph.getResourceCount(), RenderGraph::InvalidHandle);
+        std::vector<uint32_t> lastUse(graph.getResourceCount(), RenderGraph::InvalidHandle);
+        for (uint32_t pass = 0; pass < passCount; pass++)
+        {
+            const uint32_t scheduled = findScheduled(graph, pass);
+            for (RenderGraph::ResourceHandle resource : uses[pass])
+            {
+                if (scheduled == RenderGraph::InvalidHandle)
+                {
+                    continue;
+                }
+                firstUse[resource] = std::min(firstUse[resource], scheduled);
+                lastUse[resource] = lastUse[resource] == RenderGraph::InvalidHandle ? scheduled : std::max(lastUse[resource], scheduled);
+            }
+        }
+
+        bool aliased = false;
+        for (RenderGraph::ResourceHandle a : transients)
+        {
+            HDX_CHECK(graph.isPlaced(a) == (firstUse[a] != RenderGraph::InvalidHandle));
+            if (!graph.isPlaced(a))
+            {
+                continue;
+            }
+
+            const RenderGraphResourceDesc& descA = graph.getDesc(a);
+            const uint64_t offsetA = graph.getTransientOffset(a);
+            HDX_CHECK(offsetA % descA.alignment == 0);
+            HDX_CHECK(offsetA + descA.size <= graph.getAliasGroupSize(descA.aliasGroup));
+            for (RenderGraph::ResourceHandle b : transients)
+            {
+                if (b <= a || !graph.isPlaced(b) || graph.getDesc(b).aliasGroup != descA.aliasGroup)
+                {
+                    continue;
+                }
+
+                const uint64_t offsetB = graph.getTransientOffset(b);
+                const bool sharesMemory = offsetA < offsetB + graph.getDesc(b).size && offsetB < offsetA + descA.size;
+                const bool live = firstUse[a] <= lastUse[b] && firstUse[b] <= lastUse[a];
+                HDX_CHECK(!(sharesMemory && live));
+                aliased |= sharesMemory;
+            }
+        }
+        aliasedGraphs += aliased ? 1 : 0;
+
+        // at worst every placed transient sits after the previous one, padded to its alignment
+        uint64_t packedBytes = 0;
+        for (RenderGraph::ResourceHandle resource : transients)
+        {
+            packedBytes += graph.isPlaced(resource) ? graph.getDesc(resource).size + graph.getDesc(resource).alignment - 1 : 0;
+        }
+        HDX_CHECK(graph.getStats().transientBytes <= packedBytes);
+    }
+    HDX_CHECK(aliasedGraphs > 100);
+}
+
+static void testAliasingBarriers()
+{
+    RenderGraph graph;
+    const RenderGraph::ResourceHandle output = graph.importResource("output", ResourceStatePresent, ResourceStatePresent);
+    const RenderGraph::ResourceHandle a = graph.createTransient("A", makeDesc(8 << 20));
+    const RenderGraph::ResourceHandle b = graph.createTransient("B", makeDesc(8 << 20));
+    const RenderGraph::ResourceHandle c = graph.createTransient("C", makeDesc(8 << 20));
+
+    const RenderGraph::PassHandle writeA = graph.addPass("write A", 0);
+    graph.write(writeA, a, ResourceStateRenderTarget);
+    const RenderGraph::PassHandle aToB = graph.addPass("A to B", 0);
+    graph.read(aToB, a, ResourceStatePixelShaderResource);
+    graph.write(aToB, b, ResourceStateRenderTarget);
+    const RenderGraph::PassHandle bToC = graph.addPass("B to C", 0);
+    graph.read(bToC, b, ResourceStatePixelShaderResource);
+    graph.write(bToC, c, ResourceStateRenderTarget);
+    const RenderGraph::PassHandle compose = graph.addPass("compose", 0);
+    graph.read(compose, c, ResourceStatePixelShaderResource);
+    graph.write(compose, output, ResourceStateRenderTarget);
+    HDX_CHECK(graph.compile());
+
+    // A is dead once C is written, C takes its memory
+    HDX_CHECK(graph.getTransientOffset(a) == graph.getTransientOffset(c));
+    HDX_CHECK(graph.getTransientOffset(a) != graph.getTransientOffset(b));
+    HDX_CHECK(graph.getStats().transientBytes == 16 << 20);
+    HDX_CHECK(graph.getStats().unaliasedBytes == 24 << 20);
+
+    // C is activated before its first use, after A went back to its initial state
+    const std::vector<Barrier> before = getBarriersBefore(graph, bToC);
+    bool activated = false;
+    for (const Barrier& barrier : before)
+    {
+        if (barrier.type == BarrierType::Aliasing && barrier.resource == c)
+        {
+            activated = barrier.aliasBefore == a;
+        }
+    }
+    HDX_CHECK(activated);
+    HDX_CHECK(graph.getStats().aliasingBarriers >= 2);
+
+    bool retired = false;
+    for (const Barrier& barrier : getBarriersAfter(graph, aToB))
+    {
+        retired |= isTransition(barrier, BarrierSplit::Full, a, ResourceStatePixelShaderResource, ResourceStateRenderTarget);
+    }
+    HDX_CHECK(retired);
+}
+
+static void testSplitBarrierPlacement()
+{
+    RenderGraph graph;
+    const RenderGraph::ResourceHandle output = graph.importResource("output", ResourceStatePresent, ResourceStatePresent);
+    const RenderGraph::ResourceHandle shadow = graph.createTransient("shadow", makeDesc(4 << 20));
+    const RenderGraph::ResourceHandle gbuffer = graph.createTransient("gbuffer", makeDesc(4 << 20));
+    const RenderGraph::ResourceHandle velocity = graph.createTransient("velocity", makeDesc(1 << 20));
+
+    // list 0: shadow, gbuffer, velocity, lighting; list 1: post
+    const RenderGraph::PassHandle shadowPass = graph.addPass("shadow", 0);
+    graph.write(shadowPass, shadow, ResourceStateDepthWrite);
+    const RenderGraph::PassHandle gbufferPass = graph.addPass("gbuffer", 0);
+    graph.write(gbufferPass, gbuffer, ResourceStateRenderTarget);
+    const RenderGraph::PassHandle velocityPass = graph.addPass("velocity", 0);
+    graph.write(velocityPass, velocity, ResourceStateRenderTarget);
+    const RenderGraph::PassHandle lighting = graph.addPass("lighting", 0);
+    graph.read(lighting, shadow, ResourceStatePixelShaderResource);
+    graph.read(lighting, gbuffer, ResourceStatePixelShaderResource);
+    graph.write(lighting, output, ResourceStateRenderTarget);
+    const RenderGraph::PassHandle post = graph.addPass("post", 1);
+    graph.read(post, velocity, ResourceStatePixelShaderResource);
+    graph.read(post, gbuffer, ResourceStateNonPixelShaderResource);
+    graph.write(post, output, ResourceStateRenderTarget);
+    HDX_CHECK(graph.compile());
+
+    // two passes between the shadow map write and its read: begin right after the write, end before the read
+    const uint32_t DepthWrite = ResourceStateDepthWrite;
+    const uint32_t PixelShaderResource = ResourceStatePixelShaderResource;
+    uint32_t shadowBegin = 0;
+    for (const Barrier& barrier : getBarriersAfter(graph, shadowPass))
+    {
+        shadowBegin += isTransition(barrier, BarrierSplit::Begin, shadow, DepthWrite, PixelShaderResource) ? 1 : 0;
+    }
+    uint32_t shadowEnd = 0;
+    uint32_t gbufferFull = 0;
+    for (const Barrier& barrier : getBarriersBefore(graph, lighting))
+    {
+        shadowEnd += isTransition(barrier, BarrierSplit::End, shadow, DepthWrite, PixelShaderResource) ? 1 : 0;
+        // velocity sits between gbuffer and lighting, the gbuffer transition is split too
+        gbufferFull += barrier.resource == gbuffer && barrier.split == BarrierSplit::End ? 1 : 0;
+    }
+    HDX_CHECK(shadowBegin == 1 && shadowEnd == 1);
+    HDX_CHECK(gbufferFull == 1);
+
+    // the next use is in another command list, a full barrier before it
+    uint32_t velocityFull = 0;
+    for (const Barrier& barrier : getBarriersBefore(graph, post))
+    {
+        velocityFull += isTransition(barrier, BarrierSplit::Full, velocity, ResourceStateRenderTarget, PixelShaderResource) ? 1 : 0;
+    }
+    HDX_CHECK(velocityFull == 1);
+    for (const Barrier& barrier : getBarriersAfter(graph, velocityPass))
+    {
+        HDX_CHECK(barrier.resource != velocity);
+    }
+
+    // the imported output goes back to present: begun after its last use, ended in the tail of that list
+    uint32_t outputBegin = 0;
+    for (const Barrier& barrier : getBarriersAfter(graph, post))
+    {
+        outputBegin += isTransition(barrier, BarrierSplit::Begin, output, ResourceStateRenderTarget, ResourceStatePresent) ? 1 : 0;
+    }
+    uint32_t outputEnd = 0;
+    for (const Barrier& barrier : getTail(graph, 1))
+    {
+        outputEnd += isTransition(barrier, BarrierSplit::End, output, ResourceStateRenderTarget, ResourceStatePresent) ? 1 : 0;
+    }
+    HDX_CHECK(outputBegin == 1 && outputEnd == 1);
+    // list 0 only ends the transients last used in it, back to their initial states
+    const std::vector<Barrier> tail = getTail(graph, 0);
+    HDX_CHECK(tail.size() == 1);
+    HDX_CHECK(isTransition(tail[0], BarrierSplit::End, shadow, PixelShaderResource, DepthWrite));
+
+    // every begin has exactly one matching end later on
+    const std::vector<Barrier>& barriers = graph.getBarriers();
+    uint32_t begins = 0;
+    for (const Barrier& barrier : barriers)
+    {
+        if (barrier.type != BarrierType::Transition || barrier.split != BarrierSplit::Begin)
+        {
+            continue;
+        }
+        begins++;
+        uint32_t ends = 0;
+        for (const Barrier& other : barriers)
+        {
+            ends += isTransition(other, BarrierSplit::End, barrier.resource, barrier.stateBefore, barrier.stateAfter) ? 1 : 0;
+        }
+        HDX_CHECK(ends == 1);
+    }
+    HDX_CHECK(begins == graph.getStats().splitBarriers);
+}
+
+static void testReadsMergeIntoOneState()
+{
+    RenderGraph graph;
+    const RenderGraph::ResourceHandle output = graph.importResource("output", ResourceStatePresent, ResourceStatePresent);
+    const RenderGraph::ResourceHandle depth = graph.createTransient("depth", makeDesc(4 << 20));
+
+    const RenderGraph::PassHandle prepass = graph.addPass("prepass", 0);
+    graph.write(prepass, depth, ResourceStateDepthWrite);
+    const RenderGraph::PassHandle culling = graph.addPass("culling", 0);
+    graph.read(culling, depth, ResourceStateNonPixelShaderResource);
+    graph.write(culling, output, ResourceStateUnorderedAccess);
+    const RenderGraph::PassHandle shading = graph.addPass("shading", 0);
+    graph.read(shading, depth, ResourceStatePixelShaderResource);
+    graph.read(shading, depth, ResourceStateDepthRead);
+    graph.write(shading, output, ResourceStateRenderTarget);
+    HDX_CHECK(graph.compile());
+
+    // one transition into the union of the reads before the first of them, none between them
+    const uint32_t combined = ResourceStateNonPixelShaderResource | ResourceStatePixelShaderResource | ResourceStateDepthRead;
+    uint32_t merged = 0;
+    for (const Barrier& barrier : getBarriersBefore(graph, culling))
+    {
+        merged += isTransition(barrier, BarrierSplit::Full, depth, ResourceStateDepthWrite, combined) ? 1 : 0;
+    }
+    HDX_CHECK(merged == 1);
+    for (const Barrier& barrier : getBarriersBefore(graph, shading))
+    {
+        HDX_CHECK(barrier.resource != depth);
+    }
+
+    // then back to the initial state at the end of the graph
+    HDX_CHECK(graph.getInitialState(depth) == ResourceStateDepthWrite);
+    uint32_t returned = 0;
+    for (const Barrier& barrier : getBarriersAfter(graph, shading))
+    {
+        returned += isTransition(barrier, BarrierSplit::Begin, depth, combined, ResourceStateDepthWrite) ? 1 : 0;
+    }
+    HDX_CHECK(returned == 1);
+    uint32_t transitions = 0;
+    for (const Barrier& barrier : graph.getBarriers())
+    {
+        transitions += barrier.resource == depth && barrier.type == BarrierType::Transition ? 1 : 0;
+    }
+    HDX_CHECK(transitions == 3);
+}
+
+int main()
+{
+    testCullsUnusedPasses();
+    testRejectsCommandListsOutOfOrder();
+    testTransientsDoNotOverlapWhileLive();
+    testAliasingBarriers();
+    testSplitBarrierPlacement();
+    testReadsMergeIntoOneState();
+    return HDX_TEST_RESULT();
+}
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include "ResourceStateTracker.h"
+#include "TestHarness.h"
+
+#include <vector>
+
+using namespace HDX;
+
+// arbitrary state bits, the tracker does not interpret them
+static const uint32_t Common{ 0x0 };
+static const uint32_t RenderTarget{ 0x4 };
+static const uint32_t DepthWrite{ 0x10 };
+static const uint32_t ShaderResource{ 0x80 };
+
+static const uint32_t All{ ResourceStateTracker::AllSubresources };
+
+static void testRedundantTransitionsAreDropped()
+{
+    ResourceStateTracker tracker;
+    std::vector<StateTransition> transitions;
+    const uint32_t buffer = tracker.track(1, DepthWrite);
+
+    tracker.transition(buffer, All, DepthWrite, transitions);
+    HDX_CHECK(transitions.empty());
+
+    tracker.transition(buffer, All, ShaderResource, transitions);
+    HDX_CHECK(transitions.size() == 1);
+    HDX_CHECK(transitions[0].stateBefore == DepthWrite && transitions[0].stateAfter == ShaderResource);
+    HDX_CHECK(transitions[0].split == TransitionSplit::Full);
+    HDX_CHECK(tracker.getState(buffer, All) == ShaderResource);
+
+    transitions.clear();
+    tracker.transition(buffer, All, ShaderResource, transitions);
+    HDX_CHECK(transitions.empty());
+}
+
+static void testSingleSubresourceIsWhole()
+{
+    ResourceStateTracker tracker;
+    std::vector<StateTransition> transitions;
+    const uint32_t texture = tracker.track(1, Common);
+
+    tracker.transition(texture, 0, RenderTarget, transitions);
+    HDX_CHECK(transitions.size() == 1 && transitions[0].subresource == All);
+    HDX_CHECK(tracker.isUniform(texture));
+}
+
+static void testSubresourcesDivergeAndFold()
+{
+    ResourceStateTracker tracker;
+    std::vector<StateTransition> transitions;
+    const uint32_t texture = tracker.track(6, ShaderResource);
+
+    tracker.transition(texture, 2, DepthWrite, transitions);
+    HDX_CHECK(transitions.size() == 1 && transitions[0].subresource == 2);
+    HDX_CHECK(!tracker.isUniform(texture));
+    HDX_CHECK(tracker.getState(texture, 2) == DepthWrite);
+    HDX_CHECK(tracker.getState(texture, 3) == ShaderResource);
+
+    // the whole resource moves every subresource not already there, one transition each
+    transitions.clear();
+    tracker.transition(texture, All, DepthWrite, transitions);
+    HDX_CHECK(transitions.size() == 5);
+    for (const StateTransition& transition : transitions)
+    {
+        HDX_CHECK(transition.subresource != 2);
+        HDX_CHECK(transition.stateBefore == ShaderResource && transition.stateAfter == DepthWrite);
+    }
+    HDX_CHECK(tracker.isUniform(texture));
+
+    // moving each subresource in turn folds back into one state once they all agree
+    transitions.clear();
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        tracker.transition(texture, i, RenderTarget, transitions);
+        HDX_CHECK(tracker.isUniform(texture) == (i == 5));
+    }
+    HDX_CHECK(transitions.size() == 6);
+    HDX_CHECK(tracker.getState(texture, 4) == RenderTarget);
+}
+
+static void testSplitTransition()
+{
+    ResourceStateTracker tracker;
+    std::vector<StateTransition> transitions;
+    const uint32_t shadowMap = tracker.track(1, ShaderResource);
+
+    tracker.beginTransition(shadowMap, All, DepthWrite, transitions);
+    HDX_CHECK(transitions.size() == 1 && transitions[0].split == TransitionSplit::Begin);
+    // the state only changes once the split ends
+    HDX_CHECK(tracker.getState(shadowMap, All) == ShaderResource);
+    HDX_CHECK(tracker.hasPending(shadowMap, All));
+    HDX_CHECK(tracker.getPendingCount() == 1);
+
+    transitions.clear();
+    tracker.endTransition(shadowMap, All, transitions);
+    HDX_CHECK(transitions.size() == 1 && transitions[0].split == TransitionSplit::End);
+    HDX_CHECK(transitions[0].stateBefore == ShaderResource && transitions[0].stateAfter == DepthWrite);
+    HDX_CHECK(tracker.getState(shadowMap, All) == DepthWrite);
+    HDX_CHECK(tracker.getPendingCount() == 0);
+
+    // a split already in the target state records nothing and leaves nothing pending
+    transitions.clear();
+    tracker.beginTransition(shadowMap, All, DepthWrite, transitions);
+    HDX_CHECK(transitions.empty() && tracker.getPendingCount() == 0);
+}
+
+static void testTransitionEndsOverlappingSplit()
+{
+    ResourceStateTracker tracker;
+    std::vector<StateTransition> transitions;
+    const uint32_t texture = tracker.track(1, DepthWrite);
+
+    tracker.beginTransition(texture, All, ShaderResource, transitions);
+    tracker.transition(texture, All, RenderTarget, transitions);
+    HDX_CHECK(transitions.size() == 3);
+    HDX_CHECK(transitions[1].split == TransitionSplit::End && transitions[1].stateAfter == ShaderResource);
+    HDX_CHECK(transitions[2].split == TransitionSplit::Full && transitions[2].stateBefore == ShaderResource);
+    HDX_CHECK(tracker.getPendingCount() == 0);
+    HDX_CHECK(tracker.getState(texture, All) == RenderTarget);
+}
+
+static void testSplitOverDivergedSubresources()
+{
+    ResourceStateTracker tracker;
+    std::vector<StateTransition> transitions;
+    const uint32_t texture = tracker.track(6, DepthWrite);
+
+    tracker.transition(texture, 1, ShaderResource, transitions);
+    transitions.clear();
+    tracker.beginTransition(texture, All, ShaderResource, transitions);
+    HDX_CHECK(transitions.size() == 5);
+    HDX_CHECK(tracker.getPendingCount() == 5);
+    HDX_CHECK(tracker.hasPending(texture, 0) && !tracker.hasPending(texture, 1));
+
+    // ending with another subresource argument than the one begun with ends nothing
+    transitions.clear();
+    tracker.endTransition(texture, 0, transitions);
+    HDX_CHECK(transitions.empty());
+
+    tracker.endTransition(texture, All, transitions);
+    HDX_CHECK(transitions.size() == 5);
+    HDX_CHECK(tracker.isUniform(texture));
+    HDX_CHECK(tracker.getState(texture, 3) == ShaderResource);
+}
+
+static void testReset()
+{
+    ResourceStateTracker tracker;
+    std::vector<StateTransition> transitions;
+    tracker.track(1, Common);
+    const uint32_t texture = tracker.track(4, Common);
+    tracker.beginTransition(texture, 2, RenderTarget, transitions);
+
+    tracker.reset();
+    HDX_CHECK(tracker.getResourceCount() == 0);
+    HDX_CHECK(tracker.getPendingCount() == 0);
+    HDX_CHECK(tracker.track(1, Common) == 0);
+}
+
+int main()
+{
+    testRedundantTransitionsAreDropped();
+    testSingleSubresourceIsWhole();
+    testSubresourcesDivergeAndFold();
+    testSplitTransition();
+    testTransitionEndsOverlappingSplit();
+    testSplitOverDivergedSubresources();
+    testReset();
+    return HDX_TEST_RESULT();
+}
@@ -0,0 +1,126 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace HDX;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static const uint32_t NodeCount{ 100000 };
+// children per node, the tree is about 9 levels deep
+static const uint32_t Branching{ 4 };
+static const int Repeats{ 50 };
+
+static void makeLocal(std::mt19937& random, float* m)
+{
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+    const float angle = distribution(random) * 3.f;
+    const float local[16] = {
+        std::cos(angle), 0.f, -std::sin(angle), 0.f,
+        0.f, 1.f, 0.f, 0.f,
+        std::sin(angle), 0.f, std::cos(angle), 0.f,
+        distribution(random), distribution(random), distribution(random), 1.f
+    };
+    std::copy(local, local + 16, m);
+}
+
+static double getMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Nodes created breadth first, so the order goes stale and the first update rebuilds it.
+static void build(SceneGraph& graph, std::vector<SceneGraph::NodeId>& nodes, std::mt19937& random)
+{
+    nodes.clear();
+    for (uint32_t i = 0; i < NodeCount; i++)
+    {
+        const SceneGraph::NodeId parent = i == 0 ? SceneGraph::InvalidNode : nodes[(i - 1) / Branching];
+        nodes.push_back(graph.createNode(parent));
+        float local[16];
+        makeLocal(random, local);
+        graph.setLocal(nodes.back(), local);
+    }
+}
+
+// Best of Repeats updates, after dirtying the nodes picked by touch.
+template <typename Touch>
+static void measureUpdate(const char* name, SceneGraph& graph, Touch&& touch)
+{
+    double best = 1e9;
+    for (int repeat = 0; repeat < Repeats; repeat++)
+    {
+        touch();
+        const Clock::time_point start = Clock::now();
+        graph.update();
+        best = std::min(best, getMs(start));
+    }
+    printf("%-24s %8.3f ms, %6u nodes updated in %u subtrees\n", name, best, graph.getStats().updatedNodes, graph.getStats().dirtySubtrees);
+}
+
+int main()
+{
+    std::mt19937 random(1);
+    SceneGraph graph;
+    std::vector<SceneGraph::NodeId> nodes;
+
+    Clock::time_point start = Clock::now();
+    build(graph, nodes, random);
+    const double buildMs = getMs(start);
+    start = Clock::now();
+    graph.update();
+    printf("%u nodes, %u children per node\n", NodeCount, Branching);
+    printf("%-24s %8.3f ms\n", "create", buildMs);
+    printf("%-24s %8.3f ms, rebuilt %d\n", "first update", getMs(start), graph.getStats().rebuilt ? 1 : 0);
+
+    float local[16];
+    makeLocal(random, local);
+    const uint32_t firstLeaf = (NodeCount - 1) / Branching + 1;
+    measureUpdate("clean", graph, []() {});
+    measureUpdate("1% of the leaves", graph, [&]()
+    {
+        for (uint32_t i = 0; i < NodeCount / 100; i++)
+        {
+            graph.setLocal(nodes[firstLeaf + random() % (NodeCount - firstLeaf)], local);
+        }
+    });
+    measureUpdate("1% of the nodes", graph, [&]()
+    {
+        for (uint32_t i = 0; i < NodeCount / 100; i++)
+        {
+            graph.setLocal(nodes[1 + random() % (NodeCount - 1)], local);
+        }
+    });
+    measureUpdate("root", graph, [&]() { graph.setLocal(nodes[0], local); });
+    measureUpdate("reparent and rebuild", graph, [&]()
+    {
+        const SceneGraph::NodeId leaf = nodes[NodeCount - 1];
+        graph.setParent(leaf, graph.getParent(leaf) == nodes[1] ? nodes[2] : nodes[1]);
+    });
+
+    // teardown in creation order, every destroyed node hands its children to its parent
+    start = Clock::now();
+    for (SceneGraph::NodeId node : nodes)
+    {
+        graph.destroyNode(node);
+    }
+    graph.update();
+    printf("%-24s %8.3f ms, %u nodes left\n", "destroy all", getMs(start), graph.getNodeCount());
+
+    // teardown leaves first
+    build(graph, nodes, random);
+    graph.update();
+    start = Clock::now();
+    for (size_t i = nodes.size(); i-- > 0;)
+    {
+        graph.destroyNode(nodes[i]);
+    }
+    graph.update();
+    printf("%-24s %8.3f ms, %u nodes left\n", "destroy all, leaves first", getMs(start), graph.getNodeCount());
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,201 @@
+#include "SceneGraph.h"
+#include "TestHarness.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace HDX;
+
+static void multiply(const float* a, const float* b, float* result)
+{
+    for (int row = 0; row < 4; row++)
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            float sum = 0.f;
+            for (int k = 0; k < 4; k++)
+            {
+                sum += a[row * 4 + k] * b[k * 4 + column];
+            }
+            result[row * 4 + column] = sum;
+        }
+    }
+}
+
+static void makeTranslation(float x, float y, float z, float* m)
+{
+    const float translation[16] = {
+        1.f, 0.f, 0.f, 0.f,
+        0.f, 1.f, 0.f, 0.f,
+        0.f, 0.f, 1.f, 0.f,
+        x, y, z, 1.f
+    };
+    for (int i = 0; i < 16; i++)
+    {
+        m[i] = translation[i];
+    }
+}
+
+static void makeLocal(std::mt19937& random, float* m)
+{
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+    makeTranslation(distribution(random), distribution(random), distribution(random), m);
+    const float angle = distribution(random) * 3.f;
+    m[0] = std::cos(angle);
+    m[2] = -std::sin(angle);
+    m[8] = std::sin(angle);
+    m[10] = std::cos(angle);
+}
+
+// world matrix walking the parents, without the depth first arrays
+static void getReferenceWorld(const SceneGraph& graph, SceneGraph::NodeId node, float* world)
+{
+    const SceneGraph::NodeId parent = graph.getParent(node);
+    if (parent == SceneGraph::InvalidNode)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            world[i] = graph.getLocal(node)[i];
+        }
+        return;
+    }
+    float parentWorld[16];
+    getReferenceWorld(graph, parent, parentWorld);
+    multiply(graph.getLocal(node), parentWorld, world);
+}
+
+static bool matchesReference(const SceneGraph& graph, SceneGraph::NodeId node)
+{
+    float world[16];
+    getReferenceWorld(graph, node, world);
+    for (int i = 0; i < 16; i++)
+    {
+        if (std::fabs(world[i] - graph.getWorld(node)[i]) > 1e-3f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void testDestroyMovesChildrenUp()
+{
+    SceneGraph graph;
+    float m[16];
+    const SceneGraph::NodeId root = graph.createNode();
+    const SceneGraph::NodeId middle = graph.createNode(root);
+    const SceneGraph::NodeId first = graph.createNode(middle);
+    const SceneGraph::NodeId second = graph.createNode(middle);
+    const SceneGraph::NodeId sibling = graph.createNode(root);
+    makeTranslation(1.f, 0.f, 0.f, m);
+    graph.setLocal(root, m);
+    makeTranslation(0.f, 2.f, 0.f, m);
+    graph.setLocal(middle, m);
+    makeTranslation(0.f, 0.f, 3.f, m);
+    graph.setLocal(first, m);
+    graph.update();
+    HDX_CHECK(graph.getWorld(first)[12] == 1.f && graph.getWorld(first)[13] == 2.f && graph.getWorld(first)[14] == 3.f);
+
+    graph.destroyNode(middle);
+    HDX_CHECK(graph.getParent(first) == root);
+    HDX_CHECK(graph.getParent(second) == root);
+    HDX_CHECK(graph.getParent(sibling) == root);
+    graph.update();
+    HDX_CHECK(graph.getNodeCount() == 4);
+    // the children keep their local transforms, the one of the destroyed node is gone
+    HDX_CHECK(graph.getWorld(first)[12] == 1.f && graph.getWorld(first)[13] == 0.f && graph.getWorld(first)[14] == 3.f);
+    HDX_CHECK(graph.isUpdated(first) && graph.isUpdated(second));
+
+    // destroying a root turns its children into roots
+    graph.destroyNode(root);
+    HDX_CHECK(graph.getParent(first) == SceneGraph::InvalidNode);
+    HDX_CHECK(graph.getParent(second) == SceneGraph::InvalidNode);
+    HDX_CHECK(graph.getParent(sibling) == SceneGraph::InvalidNode);
+    graph.update();
+    HDX_CHECK(graph.getNodeCount() == 3);
+    HDX_CHECK(graph.getWorld(first)[12] == 0.f && graph.getWorld(first)[14] == 3.f);
+}
+
+static void testReusedHandleHasNoChildren()
+{
+    SceneGraph graph;
+    const SceneGraph::NodeId parent = graph.createNode();
+    const SceneGraph::NodeId child = graph.createNode(parent);
+    graph.destroyNode(parent);
+
+    const SceneGraph::NodeId reused = graph.createNode();
+    HDX_CHECK(reused == parent);
+    HDX_CHECK(graph.getParent(child) == SceneGraph::InvalidNode);
+
+    // the old child must not move with the new node
+    graph.destroyNode(reused);
+    HDX_CHECK(graph.getParent(child) == SceneGraph::InvalidNode);
+    graph.update();
+    HDX_CHECK(graph.getNodeCount() == 1);
+}
+
+// Random creation, destruction, reparenting and transform changes, checked against walking the parents.
+static void testRandomEdits()
+{
+    std::mt19937 random(1);
+    SceneGraph graph;
+    std::vector<SceneGraph::NodeId> alive;
+    uint32_t mismatches = 0;
+    for (int step = 0; step < 3000; step++)
+    {
+        const uint32_t operation = random() % 10;
+        float local[16];
+        if (operation < 4 || alive.empty())
+        {
+            const SceneGraph::NodeId parent = alive.empty() || random() % 4 == 0 ? SceneGraph::InvalidNode : alive[random() % alive.size()];
+            alive.push_back(graph.createNode(parent));
+            makeLocal(random, local);
+            graph.setLocal(alive.back(), local);
+        }
+        else if (operation < 5)
+        {
+            const size_t victim = random() % alive.size();
+            graph.destroyNode(alive[victim]);
+            alive.erase(alive.begin() + victim);
+        }
+        else if (operation < 6)
+        {
+            const SceneGraph::NodeId node = alive[random() % alive.size()];
+            const SceneGraph::NodeId parent = alive[random() % alive.size()];
+            bool cycle = false;
+            for (SceneGraph::NodeId ancestor = parent; ancestor != SceneGraph::InvalidNode; ancestor = graph.getParent(ancestor))
+            {
+                cycle = cycle || ancestor == node;
+            }
+            if (!cycle)
+            {
+                graph.setParent(node, parent);
+            }
+        }
+        else
+        {
+            makeLocal(random, local);
+            graph.setLocal(alive[random() % alive.size()], local);
+        }
+
+        if (random() % 3 == 0)
+        {
+            graph.update();
+            HDX_CHECK(graph.getNodeCount() == alive.size());
+            for (SceneGraph::NodeId node : alive)
+            {
+                mismatches += matchesReference(graph, node) ? 0 : 1;
+            }
+        }
+    }
+    HDX_CHECK(mismatches == 0);
+}
+
+int main()
+{
+    testDestroyMovesChildrenUp();
+    testReusedHandleHasNoChildren();
+    testRandomEdits();
+    return HDX_TEST_RESULT();
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "ShaderPermutation.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace HDX;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static const uint32_t LookupCount{ 100000000 };
+static const uint32_t BuildRepeats{ 1000 };
+
+struct Variant
+{
+    ShaderVariantKey key;
+};
+
+static std::unique_ptr<Variant> makeVariant(ShaderVariantKey key)
+{
+    return std::unique_ptr<Variant>(new Variant{ key });
+}
+
+// random keys from a linear congruential generator, cheap next to the lookup
+static ShaderVariantKey nextKey(uint32_t& state)
+{
+    state = state * 1664525u + 1013904223u;
+    return (state >> 28) & ShaderFeatureMask;
+}
+
+static double getNsPer(Clock::time_point start, uint64_t count)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / static_cast<double>(count);
+}
+
+int main()
+{
+    VariantTable<Variant> table(ShaderFeatureCount);
+    for (ShaderVariantKey key = 0; key <= ShaderFeatureMask; key++)
+    {
+        table.resolve(key, makeVariant);
+    }
+
+    uint32_t state = 1;
+    uint64_t sum = 0;
+    Clock::time_point start = Clock::now();
+    for (uint32_t i = 0; i < LookupCount; i++)
+    {
+        sum += table.find(nextKey(state))->key;
+    }
+    printf("%-36s %6.2f ns\n", "find, random keys", getNsPer(start, LookupCount));
+
+    start = Clock::now();
+    for (uint32_t i = 0; i < LookupCount; i++)
+    {
+        sum += table.resolve(nextKey(state), [](ShaderVariantKey) { return std::unique_ptr<Variant>(); })->key;
+    }
+    printf("%-36s %6.2f ns\n", "resolve, variant exists", getNsPer(start, LookupCount));
+
+    // cold tables, the creation itself is only an allocation here, so this is the table's overhead plus starting
+    // the threads
+    for (uint32_t threadCount = 1; threadCount <= 4; threadCount *= 2)
+    {
+        double ns = 0.;
+        size_t variants = 0;
+        for (uint32_t repeat = 0; repeat < BuildRepeats; repeat++)
+        {
+            VariantTable<Variant> cold(ShaderFeatureCount);
+            start = Clock::now();
+            std::vector<std::thread> threads;
+            for (uint32_t thread = 0; thread < threadCount; thread++)
+            {
+                threads.emplace_back([&cold, thread]()
+                {
+                    for (ShaderVariantKey i = 0; i <= ShaderFeatureMask; i++)
+                    {
+                        cold.resolve((thread & 1) ? ShaderFeatureMask - i : i, makeVariant);
+                    }
+                });
+            }
+            for (std::thread& thread : threads)
+            {
+                thread.join();
+            }
+            ns += getNsPer(start, 1);
+            variants = cold.getVariantCount();
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "build all keys, %u thread(s)", threadCount);
+        printf("%-36s %6.2f us, %zu variants\n", name, ns / BuildRepeats / 1000., variants);
+    }
+    printf("(checksum %llu)\n", static_cast<unsigned long long>(sum));
+    return 0;
+}
\ No newline at end of file
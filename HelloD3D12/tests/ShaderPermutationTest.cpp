@@ -0,0 +1,151 @@
+#include "ShaderPermutation.h"
+#include "TestHarness.h"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace HDX;
+
+struct Variant
+{
+    ShaderVariantKey key;
+};
+
+static std::unique_ptr<Variant> makeVariant(ShaderVariantKey key)
+{
+    return std::unique_ptr<Variant>(new Variant{ key });
+}
+
+static void testFeatureDefines()
+{
+    HDX_CHECK(strcmp(getShaderFeatureDefine(ShaderFeatureShadows), "SHADOWS") == 0);
+    HDX_CHECK(strcmp(getShaderFeatureDefine(ShaderFeatureAlphaTest), "ALPHA_TEST") == 0);
+    HDX_CHECK(strcmp(getShaderFeatureDefine(ShaderFeatureInstancing), "INSTANCING") == 0);
+    HDX_CHECK(strcmp(getShaderFeatureDefine(ShaderFeatureQuantizedVertices), "QUANTIZED_VERTICES") == 0);
+    HDX_CHECK(getShaderFeatureDefine(0) == nullptr);
+    HDX_CHECK(getShaderFeatureDefine(ShaderFeatureShadows | ShaderFeatureAlphaTest) == nullptr);
+
+    HDX_CHECK(describeShaderVariant(0) == "none");
+    HDX_CHECK(describeShaderVariant(ShaderFeatureShadows | ShaderFeatureQuantizedVertices) == "SHADOWS|QUANTIZED_VERTICES");
+    HDX_CHECK(ShaderFeatureMask == 0xf);
+}
+
+// Every key of the four features resolves to its own variant, built once.
+static void testEveryKeyResolves()
+{
+    VariantTable<Variant> table(ShaderFeatureCount);
+    HDX_CHECK(table.getCapacity() == 16);
+
+    uint32_t created = 0;
+    auto create = [&created](ShaderVariantKey key)
+    {
+        created++;
+        return makeVariant(key);
+    };
+    for (ShaderVariantKey key = 0; key <= ShaderFeatureMask; key++)
+    {
+        HDX_CHECK(table.find(key) == nullptr);
+        Variant* variant = table.resolve(key, create);
+        HDX_CHECK(variant != nullptr && variant->key == key);
+        HDX_CHECK(table.find(key) == variant);
+        HDX_CHECK(table.resolve(key, create) == variant);
+    }
+    HDX_CHECK(created == 16);
+    HDX_CHECK(table.getVariantCount() == 16);
+
+    const ShaderVariantKey quantized = ShaderFeatureShadows | ShaderFeatureInstancing | ShaderFeatureQuantizedVertices;
+    HDX_CHECK(table.find(quantized) != nullptr && table.find(quantized)->key == quantized);
+
+    // out of range keys never create anything
+    HDX_CHECK(table.find(ShaderFeatureMask + 1) == nullptr);
+    HDX_CHECK(table.resolve(ShaderFeatureMask + 1, create) == nullptr);
+    HDX_CHECK(created == 16);
+}
+
+// SimpleShader keys each stage on the features it reads, quantized vertices only change the input layout, so a
+// quantized pipeline reuses the bytecode of its float counterpart.
+static void testStagesShareBytecode()
+{
+    const ShaderVariantKey vertexFeatures = ShaderFeatureShadows | ShaderFeatureInstancing;
+    const ShaderVariantKey pixelFeatures = ShaderFeatureShadows | ShaderFeatureAlphaTest;
+
+    VariantTable<Variant> vertexShaders(ShaderFeatureCount);
+    VariantTable<Variant> pixelShaders(ShaderFeatureCount);
+    VariantTable<Variant> pipelines(ShaderFeatureCount);
+    for (ShaderVariantKey key = 0; key <= ShaderFeatureMask; key++)
+    {
+        Variant* pipeline = pipelines.resolve(key, [&](ShaderVariantKey pipelineKey)
+        {
+            const bool built = vertexShaders.resolve(pipelineKey & vertexFeatures, makeVariant) != nullptr &&
+                pixelShaders.resolve(pipelineKey & pixelFeatures, makeVariant) != nullptr;
+            return built ? makeVariant(pipelineKey) : nullptr;
+        });
+        HDX_CHECK(pipeline != nullptr);
+    }
+    HDX_CHECK(pipelines.getVariantCount() == 16);
+    HDX_CHECK(vertexShaders.getVariantCount() == 4);
+    HDX_CHECK(pixelShaders.getVariantCount() == 4);
+}
+
+static void testFailedVariantIsRetried()
+{
+    VariantTable<Variant> table(ShaderFeatureCount);
+    const ShaderVariantKey key = ShaderFeatureQuantizedVertices;
+    HDX_CHECK(table.resolve(key, [](ShaderVariantKey) { return std::unique_ptr<Variant>(); }) == nullptr);
+    HDX_CHECK(table.getFailedCount() == 1);
+    HDX_CHECK(table.find(key) == nullptr);
+
+    Variant* variant = table.resolve(key, makeVariant);
+    HDX_CHECK(variant != nullptr && variant->key == key);
+    HDX_CHECK(table.getVariantCount() == 1);
+}
+
+// Threads racing for the same keys all get the one published variant.
+static void testRacingThreadsShareVariants()
+{
+    VariantTable<Variant> table(ShaderFeatureCount);
+    std::atomic<uint32_t> created{ 0 };
+    std::vector<std::vector<Variant*>> results(4, std::vector<Variant*>(16));
+    std::vector<std::thread> threads;
+    for (uint32_t thread = 0; thread < 4; thread++)
+    {
+        threads.emplace_back([&table, &created, &results, thread]()
+        {
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                const ShaderVariantKey key = (thread & 1) ? 15 - i : i;
+                results[thread][key] = table.resolve(key, [&created](ShaderVariantKey variantKey)
+                {
+                    created++;
+                    return makeVariant(variantKey);
+                });
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    HDX_CHECK(table.getVariantCount() == 16);
+    HDX_CHECK(created >= 16);
+    for (ShaderVariantKey key = 0; key < 16; key++)
+    {
+        for (uint32_t thread = 0; thread < 4; thread++)
+        {
+            HDX_CHECK(results[thread][key] == table.find(key));
+        }
+    }
+}
+
+int main()
+{
+    testFeatureDefines();
+    testEveryKeyResolves();
+    testStagesShareBytecode();
+    testFailedVariantIsRetried();
+    testRacingThreadsShareVariants();
+    return HDX_TEST_RESULT();
+}
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "ShadowCascades.h"
+#include "TestHarness.h"
+
+#include <cmath>
+#include <random>
+
+using namespace HDX;
+
+static const float FovY{ 0.785f };
+static const float AspectRatio{ 16.f / 9.f };
+static const uint32_t Resolution{ 2048 };
+static const Float3 LightDirection{ -2.f, -2.f, 2.f };
+
+static Float3 normalize(const Float3& v)
+{
+    const float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+    return { v.x / length, v.y / length, v.z / length };
+}
+
+static Float3 cross(const Float3& a, const Float3& b)
+{
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+static float dot(const Float3& a, const Float3& b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// XMMatrixLookAtLH
+static void lookAt(const Float3& eye, const Float3& at, float* view)
+{
+    const Float3 forward = normalize({ at.x - eye.x, at.y - eye.y, at.z - eye.z });
+    const Float3 right = normalize(cross({ 0.f, 1.f, 0.f }, forward));
+    const Float3 up = cross(forward, right);
+    const float m[16] = {
+        right.x, up.x, forward.x, 0.f,
+        right.y, up.y, forward.y, 0.f,
+        right.z, up.z, forward.z, 0.f,
+        -dot(right, eye), -dot(up, eye), -dot(forward, eye), 1.f
+    };
+    for (int i = 0; i < 16; i++)
+    {
+        view[i] = m[i];
+    }
+}
+
+static void transform(const float* m, const Float3& p, float* clip)
+{
+    for (int column = 0; column < 4; column++)
+    {
+        clip[column] = p.x * m[column] + p.y * m[4 + column] + p.z * m[8 + column] + m[12 + column];
+    }
+}
+
+// inverse of the rigid view matrix
+static Float3 viewToWorld(const float* view, const Float3& p)
+{
+    const Float3 q{ p.x - view[12], p.y - view[13], p.z - view[14] };
+    return {
+        q.x * view[0] + q.y * view[1] + q.z * view[2],
+        q.x * view[4] + q.y * view[5] + q.z * view[6],
+        q.x * view[8] + q.y * view[9] + q.z * view[10]
+    };
+}
+
+static void testSplits()
+{
+    float splits[ShadowCascades::MaxCascades + 1];
+
+    ShadowCascades::computeSplits(1.f, 16.f, 4, 1.f, splits);
+    const float logarithmic[] = { 1.f, 2.f, 4.f, 8.f, 16.f };
+    for (uint32_t i = 0; i <= 4; i++)
+    {
+        HDX_CHECK_NEAR(splits[i], logarithmic[i], 1e-4f);
+    }
+
+    ShadowCascades::computeSplits(1.f, 16.f, 4, 0.f, splits);
+    const float uniform[] = { 1.f, 4.75f, 8.5f, 12.25f, 16.f };
+    for (uint32_t i = 0; i <= 4; i++)
+    {
+        HDX_CHECK_NEAR(splits[i], uniform[i], 1e-4f);
+    }
+
+    // the practical scheme lies between the two
+    ShadowCascades::computeSplits(1.f, 16.f, 4, 0.75f, splits);
+    HDX_CHECK(splits[0] == 1.f && splits[4] == 16.f);
+    for (uint32_t i = 1; i < 4; i++)
+    {
+        HDX_CHECK(splits[i] > logarithmic[i] && splits[i] < uniform[i]);
+        HDX_CHECK(splits[i] > splits[i - 1]);
+    }
+
+    ShadowCascades::computeSplits(0.1f, 100.f, 1, 0.75f, splits);
+    HDX_CHECK(splits[0] == 0.1f && splits[1] == 100.f);
+}
+
+// Every corner of each camera frustum slice is inside its cascade and its clipped camera frustum, and the cascade
+// size does not depend on where the camera looks.
+static void testCascadesCoverTheirSlice()
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(-10.f, 10.f);
+    const float tanY = std::tan(FovY * 0.5f);
+    const float tanX = tanY * AspectRatio;
+
+    uint32_t outsideCascade = 0;
+    uint32_t outsideFrustum = 0;
+    uint32_t radiusChanges = 0;
+    float radius[ShadowCascades::MaxCascades]{};
+    for (int iteration = 0; iteration < 200; iteration++)
+    {
+        const Float3 eye{ position(random), position(random) * 0.3f + 3.f, position(random) };
+        const Float3 at{ position(random), 0.f, position(random) };
+        if (std::fabs(eye.x - at.x) + std::fabs(eye.z - at.z) < 0.5f)
+        {
+            continue;
+        }
+
+        float view[16];
+        lookAt(eye, at, view);
+        ShadowCascades cascades;
+        cascades.fit({ view, FovY, AspectRatio, 0.1f, 100.f }, LightDirection, 4, 0.75f, Resolution);
+        HDX_CHECK(cascades.getCount() == 4);
+
+        for (uint32_t i = 0; i < cascades.getCount(); i++)
+        {
+            const ShadowCascades::Cascade& cascade = cascades.getCascade(i);
+            if (radius[i] > 0.f && std::fabs(cascade.radius - radius[i]) > 1e-4f * radius[i])
+            {
+                radiusChanges++;
+            }
+            radius[i] = cascade.radius;
+
+            for (int corner = 0; corner < 8; corner++)
+            {
+                const float z = (corner & 4) ? cascade.splitFar : cascade.splitNear;
+                const Float3 p = viewToWorld(view, { (corner & 1 ? z : -z) * tanX, (corner & 2 ? z : -z) * tanY, z });
+
+                float clip[4];
+                transform(cascade.viewProj, p, clip);
+                if (std::fabs(clip[0]) > 1.0001f || std::fabs(clip[1]) > 1.0001f || clip[2] < -1e-4f || clip[2] > 1.0001f)
+                {
+                    outsideCascade++;
+                }
+                for (const Plane& plane : cascade.cameraFrustum.planes)
+                {
+                    if (dot(plane.normal, p) + plane.distance < -1e-3f)
+                    {
+                        outsideFrustum++;
+                    }
+                }
+            }
+        }
+    }
+    HDX_CHECK(outsideCascade == 0);
+    HDX_CHECK(outsideFrustum == 0);
+    HDX_CHECK(radiusChanges == 0);
+}
+
+// Moving the camera moves the cascades by whole texels, so a fixed world point lands on the same texel grid.
+static void testCenterSnapsToTexels()
+{
+    std::mt19937 random(2);
+    std::uniform_real_distribution<float> position(-10.f, 10.f);
+    std::uniform_real_distribution<float> offset(-0.05f, 0.05f);
+
+    uint32_t offGrid = 0;
+    for (int iteration = 0; iteration < 200; iteration++)
+    {
+        const Float3 eye{ position(random), 3.f, position(random) };
+        const Float3 at{ eye.x + 5.f, 0.f, eye.z + 3.f };
+        const Float3 move{ offset(random), 0.f, offset(random) };
+
+        float view[16];
+        float movedView[16];
+        lookAt(eye, at, view);
+        lookAt({ eye.x + move.x, eye.y, eye.z + move.z }, { at.x + move.x, at.y, at.z + move.z }, movedView);
+
+        ShadowCascades cascades;
+        ShadowCascades moved;
+        cascades.fit({ view, FovY, AspectRatio, 0.1f, 100.f }, LightDirection, 4, 0.75f, Resolution);
+        moved.fit({ movedView, FovY, AspectRatio, 0.1f, 100.f }, LightDirection, 4, 0.75f, Resolution);
+
+        const Float3 point{ 1.234f, 0.5f, -2.345f };
+        for (uint32_t i = 0; i < cascades.getCount(); i++)
+        {
+            float before[4];
+            float after[4];
+            transform(cascades.getCascade(i).viewProj, point, before);
+            transform(moved.getCascade(i).viewProj, point, after);
+            for (int axis = 0; axis < 2; axis++)
+            {
+                const double texels = (before[axis] - after[axis]) * 0.5 * Resolution;
+                if (std::fabs(texels - std::round(texels)) > 2e-2)
+                {
+                    offGrid++;
+                }
+            }
+        }
+    }
+    HDX_CHECK(offGrid == 0);
+}
+
+static void testTexelSize()
+{
+    float view[16];
+    lookAt({ 4.f, 4.f, 4.f }, { 0.f, 0.f, 0.f }, view);
+    ShadowCascades cascades;
+    cascades.fit({ view, FovY, AspectRatio, 0.1f, 10.f }, LightDirection, 4, 0.75f, Resolution);
+
+    for (uint32_t i = 0; i < cascades.getCount(); i++)
+    {
+        const ShadowCascades::Cascade& cascade = cascades.getCascade(i);
+        // one texel of margin on each side for the snapping
+        HDX_CHECK_NEAR(cascade.texelSize * (Resolution - 2), 2.f * cascade.radius, 1e-4f * cascade.radius);
+        HDX_CHECK_NEAR(cascade.lightFarZ - cascade.lightNearZ, 2.f * cascade.radius, 1e-4f * cascade.radius);
+        if (i > 0)
+        {
+            HDX_CHECK(cascade.splitNear == cascades.getCascade(i - 1).splitFar);
+            HDX_CHECK(cascade.texelSize > cascades.getCascade(i - 1).texelSize);
+        }
+    }
+}
+
+int main()
+{
+    testSplits();
+    testCascadesCoverTheirSlice();
+    testCenterSnapsToTexels();
+    testTexelSize();
+    return HDX_TEST_RESULT();
+}
\ No newline at end of file
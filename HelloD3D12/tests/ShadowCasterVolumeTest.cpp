@@ -0,0 +1,137 @@
+#include "Bvh.h"
+#include "ShadowCasterVolume.h"
+#include "TestHarness.h"
+
+#include <vector>
+
+using namespace HDX;
+
+static void multiply(const float* a, const float* b, float* result)
+{
+    for (int row = 0; row < 4; row++)
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            float sum = 0.f;
+            for (int k = 0; k < 4; k++)
+            {
+                sum += a[row * 4 + k] * b[k * 4 + column];
+            }
+            result[row * 4 + column] = sum;
+        }
+    }
+}
+
+// camera at the origin looking down +z, 90 degree field of view, near 0.1, far 100
+static Frustum makeCamera()
+{
+    const float n = 0.1f;
+    const float f = 100.f;
+    const float projection[16] = {
+        1.f, 0.f, 0.f, 0.f,
+        0.f, 1.f, 0.f, 0.f,
+        0.f, 0.f, f / (f - n), 1.f,
+        0.f, 0.f, -n * f / (f - n), 0.f
+    };
+    return Frustum::fromViewProjection(projection);
+}
+
+// light travelling down -y from y = 50, orthographic box x, z in [-20, 20] around (0, 0, 20), near 1, far 100
+static Frustum makeLight()
+{
+    const float view[16] = {
+        1.f, 0.f, 0.f, 0.f,
+        0.f, 0.f, -1.f, 0.f,
+        0.f, 1.f, 0.f, 0.f,
+        0.f, -20.f, 50.f, 1.f
+    };
+    const float l = -20.f, r = 20.f, b = -20.f, t = 20.f, n = 1.f, f = 100.f;
+    const float projection[16] = {
+        2.f / (r - l), 0.f, 0.f, 0.f,
+        0.f, 2.f / (t - b), 0.f, 0.f,
+        0.f, 0.f, 1.f / (f - n), 0.f,
+        (l + r) / (l - r), (t + b) / (b - t), n / (n - f), 1.f
+    };
+    float viewProjection[16];
+    multiply(view, projection, viewProjection);
+    return Frustum::fromViewProjection(viewProjection);
+}
+
+static float getFacing(const Plane& plane, const Float3& direction)
+{
+    return plane.normal.x * direction.x + plane.normal.y * direction.y + plane.normal.z * direction.z;
+}
+
+static void testPlanesFacingTheLightAreDropped()
+{
+    const Frustum camera = makeCamera();
+    const Frustum light = makeLight();
+    const Float3 down{ 0.f, -1.f, 0.f };
+
+    ShadowCasterVolume volume;
+    volume.build(light, camera, down);
+
+    // light: the far plane and the four sides, parallel to the light, camera: all but the top plane
+    HDX_CHECK(volume.getPlaneCount() == 10);
+    for (uint32_t i = 0; i < volume.getPlaneCount(); i++)
+    {
+        HDX_CHECK(getFacing(volume.getPlanes()[i], down) <= 1e-4f);
+    }
+}
+
+static void testEveryPlaneAwayFromTheLightIsKept()
+{
+    const Frustum camera = makeCamera();
+    const Frustum light = makeLight();
+    const Float3 directions[] = { { 0.f, 0.f, 1.f }, { 0.f, 0.f, -1.f }, { 0.6f, -0.8f, 0.f }, { 0.f, -0.6f, 0.8f } };
+    for (const Float3& direction : directions)
+    {
+        ShadowCasterVolume volume;
+        volume.build(light, camera, direction);
+
+        uint32_t expected = 0;
+        for (const Frustum* frustum : { &light, &camera })
+        {
+            for (const Plane& plane : frustum->planes)
+            {
+                expected += getFacing(plane, direction) <= 1e-4f ? 1 : 0;
+            }
+        }
+        HDX_CHECK(volume.getPlaneCount() == expected);
+        HDX_CHECK(volume.getPlaneCount() <= 2 * Frustum::SideCount);
+    }
+}
+
+static void testCastersOutsideTheVolumeAreCulled()
+{
+    ShadowCasterVolume volume;
+    volume.build(makeLight(), makeCamera(), { 0.f, -1.f, 0.f });
+
+    const Bounds casters[] = {
+        makeBounds({ -1.f, -1.f, 9.f }, { 1.f, 1.f, 11.f }),     // in view and in the light box
+        makeBounds({ -1.f, 60.f, 9.f }, { 1.f, 62.f, 11.f }),    // between the light and its near plane
+        makeBounds({ -1.f, -1.f, -30.f }, { 1.f, 1.f, -28.f }),  // behind the camera, outside the light box
+        makeBounds({ -1.f, 15.f, 9.f }, { 1.f, 17.f, 11.f }),    // above the view, its shadow falls into it
+        makeBounds({ -1.f, -40.f, 9.f }, { 1.f, -38.f, 11.f }),  // below the view, its shadow goes further down
+        makeBounds({ 30.f, -1.f, 9.f }, { 32.f, 1.f, 11.f }),    // beside the light box
+    };
+    const uint8_t expected[] = { 1, 1, 0, 1, 0, 0 };
+    const uint32_t count = static_cast<uint32_t>(sizeof(casters) / sizeof(casters[0]));
+
+    Bvh bvh;
+    bvh.build(casters, count);
+    std::vector<uint8_t> visible(count);
+    HDX_CHECK(bvh.cull(volume.getPlanes(), volume.getPlaneCount(), visible.data()) == 3);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        HDX_CHECK(visible[i] == expected[i]);
+    }
+}
+
+int main()
+{
+    testPlanesFacingTheLightAreDropped();
+    testEveryPlaneAwayFromTheLightIsKept();
+    testCastersOutsideTheVolumeAreCulled();
+    return HDX_TEST_RESULT();
+}
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "StagingRing.h"
+#include "TestHarness.h"
+
+#include <deque>
+#include <random>
+
+using namespace HDX;
+
+static void testAlignment()
+{
+    StagingRing ring(4096);
+    uint64_t offset = 1;
+    HDX_CHECK(ring.allocate(3, 1, offset) && offset == 0);
+    HDX_CHECK(ring.allocate(100, 256, offset) && offset == 256);
+    HDX_CHECK(ring.allocate(8, 16, offset) && offset == 368);
+    // the padding skipped for the alignment counts as used until it is reclaimed
+    HDX_CHECK(ring.getUsed() == 376);
+    HDX_CHECK(ring.getPending() == 376);
+}
+
+static void testRejectsWhatCannotFit()
+{
+    StagingRing ring(1024);
+    uint64_t offset = 0;
+    HDX_CHECK(!ring.allocate(1025, 1, offset));
+    HDX_CHECK(!ring.allocate(0, 1, offset));
+    HDX_CHECK(ring.getUsed() == 0);
+
+    HDX_CHECK(ring.allocate(1024, 1, offset) && offset == 0);
+    HDX_CHECK(!ring.allocate(1, 1, offset));
+}
+
+static void testRetirementByFenceValue()
+{
+    StagingRing ring(1024);
+    uint64_t offset = 0;
+    HDX_CHECK(ring.getOldestFenceValue() == 0);
+
+    HDX_CHECK(ring.allocate(100, 1, offset));
+    HDX_CHECK(ring.allocate(100, 1, offset));
+    ring.retire(5);
+    HDX_CHECK(ring.allocate(300, 1, offset));
+    ring.retire(7);
+    // nothing allocated since the last retire, no retirement is recorded
+    ring.retire(8);
+    HDX_CHECK(ring.getPending() == 0);
+    HDX_CHECK(ring.getOldestFenceValue() == 5);
+
+    ring.reclaim(4);
+    HDX_CHECK(ring.getUsed() == 500);
+    ring.reclaim(6);
+    HDX_CHECK(ring.getUsed() == 300);
+    HDX_CHECK(ring.getOldestFenceValue() == 7);
+    ring.reclaim(8);
+    HDX_CHECK(ring.getUsed() == 0);
+    HDX_CHECK(ring.getOldestFenceValue() == 0);
+
+    // an empty ring starts over at the beginning
+    HDX_CHECK(ring.allocate(800, 1, offset) && offset == 0);
+}
+
+static void testWraparound()
+{
+    StagingRing ring(1024);
+    uint64_t offset = 0;
+    HDX_CHECK(ring.allocate(400, 1, offset) && offset == 0);
+    ring.retire(1);
+    HDX_CHECK(ring.allocate(400, 1, offset) && offset == 400);
+    ring.retire(2);
+
+    // 224 bytes left before the end, the front is still in use
+    HDX_CHECK(!ring.allocate(300, 1, offset));
+    HDX_CHECK(ring.allocate(200, 1, offset) && offset == 800);
+    ring.retire(3);
+
+    ring.reclaim(1);
+    // does not fit in the last 24 bytes, wraps to the front and pays for the skipped tail
+    HDX_CHECK(ring.allocate(300, 1, offset) && offset == 0);
+    HDX_CHECK(ring.getUsed() == 600 + 24 + 300);
+    // the front is free up to the allocation of fence 2 only
+    HDX_CHECK(!ring.allocate(200, 1, offset));
+    HDX_CHECK(ring.allocate(100, 1, offset) && offset == 300);
+    ring.retire(4);
+
+    // the skipped tail was paid by the allocations of fence 4 and is released with them
+    ring.reclaim(3);
+    HDX_CHECK(ring.getUsed() == 24 + 300 + 100);
+    ring.reclaim(4);
+    HDX_CHECK(ring.getUsed() == 0);
+}
+
+// Random traffic against a list of live ranges: allocations stay inside the ring and never overlap a live one.
+static void testRandomTraffic()
+{
+    struct Range
+    {
+        uint64_t offset;
+        uint64_t size;
+        uint64_t fenceValue;
+    };
+
+    const uint64_t capacity = 64 * 1024;
+    StagingRing ring(capacity);
+    std::deque<Range> live;
+    std::mt19937 random(1);
+    uint64_t fenceValue = 1;
+    uint64_t completed = 0;
+    uint32_t overlaps = 0;
+    uint32_t allocations = 0;
+    for (int step = 0; step < 20000; step++)
+    {
+        const uint32_t operation = random() % 8;
+        if (operation < 5)
+        {
+            const uint64_t size = 1 + random() % 4096;
+            const uint64_t alignment = 1ull << (random() % 9);
+            uint64_t offset = 0;
+            if (!ring.allocate(size, alignment, offset))
+            {
+                continue;
+            }
+            allocations++;
+            overlaps += offset % alignment != 0 || offset + size > capacity ? 1 : 0;
+            for (const Range& range : live)
+            {
+                overlaps += offset < range.offset + range.size && range.offset < offset + size ? 1 : 0;
+            }
+            live.push_back({ offset, size, fenceValue });
+        }
+        else if (operation < 7)
+        {
+            ring.retire(fenceValue++);
+        }
+        else if (completed + 1 < fenceValue)
+        {
+            completed += 1 + random() % (fenceValue - completed - 1);
+            ring.reclaim(completed);
+            while (!live.empty() && live.front().fenceValue <= completed)
+            {
+                live.pop_front();
+            }
+        }
+        HDX_CHECK(ring.getUsed() <= capacity);
+    }
+    HDX_CHECK(allocations > 1000);
+    HDX_CHECK(overlaps == 0);
+}
+
+int main()
+{
+    testAlignment();
+    testRejectsWhatCannotFit();
+    testRetirementByFenceValue();
+    testWraparound();
+    testRandomTraffic();
+    return HDX_TEST_RESULT();
+}
\ No newline at end of file
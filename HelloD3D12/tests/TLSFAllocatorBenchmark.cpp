@@ -0,0 +1,215 @@
+#include "TLSFAllocator.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace HDX;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static const uint64_t Capacity{ 64ull << 20 };
+static const int OperationCount{ 2000000 };
+
+// First fit over a map of free ranges by offset, the simple allocator TLSF is measured against.
+class FirstFitAllocator
+{
+public:
+    explicit FirstFitAllocator(uint64_t capacity) : mCapacity(capacity) { mFree[0] = capacity; }
+
+    bool allocate(uint64_t size, uint64_t alignment, uint64_t& offset)
+    {
+        for (auto range = mFree.begin(); range != mFree.end(); ++range)
+        {
+            const uint64_t start = (range->first + alignment - 1) & ~(alignment - 1);
+            if (start + size > range->first + range->second)
+            {
+                continue;
+            }
+
+            const uint64_t rangeOffset = range->first;
+            const uint64_t rangeEnd = range->first + range->second;
+            mFree.erase(range);
+            if (start > rangeOffset)
+            {
+                mFree[rangeOffset] = start - rangeOffset;
+            }
+            if (start + size < rangeEnd)
+            {
+                mFree[start + size] = rangeEnd - start - size;
+            }
+            mUsed += size;
+            offset = start;
+            return true;
+        }
+        return false;
+    }
+
+    void free(uint64_t offset, uint64_t size)
+    {
+        mUsed -= size;
+        auto next = mFree.lower_bound(offset);
+        if (next != mFree.end() && offset + size == next->first)
+        {
+            size += next->second;
+            next = mFree.erase(next);
+        }
+        if (next != mFree.begin())
+        {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset)
+            {
+                previous->second += size;
+                return;
+            }
+        }
+        mFree[offset] = size;
+    }
+
+    float getFragmentation() const
+    {
+        uint64_t largest = 0;
+        for (const auto& range : mFree)
+        {
+            largest = range.second > largest ? range.second : largest;
+        }
+        const uint64_t freeBytes = mCapacity - mUsed;
+        return freeBytes ? 1.f - static_cast<float>(static_cast<double>(largest) / freeBytes) : 0.f;
+    }
+
+    uint64_t getUsed() const { return mUsed; }
+    size_t getFreeBlockCount() const { return mFree.size(); }
+
+private:
+    uint64_t mCapacity;
+    uint64_t mUsed{ 0 };
+    std::map<uint64_t, uint64_t> mFree;
+};
+
+struct Request
+{
+    // percent roll deciding between an allocation and a free
+    uint32_t roll;
+    uint64_t size;
+    uint64_t alignment;
+    // live allocation freed, picked when replaying
+    uint32_t victim;
+};
+
+// Resource sized churn on one 64 MB heap block: small buffers at 256 bytes, buffers and textures at 64 KB,
+// 1 in 20 a 1 to 5 MB texture at 4 MB.
+static std::vector<Request> makeRequests()
+{
+    std::mt19937 random(1);
+    std::vector<Request> requests(OperationCount);
+    for (Request& request : requests)
+    {
+        request.roll = random() % 100;
+        const uint32_t kind = random() % 20;
+        if (kind == 0)
+        {
+            request.size = (1ull << 20) + random() % (4u << 20);
+            request.alignment = 4ull << 20;
+        }
+        else if (kind < 10)
+        {
+            request.size = 256ull + random() % (64u << 10);
+            request.alignment = 256;
+        }
+        else
+        {
+            request.size = (64ull << 10) * (1 + random() % 16);
+            request.alignment = 64ull << 10;
+        }
+        request.victim = random();
+    }
+    return requests;
+}
+
+struct TLSFAdapter
+{
+    typedef TLSFAllocator::Allocation Allocation;
+
+    TLSFAllocator allocator{ Capacity };
+
+    bool allocate(const Request& request, Allocation& allocation) { return allocator.allocate(request.size, request.alignment, allocation); }
+    void free(const Allocation& allocation) { allocator.free(allocation.handle); }
+    uint64_t getUsed() const { return allocator.getUsed(); }
+    float getFragmentation() const { return allocator.getFragmentation(); }
+};
+
+struct FirstFitAdapter
+{
+    typedef std::pair<uint64_t, uint64_t> Allocation;
+
+    FirstFitAllocator allocator{ Capacity };
+
+    bool allocate(const Request& request, Allocation& allocation)
+    {
+        allocation.second = request.size;
+        return allocator.allocate(request.size, request.alignment, allocation.first);
+    }
+    void free(const Allocation& allocation) { allocator.free(allocation.first, allocation.second); }
+    uint64_t getUsed() const { return allocator.getUsed(); }
+    float getFragmentation() const { return allocator.getFragmentation(); }
+};
+
+// The heap is kept around 75% full: allocations are more likely below it and frees above it. Fragmentation is
+// sampled every SampleInterval operations, outside the timing.
+template <typename Adapter>
+static void run(const char* name, const std::vector<Request>& requests)
+{
+    static const int SampleInterval{ 1000 };
+
+    Adapter adapter;
+    std::vector<typename Adapter::Allocation> live;
+    uint32_t failures = 0;
+    double fragmentation = 0.;
+    uint32_t samples = 0;
+    double seconds = 0.;
+    for (size_t first = 0; first < requests.size(); first += SampleInterval)
+    {
+        const Clock::time_point start = Clock::now();
+        for (size_t i = first; i < first + SampleInterval && i < requests.size(); i++)
+        {
+            const Request& request = requests[i];
+            const uint32_t allocatePercent = adapter.getUsed() < Capacity * 3 / 4 ? 60 : 40;
+            if (request.roll < allocatePercent || live.empty())
+            {
+                typename Adapter::Allocation allocation;
+                if (adapter.allocate(request, allocation))
+                {
+                    live.push_back(allocation);
+                }
+                else
+                {
+                    failures++;
+                }
+            }
+            else
+            {
+                const size_t index = request.victim % live.size();
+                adapter.free(live[index]);
+                live[index] = live.back();
+                live.pop_back();
+            }
+        }
+        seconds += std::chrono::duration<double>(Clock::now() - start).count();
+        fragmentation += adapter.getFragmentation();
+        samples++;
+    }
+    printf("%-28s %8.1f ns/op, %u failed allocations, mean fragmentation %.3f\n", name, seconds * 1e9 / requests.size(),
+        failures, fragmentation / samples);
+}
+
+int main()
+{
+    const std::vector<Request> requests = makeRequests();
+    printf("%d operations on a %llu MB range\n", OperationCount, static_cast<unsigned long long>(Capacity >> 20));
+    run<TLSFAdapter>("TLSF", requests);
+    run<FirstFitAdapter>("first fit (std::map)", requests);
+    return 0;
+}
\ No newline at end of file
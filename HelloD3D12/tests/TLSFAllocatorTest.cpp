@@ -0,0 +1,190 @@
+#include "TLSFAllocator.h"
+#include "TestHarness.h"
+
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace HDX;
+
+typedef TLSFAllocator::Allocation Allocation;
+
+static void testAlignment()
+{
+    TLSFAllocator allocator(1 << 20);
+    Allocation allocation;
+    HDX_CHECK(allocator.allocate(3, 1, allocation) && allocation.offset == 0 && allocation.size == 3);
+    for (uint64_t alignment = 1; alignment <= 65536; alignment <<= 1)
+    {
+        HDX_CHECK(allocator.allocate(100, alignment, allocation));
+        HDX_CHECK(allocation.offset % alignment == 0);
+        HDX_CHECK(allocation.size == 100);
+    }
+    // the padding skipped for the alignment stays free and is handed out again
+    HDX_CHECK(allocator.getUsed() == 3 + 17 * 100);
+    HDX_CHECK(allocator.allocate(8, 8, allocation) && allocation.offset < 65536);
+}
+
+static void testRejectsWhatCannotFit()
+{
+    TLSFAllocator allocator(4096);
+    Allocation allocation;
+    HDX_CHECK(!allocator.allocate(0, 1, allocation));
+    HDX_CHECK(!allocator.allocate(4097, 1, allocation));
+    HDX_CHECK(allocator.allocate(4096, 4096, allocation) && allocation.offset == 0);
+    HDX_CHECK(allocator.getFree() == 0 && allocator.getFreeBlockCount() == 0);
+    HDX_CHECK(!allocator.allocate(1, 1, allocation));
+    allocator.free(allocation.handle);
+    HDX_CHECK(allocator.isEmpty());
+
+    // enough free bytes, but not at the alignment
+    HDX_CHECK(allocator.allocate(1, 1, allocation));
+    HDX_CHECK(!allocator.allocate(4095, 2, allocation));
+    HDX_CHECK(allocator.allocate(4095, 1, allocation) && allocation.offset == 1);
+
+    TLSFAllocator none(0);
+    HDX_CHECK(!none.allocate(1, 1, allocation));
+    HDX_CHECK(none.getLargestFreeBlock() == 0 && none.getFragmentation() == 0.f);
+}
+
+static void testCoalescingOnFree()
+{
+    TLSFAllocator allocator(4096);
+    Allocation blocks[4];
+    for (Allocation& block : blocks)
+    {
+        HDX_CHECK(allocator.allocate(1024, 1, block));
+    }
+    HDX_CHECK(allocator.getFreeBlockCount() == 0);
+
+    // neighbours that are both in use keep a freed block on its own
+    allocator.free(blocks[1].handle);
+    HDX_CHECK(allocator.getFreeBlockCount() == 1 && allocator.getLargestFreeBlock() == 1024);
+    // merges with the free block before it
+    allocator.free(blocks[2].handle);
+    HDX_CHECK(allocator.getFreeBlockCount() == 1 && allocator.getLargestFreeBlock() == 2048);
+    // merges with the free block after it
+    allocator.free(blocks[0].handle);
+    HDX_CHECK(allocator.getFreeBlockCount() == 1 && allocator.getLargestFreeBlock() == 3072);
+
+    Allocation merged;
+    HDX_CHECK(allocator.allocate(3072, 1, merged) && merged.offset == 0);
+    allocator.free(merged.handle);
+
+    // merges on both sides at once
+    Allocation first;
+    Allocation middle;
+    Allocation last;
+    HDX_CHECK(allocator.allocate(1024, 1, first));
+    HDX_CHECK(allocator.allocate(1024, 1, middle));
+    HDX_CHECK(allocator.allocate(1024, 1, last));
+    allocator.free(first.handle);
+    allocator.free(last.handle);
+    HDX_CHECK(allocator.getFreeBlockCount() == 2);
+    allocator.free(middle.handle);
+    allocator.free(blocks[3].handle);
+    HDX_CHECK(allocator.isEmpty());
+    HDX_CHECK(allocator.getFreeBlockCount() == 1 && allocator.getLargestFreeBlock() == 4096);
+}
+
+static void testFragmentation()
+{
+    TLSFAllocator allocator(16 * 1024);
+    HDX_CHECK(allocator.getFragmentation() == 0.f);
+
+    Allocation blocks[16];
+    for (Allocation& block : blocks)
+    {
+        HDX_CHECK(allocator.allocate(1024, 1, block));
+    }
+    HDX_CHECK(allocator.getFragmentation() == 0.f);
+
+    // every other block free, 8 KB free as 8 blocks of 1 KB
+    for (uint32_t i = 0; i < 16; i += 2)
+    {
+        allocator.free(blocks[i].handle);
+    }
+    HDX_CHECK(allocator.getFree() == 8 * 1024 && allocator.getLargestFreeBlock() == 1024);
+    HDX_CHECK_NEAR(allocator.getFragmentation(), 7.f / 8.f, 1e-6f);
+    Allocation allocation;
+    HDX_CHECK(!allocator.allocate(2048, 1, allocation));
+
+    // freeing the first half joins 4 free blocks and the 4 blocks between them into 7 KB
+    for (uint32_t i = 1; i < 7; i += 2)
+    {
+        allocator.free(blocks[i].handle);
+    }
+    HDX_CHECK(allocator.getLargestFreeBlock() == 7 * 1024);
+    HDX_CHECK_NEAR(allocator.getFragmentation(), 1.f - 7.f / 11.f, 1e-6f);
+    HDX_CHECK(allocator.allocate(7 * 1024, 1, allocation) && allocation.offset == 0);
+}
+
+// random allocations and frees checked against a map of the live ranges
+static void testRandomTraffic()
+{
+    const uint64_t Capacity{ 64ull << 20 };
+    TLSFAllocator allocator(Capacity);
+    std::mt19937_64 random(7);
+    std::vector<Allocation> live;
+    std::map<uint64_t, uint64_t> ranges;
+    uint64_t used = 0;
+    uint32_t overlaps = 0;
+    uint32_t misaligned = 0;
+    for (int i = 0; i < 50000; i++)
+    {
+        if (live.empty() || random() % 100 < 55)
+        {
+            const uint64_t size = random() % 3 == 0 ? random() % (1 << 20) + 1 : random() % 65536 + 1;
+            const uint64_t alignment = 1ull << (random() % 17);
+            Allocation allocation;
+            if (!allocator.allocate(size, alignment, allocation))
+            {
+                continue;
+            }
+
+            misaligned += allocation.offset % alignment != 0 || allocation.offset + size > Capacity ? 1 : 0;
+            auto next = ranges.lower_bound(allocation.offset);
+            overlaps += next != ranges.end() && next->first < allocation.offset + size ? 1 : 0;
+            if (next != ranges.begin())
+            {
+                auto previous = std::prev(next);
+                overlaps += previous->first + previous->second > allocation.offset ? 1 : 0;
+            }
+            ranges[allocation.offset] = size;
+            used += size;
+            live.push_back(allocation);
+        }
+        else
+        {
+            const size_t index = random() % live.size();
+            allocator.free(live[index].handle);
+            ranges.erase(live[index].offset);
+            used -= live[index].size;
+            live[index] = live.back();
+            live.pop_back();
+        }
+    }
+    HDX_CHECK(overlaps == 0);
+    HDX_CHECK(misaligned == 0);
+    HDX_CHECK(allocator.getUsed() == used);
+    HDX_CHECK(allocator.getAllocationCount() == live.size());
+    HDX_CHECK(allocator.getFragmentation() >= 0.f && allocator.getFragmentation() < 1.f);
+
+    for (const Allocation& allocation : live)
+    {
+        allocator.free(allocation.handle);
+    }
+    HDX_CHECK(allocator.isEmpty() && allocator.getUsed() == 0);
+    HDX_CHECK(allocator.getFreeBlockCount() == 1 && allocator.getLargestFreeBlock() == Capacity);
+}
+
+int main()
+{
+    testAlignment();
+    testRejectsWhatCannotFit();
+    testCoalescingOnFree();
+    testFragmentation();
+    testRandomTraffic();
+    return HDX_TEST_RESULT();
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal checks for the unit tests, a failed check is reported and the test keeps going. main returns
+// HDX_TEST_RESULT() so ctest sees the failures.
+namespace HDX
+{
+namespace Test
+{
+
+inline int& getFailureCount()
+{
+    static int failures = 0;
+    return failures;
+}
+
+inline void reportFailure(const char* file, int line, const char* expression)
+{
+    std::printf("%s(%d): check failed: %s\n", file, line, expression);
+    getFailureCount()++;
+}
+
+}
+}
+
+#define HDX_CHECK(expression) \
+    do { if (!(expression)) { HDX::Test::reportFailure(__FILE__, __LINE__, #expression); } } while (0)
+
+#define HDX_CHECK_NEAR(a, b, tolerance) \
+    HDX_CHECK(((a) - (b)) <= (tolerance) && ((b) - (a)) <= (tolerance))
+
+#define HDX_TEST_RESULT() \
+    (std::printf("%d failed checks\n", HDX::Test::getFailureCount()), HDX::Test::getFailureCount() == 0 ? 0 : 1)